@@ -70,6 +70,9 @@ if(WITH_CPP)
     find_package(Libevent QUIET)
     CMAKE_DEPENDENT_OPTION(WITH_LIBEVENT "Build with libevent support" ON
                            "Libevent_FOUND" OFF)
+    find_package(NGHTTP2 QUIET)
+    CMAKE_DEPENDENT_OPTION(WITH_NGHTTP2 "Build with nghttp2 (HTTP/2) support" ON
+                           "NGHTTP2_FOUND" OFF)
     find_package(Qt5 QUIET COMPONENTS Core Network)
     CMAKE_DEPENDENT_OPTION(WITH_QT5 "Build with Qt5 support" ON
                            "Qt5_FOUND" OFF)
@@ -183,6 +186,7 @@ if (BUILD_CPP)
     message(STATUS "    C++ Language Level:                       ${CXX_LANGUAGE_LEVEL}")
     message(STATUS "    Build shared libraries:                   ${BUILD_SHARED_LIBS}")
     message(STATUS "    Build with libevent support:              ${WITH_LIBEVENT}")
+    message(STATUS "    Build with nghttp2 support:               ${WITH_NGHTTP2}")
     message(STATUS "    Build with Qt5 support:                   ${WITH_QT5}")
     message(STATUS "    Build with ZLIB support:                  ${WITH_ZLIB}")
 endif ()
@@ -0,0 +1,39 @@
+# find nghttp2
+# an HTTP/2 C library (https://nghttp2.org/)
+#
+# Usage:
+# NGHTTP2_INCLUDE_DIRS, where to find nghttp2 headers
+# NGHTTP2_LIBRARIES, nghttp2 libraries
+# NGHTTP2_FOUND, If false, do not try to use nghttp2
+
+set(NGHTTP2_ROOT CACHE PATH "Root directory of nghttp2 installation")
+set(NGHTTP2_EXTRA_PREFIXES /usr/local /opt/local "$ENV{HOME}" ${NGHTTP2_ROOT})
+foreach(prefix ${NGHTTP2_EXTRA_PREFIXES})
+  list(APPEND NGHTTP2_INCLUDE_PATHS "${prefix}/include")
+  list(APPEND NGHTTP2_LIBRARIES_PATHS "${prefix}/lib")
+endforeach()
+
+find_path(NGHTTP2_INCLUDE_DIRS nghttp2/nghttp2.h PATHS ${NGHTTP2_INCLUDE_PATHS})
+find_library(NGHTTP2_LIBRARIES NAMES nghttp2 libnghttp2 PATHS ${NGHTTP2_LIBRARIES_PATHS})
+
+if (NGHTTP2_LIBRARIES AND NGHTTP2_INCLUDE_DIRS)
+  set(NGHTTP2_FOUND TRUE)
+else ()
+  set(NGHTTP2_FOUND FALSE)
+endif ()
+
+if (NGHTTP2_FOUND)
+  if (NOT NGHTTP2_FIND_QUIETLY)
+    message(STATUS "Found nghttp2: ${NGHTTP2_LIBRARIES}")
+  endif ()
+else ()
+  if (NGHTTP2_FIND_REQUIRED)
+    message(FATAL_ERROR "Could NOT find nghttp2.")
+  endif ()
+  message(STATUS "nghttp2 NOT found.")
+endif ()
+
+mark_as_advanced(
+    NGHTTP2_LIBRARIES
+    NGHTTP2_INCLUDE_DIRS
+  )
@@ -21,6 +21,7 @@
  * details.
  */
 
+#include <algorithm>
 #include <cassert>
 
 #include <fstream>
@@ -68,6 +69,9 @@ public:
     gen_moveable_ = false;
     gen_no_ostream_operators_ = false;
     gen_no_skeleton_ = false;
+    gen_reflection_ = false;
+    gen_table_driven_ = false;
+    gen_simple_json_ = false;
     has_members_ = false;
 
     for( iter = parsed_options.begin(); iter != parsed_options.end(); ++iter) {
@@ -90,6 +94,13 @@ public:
         gen_no_ostream_operators_ = true;
       } else if ( iter->first.compare("no_skeleton") == 0) {
         gen_no_skeleton_ = true;
+      } else if ( iter->first.compare("reflection") == 0) {
+        gen_reflection_ = true;
+      } else if ( iter->first.compare("table_driven") == 0) {
+        gen_reflection_ = true;
+        gen_table_driven_ = true;
+      } else if ( iter->first.compare("simple_json") == 0) {
+        gen_simple_json_ = true;
       } else {
         throw "unknown option cpp:" + iter->first;
       }
@@ -153,6 +164,17 @@ public:
   void generate_move_assignment_operator(std::ostream& out, t_struct* tstruct);
   void generate_assignment_helper(std::ostream& out, t_struct* tstruct, bool is_move);
   void generate_struct_reader(std::ostream& out, t_struct* tstruct, bool pointers = false);
+  void generate_field_name_table(std::ostream& out, t_struct* tstruct);
+  void generate_struct_descriptor(std::ostream& out, t_struct* tstruct);
+  void generate_table_driven_reader(std::ostream& out, t_struct* tstruct);
+  void generate_lazy_field_helpers(std::ostream& out, t_struct* tstruct);
+  bool has_lazy_fields(t_program* program);
+  void generate_table_driven_writer(std::ostream& out, t_struct* tstruct);
+  bool is_generic_type(t_type* ttype);
+  bool is_generic_struct(t_struct* tstruct);
+  std::string generate_type_descriptor(t_type* ttype,
+                                       const std::string& table,
+                                       std::vector<std::string>& entries);
   void generate_struct_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_result_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_swap(std::ostream& out, t_struct* tstruct);
@@ -266,6 +288,10 @@ public:
 
   bool is_reference(t_field* tfield) { return tfield->get_reference(); }
 
+  bool is_lazy(t_field* tfield) {
+    return tfield->annotations_.find("cpp.lazy") != tfield->annotations_.end();
+  }
+
   bool is_complex_type(t_type* ttype) {
     ttype = get_true_type(ttype);
 
@@ -365,6 +391,21 @@ private:
    */
   bool gen_no_skeleton_;
 
+  /**
+   * True if we should generate a TStructDescriptor for each struct.
+   */
+  bool gen_reflection_;
+
+  /**
+   * True if generated read() and write() methods should use TTableSerializer.
+   */
+  bool gen_table_driven_;
+
+  /**
+   * True if generated read() methods should accept fields identified by name.
+   */
+  bool gen_simple_json_;
+
   /**
    * True if thrift has member(s)
    */
@@ -439,8 +480,18 @@ void t_cpp_generator::init_generator() {
            << "#include <thrift/Thrift.h>" << endl
            << "#include <thrift/TApplicationException.h>" << endl
            << "#include <thrift/TBase.h>" << endl
-           << "#include <thrift/protocol/TProtocol.h>" << endl
-           << "#include <thrift/transport/TTransport.h>" << endl
+           << "#include <thrift/protocol/TProtocol.h>" << endl;
+  if (gen_simple_json_) {
+    f_types_ << "#include <thrift/protocol/TFieldNameTable.h>" << endl;
+  }
+  if (gen_reflection_) {
+    f_types_ << "#include <thrift/protocol/TFieldMask.h>" << endl
+             << "#include <thrift/protocol/TTypeDescriptor.h>" << endl;
+  }
+  if (has_lazy_fields(program_)) {
+    f_types_ << "#include <thrift/protocol/TLazyField.h>" << endl;
+  }
+  f_types_ << "#include <thrift/transport/TTransport.h>" << endl
            << endl;
   // Include C++xx compatibility header
   f_types_ << "#include <functional>" << endl;
@@ -480,7 +531,14 @@ void t_cpp_generator::init_generator() {
   f_types_impl_ << "#include <algorithm>" << endl;
   // for operator<<
   f_types_impl_ << "#include <ostream>" << endl << endl;
-  f_types_impl_ << "#include <thrift/TToString.h>" << endl << endl;
+  f_types_impl_ << "#include <thrift/TToString.h>" << endl;
+  if (gen_reflection_) {
+    f_types_impl_ << "#include <thrift/protocol/TTableSerializer.h>" << endl;
+  }
+  if (gen_table_driven_) {
+    f_types_tcc_ << "#include <thrift/protocol/TTableSerializer.h>" << endl << endl;
+  }
+  f_types_impl_ << endl;
 
   // Open namespace
   ns_open_ = namespace_open(program_->get_namespace("cpp"));
@@ -906,8 +964,14 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
   generate_struct_definition(f_types_impl_, f_types_impl_, tstruct, true, true);
 
   std::ostream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
-  generate_struct_reader(out, tstruct);
-  generate_struct_writer(out, tstruct);
+  generate_lazy_field_helpers(out, tstruct);
+  if (gen_table_driven_ && is_generic_struct(tstruct)) {
+    generate_table_driven_reader(out, tstruct);
+    generate_table_driven_writer(out, tstruct);
+  } else {
+    generate_struct_reader(out, tstruct);
+    generate_struct_writer(out, tstruct);
+  }
   generate_struct_swap(f_types_impl_, tstruct);
   generate_copy_constructor(f_types_impl_, tstruct, is_exception);
   if (gen_moveable_) {
@@ -926,6 +990,10 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
     generate_exception_what_method(f_types_impl_, tstruct);
   }
 
+  if (gen_reflection_) {
+    generate_struct_descriptor(f_types_impl_, tstruct);
+  }
+
   has_members_ = true;
 }
 
@@ -1205,7 +1273,10 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
       if (!t->is_base_type()) {
         t_const_value* cv = (*m_iter)->get_value();
         if (cv != nullptr) {
-          print_const_value(out, (*m_iter)->get_name(), t, cv);
+          print_const_value(out,
+                            (*m_iter)->get_name() + (is_lazy(*m_iter) ? ".mutate()" : ""),
+                            t,
+                            cv);
         }
       }
     }
@@ -1309,6 +1380,13 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
   }
   out << endl;
 
+  if (is_user_struct && gen_reflection_) {
+    out << indent() << "static const ::apache::thrift::protocol::TStructDescriptor __descriptor;"
+        << endl << endl;
+    out << indent() << "uint32_t readPartial(::apache::thrift::protocol::TProtocol* iprot, "
+        << "const ::apache::thrift::protocol::TFieldMask& mask);" << endl << endl;
+  }
+
   if (is_user_struct && !has_custom_ostream(tstruct)) {
     out << indent() << "virtual ";
     generate_struct_print_method_decl(out, nullptr);
@@ -1393,6 +1471,388 @@ void t_cpp_generator::generate_struct_definition(ostream& out,
   out << endl;
 }
 
+namespace {
+// Must match TFieldNameTable::hash() in the C++ library
+uint32_t field_name_hash(const string& name, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  for (char c : name) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 16777619u;
+  }
+  h ^= h >> 13;
+  h *= 0x5bd1e995u;
+  return h ^ (h >> 15);
+}
+}
+
+/**
+ * Emits the TFieldNameTable of a struct as function-local statics named
+ * fieldNames, fieldSlots and fieldNameTable. The slots form a perfect hash
+ * of the field names: the smallest power of two table, and the first seed,
+ * for which no two names collide.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct, which must have fields
+ */
+void t_cpp_generator::generate_field_name_table(ostream& out, t_struct* tstruct) {
+  const vector<t_field*>& fields = tstruct->get_members();
+  vector<t_field*>::const_iterator f_iter;
+
+  vector<int> slots;
+  uint32_t size = 1;
+  uint32_t seed = 0;
+  while (size < fields.size()) {
+    size <<= 1;
+  }
+  for (bool found = false; !found;) {
+    for (seed = 0; seed < 4096 && !found; ++seed) {
+      slots.assign(size, -1);
+      found = true;
+      for (size_t i = 0; i < fields.size() && found; ++i) {
+        int& slot = slots[field_name_hash(fields[i]->get_name(), seed) & (size - 1)];
+        found = (slot == -1);
+        slot = static_cast<int>(i);
+      }
+    }
+    if (!found) {
+      size <<= 1;
+    }
+  }
+  --seed; // undo the loop's increment past the seed that worked
+
+  indent(out) << "static const ::apache::thrift::protocol::TFieldName fieldNames[] = {" << endl;
+  indent_up();
+  for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+    indent(out) << "{\"" << (*f_iter)->get_name() << "\", " << (*f_iter)->get_key() << ", "
+                << type_to_enum((*f_iter)->get_type()) << "}," << endl;
+  }
+  indent_down();
+  indent(out) << "};" << endl;
+  indent(out) << "static const int16_t fieldSlots[] = {";
+  for (size_t i = 0; i < slots.size(); ++i) {
+    if (i % 16 == 0) {
+      out << endl << indent() << "  ";
+    }
+    out << slots[i] << (i + 1 < slots.size() ? "," : "");
+    if (i % 16 != 15 && i + 1 < slots.size()) {
+      out << " ";
+    }
+  }
+  out << endl << indent() << "};" << endl;
+  indent(out) << "static const ::apache::thrift::protocol::TFieldNameTable fieldNameTable = "
+              << "{fieldNames, fieldSlots, " << (size - 1) << "u, " << seed << "u};" << endl;
+}
+
+/**
+ * Adds the TTypeDescriptor of a type, and those of the types it is made of,
+ * to the entries of the table named table, reusing identical entries.
+ *
+ * @param ttype The type
+ * @param table Name of the array the entries will be emitted as
+ * @param entries Initializers of the array so far
+ * @return Address of the type's entry
+ */
+string t_cpp_generator::generate_type_descriptor(t_type* ttype,
+                                                 const string& table,
+                                                 vector<string>& entries) {
+  ttype = get_true_type(ttype);
+
+  string elem = "nullptr";
+  string value = "nullptr";
+  string struct_type = "nullptr";
+  string ops = "nullptr";
+  if (ttype->is_map()) {
+    elem = generate_type_descriptor(((t_map*)ttype)->get_key_type(), table, entries);
+    value = generate_type_descriptor(((t_map*)ttype)->get_val_type(), table, entries);
+    ops = "TMapOps";
+  } else if (ttype->is_set()) {
+    elem = generate_type_descriptor(((t_set*)ttype)->get_elem_type(), table, entries);
+    ops = "TSetOps";
+  } else if (ttype->is_list()) {
+    elem = generate_type_descriptor(((t_list*)ttype)->get_elem_type(), table, entries);
+    ops = "TListOps";
+  } else if (ttype->is_struct() || ttype->is_xception()) {
+    struct_type = "&" + type_name(ttype) + "::__descriptor";
+  }
+  if (ttype->is_container()) {
+    ops = is_generic_type(ttype)
+              ? "&::apache::thrift::protocol::" + ops + "<" + type_name(ttype) + ">::ops"
+              : "nullptr";
+  }
+
+  string entry = "{" + type_to_enum(ttype) + ", " + (ttype->is_binary() ? "true" : "false")
+                 + ", " + elem + ", " + value + ", " + struct_type + ", " + ops + "}";
+  size_t index = std::find(entries.begin(), entries.end(), entry) - entries.begin();
+  if (index == entries.size()) {
+    entries.push_back(entry);
+  }
+  return "&" + table + "[" + std::to_string(index) + "]";
+}
+
+/**
+ * Defines the static __descriptor member of a struct, along with the type
+ * descriptors and __isset accessors it points to.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_struct_descriptor(ostream& out, t_struct* tstruct) {
+  const string& name = tstruct->get_name();
+  const vector<t_field*>& fields = tstruct->get_sorted_members();
+  vector<t_field*>::const_iterator f_iter;
+
+  bool has_isset = false;
+  for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+    if ((*f_iter)->get_req() != t_field::T_REQUIRED) {
+      has_isset = true;
+    }
+  }
+
+  vector<string> types;
+  vector<string> field_types;
+  for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+    field_types.push_back(generate_type_descriptor((*f_iter)->get_type(),
+                                                   "_" + name + "__types",
+                                                   types));
+  }
+
+  // The generated classes are not standard-layout, for which offsetof() is
+  // conditionally supported; every compiler Thrift supports handles it.
+  out << "#if defined(__GNUC__)" << endl
+      << "#pragma GCC diagnostic push" << endl
+      << "#pragma GCC diagnostic ignored \"-Winvalid-offsetof\"" << endl
+      << "#endif" << endl << endl;
+
+  if (!types.empty()) {
+    indent(out) << "static constexpr ::apache::thrift::protocol::TTypeDescriptor _" << name
+                << "__types[" << types.size() << "] = {" << endl;
+    indent_up();
+    for (const auto& type : types) {
+      indent(out) << type << "," << endl;
+    }
+    indent_down();
+    indent(out) << "};" << endl << endl;
+
+    indent(out) << "static constexpr ::apache::thrift::protocol::TFieldDescriptor _" << name
+                << "__fields[] = {" << endl;
+    indent_up();
+    for (size_t i = 0; i < fields.size(); ++i) {
+      t_field* field = fields[i];
+      string req = field->get_req() == t_field::T_REQUIRED
+                       ? "T_REQUIRED_FIELD"
+                       : field->get_req() == t_field::T_OPTIONAL ? "T_OPTIONAL_FIELD"
+                                                                 : "T_DEFAULT_FIELD";
+      indent(out) << "{" << field->get_key() << ", ::apache::thrift::protocol::" << req
+                  << ", \"" << field->get_name() << "\", " << field_types[i] << ", offsetof("
+                  << name << ", " << field->get_name() << "), "
+                  << (is_reference(field) ? "true" : "false") << ", "
+                  << (is_lazy(field) ? "true" : "false") << "}," << endl;
+    }
+    indent_down();
+    indent(out) << "};" << endl << endl;
+  }
+
+  string obj = has_isset ? "obj" : "/* obj */";
+  indent(out) << "static bool _" << name << "__isSet(const void* " << obj << ", uint32_t "
+              << (has_isset ? "index" : "/* index */") << ") {" << endl;
+  indent_up();
+  if (has_isset) {
+    indent(out) << "const " << name << "& self = *static_cast<const " << name << "*>(obj);" << endl;
+    indent(out) << "switch (index) {" << endl;
+    for (size_t i = 0; i < fields.size(); ++i) {
+      if (fields[i]->get_req() != t_field::T_REQUIRED) {
+        indent(out) << "case " << i << ": return self.__isset." << fields[i]->get_name() << ";"
+                    << endl;
+      }
+    }
+    indent(out) << "}" << endl;
+  }
+  indent(out) << "return true;" << endl;
+  scope_down(out);
+  out << endl;
+
+  indent(out) << "static void _" << name << "__setIsSet(void* " << obj << ", uint32_t "
+              << (has_isset ? "index" : "/* index */") << ", bool "
+              << (has_isset ? "value" : "/* value */") << ") {" << endl;
+  indent_up();
+  if (has_isset) {
+    indent(out) << name << "& self = *static_cast<" << name << "*>(obj);" << endl;
+    indent(out) << "switch (index) {" << endl;
+    for (size_t i = 0; i < fields.size(); ++i) {
+      if (fields[i]->get_req() != t_field::T_REQUIRED) {
+        indent(out) << "case " << i << ": self.__isset." << fields[i]->get_name()
+                    << " = value; break;" << endl;
+      }
+    }
+    indent(out) << "}" << endl;
+  }
+  scope_down(out);
+  out << endl;
+
+  indent(out) << "static uint32_t _" << name
+              << "__read(::apache::thrift::protocol::TProtocol* iprot, void* obj) {" << endl;
+  indent(out) << "  return static_cast<" << name << "*>(obj)->read(iprot);" << endl;
+  indent(out) << "}" << endl << endl;
+
+  indent(out) << "static uint32_t _" << name
+              << "__write(::apache::thrift::protocol::TProtocol* oprot, const void* obj) {"
+              << endl;
+  indent(out) << "  return static_cast<const " << name << "*>(obj)->write(oprot);" << endl;
+  indent(out) << "}" << endl << endl;
+
+  indent(out) << "uint32_t " << name << "::readPartial(::apache::thrift::protocol::TProtocol* iprot, "
+              << "const ::apache::thrift::protocol::TFieldMask& mask) {" << endl;
+  indent(out) << "  return ::apache::thrift::protocol::TTableSerializer::readPartial(iprot, "
+              << "__descriptor, mask, this);" << endl;
+  indent(out) << "}" << endl << endl;
+
+  indent(out) << "const ::apache::thrift::protocol::TStructDescriptor " << name
+              << "::__descriptor = {" << endl;
+  indent_up();
+  indent(out) << "\"" << name << "\", " << (types.empty() ? "nullptr" : "_" + name + "__fields")
+              << ", " << fields.size() << ", " << (tstruct->is_xception() ? "true" : "false")
+              << ", " << (is_generic_struct(tstruct) ? "true" : "false") << "," << endl;
+  indent(out) << "_" << name << "__isSet, _" << name << "__setIsSet, _" << name << "__read, _"
+              << name << "__write" << endl;
+  indent_down();
+  indent(out) << "};" << endl << endl;
+
+  out << "#if defined(__GNUC__)" << endl
+      << "#pragma GCC diagnostic pop" << endl
+      << "#endif" << endl << endl;
+}
+
+/**
+ * Returns true if the C++ type of ttype is the standard one, which
+ * TTableSerializer and TContainerOps can handle.
+ */
+bool t_cpp_generator::is_generic_type(t_type* ttype) {
+  ttype = get_true_type(ttype);
+  if (ttype->is_base_type()) {
+    return ttype->annotations_.find("cpp.type") == ttype->annotations_.end();
+  } else if (ttype->is_container() && ((t_container*)ttype)->has_cpp_name()) {
+    return false;
+  } else if (ttype->is_map()) {
+    return is_generic_type(((t_map*)ttype)->get_key_type())
+           && is_generic_type(((t_map*)ttype)->get_val_type());
+  } else if (ttype->is_set()) {
+    return is_generic_type(((t_set*)ttype)->get_elem_type());
+  } else if (ttype->is_list()) {
+    return is_generic_type(((t_list*)ttype)->get_elem_type());
+  }
+  return true;
+}
+
+/**
+ * Returns true if TTableSerializer can read and write every field of a
+ * struct from its descriptor. Nested structs need not be generic, as it
+ * calls their own read() and write() methods.
+ */
+bool t_cpp_generator::is_generic_struct(t_struct* tstruct) {
+  const vector<t_field*>& fields = tstruct->get_members();
+  for (auto field : fields) {
+    if (is_reference(field) || is_lazy(field) || !is_generic_type(field->get_type())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Generates a struct reader that interprets the struct's descriptor.
+ */
+void t_cpp_generator::generate_table_driven_reader(ostream& out, t_struct* tstruct) {
+  if (gen_templates_) {
+    out << indent() << "template <class Protocol_>" << endl << indent() << "uint32_t "
+        << tstruct->get_name() << "::read(Protocol_* iprot) {" << endl;
+  } else {
+    indent(out) << "uint32_t " << tstruct->get_name()
+                << "::read(::apache::thrift::protocol::TProtocol* iprot) {" << endl;
+  }
+  indent_up();
+  indent(out) << "return ::apache::thrift::protocol::TTableSerializer::read(iprot, __descriptor, "
+              << "this);" << endl;
+  indent_down();
+  indent(out) << "}" << endl << endl;
+}
+
+/**
+ * Generates a struct writer that interprets the struct's descriptor.
+ */
+void t_cpp_generator::generate_table_driven_writer(ostream& out, t_struct* tstruct) {
+  if (gen_templates_) {
+    out << indent() << "template <class Protocol_>" << endl << indent() << "uint32_t "
+        << tstruct->get_name() << "::write(Protocol_* oprot) const {" << endl;
+  } else {
+    indent(out) << "uint32_t " << tstruct->get_name()
+                << "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
+  }
+  indent_up();
+  indent(out) << "return ::apache::thrift::protocol::TTableSerializer::write(oprot, __descriptor, "
+              << "this);" << endl;
+  indent_down();
+  indent(out) << "}" << endl << endl;
+}
+
+/**
+ * Returns true if any struct of a program has a cpp.lazy field.
+ */
+bool t_cpp_generator::has_lazy_fields(t_program* program) {
+  for (auto tstruct : program->get_objects()) {
+    for (auto field : tstruct->get_members()) {
+      if (is_lazy(field)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Generates the functions that read and write the values of a struct's
+ * cpp.lazy fields, which TLazyField calls when it needs the value decoded
+ * or encoded.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_lazy_field_helpers(ostream& out, t_struct* tstruct) {
+  const vector<t_field*>& fields = tstruct->get_members();
+  for (auto field : fields) {
+    if (!is_lazy(field)) {
+      continue;
+    }
+    t_type* type = get_true_type(field->get_type());
+    if (!(type->is_container() || type->is_struct() || type->is_xception())
+        || is_reference(field)) {
+      throw "cpp.lazy is only supported on struct and container fields held by value: "
+          + tstruct->get_name() + "." + field->get_name();
+    }
+
+    // The .tcc file is a header
+    string linkage = gen_templates_ ? "inline" : "static";
+    indent(out) << linkage << " uint32_t _" << tstruct->get_name() << "__read_"
+                << field->get_name() << "(::apache::thrift::protocol::TProtocol* iprot, "
+                << type_name(field->get_type()) << "& " << field->get_name() << ") {" << endl;
+    indent_up();
+    indent(out) << "uint32_t xfer = 0;" << endl;
+    generate_deserialize_field(out, field);
+    indent(out) << "return xfer;" << endl;
+    scope_down(out);
+    out << endl;
+
+    indent(out) << linkage << " uint32_t _" << tstruct->get_name() << "__write_"
+                << field->get_name() << "(::apache::thrift::protocol::TProtocol* oprot, const "
+                << type_name(field->get_type()) << "& " << field->get_name() << ") {" << endl;
+    indent_up();
+    indent(out) << "uint32_t xfer = 0;" << endl;
+    generate_serialize_field(out, field);
+    indent(out) << "return xfer;" << endl;
+    scope_down(out);
+    out << endl;
+  }
+}
+
 /**
  * Makes a helper function to gen a struct reader.
  *
@@ -1412,6 +1872,11 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
   const vector<t_field*>& fields = tstruct->get_members();
   vector<t_field*>::const_iterator f_iter;
 
+  if (gen_simple_json_ && !fields.empty()) {
+    out << endl;
+    generate_field_name_table(out, tstruct);
+  }
+
   // Declare stack tmp variables
   out << endl
       << indent() << "::apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);" << endl
@@ -1446,6 +1911,13 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
   if (fields.empty()) {
     out << indent() << "xfer += iprot->skip(ftype);" << endl;
   } else {
+    if (gen_simple_json_) {
+      // Protocols that identify fields by name only report them as T_VOID
+      out << indent() << "if (fid == 0 && ftype == ::apache::thrift::protocol::T_VOID) {" << endl
+          << indent() << "  fieldNameTable.find(fname, fid, ftype);" << endl
+          << indent() << "}" << endl;
+    }
+
     // Switch statement on the field we are reading
     indent(out) << "switch (fid)" << endl;
 
@@ -1473,6 +1945,9 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
 
       if (pointers && !(*f_iter)->get_type()->is_xception()) {
         generate_deserialize_field(out, *f_iter, "(*(this->", "))");
+      } else if (is_lazy(*f_iter)) {
+        indent(out) << "xfer += this->" << (*f_iter)->get_name() << ".read(iprot, ftype, &_"
+                    << tstruct->get_name() << "__read_" << (*f_iter)->get_name() << ");" << endl;
       } else {
         generate_deserialize_field(out, *f_iter, "this->");
       }
@@ -1558,6 +2033,9 @@ void t_cpp_generator::generate_struct_writer(ostream& out, t_struct* tstruct, bo
     // Write field contents
     if (pointers && !(*f_iter)->get_type()->is_xception()) {
       generate_serialize_field(out, *f_iter, "(*(this->", "))");
+    } else if (is_lazy(*f_iter)) {
+      indent(out) << "xfer += this->" << (*f_iter)->get_name() << ".write(oprot, &_" << name
+                  << "__write_" << (*f_iter)->get_name() << ");" << endl;
     } else {
       generate_serialize_field(out, *f_iter, "this->");
     }
@@ -1874,6 +2352,7 @@ void t_cpp_generator::generate_service(t_service* tservice) {
     f_header_ << "#include <thrift/async/TAsyncDispatchProcessor.h>" << endl;
   }
   f_header_ << "#include <thrift/async/TConcurrentClientSyncInfo.h>" << endl;
+  f_header_ << "#include <cstring>" << endl;
   f_header_ << "#include <memory>" << endl;
   f_header_ << "#include \"" << get_include_prefix(*get_program()) << program_name_ << "_types.h\""
             << endl;
@@ -1990,6 +2469,13 @@ void t_cpp_generator::generate_service_helpers(t_service* tservice) {
     t_struct* ts = (*f_iter)->get_arglist();
     string name_orig = ts->get_name();
 
+    for (auto arg : ts->get_members()) {
+      if (is_lazy(arg)) {
+        throw "cpp.lazy is not supported on function arguments: " + tservice->get_name() + "."
+            + (*f_iter)->get_name() + "(" + arg->get_name() + ")";
+      }
+    }
+
     // TODO(dreiss): Why is this stuff not in generate_function_helpers?
     ts->set_name(tservice->get_name() + "_" + (*f_iter)->get_name() + "_args");
     generate_struct_declaration(f_header_, ts, false);
@@ -3017,7 +3503,8 @@ public:
   void run() {
     generate_class_definition();
 
-    // Generate the dispatchCall() function
+    // Generate the method name lookup and the dispatchCall() function
+    generate_process_function_lookup();
     generate_dispatch_call(false);
     if (generator_->gen_templates_) {
       generate_dispatch_call(true);
@@ -3026,15 +3513,28 @@ public:
     // Generate all of the process subfunctions
     generate_process_functions();
 
+    generate_get_priority();
+
+    generate_is_inline();
+
     generate_factory();
   }
 
   void generate_class_definition();
+  void generate_process_function_lookup();
+  void generate_process_function_match(const std::vector<t_function*>& candidates);
   void generate_dispatch_call(bool template_protocol);
   void generate_process_functions();
+  void generate_get_priority();
+  void generate_is_inline();
   void generate_factory();
 
 protected:
+  std::string function_priority(t_function* tfunction);
+  bool has_priorities();
+  std::string function_inline(t_function* tfunction);
+  bool has_inline_functions();
+
   std::string type_name(t_type* ttype, bool in_typedef = false, bool arg = false) {
     return generator_->type_name(ttype, in_typedef, arg);
   }
@@ -3162,7 +3662,7 @@ void ProcessorGenerator::generate_class_definition() {
   f_header_ << " private:" << endl;
   indent_up();
 
-  // Declare processMap_
+  // Declare the method name lookup
   f_header_ << indent() << "typedef  void (" << class_name_ << "::*"
             << "ProcessFunction)(" << finish_cob_decl_ << "int32_t, "
             << "::apache::thrift::protocol::TProtocol*, "
@@ -3178,13 +3678,11 @@ void ProcessorGenerator::generate_class_definition() {
               << indent() << "    specialized(s) {}" << endl << indent()
               << "  ProcessFunctions() : generic(nullptr), specialized(nullptr) "
               << "{}" << endl << indent() << "};" << endl << indent()
-              << "typedef std::map<std::string, ProcessFunctions> "
-              << "ProcessMap;" << endl;
+              << "static ProcessFunctions findProcessFunction(const std::string& fname);" << endl;
   } else {
-    f_header_ << indent() << "typedef std::map<std::string, ProcessFunction> "
-              << "ProcessMap;" << endl;
+    f_header_ << indent() << "static ProcessFunction findProcessFunction(const std::string& fname);"
+              << endl;
   }
-  f_header_ << indent() << "ProcessMap processMap_;" << endl;
 
   for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
     indent(f_header_) << "void process_" << (*f_iter)->get_name() << "(" << finish_cob_
@@ -3229,29 +3727,15 @@ void ProcessorGenerator::generate_class_definition() {
   if (!extends_.empty()) {
     f_header_ << indent() << "  " << extends_ << "(iface)," << endl;
   }
-  f_header_ << indent() << "  iface_(iface) {" << endl;
-  indent_up();
-
-  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
-    f_header_ << indent() << "processMap_[\"" << (*f_iter)->get_name() << "\"] = ";
-    if (generator_->gen_templates_) {
-      f_header_ << "ProcessFunctions(" << endl;
-      if (generator_->gen_templates_only_) {
-        indent(f_header_) << "  nullptr," << endl;
-      } else {
-        indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ","
-                          << endl;
-      }
-      indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ")";
-    } else {
-      f_header_ << "&" << class_name_ << "::process_" << (*f_iter)->get_name();
-    }
-    f_header_ << ";" << endl;
+  f_header_ << indent() << "  iface_(iface) {}" << endl << endl << indent() << "virtual ~"
+            << class_name_ << "() {}" << endl;
+  if (has_priorities()) {
+    f_header_ << indent() << "::apache::thrift::concurrency::PRIORITY getPriority("
+              << "const std::string& fname) const override;" << endl;
+  }
+  if (has_inline_functions()) {
+    f_header_ << indent() << "bool isInline(const std::string& fname) const override;" << endl;
   }
-
-  indent_down();
-  f_header_ << indent() << "}" << endl << endl << indent() << "virtual ~" << class_name_ << "() {}"
-            << endl;
   indent_down();
   f_header_ << "};" << endl << endl;
 
@@ -3270,6 +3754,240 @@ void ProcessorGenerator::generate_class_definition() {
   }
 }
 
+/**
+ * Returns the priority class given to calls to a function, by its
+ * "priority" annotation or its service's, or "" if it has none.
+ */
+string ProcessorGenerator::function_priority(t_function* tfunction) {
+  std::map<string, string>::const_iterator it = tfunction->annotations_.find("priority");
+  if (it == tfunction->annotations_.end()) {
+    it = service_->annotations_.find("priority");
+    if (it == service_->annotations_.end()) {
+      return "";
+    }
+  }
+  const string& priority = it->second;
+  if (priority != "HIGH_IMPORTANT" && priority != "HIGH" && priority != "IMPORTANT"
+      && priority != "NORMAL" && priority != "BEST_EFFORT") {
+    throw "unknown priority \"" + priority + "\" for " + service_->get_name() + "."
+        + tfunction->get_name()
+        + ", expected HIGH_IMPORTANT, HIGH, IMPORTANT, NORMAL or BEST_EFFORT";
+  }
+  return priority;
+}
+
+/**
+ * Returns true if getPriority() is generated for the service, which is when
+ * some of its functions are annotated. TAsyncProcessor has no priorities.
+ */
+bool ProcessorGenerator::has_priorities() {
+  if (style_ == "Cob") {
+    return false;
+  }
+  for (auto function : service_->get_functions()) {
+    if (!function_priority(function).empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Generates getPriority(), which returns the annotated priority of a
+ * function's calls, and leaves the others to the parent processor.
+ */
+void ProcessorGenerator::generate_get_priority() {
+  if (!has_priorities()) {
+    return;
+  }
+
+  string class_name = class_name_ + template_suffix_;
+  f_out_ << template_header_ << "::apache::thrift::concurrency::PRIORITY " << class_name
+         << "::getPriority(const std::string& fname) const {" << endl;
+  indent_up();
+  for (auto function : service_->get_functions()) {
+    string priority = function_priority(function);
+    if (!priority.empty()) {
+      indent(f_out_) << "if (fname == \"" << function->get_name() << "\") {" << endl;
+      indent(f_out_) << "  return ::apache::thrift::concurrency::" << priority << ";" << endl;
+      indent(f_out_) << "}" << endl;
+    }
+  }
+  if (extends_.empty()) {
+    indent(f_out_) << "return ::apache::thrift::TDispatchProcessor"
+                   << (generator_->gen_templates_ ? "T<Protocol_>" : "")
+                   << "::getPriority(fname);" << endl;
+  } else {
+    indent(f_out_) << "return " << extends_ << "::getPriority(fname);" << endl;
+  }
+  indent_down();
+  f_out_ << "}" << endl << endl;
+}
+
+/**
+ * Returns "true" or "false" as a function's "inline" annotation, or its
+ * service's, says whether its calls are processed inline, or "" if it has
+ * neither. An annotation without a value is true.
+ */
+string ProcessorGenerator::function_inline(t_function* tfunction) {
+  std::map<string, string>::const_iterator it = tfunction->annotations_.find("inline");
+  if (it == tfunction->annotations_.end()) {
+    it = service_->annotations_.find("inline");
+    if (it == service_->annotations_.end()) {
+      return "";
+    }
+  }
+  const string& value = it->second;
+  if (value == "1" || value == "true") {
+    return "true";
+  } else if (value == "0" || value == "false") {
+    return "false";
+  }
+  throw "unknown inline value \"" + value + "\" for " + service_->get_name() + "."
+      + tfunction->get_name() + ", expected true or false";
+}
+
+/**
+ * Returns true if isInline() is generated for the service, which is when
+ * some of its functions are annotated. TAsyncProcessor has no inline calls.
+ */
+bool ProcessorGenerator::has_inline_functions() {
+  if (style_ == "Cob") {
+    return false;
+  }
+  for (auto function : service_->get_functions()) {
+    if (!function_inline(function).empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Generates isInline(), which returns whether an annotated function's calls
+ * are processed inline, and leaves the others to the parent processor.
+ */
+void ProcessorGenerator::generate_is_inline() {
+  if (!has_inline_functions()) {
+    return;
+  }
+
+  string class_name = class_name_ + template_suffix_;
+  f_out_ << template_header_ << "bool " << class_name
+         << "::isInline(const std::string& fname) const {" << endl;
+  indent_up();
+  for (auto function : service_->get_functions()) {
+    string value = function_inline(function);
+    if (!value.empty()) {
+      indent(f_out_) << "if (fname == \"" << function->get_name() << "\") {" << endl;
+      indent(f_out_) << "  return " << value << ";" << endl;
+      indent(f_out_) << "}" << endl;
+    }
+  }
+  if (extends_.empty()) {
+    indent(f_out_) << "return ::apache::thrift::TDispatchProcessor"
+                   << (generator_->gen_templates_ ? "T<Protocol_>" : "")
+                   << "::isInline(fname);" << endl;
+  } else {
+    indent(f_out_) << "return " << extends_ << "::isInline(fname);" << endl;
+  }
+  indent_down();
+  f_out_ << "}" << endl << endl;
+}
+
+/**
+ * Generates findProcessFunction(), which maps a method name to the function
+ * processing calls to it. It switches on the length of the name, then, if
+ * several methods have that length, on the character that best tells them
+ * apart, and compares the name with the few candidates left.
+ */
+void ProcessorGenerator::generate_process_function_lookup() {
+  string class_name = class_name_ + template_suffix_;
+  string result_type = generator_->gen_templates_ ? "ProcessFunctions" : "ProcessFunction";
+
+  std::map<size_t, vector<t_function*> > by_length;
+  for (auto function : service_->get_functions()) {
+    by_length[function->get_name().size()].push_back(function);
+  }
+
+  f_out_ << template_header_ << typename_str_ << class_name << "::" << result_type << " "
+         << class_name << "::findProcessFunction(const std::string& fname) {" << endl;
+  indent_up();
+  if (!by_length.empty()) {
+    indent(f_out_) << "switch (fname.size()) {" << endl;
+    for (const auto& group : by_length) {
+      indent(f_out_) << "case " << group.first << ":" << endl;
+      indent_up();
+
+      // Find the character position where the names differ most
+      size_t position = 0;
+      size_t most = 1;
+      for (size_t i = 0; i < group.first; ++i) {
+        std::set<char> chars;
+        for (auto function : group.second) {
+          chars.insert(function->get_name()[i]);
+        }
+        if (chars.size() > most) {
+          position = i;
+          most = chars.size();
+        }
+      }
+
+      if (most > 1) {
+        std::map<char, vector<t_function*> > by_char;
+        for (auto function : group.second) {
+          by_char[function->get_name()[position]].push_back(function);
+        }
+        indent(f_out_) << "switch (fname[" << position << "]) {" << endl;
+        for (const auto& bucket : by_char) {
+          indent(f_out_) << "case '" << bucket.first << "':" << endl;
+          indent_up();
+          generate_process_function_match(bucket.second);
+          indent(f_out_) << "break;" << endl;
+          indent_down();
+        }
+        indent(f_out_) << "}" << endl;
+      } else {
+        generate_process_function_match(group.second);
+      }
+      indent(f_out_) << "break;" << endl;
+      indent_down();
+    }
+    indent(f_out_) << "}" << endl;
+  }
+  indent(f_out_) << "return " << (generator_->gen_templates_ ? "ProcessFunctions()" : "nullptr")
+                 << ";" << endl;
+  indent_down();
+  f_out_ << "}" << endl << endl;
+}
+
+/**
+ * Generates the part of findProcessFunction() that compares the method name
+ * with each of the given candidates, all of the same length.
+ */
+void ProcessorGenerator::generate_process_function_match(const vector<t_function*>& candidates) {
+  string class_name = class_name_ + template_suffix_;
+  for (auto function : candidates) {
+    const string& name = function->get_name();
+    indent(f_out_) << "if (std::memcmp(fname.data(), \"" << name << "\", " << name.size()
+                   << ") == 0) {" << endl;
+    indent_up();
+    if (generator_->gen_templates_) {
+      indent(f_out_) << "return ProcessFunctions(";
+      if (generator_->gen_templates_only_) {
+        f_out_ << "nullptr";
+      } else {
+        f_out_ << "&" << class_name << "::process_" << name;
+      }
+      f_out_ << ", &" << class_name << "::process_" << name << ");" << endl;
+    } else {
+      indent(f_out_) << "return &" << class_name << "::process_" << name << ";" << endl;
+    }
+    indent_down();
+    indent(f_out_) << "}" << endl;
+  }
+}
+
 void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
   string protocol = "::apache::thrift::protocol::TProtocol";
   string function_suffix;
@@ -3291,10 +4009,14 @@ void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
          << "const std::string& fname, int32_t seqid" << call_context_ << ") {" << endl;
   indent_up();
 
-  // HOT: member function pointer map
-  f_out_ << indent() << typename_str_ << "ProcessMap::iterator pfn;" << endl << indent()
-         << "pfn = processMap_.find(fname);" << endl << indent()
-         << "if (pfn == processMap_.end()) {" << endl;
+  // HOT: method name lookup
+  if (generator_->gen_templates_) {
+    f_out_ << indent() << "ProcessFunctions pfn = findProcessFunction(fname);" << endl << indent()
+           << "if (pfn.specialized == nullptr) {" << endl;
+  } else {
+    f_out_ << indent() << "ProcessFunction pfn = findProcessFunction(fname);" << endl << indent()
+           << "if (pfn == nullptr) {" << endl;
+  }
   if (extends_.empty()) {
     f_out_ << indent() << "  iprot->skip(::apache::thrift::protocol::T_STRUCT);" << endl << indent()
            << "  iprot->readMessageEnd();" << endl << indent()
@@ -3315,16 +4037,16 @@ void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
   }
   f_out_ << indent() << "}" << endl;
   if (template_protocol) {
-    f_out_ << indent() << "(this->*(pfn->second.specialized))";
+    f_out_ << indent() << "(this->*(pfn.specialized))";
   } else {
     if (generator_->gen_templates_only_) {
       // TODO: This is a null pointer, so nothing good will come from calling
       // it.  Throw an exception instead.
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
+      f_out_ << indent() << "(this->*(pfn.generic))";
     } else if (generator_->gen_templates_) {
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
+      f_out_ << indent() << "(this->*(pfn.generic))";
     } else {
-      f_out_ << indent() << "(this->*(pfn->second))";
+      f_out_ << indent() << "(this->*pfn)";
     }
   }
   f_out_ << "(" << cob_arg_ << "seqid, iprot, oprot" << call_context_arg_ << ");" << endl;
@@ -4514,6 +5236,8 @@ string t_cpp_generator::declare_field(t_field* tfield,
   result += type_name(tfield->get_type());
   if (is_reference(tfield)) {
     result = "::std::shared_ptr<" + result + ">";
+  } else if (is_lazy(tfield)) {
+    result = "::apache::thrift::protocol::TLazyField<" + result + " >";
   }
   if (pointer) {
     result += "*";
@@ -4760,4 +5484,11 @@ THRIFT_REGISTER_GENERATOR(
     "    moveable_types:  Generate move constructors and assignment operators.\n"
     "    no_ostream_operators:\n"
     "                     Omit generation of ostream definitions.\n"
-    "    no_skeleton:     Omits generation of skeleton.\n")
+    "    no_skeleton:     Omits generation of skeleton.\n"
+    "    reflection:      Generate a TStructDescriptor of each struct's fields, for\n"
+    "                     generic code, and readPartial() methods that read the\n"
+    "                     fields of a TFieldMask. Included files must use it too.\n"
+    "    table_driven:    Implies reflection. Generate read() and write() methods that\n"
+    "                     interpret the TStructDescriptor, for smaller code.\n"
+    "    simple_json:     Generate read() methods that also accept fields identified by\n"
+    "                     name, as TSimpleJSONProtocol reads them.\n")
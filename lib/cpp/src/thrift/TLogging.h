@@ -163,28 +163,37 @@
 #endif
 
 /**
- * T_GLOBAL_DEBUG_VIRTUAL = 0 or unset: normal operation,
- *                                      virtual call debug messages disabled
+ * T_GLOBAL_DEBUG_VIRTUAL < 0:          no virtual call hooks
+ * T_GLOBAL_DEBUG_VIRTUAL = 0 or unset: normal operation, avoidable virtual
+ *                                      calls are counted while
+ *                                      apache::thrift::TVirtualProfiler is
+ *                                      enabled at run time
  * T_GLOBAL_DEBUG_VIRTUAL = 1:          log a debug messages whenever an
  *                                      avoidable virtual call is made
- * T_GLOBAL_DEBUG_VIRTUAL = 2:          record detailed info that can be
- *                                      printed by calling
- *                                      apache::thrift::profile_print_info()
+ * T_GLOBAL_DEBUG_VIRTUAL = 2:          as 0, with the profiler enabled
+ *                                      from the start
  */
-#if T_GLOBAL_DEBUG_VIRTUAL > 1
-#define T_VIRTUAL_CALL() ::apache::thrift::profile_virtual_call(typeid(*this))
+#if T_GLOBAL_DEBUG_VIRTUAL == 1
+#define T_VIRTUAL_CALL() fprintf(stderr, "[%s,%d] virtual call\n", __FILE__, __LINE__)
 #define T_GENERIC_PROTOCOL(template_class, generic_prot, specific_prot)                            \
   do {                                                                                             \
     if (!(specific_prot)) {                                                                        \
-      ::apache::thrift::profile_generic_protocol(typeid(*template_class), typeid(*generic_prot));  \
+      fprintf(stderr, "[%s,%d] failed to cast to specific protocol type\n", __FILE__, __LINE__);   \
+    }                                                                                              \
+  } while (0)
+#elif T_GLOBAL_DEBUG_VIRTUAL >= 0
+#include <thrift/VirtualProfiling.h>
+#define T_VIRTUAL_CALL()                                                                           \
+  do {                                                                                             \
+    if (::apache::thrift::TVirtualProfiler::isEnabled()) {                                         \
+      ::apache::thrift::TVirtualProfiler::recordVirtualCall(this);                                 \
     }                                                                                              \
   } while (0)
-#elif T_GLOBAL_DEBUG_VIRTUAL == 1
-#define T_VIRTUAL_CALL() fprintf(stderr, "[%s,%d] virtual call\n", __FILE__, __LINE__)
 #define T_GENERIC_PROTOCOL(template_class, generic_prot, specific_prot)                            \
   do {                                                                                             \
-    if (!(specific_prot)) {                                                                        \
-      fprintf(stderr, "[%s,%d] failed to cast to specific protocol type\n", __FILE__, __LINE__);   \
+    if (!(specific_prot) && ::apache::thrift::TVirtualProfiler::isEnabled()) {                     \
+      ::apache::thrift::TVirtualProfiler::recordGenericProtocol(typeid(*template_class),           \
+                                                                generic_prot);                     \
     }                                                                                              \
   } while (0)
 #else
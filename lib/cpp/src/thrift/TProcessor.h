@@ -21,6 +21,7 @@
 #define _THRIFT_TPROCESSOR_H_ 1
 
 #include <string>
+#include <thrift/concurrency/Priority.h>
 #include <thrift/protocol/TProtocol.h>
 
 namespace apache {
@@ -149,6 +150,28 @@ public:
     return process(io, io, connectionContext);
   }
 
+  /**
+   * Returns the priority class of calls to the named function, so a server
+   * can order them before they are processed. Generated processors return
+   * the class given by the function's "priority" annotation; others return
+   * NORMAL for every call.
+   */
+  virtual concurrency::PRIORITY getPriority(const std::string& fname) const {
+    (void)fname;
+    return concurrency::NORMAL;
+  }
+
+  /**
+   * Returns whether calls to the named function are cheap enough for a
+   * server to process them on the thread that read them, rather than hand
+   * them to a worker thread. Generated processors return true for functions
+   * with the "inline" annotation; others return false for every call.
+   */
+  virtual bool isInline(const std::string& fname) const {
+    (void)fname;
+    return false;
+  }
+
   std::shared_ptr<TProcessorEventHandler> getEventHandler() const { return eventHandler_; }
 
   void setEventHandler(std::shared_ptr<TProcessorEventHandler> eventHandler) {
@@ -0,0 +1,218 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/TTracing.h>
+
+#include <cstdint>
+#include <random>
+
+namespace apache {
+namespace thrift {
+
+namespace {
+
+thread_local TTraceContext currentContext;
+
+// Returns a random, non-zero id, from a generator of the calling thread's
+uint64_t randomId() {
+  thread_local uint64_t state = std::random_device()() * uint64_t(0x100000001) + 1;
+  uint64_t id;
+  do {
+    // splitmix64
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    id = z ^ (z >> 31);
+  } while (id == 0);
+  return id;
+}
+
+std::string toHex(uint64_t id) {
+  static const char digits[] = "0123456789abcdef";
+  std::string hex(16, '0');
+  for (int i = 15; i >= 0; --i) {
+    hex[i] = digits[id & 0xf];
+    id >>= 4;
+  }
+  return hex;
+}
+
+// Reads an id written in hex, or returns 0 if it is not 1 to 32 hex digits. A 128 bit
+// trace id is truncated to its low 64 bits.
+uint64_t fromHex(const std::string& hex) {
+  if (hex.empty() || hex.size() > 32) {
+    return 0;
+  }
+  uint64_t id = 0;
+  for (size_t i = hex.size() > 16 ? hex.size() - 16 : 0; i < hex.size(); ++i) {
+    char c = hex[i];
+    int digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return 0;
+    }
+    id = (id << 4) | static_cast<uint64_t>(digit);
+  }
+  return id;
+}
+
+uint64_t headerId(const std::map<std::string, std::string>& headers, const char* name) {
+  auto it = headers.find(name);
+  return it == headers.end() ? 0 : fromHex(it->second);
+}
+}
+
+TSpanRing::TSpanRing(size_t capacity) : enqueuePos_(0), dequeuePos_(0), dropped_(0) {
+  size_t size = 2;
+  while (size < capacity) {
+    size *= 2;
+  }
+  cells_.reset(new Cell[size]);
+  mask_ = size - 1;
+  for (size_t i = 0; i < size; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+// A cell's sequence is its position while it is free to be written, and
+// one past it once it holds a span to read.
+bool TSpanRing::push(TSpan&& span) {
+  Cell* cell;
+  size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &cells_[pos & mask_];
+    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = enqueuePos_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->span = std::move(span);
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool TSpanRing::pop(TSpan& span) {
+  Cell* cell;
+  size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &cells_[pos & mask_];
+    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = dequeuePos_.load(std::memory_order_relaxed);
+    }
+  }
+  span = std::move(cell->span);
+  cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+const char* const TTracer::TRACE_ID_HEADER = "X-B3-TraceId";
+const char* const TTracer::SPAN_ID_HEADER = "X-B3-SpanId";
+const char* const TTracer::PARENT_SPAN_ID_HEADER = "X-B3-ParentSpanId";
+
+TTracer::TTracer(size_t capacity, double sampleRate) : ring_(capacity) {
+  // Traces whose random id is below the threshold are sampled
+  double threshold = sampleRate * 18446744073709551616.0;
+  if (threshold >= 18446744073709551616.0) {
+    sampleThreshold_ = UINT64_MAX;
+  } else if (threshold <= 0.0) {
+    sampleThreshold_ = 0;
+  } else {
+    sampleThreshold_ = static_cast<uint64_t>(threshold);
+  }
+}
+
+TTraceContext TTracer::startSpan(const TTraceContext& parent) const {
+  TTraceContext context;
+  if (parent.valid()) {
+    context.traceId = parent.traceId;
+    context.parentSpanId = parent.spanId;
+  } else {
+    uint64_t traceId = randomId();
+    if (sampleThreshold_ != UINT64_MAX && traceId >= sampleThreshold_) {
+      return context;
+    }
+    context.traceId = traceId;
+  }
+  context.spanId = randomId();
+  return context;
+}
+
+size_t TTracer::drain(std::vector<TSpan>& spans, size_t max) {
+  size_t count = 0;
+  TSpan span;
+  while (count < max && ring_.pop(span)) {
+    spans.push_back(std::move(span));
+    ++count;
+  }
+  return count;
+}
+
+TTraceContext TTracer::current() {
+  return currentContext;
+}
+
+TTraceContext TTracer::setCurrent(const TTraceContext& context) {
+  TTraceContext last = currentContext;
+  currentContext = context;
+  return last;
+}
+
+void TTracer::inject(const TTraceContext& context, std::map<std::string, std::string>& headers) {
+  headers[TRACE_ID_HEADER] = toHex(context.traceId);
+  headers[SPAN_ID_HEADER] = toHex(context.spanId);
+  if (context.parentSpanId != 0) {
+    headers[PARENT_SPAN_ID_HEADER] = toHex(context.parentSpanId);
+  } else {
+    headers.erase(PARENT_SPAN_ID_HEADER);
+  }
+}
+
+TTraceContext TTracer::extract(const std::map<std::string, std::string>& headers) {
+  TTraceContext context;
+  context.traceId = headerId(headers, TRACE_ID_HEADER);
+  context.spanId = headerId(headers, SPAN_ID_HEADER);
+  context.parentSpanId = headerId(headers, PARENT_SPAN_ID_HEADER);
+  if (context.spanId == 0) {
+    return TTraceContext();
+  }
+  return context;
+}
+}
+} // apache::thrift
@@ -0,0 +1,199 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TTRACING_H_
+#define _THRIFT_TTRACING_H_ 1
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <thrift/Thrift.h>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * Identifies a span, and the trace it is part of.
+ */
+struct TTraceContext {
+  TTraceContext() : traceId(0), spanId(0), parentSpanId(0) {}
+
+  /** The trace, or 0 if there is none. */
+  uint64_t traceId;
+  uint64_t spanId;
+  /** The span that caused this one, or 0 for the root of a trace. */
+  uint64_t parentSpanId;
+
+  bool valid() const { return traceId != 0; }
+};
+
+enum TSpanKind { T_SPAN_CLIENT, T_SPAN_SERVER };
+
+/**
+ * A call, as seen by the client that made it or the server that processed
+ * it, with the time it spent in each phase. Times are in microseconds.
+ *
+ * For a client span, serialize is the time taken writing the request,
+ * network the time from then until the reply began to be read, which
+ * includes the time the server took, and deserialize the time taken reading
+ * the reply. For a server span, queue is the time the call waited for a
+ * worker thread, if the server queues calls, deserialize the time taken
+ * reading the request, handler the time spent in the handler, and serialize
+ * the time taken writing the reply.
+ */
+struct TSpan {
+  TSpan()
+    : kind(T_SPAN_SERVER),
+      startMicros(0),
+      durationMicros(0),
+      serializeMicros(0),
+      networkMicros(0),
+      queueMicros(0),
+      handlerMicros(0),
+      deserializeMicros(0),
+      error(false) {}
+
+  TTraceContext context;
+  TSpanKind kind;
+  /** The method called. */
+  std::string name;
+  /** When the span started, in microseconds since the epoch. */
+  int64_t startMicros;
+  uint64_t durationMicros;
+  uint64_t serializeMicros;
+  uint64_t networkMicros;
+  uint64_t queueMicros;
+  uint64_t handlerMicros;
+  uint64_t deserializeMicros;
+  bool error;
+};
+
+/**
+ * A bounded queue of finished spans, which any number of threads can add to
+ * and take from without locking. Spans added while it is full are dropped.
+ */
+class TSpanRing {
+public:
+  /**
+   * @param capacity Number of spans held, rounded up to a power of two.
+   */
+  explicit TSpanRing(size_t capacity);
+
+  /**
+   * Adds a span, unless the ring is full. Returns whether it was added.
+   */
+  bool push(TSpan&& span);
+
+  /**
+   * Takes the oldest span into span. Returns false if the ring is empty.
+   */
+  bool pop(TSpan& span);
+
+  size_t capacity() const { return mask_ + 1; }
+
+  /** The number of spans dropped because the ring was full. */
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    TSpan span;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_;
+  std::atomic<size_t> enqueuePos_;
+  std::atomic<size_t> dequeuePos_;
+  std::atomic<uint64_t> dropped_;
+};
+
+/**
+ * Starts traces, and collects the spans of calls that are traced, for an
+ * exporter to drain.
+ *
+ * Spans are recorded by a processor::TTracingEventHandler on servers, and a
+ * protocol::TTracingProtocol on clients, which are built into libthriftz
+ * with THeaderProtocol. Trace and span ids travel with calls as
+ * THeaderTransport headers, in the B3 format, so calls only join the trace
+ * of their caller across THeaderProtocol connections.
+ *
+ * While a traced call is processed, its context is the current context of
+ * the thread processing it, so calls the handler makes through a
+ * TTracingProtocol are its children.
+ */
+class TTracer {
+public:
+  static const char* const TRACE_ID_HEADER;
+  static const char* const SPAN_ID_HEADER;
+  static const char* const PARENT_SPAN_ID_HEADER;
+
+  /**
+   * @param capacity   Number of finished spans buffered until drained.
+   * @param sampleRate Fraction, from 0 to 1, of calls not already part of a
+   *                   trace that start one.
+   */
+  explicit TTracer(size_t capacity = 4096, double sampleRate = 1.0);
+
+  /**
+   * Returns the context of a new span: a child of parent if it is valid,
+   * otherwise the root of a new trace, if sampled, or an invalid context.
+   */
+  TTraceContext startSpan(const TTraceContext& parent) const;
+
+  /** Adds a finished span, or drops it if too many are buffered. */
+  void record(TSpan&& span) { ring_.push(std::move(span)); }
+
+  /**
+   * Moves up to max finished spans, oldest first, to the end of spans, and
+   * returns how many were moved.
+   */
+  size_t drain(std::vector<TSpan>& spans, size_t max = static_cast<size_t>(-1));
+
+  /** The number of spans dropped because they were not drained in time. */
+  uint64_t dropped() const { return ring_.dropped(); }
+
+  /**
+   * Returns the context of the call the calling thread is processing, or
+   * an invalid context.
+   */
+  static TTraceContext current();
+
+  /** Sets the calling thread's current context, and returns the last one. */
+  static TTraceContext setCurrent(const TTraceContext& context);
+
+  /** Writes a context's ids to headers. */
+  static void inject(const TTraceContext& context, std::map<std::string, std::string>& headers);
+
+  /**
+   * Reads the context a caller sent in headers, which is invalid if they
+   * have none.
+   */
+  static TTraceContext extract(const std::map<std::string, std::string>& headers);
+
+private:
+  TSpanRing ring_;
+  uint64_t sampleThreshold_;
+};
+}
+} // apache::thrift
+
+#endif // #ifndef _THRIFT_TTRACING_H_
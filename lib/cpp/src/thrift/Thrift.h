@@ -120,13 +120,6 @@ TDelayedException* TDelayedException::delayException(const E& e) {
   return new TExceptionWrapper<E>(e);
 }
 
-#if T_GLOBAL_DEBUG_VIRTUAL > 1
-void profile_virtual_call(const std::type_info& info);
-void profile_generic_protocol(const std::type_info& template_type, const std::type_info& prot_type);
-void profile_print_info(FILE* f);
-void profile_print_info();
-void profile_write_pprof(FILE* gen_calls_f, FILE* virtual_calls_f);
-#endif
 }
 } // apache::thrift
 
@@ -17,409 +17,672 @@
  * under the License.
  */
 
-#include <thrift/Thrift.h>
+#include <thrift/VirtualProfiling.h>
 
-// Do nothing if virtual call profiling is not enabled
-#if T_GLOBAL_DEBUG_VIRTUAL > 1
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
 
-// TODO: This code only works with g++ (since we rely on the fact
-// that all std::type_info instances referring to a particular type
-// always return the exact same pointer value from name().)
-#ifndef __GNUG__
-#error "Thrift virtual function profiling currently only works with gcc"
-#endif // !__GNUG__
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/transport/TTransport.h>
 
-// TODO: We also require glibc for the backtrace() and backtrace_symbols()
-// functions.
-#ifndef __GLIBC__
-#error "Thrift virtual function profiling currently requires glibc"
-#endif // !__GLIBC__
-
-#include <thrift/concurrency/Mutex.h>
-
-#include <ext/hash_map>
+#if defined(__GLIBC__) || defined(__APPLE__)
 #include <execinfo.h>
-#include <stdio.h>
+#define THRIFT_HAVE_BACKTRACE 1
+#endif
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
 
 namespace apache {
 namespace thrift {
 
-using ::apache::thrift::concurrency::Mutex;
-using ::apache::thrift::concurrency::Guard;
+#ifndef T_GLOBAL_DEBUG_VIRTUAL
+#define T_GLOBAL_DEBUG_VIRTUAL 0
+#endif
+
+THRIFT_EXPORT std::atomic<bool> TVirtualProfiler::enabled_(T_GLOBAL_DEBUG_VIRTUAL > 1);
+
+namespace {
 
-static const unsigned int MAX_STACK_DEPTH = 15;
+const size_t MAX_STACK_DEPTH = 32;
+
+std::atomic<uint32_t> samplePeriod(1000);
 
 /**
- * A stack trace
+ * The concrete types of a profiled call: the processor, protocol and
+ * transport, any of which may be null.
  */
-class Backtrace {
-public:
-  Backtrace(int skip = 0);
-  Backtrace(Backtrace const& bt);
-
-  void operator=(Backtrace const& bt) {
-    numCallers_ = bt.numCallers_;
-    if (numCallers_ >= 0) {
-      memcpy(callers_, bt.callers_, numCallers_ * sizeof(void*));
-    }
+struct Key {
+  Key()
+    : kind(TVirtualProfiler::VIRTUAL_PROTOCOL_CALL),
+      processor(nullptr),
+      protocol(nullptr),
+      transport(nullptr) {}
+
+  TVirtualProfiler::CallKind kind;
+  const std::type_info* processor;
+  const std::type_info* protocol;
+  const std::type_info* transport;
+
+  // Types are compared by identity while counting; the same type may have
+  // several type_infos, across shared libraries, which are merged by name
+  // in snapshots.
+  bool operator==(const Key& other) const {
+    return kind == other.kind && processor == other.processor && protocol == other.protocol
+           && transport == other.transport;
   }
 
-  bool operator==(Backtrace const& bt) const { return (cmp(bt) == 0); }
+  bool operator<(const Key& other) const {
+    return std::tie(kind, processor, protocol, transport)
+           < std::tie(other.kind, other.processor, other.protocol, other.transport);
+  }
 
   size_t hash() const {
-    intptr_t ret = 0;
-    for (int n = 0; n < numCallers_; ++n) {
-      ret ^= reinterpret_cast<intptr_t>(callers_[n]);
+    auto h = static_cast<size_t>(kind);
+    h = h * 31 + reinterpret_cast<size_t>(processor);
+    h = h * 31 + reinterpret_cast<size_t>(protocol);
+    h = h * 31 + reinterpret_cast<size_t>(transport);
+    return h ^ (h >> 17);
+  }
+};
+
+/** A call whose stack was recorded. */
+struct Sample {
+  Key key;
+  std::vector<void*> stack;
+
+  bool operator<(const Sample& other) const {
+    if (key == other.key) {
+      return stack < other.stack;
     }
-    return static_cast<size_t>(ret);
+    return key < other.key;
   }
+};
+
+typedef std::map<Key, uint64_t> CallMap;
+typedef std::map<Sample, uint64_t> SampleMap;
+
+/**
+ * The counts of one thread. Only the thread itself adds slots, so it counts
+ * without locking; others read the slots it has published. Stacks are rare,
+ * and kept under a lock.
+ */
+class ThreadProfile {
+public:
+  static const size_t SLOTS = 256;
 
-  int cmp(Backtrace const& bt) const {
-    int depth_diff = (numCallers_ - bt.numCallers_);
-    if (depth_diff != 0) {
-      return depth_diff;
+  ThreadProfile() : lost(0), untilSample(0), random(reinterpret_cast<uintptr_t>(this) | 1) {
+    for (auto& slot : slots) {
+      slot.used.store(false, std::memory_order_relaxed);
+      slot.calls.store(0, std::memory_order_relaxed);
     }
+  }
 
-    for (int n = 0; n < numCallers_; ++n) {
-      int diff = reinterpret_cast<intptr_t>(callers_[n])
-                 - reinterpret_cast<intptr_t>(bt.callers_[n]);
-      if (diff != 0) {
-        return diff;
+  void count(const Key& key) {
+    size_t mask = SLOTS - 1;
+    for (size_t i = key.hash() & mask, probes = 0; probes < SLOTS; i = (i + 1) & mask, ++probes) {
+      Slot& slot = slots[i];
+      if (!slot.used.load(std::memory_order_relaxed)) {
+        slot.key = key;
+        slot.calls.store(1, std::memory_order_relaxed);
+        slot.used.store(true, std::memory_order_release);
+        return;
+      }
+      if (slot.key == key) {
+        slot.calls.fetch_add(1, std::memory_order_relaxed);
+        return;
       }
     }
+    lost.fetch_add(1, std::memory_order_relaxed);
+  }
 
-    return 0;
+  /**
+   * Returns the calls until the next stack is recorded: a period on average,
+   * but varied, so calls made in a regular pattern are sampled fairly.
+   */
+  uint32_t nextInterval(uint32_t period) {
+    // xorshift64
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    return 1 + static_cast<uint32_t>(random % (2 * static_cast<uint64_t>(period) - 1));
   }
 
-  void print(FILE* f, int indent = 0, int start = 0) const {
-    char** strings = backtrace_symbols(callers_, numCallers_);
-    if (strings) {
-      start += skip_;
-      if (start < 0) {
-        start = 0;
-      }
-      for (int n = start; n < numCallers_; ++n) {
-        fprintf(f, "%*s#%-2d %s\n", indent, "", n, strings[n]);
+  void sample(const Key& key, Sample&& sample) {
+    std::lock_guard<std::mutex> guard(samplesMutex);
+    sample.key = key;
+    ++samples[std::move(sample)];
+  }
+
+  /** Adds this thread's counts to calls and samples. */
+  void addTo(CallMap& calls, SampleMap& allSamples, uint64_t& allLost) {
+    for (auto& slot : slots) {
+      if (slot.used.load(std::memory_order_acquire)) {
+        uint64_t count = slot.calls.load(std::memory_order_relaxed);
+        if (count != 0) {
+          calls[slot.key] += count;
+        }
       }
-      free(strings);
-    } else {
-      fprintf(f, "%*s<failed to determine symbols>\n", indent, "");
+    }
+    allLost += lost.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard(samplesMutex);
+    for (const auto& sample : samples) {
+      allSamples[sample.first] += sample.second;
     }
   }
 
-  int getDepth() const { return numCallers_ - skip_; }
-
-  void* getFrame(int index) const {
-    int adjusted_index = index + skip_;
-    if (adjusted_index < 0 || adjusted_index >= numCallers_) {
-      return nullptr;
+  void reset() {
+    for (auto& slot : slots) {
+      slot.calls.store(0, std::memory_order_relaxed);
     }
-    return callers_[adjusted_index];
+    lost.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard(samplesMutex);
+    samples.clear();
   }
 
-private:
-  void* callers_[MAX_STACK_DEPTH];
-  int numCallers_;
-  int skip_;
+  struct Slot {
+    std::atomic<bool> used;
+    Key key;
+    std::atomic<uint64_t> calls;
+  };
+
+  Slot slots[SLOTS];
+  std::atomic<uint64_t> lost;
+  // Touched only by the thread: calls left until the next stack is recorded
+  uint32_t untilSample;
+  uint64_t random;
+  std::mutex samplesMutex;
+  SampleMap samples;
 };
 
-// Define the constructors non-inline, so they consistently add a single
-// frame to the stack trace, regardless of whether optimization is enabled
-Backtrace::Backtrace(int skip)
-  : skip_(skip + 1) // ignore the constructor itself
-{
-  numCallers_ = backtrace(callers_, MAX_STACK_DEPTH);
-  if (skip_ > numCallers_) {
-    skip_ = numCallers_;
-  }
-}
+/**
+ * The profiles of running threads, and what exited threads counted.
+ */
+struct Registry {
+  Registry() : retiredLost(0) {}
+
+  std::mutex mutex;
+  std::set<ThreadProfile*> threads;
+  CallMap retiredCalls;
+  SampleMap retiredSamples;
+  uint64_t retiredLost;
+};
 
-Backtrace::Backtrace(Backtrace const& bt) : numCallers_(bt.numCallers_), skip_(bt.skip_) {
-  if (numCallers_ >= 0) {
-    memcpy(callers_, bt.callers_, numCallers_ * sizeof(void*));
-  }
+// Never destroyed, as threads may exit after static destructors have run
+Registry& registry() {
+  static auto* registry = new Registry();
+  return *registry;
 }
 
-/**
- * A backtrace, plus one or two type names
- */
-class Key {
+class ThreadHolder {
 public:
-  class Hash {
-  public:
-    size_t operator()(Key const& k) const { return k.hash(); }
-  };
+  ThreadHolder() : profile_(nullptr) {}
+
+  ~ThreadHolder() {
+    if (profile_ != nullptr) {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> guard(r.mutex);
+      r.threads.erase(profile_);
+      profile_->addTo(r.retiredCalls, r.retiredSamples, r.retiredLost);
+      delete profile_;
+    }
+  }
+
+  ThreadProfile* get() {
+    if (profile_ == nullptr) {
+      profile_ = new ThreadProfile();
+      Registry& r = registry();
+      std::lock_guard<std::mutex> guard(r.mutex);
+      r.threads.insert(profile_);
+    }
+    return profile_;
+  }
 
-  Key(const Backtrace* bt, const std::type_info& type_info)
-    : backtrace_(bt), typeName1_(type_info.name()), typeName2_(nullptr) {}
+private:
+  ThreadProfile* profile_;
+};
 
-  Key(const Backtrace* bt, const std::type_info& type_info1, const std::type_info& type_info2)
-    : backtrace_(bt), typeName1_(type_info1.name()), typeName2_(type_info2.name()) {}
+thread_local ThreadHolder threadProfile;
 
-  Key(const Key& k)
-    : backtrace_(k.backtrace_), typeName1_(k.typeName1_), typeName2_(k.typeName2_) {}
+// Kept out of line, so the frames skipped are the same in every build
+#ifdef __GNUG__
+__attribute__((noinline))
+#endif
+void record(const Key& key) {
+  ThreadProfile* profile = threadProfile.get();
+  profile->count(key);
 
-  void operator=(const Key& k) {
-    backtrace_ = k.backtrace_;
-    typeName1_ = k.typeName1_;
-    typeName2_ = k.typeName2_;
+  uint32_t period = samplePeriod.load(std::memory_order_relaxed);
+  if (period == 0) {
+    return;
+  }
+  if (profile->untilSample == 0 || profile->untilSample >= 2 * static_cast<uint64_t>(period)) {
+    profile->untilSample = profile->nextInterval(period);
+  }
+  if (--profile->untilSample != 0) {
+    return;
   }
+  profile->untilSample = profile->nextInterval(period);
+
+  Sample sample;
+#ifdef THRIFT_HAVE_BACKTRACE
+  void* frames[MAX_STACK_DEPTH + 2];
+  int depth = backtrace(frames, static_cast<int>(MAX_STACK_DEPTH + 2));
+  // Skip this function, and the TVirtualProfiler method that called it
+  if (depth > 2) {
+    sample.stack.assign(frames + 2, frames + depth);
+  }
+#endif
+  profile->sample(key, std::move(sample));
+}
 
-  const Backtrace* getBacktrace() const { return backtrace_; }
+std::string demangle(const std::type_info* type) {
+  if (type == nullptr) {
+    return std::string();
+  }
+#ifdef __GNUG__
+  int status = 0;
+  char* name = abi::__cxa_demangle(type->name(), nullptr, nullptr, &status);
+  if (status == 0 && name != nullptr) {
+    std::string demangled(name);
+    std::free(name);
+    return demangled;
+  }
+#endif
+  return type->name();
+}
 
-  const char* getTypeName() const { return typeName1_; }
+/** The types of a key, by name, in the form used for entries. */
+struct NamedKey {
+  TVirtualProfiler::CallKind kind;
+  std::string processor;
+  std::string protocol;
+  std::string transport;
 
-  const char* getTypeName2() const { return typeName2_; }
+  bool operator<(const NamedKey& other) const {
+    return std::tie(kind, processor, protocol, transport)
+           < std::tie(other.kind, other.processor, other.protocol, other.transport);
+  }
+};
 
-  void makePersistent() {
-    // Copy the Backtrace object
-    backtrace_ = new Backtrace(*backtrace_);
+NamedKey nameOf(const Key& key) {
+  NamedKey named;
+  named.kind = key.kind;
+  named.processor = demangle(key.processor);
+  named.protocol = demangle(key.protocol);
+  named.transport = demangle(key.transport);
+  return named;
+}
 
-    // NOTE: We don't copy the type name.
-    // The GNU libstdc++ implementation of type_info::name() returns a value
-    // that will be valid for the lifetime of the program.  (Although the C++
-    // standard doesn't guarantee this will be true on all implementations.)
+std::string describe(const NamedKey& key) {
+  std::string description;
+  if (!key.processor.empty()) {
+    description = key.processor + " with ";
   }
+  if (!key.protocol.empty()) {
+    description += key.protocol;
+    if (!key.transport.empty()) {
+      description += " over ";
+    }
+  }
+  return description + key.transport;
+}
 
-  /**
-   * Clean up memory allocated by makePersistent()
-   *
-   * Should only be invoked if makePersistent() has previously been called.
-   * The Key should no longer be used after cleanup() is called.
-   */
-  void cleanup() {
-    delete backtrace_;
-    backtrace_ = nullptr;
+const char* kindName(TVirtualProfiler::CallKind kind) {
+  switch (kind) {
+  case TVirtualProfiler::VIRTUAL_PROTOCOL_CALL:
+    return "virtual_protocol";
+  case TVirtualProfiler::VIRTUAL_TRANSPORT_CALL:
+    return "virtual_transport";
+  case TVirtualProfiler::GENERIC_PROTOCOL_CALL:
+    return "generic_protocol";
   }
+  return "unknown";
+}
 
-  int cmp(const Key& k) const {
-    int ret = backtrace_->cmp(*k.backtrace_);
-    if (ret != 0) {
-      return ret;
-    }
+/** Takes what every thread, running or exited, has counted. */
+void collect(CallMap& calls, SampleMap& samples, uint64_t& lost) {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> guard(r.mutex);
+  calls = r.retiredCalls;
+  samples = r.retiredSamples;
+  lost = r.retiredLost;
+  for (ThreadProfile* profile : r.threads) {
+    profile->addTo(calls, samples, lost);
+  }
+}
 
-    // NOTE: We compare just the name pointers.
-    // With GNU libstdc++, every type_info object for the same type points to
-    // exactly the same name string.  (Although this isn't guaranteed by the
-    // C++ standard.)
-    ret = k.typeName1_ - typeName1_;
-    if (ret != 0) {
-      return ret;
+/**
+ * Writes protocol buffers, as profile.proto is one; only what it needs.
+ */
+class ProtoWriter {
+public:
+  void varint(uint64_t value) {
+    while (value >= 0x80) {
+      buffer_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
     }
-    return k.typeName2_ - typeName2_;
+    buffer_.push_back(static_cast<char>(value));
   }
 
-  bool operator==(const Key& k) const { return cmp(k) == 0; }
+  void uint64Field(int field, uint64_t value) {
+    varint(static_cast<uint64_t>(field) << 3);
+    varint(value);
+  }
 
-  size_t hash() const {
-    // NOTE: As above, we just use the name pointer value.
-    // Works with GNU libstdc++, but not guaranteed to be correct on all
-    // implementations.
-    return backtrace_->hash() ^ reinterpret_cast<size_t>(typeName1_)
-           ^ reinterpret_cast<size_t>(typeName2_);
+  void bytesField(int field, const std::string& bytes) {
+    varint((static_cast<uint64_t>(field) << 3) | 2);
+    varint(bytes.size());
+    buffer_.append(bytes);
+  }
+
+  void packedField(int field, const std::vector<uint64_t>& values) {
+    ProtoWriter packed;
+    for (uint64_t value : values) {
+      packed.varint(value);
+    }
+    bytesField(field, packed.buffer_);
   }
 
+  void messageField(int field, const ProtoWriter& message) { bytesField(field, message.buffer_); }
+
+  const std::string& buffer() const { return buffer_; }
+
 private:
-  const Backtrace* backtrace_;
-  const char* typeName1_;
-  const char* typeName2_;
+  std::string buffer_;
 };
 
-/**
- * A functor that determines which of two BacktraceMap entries
- * has a higher count.
- */
-class CountGreater {
+/** The string table of a profile. */
+class StringTable {
 public:
-  bool operator()(std::pair<Key, size_t> bt1, std::pair<Key, size_t> bt2) const {
-    return bt1.second > bt2.second;
+  StringTable() { index(""); }
+
+  uint64_t index(const std::string& s) {
+    auto it = indices_.find(s);
+    if (it != indices_.end()) {
+      return it->second;
+    }
+    uint64_t i = strings_.size();
+    strings_.push_back(s);
+    indices_[s] = i;
+    return i;
   }
-};
 
-typedef __gnu_cxx::hash_map<Key, size_t, Key::Hash> BacktraceMap;
+  const std::vector<std::string>& strings() const { return strings_; }
 
-/**
- * A map describing how many times T_VIRTUAL_CALL() has been invoked.
- */
-BacktraceMap virtual_calls;
-Mutex virtual_calls_mutex;
+private:
+  std::vector<std::string> strings_;
+  std::map<std::string, uint64_t> indices_;
+};
 
-/**
- * A map describing how many times T_GENERIC_PROTOCOL() has been invoked.
- */
-BacktraceMap generic_calls;
-Mutex generic_calls_mutex;
-
-void _record_backtrace(BacktraceMap* map, const Mutex& mutex, Key* k) {
-  Guard guard(mutex);
-
-  BacktraceMap::iterator it = map->find(*k);
-  if (it == map->end()) {
-    k->makePersistent();
-    map->insert(std::make_pair(*k, 1));
-  } else {
-    // increment the count
-    // NOTE: we could assert if it->second is 0 afterwards, since that would
-    // mean we've wrapped.
-    ++(it->second);
+struct Mapping {
+  uint64_t start;
+  uint64_t limit;
+  uint64_t offset;
+  std::string file;
+};
+
+// Returns the executable mappings of the process, where it can tell
+std::vector<Mapping> readMappings() {
+  std::vector<Mapping> mappings;
+#ifdef __linux__
+  FILE* maps = fopen("/proc/self/maps", "r");
+  if (maps == nullptr) {
+    return mappings;
   }
+  char line[4096];
+  while (fgets(line, sizeof(line), maps) != nullptr) {
+    unsigned long long start, limit, offset;
+    char perms[8];
+    int pathStart = 0;
+    if (sscanf(line, "%llx-%llx %7s %llx %*s %*s %n", &start, &limit, perms, &offset, &pathStart)
+            < 4
+        || std::strchr(perms, 'x') == nullptr) {
+      continue;
+    }
+    Mapping mapping;
+    mapping.start = start;
+    mapping.limit = limit;
+    mapping.offset = offset;
+    if (pathStart > 0) {
+      mapping.file = line + pathStart;
+      mapping.file.erase(mapping.file.find_last_not_of(" \n") + 1);
+    }
+    mappings.push_back(mapping);
+  }
+  fclose(maps);
+#endif
+  return mappings;
+}
 }
 
-/**
- * Record an unnecessary virtual function call.
- *
- * This method is invoked by the T_VIRTUAL_CALL() macro.
- */
-void profile_virtual_call(const std::type_info& type) {
-  int const skip = 1; // ignore this frame
-  Backtrace bt(skip);
-  Key k(&bt, type);
-  _record_backtrace(&virtual_calls, virtual_calls_mutex, &k);
+void TVirtualProfiler::enable(uint32_t period) {
+  samplePeriod.store(period, std::memory_order_relaxed);
+  enabled_.store(true, std::memory_order_relaxed);
 }
 
-/**
- * Record a call to a template processor with a protocol that is not the one
- * specified in the template parameter.
- *
- * This method is invoked by the T_GENERIC_PROTOCOL() macro.
- */
-void profile_generic_protocol(const std::type_info& template_type,
-                              const std::type_info& prot_type) {
-  int const skip = 1; // ignore this frame
-  Backtrace bt(skip);
-  Key k(&bt, template_type, prot_type);
-  _record_backtrace(&generic_calls, generic_calls_mutex, &k);
+void TVirtualProfiler::disable() {
+  enabled_.store(false, std::memory_order_relaxed);
 }
 
-/**
- * Print the recorded profiling information to the specified file.
- */
-void profile_print_info(FILE* f) {
-  typedef std::vector<std::pair<Key, size_t> > BacktraceVector;
-
-  CountGreater is_greater;
-
-  // Grab both locks for the duration of the print operation,
-  // to ensure the output is a consistent snapshot of a single point in time
-  Guard generic_calls_guard(generic_calls_mutex);
-  Guard virtual_calls_guard(virtual_calls_mutex);
-
-  // print the info from generic_calls, sorted by frequency
-  //
-  // We print the generic_calls info ahead of virtual_calls, since it is more
-  // useful in some cases.  All T_GENERIC_PROTOCOL calls can be eliminated
-  // from most programs.  Not all T_VIRTUAL_CALLs will be eliminated by
-  // converting to templates.
-  BacktraceVector gp_sorted(generic_calls.begin(), generic_calls.end());
-  std::sort(gp_sorted.begin(), gp_sorted.end(), is_greater);
-
-  for (BacktraceVector::const_iterator it = gp_sorted.begin(); it != gp_sorted.end(); ++it) {
-    Key const& key = it->first;
-    size_t const count = it->second;
-    fprintf(f,
-            "T_GENERIC_PROTOCOL: %zu calls to %s with a %s:\n",
-            count,
-            key.getTypeName(),
-            key.getTypeName2());
-    key.getBacktrace()->print(f, 2);
-    fprintf(f, "\n");
+void TVirtualProfiler::reset() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> guard(r.mutex);
+  r.retiredCalls.clear();
+  r.retiredSamples.clear();
+  r.retiredLost = 0;
+  for (ThreadProfile* profile : r.threads) {
+    profile->reset();
   }
+}
 
-  // print the info from virtual_calls, sorted by frequency
-  BacktraceVector vc_sorted(virtual_calls.begin(), virtual_calls.end());
-  std::sort(vc_sorted.begin(), vc_sorted.end(), is_greater);
-
-  for (BacktraceVector::const_iterator it = vc_sorted.begin(); it != vc_sorted.end(); ++it) {
-    Key const& key = it->first;
-    size_t const count = it->second;
-    fprintf(f, "T_VIRTUAL_CALL: %zu calls on %s:\n", count, key.getTypeName());
-    key.getBacktrace()->print(f, 2);
-    fprintf(f, "\n");
+void TVirtualProfiler::recordVirtualCall(const protocol::TProtocol* protocol) {
+  Key key;
+  key.kind = VIRTUAL_PROTOCOL_CALL;
+  key.protocol = &typeid(*protocol);
+  std::shared_ptr<transport::TTransport> transport
+      = const_cast<protocol::TProtocol*>(protocol)->getTransport();
+  if (transport) {
+    key.transport = &typeid(*transport);
   }
+  record(key);
 }
 
-/**
- * Print the recorded profiling information to stdout.
- */
-void profile_print_info() {
-  profile_print_info(stdout);
+void TVirtualProfiler::recordVirtualCall(const transport::TTransport* transport) {
+  Key key;
+  key.kind = VIRTUAL_TRANSPORT_CALL;
+  key.transport = &typeid(*transport);
+  record(key);
 }
 
-/**
- * Write a BacktraceMap as Google CPU profiler binary data.
- */
-static void profile_write_pprof_file(FILE* f, BacktraceMap const& map) {
-  // Write the header
-  uintptr_t header[5] = {0, 3, 0, 0, 0};
-  fwrite(&header, sizeof(header), 1, f);
-
-  // Write the profile records
-  for (BacktraceMap::const_iterator it = map.begin(); it != map.end(); ++it) {
-    uintptr_t count = it->second;
-    fwrite(&count, sizeof(count), 1, f);
-
-    Backtrace const* bt = it->first.getBacktrace();
-    uintptr_t num_pcs = bt->getDepth();
-    fwrite(&num_pcs, sizeof(num_pcs), 1, f);
-
-    for (uintptr_t n = 0; n < num_pcs; ++n) {
-      void* pc = bt->getFrame(n);
-      fwrite(&pc, sizeof(pc), 1, f);
+void TVirtualProfiler::recordGenericProtocol(const std::type_info& processor,
+                                             const protocol::TProtocol* protocol) {
+  Key key;
+  key.kind = GENERIC_PROTOCOL_CALL;
+  key.processor = &processor;
+  key.protocol = &typeid(*protocol);
+  std::shared_ptr<transport::TTransport> transport
+      = const_cast<protocol::TProtocol*>(protocol)->getTransport();
+  if (transport) {
+    key.transport = &typeid(*transport);
+  }
+  record(key);
+}
+
+std::vector<TVirtualProfiler::Entry> TVirtualProfiler::snapshot() {
+  CallMap calls;
+  SampleMap samples;
+  uint64_t lost;
+  collect(calls, samples, lost);
+
+  std::map<NamedKey, Entry> entries;
+  for (const auto& call : calls) {
+    NamedKey named = nameOf(call.first);
+    Entry& entry = entries[named];
+    entry.kind = named.kind;
+    entry.processor = named.processor;
+    entry.protocol = named.protocol;
+    entry.transport = named.transport;
+    entry.calls += call.second;
+  }
+  for (const auto& sample : samples) {
+    auto it = entries.find(nameOf(sample.first.key));
+    if (it != entries.end()) {
+      it->second.samples += sample.second;
     }
   }
 
-  // Write the trailer
-  uintptr_t trailer[3] = {0, 1, 0};
-  fwrite(&trailer, sizeof(trailer), 1, f);
+  std::vector<Entry> result;
+  for (auto& entry : entries) {
+    result.push_back(std::move(entry.second));
+  }
+  std::stable_sort(result.begin(), result.end(), [](const Entry& a, const Entry& b) {
+    return a.calls > b.calls;
+  });
+  return result;
+}
 
-  // Write /proc/self/maps
-  // TODO(simpkins): This only works on linux
-  FILE* proc_maps = fopen("/proc/self/maps", "r");
-  if (proc_maps) {
-    uint8_t buf[4096];
-    while (true) {
-      size_t bytes_read = fread(buf, 1, sizeof(buf), proc_maps);
-      if (bytes_read == 0) {
-        break;
-      }
-      fwrite(buf, 1, bytes_read, f);
-    }
-    fclose(proc_maps);
+void TVirtualProfiler::printReport(FILE* f) {
+  std::vector<Entry> entries = snapshot();
+  fprintf(f, "%14s  %-18s  %s\n", "calls", "kind", "types");
+  for (const auto& entry : entries) {
+    NamedKey named = {entry.kind, entry.processor, entry.protocol, entry.transport};
+    fprintf(f,
+            "%14llu  %-18s  %s\n",
+            static_cast<unsigned long long>(entry.calls),
+            kindName(entry.kind),
+            describe(named).c_str());
   }
 }
 
-/**
- * Write the recorded profiling information as pprof files.
- *
- * This writes the information using the Google CPU profiler binary data
- * format, so it can be analyzed with pprof.  Note that information about the
- * protocol/transport data types cannot be stored in this file format.
- *
- * See http://code.google.com/p/google-perftools/ for more details.
- *
- * @param gen_calls_f     The information about calls to
- *                        profile_generic_protocol() will be written to this
- *                        file.
- * @param virtual_calls_f The information about calls to
- *                        profile_virtual_call() will be written to this file.
- */
-void profile_write_pprof(FILE* gen_calls_f, FILE* virtual_calls_f) {
-  typedef std::vector<std::pair<Key, size_t> > BacktraceVector;
+bool TVirtualProfiler::writePprof(FILE* f) {
+  CallMap calls;
+  SampleMap samples;
+  uint64_t lost;
+  collect(calls, samples, lost);
+  uint64_t period = samplePeriod.load(std::memory_order_relaxed);
+
+  StringTable strings;
+  ProtoWriter profile;
+
+  // The values of each sample: how many were taken, and the calls they stand for
+  ProtoWriter sampleType;
+  sampleType.uint64Field(1, strings.index("samples"));
+  sampleType.uint64Field(2, strings.index("count"));
+  profile.messageField(1, sampleType);
+  ProtoWriter callType;
+  callType.uint64Field(1, strings.index("calls"));
+  callType.uint64Field(2, strings.index("count"));
+  profile.messageField(1, callType);
+
+  std::vector<Mapping> mappings = readMappings();
+  std::map<void*, uint64_t> addressLocations;
+  std::map<NamedKey, uint64_t> typeLocations;
+  ProtoWriter locations;
+  ProtoWriter functions;
+  uint64_t nextLocation = 1;
+
+  for (const auto& sample : samples) {
+    NamedKey named = nameOf(sample.first.key);
+    std::vector<uint64_t> locationIds;
+
+    // The leaf frame names the types called, so they show in every view
+    auto typeLocation = typeLocations.find(named);
+    if (typeLocation == typeLocations.end()) {
+      uint64_t id = nextLocation++;
+      ProtoWriter function;
+      function.uint64Field(1, id);
+      function.uint64Field(2,
+                           strings.index(std::string(kindName(named.kind)) + " "
+                                         + describe(named)));
+      functions.messageField(5, function);
+      ProtoWriter line;
+      line.uint64Field(1, id);
+      ProtoWriter location;
+      location.uint64Field(1, id);
+      location.messageField(4, line);
+      locations.messageField(4, location);
+      typeLocation = typeLocations.insert(std::make_pair(named, id)).first;
+    }
+    locationIds.push_back(typeLocation->second);
+
+    for (size_t i = 0; i < sample.first.stack.size(); ++i) {
+      void* pc = sample.first.stack[i];
+      auto addressLocation = addressLocations.find(pc);
+      if (addressLocation == addressLocations.end()) {
+        uint64_t id = nextLocation++;
+        // Frames are return addresses; the call is the instruction before
+        auto address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pc)) - 1;
+        ProtoWriter location;
+        location.uint64Field(1, id);
+        for (size_t m = 0; m < mappings.size(); ++m) {
+          if (address >= mappings[m].start && address < mappings[m].limit) {
+            location.uint64Field(2, m + 1);
+            break;
+          }
+        }
+        location.uint64Field(3, address);
+        locations.messageField(4, location);
+        addressLocation = addressLocations.insert(std::make_pair(pc, id)).first;
+      }
+      locationIds.push_back(addressLocation->second);
+    }
 
-  CountGreater is_greater;
+    ProtoWriter message;
+    message.packedField(1, locationIds);
+    message.packedField(2, {sample.second, sample.second * period});
+    const std::pair<const char*, const std::string*> labels[] = {
+        {"kind", nullptr},
+        {"processor", &named.processor},
+        {"protocol", &named.protocol},
+        {"transport", &named.transport}};
+    for (const auto& label : labels) {
+      std::string value = label.second == nullptr ? kindName(named.kind) : *label.second;
+      if (!value.empty()) {
+        ProtoWriter labelMessage;
+        labelMessage.uint64Field(1, strings.index(label.first));
+        labelMessage.uint64Field(2, strings.index(value));
+        message.messageField(3, labelMessage);
+      }
+    }
+    profile.messageField(2, message);
+  }
 
-  // Grab both locks for the duration of the print operation,
-  // to ensure the output is a consistent snapshot of a single point in time
-  Guard generic_calls_guard(generic_calls_mutex);
-  Guard virtual_calls_guard(virtual_calls_mutex);
+  for (size_t m = 0; m < mappings.size(); ++m) {
+    ProtoWriter mapping;
+    mapping.uint64Field(1, m + 1);
+    mapping.uint64Field(2, mappings[m].start);
+    mapping.uint64Field(3, mappings[m].limit);
+    mapping.uint64Field(4, mappings[m].offset);
+    mapping.uint64Field(5, strings.index(mappings[m].file));
+    profile.messageField(3, mapping);
+  }
+  ProtoWriter periodType;
+  periodType.uint64Field(1, strings.index("calls"));
+  periodType.uint64Field(2, strings.index("count"));
+  profile.messageField(11, periodType);
+  profile.uint64Field(12, period);
+  if (lost != 0) {
+    profile.uint64Field(13,
+                        strings.index(std::to_string(lost) + " calls not counted: too many types"));
+  }
 
-  // write the info from generic_calls
-  profile_write_pprof_file(gen_calls_f, generic_calls);
+  // Fields may come in any order; the string table is last, once complete
+  ProtoWriter stringTable;
+  for (const auto& s : strings.strings()) {
+    stringTable.bytesField(6, s);
+  }
+  std::string body = profile.buffer() + locations.buffer() + functions.buffer()
+                     + stringTable.buffer();
 
-  // write the info from virtual_calls
-  profile_write_pprof_file(virtual_calls_f, virtual_calls);
+  return fwrite(body.data(), 1, body.size(), f) == body.size() && fflush(f) == 0;
 }
 }
 } // apache::thrift
-
-#endif // T_GLOBAL_PROFILE_VIRTUAL > 0
@@ -0,0 +1,138 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_VIRTUALPROFILING_H_
+#define _THRIFT_VIRTUALPROFILING_H_ 1
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include <thrift/thrift_export.h>
+
+namespace apache {
+namespace thrift {
+
+namespace protocol {
+class TProtocol;
+}
+namespace transport {
+class TTransport;
+}
+
+/**
+ * Counts the calls that miss the template fast path: calls made on a
+ * TProtocol or TTransport through the base class, which go through their
+ * virtual _virt methods, and calls to templated processors with a protocol
+ * other than the one they were generated for. Each is counted against the
+ * concrete types involved, so a report shows which protocol and transport
+ * combinations lose devirtualization, and where.
+ *
+ * The profiler is off until enabled, at run time; while it is off, each
+ * profiled call costs one relaxed load and a predictable branch. While it is
+ * on, calls are counted by each thread, without locking, and one call in
+ * every sample period, on average, also has its stack recorded, for
+ * writePprof().
+ *
+ * <blockquote><code>
+ *     TVirtualProfiler::enable();
+ *     ...
+ *     TVirtualProfiler::printReport(stderr);
+ *     TVirtualProfiler::writePprof(fopen("virtual.pb", "w"));
+ * </code></blockquote>
+ *
+ * The hooks are compiled out when T_GLOBAL_DEBUG_VIRTUAL is negative (see
+ * TLogging.h), and the profiler starts enabled when it is 2.
+ */
+class TVirtualProfiler {
+public:
+  enum CallKind {
+    /** A call to a TProtocol through the base class. */
+    VIRTUAL_PROTOCOL_CALL,
+    /** A call to a TTransport through the base class. */
+    VIRTUAL_TRANSPORT_CALL,
+    /** A message processed by a templated processor on its generic path. */
+    GENERIC_PROTOCOL_CALL
+  };
+
+  /** The calls counted for one combination of concrete types. */
+  struct Entry {
+    Entry() : kind(VIRTUAL_PROTOCOL_CALL), calls(0), samples(0) {}
+
+    CallKind kind;
+    /** The processor, for GENERIC_PROTOCOL_CALL, or empty. */
+    std::string processor;
+    /** The protocol, or empty for VIRTUAL_TRANSPORT_CALL. */
+    std::string protocol;
+    std::string transport;
+    uint64_t calls;
+    /** The number of these calls whose stacks were recorded. */
+    uint64_t samples;
+  };
+
+  static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * Starts counting calls.
+   *
+   * @param samplePeriod Record the stack of one call in this many, on
+   *                     average, on each thread, or of none if 0.
+   */
+  static void enable(uint32_t samplePeriod = 1000);
+
+  /** Stops counting calls. What was counted is kept. */
+  static void disable();
+
+  /** Forgets what has been counted. */
+  static void reset();
+
+  /**
+   * Returns what has been counted, on all threads, including those that have
+   * exited, most frequent first.
+   */
+  static std::vector<Entry> snapshot();
+
+  /** Prints snapshot() as a table. */
+  static void printReport(FILE* f);
+
+  /**
+   * Writes the stacks recorded, in the pprof profile.proto format
+   * (uncompressed, which pprof accepts), for "pprof -top binary file" and
+   * the like. Each stack ends in a frame naming the types called, and its
+   * samples are labelled with them, for -tagfocus. Returns false if writing
+   * failed.
+   */
+  static bool writePprof(FILE* f);
+
+  // Called by the T_VIRTUAL_CALL() and T_GENERIC_PROTOCOL() hooks
+  static void recordVirtualCall(const protocol::TProtocol* protocol);
+  static void recordVirtualCall(const transport::TTransport* transport);
+  static void recordGenericProtocol(const std::type_info& processor,
+                                    const protocol::TProtocol* protocol);
+
+private:
+  THRIFT_EXPORT static std::atomic<bool> enabled_;
+};
+}
+} // apache::thrift
+
+#endif // #ifndef _THRIFT_VIRTUALPROFILING_H_
@@ -0,0 +1,255 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/concurrency/AffinityThreadFactory.h>
+#include <thrift/Thrift.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+namespace {
+
+typedef AffinityThreadFactory::CpuSet CpuSet;
+
+/**
+ * A thread that binds itself before running its runnable.
+ */
+class AffinityThread : public Thread {
+public:
+  AffinityThread(bool detached,
+                 std::shared_ptr<Runnable> runnable,
+                 const CpuSet& cpus,
+                 int numaNode)
+    : Thread(detached, runnable), cpus_(cpus), numaNode_(numaNode) {}
+
+protected:
+  thread_funct_t getThreadFunc() const override { return boundThreadMain; }
+
+private:
+  static void boundThreadMain(std::shared_ptr<Thread> thread) {
+    const AffinityThread* self = static_cast<const AffinityThread*>(thread.get());
+    AffinityThreadFactory::bindCurrentThread(self->cpus_, self->numaNode_);
+    threadMain(thread);
+  }
+
+  const CpuSet cpus_;
+  const int numaNode_;
+};
+
+// Reads the first line of a sysfs file, returning false if there is none
+bool readSysfs(const std::string& path, std::string& line) {
+  std::ifstream in(path.c_str());
+  return static_cast<bool>(std::getline(in, line));
+}
+
+bool parseCpu(const std::string& list, size_t& pos, int& cpu) {
+  size_t start = pos;
+  long value = 0;
+  while (pos < list.size() && std::isdigit(static_cast<unsigned char>(list[pos]))) {
+    value = value * 10 + (list[pos] - '0');
+    if (value > 1 << 20) {
+      return false;
+    }
+    ++pos;
+  }
+  cpu = static_cast<int>(value);
+  return pos > start;
+}
+}
+
+AffinityThreadFactory::AffinityThreadFactory(const std::vector<CpuSet>& cpuSets,
+                                             int numaNode,
+                                             bool detached)
+  : ThreadFactory(detached), cpuSets_(cpuSets), numaNode_(numaNode), next_(0) {
+  for (const auto& cpus : cpuSets_) {
+    for (int cpu : cpus) {
+      if (cpu < 0) {
+        throw std::invalid_argument("AffinityThreadFactory: negative CPU number");
+      }
+    }
+  }
+  if (numaNode_ < -1) {
+    throw std::invalid_argument("AffinityThreadFactory: negative NUMA node");
+  }
+}
+
+std::shared_ptr<AffinityThreadFactory> AffinityThreadFactory::forNumaNode(int numaNode,
+                                                                          bool detached) {
+  return std::make_shared<AffinityThreadFactory>(std::vector<CpuSet>(1, numaNodeCpus(numaNode)),
+                                                 numaNode,
+                                                 detached);
+}
+
+std::shared_ptr<Thread> AffinityThreadFactory::newThread(std::shared_ptr<Runnable> runnable) const {
+  CpuSet cpus;
+  if (!cpuSets_.empty()) {
+    cpus = cpuSets_[next_++ % cpuSets_.size()];
+  }
+  if (cpus.empty() && numaNode_ < 0) {
+    return ThreadFactory::newThread(runnable);
+  }
+  std::shared_ptr<Thread> result
+      = std::make_shared<AffinityThread>(isDetached(), runnable, cpus, numaNode_);
+  runnable->thread(result);
+  return result;
+}
+
+bool AffinityThreadFactory::bindCurrentThread(const CpuSet& cpus, int numaNode) {
+  bool bound = true;
+#if defined(__linux__)
+  if (!cpus.empty()) {
+    int count = *std::max_element(cpus.begin(), cpus.end()) + 1;
+    cpu_set_t* set = CPU_ALLOC(count);
+    if (set == nullptr) {
+      return false;
+    }
+    size_t size = CPU_ALLOC_SIZE(count);
+    CPU_ZERO_S(size, set);
+    for (int cpu : cpus) {
+      CPU_SET_S(cpu, size, set);
+    }
+    int rc = pthread_setaffinity_np(pthread_self(), size, set);
+    CPU_FREE(set);
+    if (rc != 0) {
+      GlobalOutput.perror("AffinityThreadFactory: pthread_setaffinity_np(): ", rc);
+      bound = false;
+    }
+  }
+  if (numaNode >= 0) {
+#ifdef SYS_set_mempolicy
+    // Called directly, as libnuma may not be installed
+    const int MPOL_PREFERRED = 1;
+    const size_t bits = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> nodes(numaNode / bits + 1);
+    nodes[numaNode / bits] |= 1UL << (numaNode % bits);
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodes.data(), nodes.size() * bits + 1) != 0) {
+      GlobalOutput.perror("AffinityThreadFactory: set_mempolicy(): ", errno);
+      bound = false;
+    }
+#else
+    bound = false;
+#endif
+  }
+#elif defined(_WIN32)
+  // Windows takes memory from the node of the CPU a thread runs on
+  THRIFT_UNUSED_VARIABLE(numaNode);
+  if (!cpus.empty()) {
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus) {
+      if (cpu >= static_cast<int>(sizeof(mask) * 8)) {
+        return false;
+      }
+      mask |= static_cast<DWORD_PTR>(1) << cpu;
+    }
+    if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+      GlobalOutput.perror("AffinityThreadFactory: SetThreadAffinityMask(): ",
+                          static_cast<int>(GetLastError()));
+      bound = false;
+    }
+  }
+#else
+  bound = cpus.empty() && numaNode < 0;
+#endif
+  return bound;
+}
+
+int AffinityThreadFactory::numaNodeCount() {
+  std::string line;
+  if (readSysfs("/sys/devices/system/node/online", line)) {
+    try {
+      CpuSet nodes = parseCpuList(line);
+      if (!nodes.empty()) {
+        return nodes.back() + 1;
+      }
+    } catch (const std::invalid_argument&) {
+    }
+  }
+  return 1;
+}
+
+AffinityThreadFactory::CpuSet AffinityThreadFactory::numaNodeCpus(int numaNode) {
+  if (numaNode < 0 || numaNode >= numaNodeCount()) {
+    throw std::invalid_argument("AffinityThreadFactory: no such NUMA node");
+  }
+  std::string line;
+  if (readSysfs("/sys/devices/system/node/node" + std::to_string(numaNode) + "/cpulist", line)) {
+    return parseCpuList(line);
+  }
+  CpuSet cpus;
+  for (unsigned cpu = 0; cpu < (std::max)(std::thread::hardware_concurrency(), 1u); ++cpu) {
+    cpus.push_back(static_cast<int>(cpu));
+  }
+  return cpus;
+}
+
+AffinityThreadFactory::CpuSet AffinityThreadFactory::parseCpuList(const std::string& list) {
+  CpuSet cpus;
+  size_t end = list.size();
+  while (end > 0 && std::isspace(static_cast<unsigned char>(list[end - 1]))) {
+    --end;
+  }
+  for (size_t pos = 0; pos < end;) {
+    int first;
+    int last;
+    if (!parseCpu(list, pos, first)) {
+      throw std::invalid_argument("AffinityThreadFactory: bad CPU list: " + list);
+    }
+    last = first;
+    if (pos < end && list[pos] == '-') {
+      ++pos;
+      if (!parseCpu(list, pos, last) || last < first) {
+        throw std::invalid_argument("AffinityThreadFactory: bad CPU list: " + list);
+      }
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+    if (pos < end) {
+      if (list[pos] != ',' || pos + 1 == end) {
+        throw std::invalid_argument("AffinityThreadFactory: bad CPU list: " + list);
+      }
+      ++pos;
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+}
+}
+} // apache::thrift::concurrency
@@ -0,0 +1,116 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_AFFINITYTHREADFACTORY_H_
+#define _THRIFT_CONCURRENCY_AFFINITYTHREADFACTORY_H_ 1
+
+#include <thrift/concurrency/ThreadFactory.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+/**
+ * Factory for threads that run only on given CPUs, and that take their
+ * memory from a given NUMA node.
+ *
+ * Each new thread is bound to the next of the factory's CPU sets, in turn,
+ * so a factory can either keep all its threads on one set of CPUs, or give
+ * each thread a CPU of its own. Memory that a thread touches first is then
+ * allocated on its node, which keeps the buffers of a thread that only talks
+ * to threads on the same node off the interconnect.
+ *
+ * Binding is supported on Linux, and, for the first 64 CPUs, on Windows.
+ * Elsewhere, or if binding fails, threads run unbound.
+ */
+class AffinityThreadFactory : public ThreadFactory {
+public:
+  /**
+   * CPUs, by the numbers the operating system gives them.
+   */
+  typedef std::vector<int> CpuSet;
+
+  /**
+   * @param cpuSets  The CPU sets new threads are bound to, in turn. An empty
+   *                 set, or no sets at all, leaves threads free to run on
+   *                 any CPU.
+   * @param numaNode The NUMA node threads prefer to take memory from, or -1
+   *                 to leave that to the system.
+   * @param detached Whether threads are detached; see ThreadFactory.
+   */
+  AffinityThreadFactory(const std::vector<CpuSet>& cpuSets,
+                        int numaNode = -1,
+                        bool detached = true);
+
+  /**
+   * Creates a factory whose threads may run on any CPU of the given NUMA
+   * node, and take their memory from it.
+   *
+   * @throws std::invalid_argument if there is no such node.
+   */
+  static std::shared_ptr<AffinityThreadFactory> forNumaNode(int numaNode, bool detached = true);
+
+  /**
+   * Create a new thread, bound to the next CPU set.
+   */
+  std::shared_ptr<Thread> newThread(std::shared_ptr<Runnable> runnable) const override;
+
+  /**
+   * Binds the calling thread to the given CPUs, if not empty, and makes it
+   * prefer memory from the given NUMA node, if not -1.
+   *
+   * @return false if binding is not supported, or failed.
+   */
+  static bool bindCurrentThread(const CpuSet& cpus, int numaNode);
+
+  /**
+   * Returns the number of NUMA nodes, or 1 if it is not known.
+   */
+  static int numaNodeCount();
+
+  /**
+   * Returns the CPUs of the given NUMA node. If the topology is not known,
+   * node 0 is taken to have every CPU.
+   *
+   * @throws std::invalid_argument if there is no such node.
+   */
+  static CpuSet numaNodeCpus(int numaNode);
+
+  /**
+   * Parses a CPU list as Linux writes them, such as "0-3,8,10-11".
+   *
+   * @throws std::invalid_argument if list is malformed.
+   */
+  static CpuSet parseCpuList(const std::string& list);
+
+private:
+  std::vector<CpuSet> cpuSets_;
+  int numaNode_;
+  mutable std::atomic<size_t> next_;
+};
+}
+}
+} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_AFFINITYTHREADFACTORY_H_
@@ -0,0 +1,129 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/concurrency/Futex.h>
+
+#include <climits>
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+#ifdef __linux__
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futexes need atomics laid out as plain words");
+
+bool futexWait(const std::atomic<uint32_t>& word,
+               uint32_t expected,
+               const std::chrono::steady_clock::time_point* deadline) {
+  struct timespec timeout;
+  struct timespec* timeoutp = nullptr;
+  if (deadline != nullptr) {
+    auto remaining = *deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) {
+      return false;
+    }
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+    timeout.tv_sec = static_cast<time_t>(nanos / 1000000000);
+    timeout.tv_nsec = static_cast<long>(nanos % 1000000000);
+    timeoutp = &timeout;
+  }
+  long result = syscall(SYS_futex,
+                        const_cast<std::atomic<uint32_t>*>(&word),
+                        FUTEX_WAIT_PRIVATE,
+                        expected,
+                        timeoutp,
+                        nullptr,
+                        0);
+  return !(result == -1 && errno == ETIMEDOUT);
+}
+
+void futexWake(const std::atomic<uint32_t>& word, int count) {
+  syscall(SYS_futex,
+          const_cast<std::atomic<uint32_t>*>(&word),
+          FUTEX_WAKE_PRIVATE,
+          count,
+          nullptr,
+          nullptr,
+          0);
+}
+
+#else
+
+namespace {
+
+/**
+ * Threads waiting on words hashing to a bucket block on its condition
+ * variable, and are all woken to check their words.
+ */
+struct Bucket {
+  std::mutex mutex;
+  std::condition_variable condition;
+};
+
+const size_t BUCKETS = 64;
+
+Bucket& bucketOf(const std::atomic<uint32_t>& word) {
+  // Never destroyed, as mutexes may be used by static destructors
+  static Bucket* buckets = new Bucket[BUCKETS];
+  auto address = reinterpret_cast<uintptr_t>(&word);
+  return buckets[(address >> 4) % BUCKETS];
+}
+}
+
+bool futexWait(const std::atomic<uint32_t>& word,
+               uint32_t expected,
+               const std::chrono::steady_clock::time_point* deadline) {
+  Bucket& bucket = bucketOf(word);
+  std::unique_lock<std::mutex> lock(bucket.mutex);
+  if (word.load(std::memory_order_relaxed) != expected) {
+    return true;
+  }
+  if (deadline == nullptr) {
+    bucket.condition.wait(lock);
+    return true;
+  }
+  return bucket.condition.wait_until(lock, *deadline) == std::cv_status::no_timeout;
+}
+
+void futexWake(const std::atomic<uint32_t>& word, int count) {
+  (void)count;
+  Bucket& bucket = bucketOf(word);
+  std::lock_guard<std::mutex> lock(bucket.mutex);
+  bucket.condition.notify_all();
+}
+
+#endif
+}
+}
+} // apache::thrift::concurrency
@@ -0,0 +1,63 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_FUTEX_H_
+#define _THRIFT_CONCURRENCY_FUTEX_H_ 1
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+/**
+ * Blocks the calling thread while word holds expected, until another thread
+ * calls futexWake() on it or, if deadline is not null, until the deadline.
+ * May return spuriously, so callers check word again.
+ *
+ * Uses the futex system call on Linux, and a table of condition variables,
+ * hashed by address, elsewhere.
+ *
+ * @return false if the deadline passed, otherwise true.
+ */
+bool futexWait(const std::atomic<uint32_t>& word,
+               uint32_t expected,
+               const std::chrono::steady_clock::time_point* deadline = nullptr);
+
+/**
+ * Wakes up to count threads blocked in futexWait() on word. Callers change
+ * word before waking, so threads about to block do not.
+ */
+void futexWake(const std::atomic<uint32_t>& word, int count);
+
+/** Hints to the processor that the calling thread is spinning. */
+inline void cpuRelax() {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+  __builtin_ia32_pause();
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__arm__))
+  __asm__ __volatile__("yield");
+#endif
+}
+}
+}
+} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_FUTEX_H_
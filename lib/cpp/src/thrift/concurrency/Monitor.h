@@ -20,6 +20,7 @@
 #ifndef _THRIFT_CONCURRENCY_MONITOR_H_
 #define _THRIFT_CONCURRENCY_MONITOR_H_ 1
 
+#include <atomic>
 #include <chrono>
 #include <thrift/concurrency/Exception.h>
 #include <thrift/concurrency/Mutex.h>
@@ -45,6 +46,10 @@ namespace concurrency {
  * bit constness.  This allows const methods to call monitor methods without
  * needing to cast away constness or change to non-const signatures.
  *
+ * Waiting threads park on a futex holding a count of notifications, so
+ * notifying a monitor nobody waits on makes no system call.  As with
+ * condition variables, waits may return without a notification.
+ *
  * @version $Id:$
  */
 class Monitor : apache::thrift::TNonCopyable {
@@ -107,9 +112,17 @@ public:
   virtual void notifyAll() const;
 
 private:
-  class Impl;
+  /**
+   * Waits until notified or, if deadline is not null, the deadline.
+   * Returns 0, or THRIFT_ETIMEDOUT if the deadline passed.
+   */
+  int waitUntil(const std::chrono::steady_clock::time_point* deadline) const;
 
-  Impl* impl_;
+  Mutex ownedMutex_;
+  Mutex* mutex_;
+  /** Advanced by each notification; waiters park until it changes. */
+  mutable std::atomic<uint32_t> sequence_;
+  mutable std::atomic<uint32_t> waiters_;
 };
 
 class Synchronized {
@@ -19,45 +19,149 @@
 
 #include <thrift/concurrency/Mutex.h>
 
-#include <chrono>
-#include <mutex>
+#include <algorithm>
+#include <thread>
+
+#include <thrift/concurrency/Futex.h>
+
+#if defined(__GNUC__)
+#define THRIFT_CALLSITE() __builtin_return_address(0)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define THRIFT_CALLSITE() _ReturnAddress()
+#else
+#define THRIFT_CALLSITE() nullptr
+#endif
 
 namespace apache {
 namespace thrift {
 namespace concurrency {
 
-/**
- * Implementation of Mutex class using C++11 std::timed_mutex
- *
- * Methods throw std::system_error on error.
- *
- * @version $Id:$
- */
-class Mutex::impl : public std::timed_mutex {};
+namespace {
+
+const int32_t MAX_SPINS = 100;
+
+std::atomic<int32_t> profilingSampleRate(0);
+std::atomic<MutexWaitCallback> profilingCallback(nullptr);
 
-Mutex::Mutex() : impl_(new Mutex::impl()) {
+// Contended acquisitions by the calling thread since the last one sampled
+thread_local int32_t contendedSinceSample = 0;
+
+bool shouldSpin() {
+  // Spinning on one processor only delays the holder
+  static const bool multiprocessor = std::thread::hardware_concurrency() != 1;
+  return multiprocessor;
+}
 }
 
-void* Mutex::getUnderlyingImpl() const {
-  return impl_.get();
+void enableMutexProfiling(int32_t profilingSampleRate_, MutexWaitCallback callback) {
+  profilingCallback.store(callback, std::memory_order_relaxed);
+  profilingSampleRate.store(callback == nullptr ? 0 : profilingSampleRate_,
+                            std::memory_order_release);
 }
 
 void Mutex::lock() const {
-  impl_->lock();
+  uint32_t state = UNLOCKED;
+  if (state_.compare_exchange_strong(state, LOCKED, std::memory_order_acquire)) {
+    if (profilingSampleRate.load(std::memory_order_relaxed) != 0) {
+      holder_.store(THRIFT_CALLSITE(), std::memory_order_relaxed);
+    }
+    return;
+  }
+  lockSlow(THRIFT_CALLSITE(), nullptr);
 }
 
 bool Mutex::trylock() const {
-  return impl_->try_lock();
+  uint32_t state = UNLOCKED;
+  if (state_.compare_exchange_strong(state, LOCKED, std::memory_order_acquire)) {
+    if (profilingSampleRate.load(std::memory_order_relaxed) != 0) {
+      holder_.store(THRIFT_CALLSITE(), std::memory_order_relaxed);
+    }
+    return true;
+  }
+  return false;
 }
 
-bool Mutex::timedlock(int64_t ms) const {
-  return impl_->try_lock_for(std::chrono::milliseconds(ms));
+bool Mutex::timedlock(int64_t milliseconds) const {
+  uint32_t state = UNLOCKED;
+  if (state_.compare_exchange_strong(state, LOCKED, std::memory_order_acquire)) {
+    if (profilingSampleRate.load(std::memory_order_relaxed) != 0) {
+      holder_.store(THRIFT_CALLSITE(), std::memory_order_relaxed);
+    }
+    return true;
+  }
+  std::chrono::steady_clock::time_point deadline
+      = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+  return lockSlow(THRIFT_CALLSITE(), &deadline);
 }
 
 void Mutex::unlock() const {
-  impl_->unlock();
+  if (state_.exchange(UNLOCKED, std::memory_order_release) == CONTENDED) {
+    futexWake(state_, 1);
+  }
 }
 
+bool Mutex::lockSlow(const void* callsite,
+                     const std::chrono::steady_clock::time_point* deadline) const {
+  int32_t sampleRate = profilingSampleRate.load(std::memory_order_acquire);
+  bool sampled = false;
+  std::chrono::steady_clock::time_point start;
+  const void* holder = nullptr;
+  if (sampleRate != 0 && ++contendedSinceSample >= sampleRate) {
+    contendedSinceSample = 0;
+    sampled = true;
+    start = std::chrono::steady_clock::now();
+    holder = holder_.load(std::memory_order_relaxed);
+  }
+
+  // Spin for a little longer than recent waits that spinning ended took
+  bool acquired = false;
+  if (shouldSpin()) {
+    int32_t estimate = spins_.load(std::memory_order_relaxed);
+    int32_t limit = (std::min)(MAX_SPINS, estimate * 2 + 10);
+    int32_t spins = 0;
+    while (spins < limit) {
+      ++spins;
+      cpuRelax();
+      uint32_t state = state_.load(std::memory_order_relaxed);
+      if (state == UNLOCKED
+          && state_.compare_exchange_weak(state, LOCKED, std::memory_order_acquire)) {
+        acquired = true;
+        break;
+      }
+    }
+    spins_.store(estimate + (spins - estimate) / 8, std::memory_order_relaxed);
+  }
+
+  // Then park. CONTENDED tells unlock() that a thread may be parked, so it
+  // is left set by whichever thread gets the mutex next.
+  if (!acquired) {
+    uint32_t state = state_.exchange(CONTENDED, std::memory_order_acquire);
+    while (state != UNLOCKED) {
+      if (!futexWait(state_, CONTENDED, deadline)) {
+        return false;
+      }
+      state = state_.exchange(CONTENDED, std::memory_order_acquire);
+    }
+  }
+
+  if (sampleRate != 0) {
+    holder_.store(callsite, std::memory_order_relaxed);
+  }
+  if (sampled) {
+    MutexWaitCallback callback = profilingCallback.load(std::memory_order_relaxed);
+    if (callback != nullptr) {
+      MutexContention contention;
+      contention.id = this;
+      contention.waitTimeMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                                      std::chrono::steady_clock::now() - start).count();
+      contention.waiterCallsite = callsite;
+      contention.holderCallsite = holder;
+      callback(contention);
+    }
+  }
+  return true;
+}
 }
 }
 } // apache::thrift::concurrency
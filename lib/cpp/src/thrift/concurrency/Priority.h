@@ -0,0 +1,46 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_PRIORITY_H_
+#define _THRIFT_CONCURRENCY_PRIORITY_H_ 1
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+/**
+ * Classes of work, from the most urgent to the least. A thread manager made
+ * by ThreadManager::newPriorityThreadManager() queues each class apart, so
+ * that health checks and admin calls need not wait behind bulk work.
+ * Processors give the class of each method through TProcessor::getPriority(),
+ * from the priority annotation in the IDL.
+ */
+enum PRIORITY {
+  HIGH_IMPORTANT = 0,
+  HIGH,
+  IMPORTANT,
+  NORMAL,
+  BEST_EFFORT,
+  N_PRIORITIES
+};
+}
+}
+} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_PRIORITY_H_
@@ -23,6 +23,7 @@
 #include <thrift/concurrency/Exception.h>
 #include <thrift/concurrency/Monitor.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <stdexcept>
@@ -48,6 +49,12 @@ using std::dynamic_pointer_cast;
  * There are three different monitors used for signaling different conditions
  * however they all share the same mutex_.
  *
+ * Pending tasks wait in a single queue, or, when priorities have been set up,
+ * in a queue per PRIORITY. With WEIGHTED_FAIR scheduling, queues are picked by
+ * stride scheduling: taking a task from a queue advances its pass by a stride
+ * inversely proportional to its weight, and the non-empty queue with the
+ * lowest pass goes next.
+ *
  * @version $Id:$
  */
 class ThreadManager::Impl : public ThreadManager {
@@ -60,6 +67,10 @@ public:
       pendingTaskCountMax_(0),
       expiredCount_(0),
       state_(ThreadManager::UNINITIALIZED),
+      queues_(1),
+      pendingCount_(0),
+      scheduling_(STRICT_PRIORITY),
+      pass_(0),
       monitor_(&mutex_),
       maxMonitor_(&mutex_),
       workerMonitor_(&mutex_) {}
@@ -97,12 +108,12 @@ public:
 
   size_t pendingTaskCount() const override {
     Guard g(mutex_);
-    return tasks_.size();
+    return pendingCount_;
   }
 
   size_t totalTaskCount() const override {
     Guard g(mutex_);
-    return tasks_.size() + workerCount_ - idleCount_;
+    return pendingCount_ + workerCount_ - idleCount_;
   }
 
   size_t pendingTaskCountMax() const override {
@@ -120,7 +131,20 @@ public:
     pendingTaskCountMax_ = value;
   }
 
-  void add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration) override;
+  /**
+   * Keeps a queue for each PRIORITY from now on. Only meant to be called
+   * before start().
+   */
+  void priorities(SCHEDULING scheduling, const std::vector<uint32_t>& weights);
+
+  void add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration) override {
+    add(value, timeout, expiration, NORMAL);
+  }
+
+  void add(shared_ptr<Runnable> value,
+           int64_t timeout,
+           int64_t expiration,
+           PRIORITY priority) override;
 
   void remove(shared_ptr<Runnable> task) override;
 
@@ -151,6 +175,17 @@ private:
    */
   void removeWorkersUnderLock(size_t value);
 
+  /**
+   * Queues a task at the given priority. The caller holds mutex_.
+   */
+  void push(shared_ptr<Task> task, PRIORITY priority);
+
+  /**
+   * Takes the task to run next off its queue. The caller holds mutex_, and
+   * there must be a pending task.
+   */
+  shared_ptr<Task> popNext();
+
   size_t workerCount_;
   size_t workerMaxCount_;
   size_t idleCount_;
@@ -163,7 +198,15 @@ private:
 
   friend class ThreadManager::Task;
   typedef std::deque<shared_ptr<Task> > TaskQueue;
-  TaskQueue tasks_;
+  // One queue, or one for each PRIORITY
+  std::vector<TaskQueue> queues_;
+  size_t pendingCount_;
+  SCHEDULING scheduling_;
+  // For WEIGHTED_FAIR, the stride and pass of each queue, and the pass of the
+  // queue last taken from
+  std::vector<uint64_t> strides_;
+  std::vector<uint64_t> passes_;
+  uint64_t pass_;
   Mutex mutex_;
   Monitor monitor_;
   Monitor maxMonitor_;
@@ -182,7 +225,8 @@ public:
 
   Task(shared_ptr<Runnable> runnable, uint64_t expiration = 0ULL)
     : runnable_(runnable),
-      state_(WAITING) {
+      state_(WAITING),
+      queued_(std::chrono::steady_clock::now()) {
         if (expiration != 0ULL) {
           expireTime_.reset(new std::chrono::steady_clock::time_point(std::chrono::steady_clock::now() + std::chrono::milliseconds(expiration)));
         }
@@ -205,9 +249,17 @@ private:
   shared_ptr<Runnable> runnable_;
   friend class ThreadManager::Worker;
   STATE state_;
+  std::chrono::steady_clock::time_point queued_;
   unique_ptr<std::chrono::steady_clock::time_point> expireTime_;
 };
 
+namespace {
+
+// How long the task the thread is running waited, until taken
+thread_local bool queueTimeSet = false;
+thread_local std::chrono::steady_clock::duration queueTime;
+}
+
 class ThreadManager::Worker : public Runnable {
   enum STATE { UNINITIALIZED, STARTING, STARTED, STOPPING, STOPPED };
 
@@ -219,7 +271,7 @@ public:
 private:
   bool isActive() const {
     return (manager_->workerCount_ <= manager_->workerMaxCount_)
-           || (manager_->state_ == JOINING && !manager_->tasks_.empty());
+           || (manager_->state_ == JOINING && manager_->pendingCount_ != 0);
   }
 
 public:
@@ -266,7 +318,7 @@ public:
         */
       active = isActive();
 
-      while (active && manager_->tasks_.empty()) {
+      while (active && manager_->pendingCount_ == 0) {
         manager_->idleCount_++;
         manager_->monitor_.wait();
         active = isActive();
@@ -276,9 +328,8 @@ public:
       shared_ptr<ThreadManager::Task> task;
 
       if (active) {
-        if (!manager_->tasks_.empty()) {
-          task = manager_->tasks_.front();
-          manager_->tasks_.pop_front();
+        if (manager_->pendingCount_ != 0) {
+          task = manager_->popNext();
           if (task->state_ == ThreadManager::Task::WAITING) {
             // If the state is changed to anything other than EXECUTING or TIMEDOUT here
             // then the execution loop needs to be changed below.
@@ -292,7 +343,7 @@ public:
         /* If we have a pending task max and we just dropped below it, wakeup any
             thread that might be blocked on add. */
         if (manager_->pendingTaskCountMax_ != 0
-            && manager_->tasks_.size() <= manager_->pendingTaskCountMax_ - 1) {
+            && manager_->pendingCount_ <= manager_->pendingTaskCountMax_ - 1) {
           manager_->maxMonitor_.notify();
         }
       }
@@ -306,6 +357,8 @@ public:
           // Release the lock so we can run the task without blocking the thread manager
           manager_->mutex_.unlock();
 
+          queueTime = std::chrono::steady_clock::now() - task->queued_;
+          queueTimeSet = true;
           try {
             task->run();
           } catch (const std::exception& e) {
@@ -314,6 +367,8 @@ public:
             GlobalOutput.printf("[ERROR] task->run() raised an unknown exception");
           }
 
+          queueTimeSet = false;
+
           // Re-acquire the lock to proceed in the thread manager
           manager_->mutex_.lock();
 
@@ -450,7 +505,73 @@ bool ThreadManager::Impl::canSleep() const {
   return idMap_.find(id) == idMap_.end();
 }
 
-void ThreadManager::Impl::add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration) {
+void ThreadManager::Impl::priorities(SCHEDULING scheduling, const std::vector<uint32_t>& weights) {
+  std::vector<uint32_t> actual = weights;
+  if (actual.empty()) {
+    for (int priority = 0; priority < N_PRIORITIES; priority++) {
+      actual.push_back(1u << (N_PRIORITIES - 1 - priority));
+    }
+  }
+  if (actual.size() != N_PRIORITIES
+      || std::find(actual.begin(), actual.end(), 0u) != actual.end()) {
+    throw InvalidArgumentException();
+  }
+
+  Guard g(mutex_);
+  queues_.resize(N_PRIORITIES);
+  scheduling_ = scheduling;
+  strides_.clear();
+  passes_.clear();
+  if (scheduling_ == WEIGHTED_FAIR) {
+    const uint64_t STRIDE = 1 << 20;
+    for (uint32_t weight : actual) {
+      strides_.push_back((std::max)(STRIDE / weight, uint64_t(1)));
+    }
+    passes_.assign(N_PRIORITIES, pass_);
+  }
+}
+
+void ThreadManager::Impl::push(shared_ptr<Task> task, PRIORITY priority) {
+  size_t index = queues_.size() == 1 ? 0 : static_cast<size_t>(priority);
+  if (!passes_.empty() && queues_[index].empty()) {
+    // A queue that was idle doesn't get to catch up on the turns it missed
+    passes_[index] = (std::max)(passes_[index], pass_);
+  }
+  queues_[index].push_back(std::move(task));
+  pendingCount_++;
+}
+
+shared_ptr<ThreadManager::Task> ThreadManager::Impl::popNext() {
+  size_t index = 0;
+  if (passes_.empty()) {
+    while (queues_[index].empty()) {
+      index++;
+    }
+  } else {
+    index = queues_.size();
+    for (size_t ix = 0; ix < queues_.size(); ix++) {
+      if (!queues_[ix].empty() && (index == queues_.size() || passes_[ix] < passes_[index])) {
+        index = ix;
+      }
+    }
+    pass_ = passes_[index];
+    passes_[index] += strides_[index];
+  }
+
+  shared_ptr<Task> task = queues_[index].front();
+  queues_[index].pop_front();
+  pendingCount_--;
+  return task;
+}
+
+void ThreadManager::Impl::add(shared_ptr<Runnable> value,
+                              int64_t timeout,
+                              int64_t expiration,
+                              PRIORITY priority) {
+  if (priority < 0 || priority >= N_PRIORITIES) {
+    throw InvalidArgumentException();
+  }
+
   Guard g(mutex_, timeout);
 
   if (!g) {
@@ -464,13 +585,13 @@ void ThreadManager::Impl::add(shared_ptr<Runnable> value, int64_t timeout, int64
   }
 
   // if we're at a limit, remove an expired task to see if the limit clears
-  if (pendingTaskCountMax_ > 0 && (tasks_.size() >= pendingTaskCountMax_)) {
+  if (pendingTaskCountMax_ > 0 && (pendingCount_ >= pendingTaskCountMax_)) {
     removeExpired(true);
   }
 
-  if (pendingTaskCountMax_ > 0 && (tasks_.size() >= pendingTaskCountMax_)) {
+  if (pendingTaskCountMax_ > 0 && (pendingCount_ >= pendingTaskCountMax_)) {
     if (canSleep() && timeout >= 0) {
-      while (pendingTaskCountMax_ > 0 && tasks_.size() >= pendingTaskCountMax_) {
+      while (pendingTaskCountMax_ > 0 && pendingCount_ >= pendingTaskCountMax_) {
         // This is thread safe because the mutex is shared between monitors.
         maxMonitor_.wait(timeout);
       }
@@ -479,7 +600,7 @@ void ThreadManager::Impl::add(shared_ptr<Runnable> value, int64_t timeout, int64
     }
   }
 
-  tasks_.push_back(std::make_shared<ThreadManager::Task>(value, expiration));
+  push(std::make_shared<ThreadManager::Task>(value, expiration), priority);
 
   // If idle thread is available notify it, otherwise all worker threads are
   // running and will get around to this task in time.
@@ -496,12 +617,15 @@ void ThreadManager::Impl::remove(shared_ptr<Runnable> task) {
         "started");
   }
 
-  for (auto it = tasks_.begin(); it != tasks_.end(); ++it)
-  {
-    if ((*it)->getRunnable() == task)
+  for (auto& tasks : queues_) {
+    for (auto it = tasks.begin(); it != tasks.end(); ++it)
     {
-      tasks_.erase(it);
-      return;
+      if ((*it)->getRunnable() == task)
+      {
+        tasks.erase(it);
+        pendingCount_--;
+        return;
+      }
     }
   }
 }
@@ -514,39 +638,48 @@ std::shared_ptr<Runnable> ThreadManager::Impl::removeNextPending() {
         "ThreadManager not started");
   }
 
-  if (tasks_.empty()) {
+  if (pendingCount_ == 0) {
     return std::shared_ptr<Runnable>();
   }
 
-  shared_ptr<ThreadManager::Task> task = tasks_.front();
-  tasks_.pop_front();
+  // The only queue, or the least urgent that has tasks
+  auto tasks = queues_.rbegin();
+  while (tasks->empty()) {
+    ++tasks;
+  }
+  shared_ptr<ThreadManager::Task> task = tasks->front();
+  tasks->pop_front();
+  pendingCount_--;
 
   return task->getRunnable();
 }
 
 void ThreadManager::Impl::removeExpired(bool justOne) {
   // this is always called under a lock
-  if (tasks_.empty()) {
+  if (pendingCount_ == 0) {
     return;
   }
   auto now = std::chrono::steady_clock::now();
 
-  for (auto it = tasks_.begin(); it != tasks_.end(); )
-  {
-    if ((*it)->getExpireTime() && *((*it)->getExpireTime()) < now) {
-      if (expireCallback_) {
-        expireCallback_((*it)->getRunnable());
+  for (auto& tasks : queues_) {
+    for (auto it = tasks.begin(); it != tasks.end(); )
+    {
+      if ((*it)->getExpireTime() && *((*it)->getExpireTime()) < now) {
+        if (expireCallback_) {
+          expireCallback_((*it)->getRunnable());
+        }
+        it = tasks.erase(it);
+        --pendingCount_;
+        ++expiredCount_;
+        if (justOne) {
+          return;
+        }
       }
-      it = tasks_.erase(it);
-      ++expiredCount_;
-      if (justOne) {
-        return;
+      else
+      {
+        ++it;
       }
     }
-    else
-    {
-      ++it;
-    }
   }
 }
 
@@ -572,14 +705,44 @@ private:
   const size_t pendingTaskCountMax_;
 };
 
+class PriorityThreadManager : public SimpleThreadManager {
+
+public:
+  PriorityThreadManager(size_t workerCount,
+                        SCHEDULING scheduling,
+                        const std::vector<uint32_t>& weights,
+                        size_t pendingTaskCountMax)
+    : SimpleThreadManager(workerCount, pendingTaskCountMax) {
+    priorities(scheduling, weights);
+  }
+};
+
 shared_ptr<ThreadManager> ThreadManager::newThreadManager() {
   return shared_ptr<ThreadManager>(new ThreadManager::Impl());
 }
 
+bool ThreadManager::takeQueueTime(std::chrono::steady_clock::duration& waited) {
+  if (!queueTimeSet) {
+    return false;
+  }
+  waited = queueTime;
+  queueTimeSet = false;
+  return true;
+}
+
 shared_ptr<ThreadManager> ThreadManager::newSimpleThreadManager(size_t count,
                                                                 size_t pendingTaskCountMax) {
   return shared_ptr<ThreadManager>(new SimpleThreadManager(count, pendingTaskCountMax));
 }
+
+shared_ptr<ThreadManager> ThreadManager::newPriorityThreadManager(
+    size_t count,
+    SCHEDULING scheduling,
+    const std::vector<uint32_t>& weights,
+    size_t pendingTaskCountMax) {
+  return shared_ptr<ThreadManager>(
+      new PriorityThreadManager(count, scheduling, weights, pendingTaskCountMax));
+}
 }
 }
 } // apache::thrift::concurrency
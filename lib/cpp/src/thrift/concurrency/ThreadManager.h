@@ -20,8 +20,11 @@
 #ifndef _THRIFT_CONCURRENCY_THREADMANAGER_H_
 #define _THRIFT_CONCURRENCY_THREADMANAGER_H_ 1
 
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <vector>
+#include <thrift/concurrency/Priority.h>
 #include <thrift/concurrency/ThreadFactory.h>
 
 namespace apache {
@@ -165,13 +168,29 @@ public:
                    int64_t timeout = 0LL,
                    int64_t expiration = 0LL) = 0;
 
+  /**
+   * Adds a task of the given priority. Thread managers without priorities,
+   * which is all but those made by newPriorityThreadManager(), treat every
+   * task alike.
+   *
+   * @see add(std::shared_ptr<Runnable>, int64_t, int64_t)
+   */
+  virtual void add(std::shared_ptr<Runnable> task,
+                   int64_t timeout,
+                   int64_t expiration,
+                   PRIORITY priority) {
+    (void)priority;
+    add(task, timeout, expiration);
+  }
+
   /**
    * Removes a pending task
    */
   virtual void remove(std::shared_ptr<Runnable> task) = 0;
 
   /**
-   * Remove the next pending task which would be run.
+   * Remove the next pending task which would be run. A thread manager with
+   * priorities removes its least urgent task instead.
    *
    * @return the task removed.
    */
@@ -200,6 +219,44 @@ public:
   static std::shared_ptr<ThreadManager> newSimpleThreadManager(size_t count = 4,
                                                                  size_t pendingTaskCountMax = 0);
 
+  /**
+   * How a thread manager made by newPriorityThreadManager() picks the
+   * priority to take the next task from.
+   */
+  enum SCHEDULING {
+    /** Always run the most urgent task. Less urgent tasks can starve. */
+    STRICT_PRIORITY,
+    /**
+     * Run tasks of each priority in proportion to its weight, whenever
+     * tasks of several priorities are pending.
+     */
+    WEIGHTED_FAIR
+  };
+
+  /**
+   * Creates a thread manager like newSimpleThreadManager(), but that keeps a
+   * queue for each PRIORITY, and picks which to run next by scheduling.
+   *
+   * @param weights For WEIGHTED_FAIR, the weight of each PRIORITY, by value.
+   * The default, empty, weighs them 16, 8, 4, 2 and 1 from the most urgent.
+   *
+   * @throws InvalidArgumentException if weights has the wrong size, or a zero
+   */
+  static std::shared_ptr<ThreadManager> newPriorityThreadManager(
+      size_t count = 4,
+      SCHEDULING scheduling = WEIGHTED_FAIR,
+      const std::vector<uint32_t>& weights = std::vector<uint32_t>(),
+      size_t pendingTaskCountMax = 0);
+
+  /**
+   * Sets waited to how long the task the calling thread is running waited in
+   * its thread manager's queue, and returns true, the first time it is called
+   * by the task. Returns false otherwise, including on threads that are not
+   * thread manager workers. A task that processes several calls in turn, as
+   * TThreadPoolServer's do, so only charges the wait to the first.
+   */
+  static bool takeQueueTime(std::chrono::steady_clock::duration& waited);
+
   class Task;
 
   class Worker;
@@ -20,10 +20,12 @@
 #include <thrift/concurrency/TimerManager.h>
 #include <thrift/concurrency/Exception.h>
 
+#include <algorithm>
 #include <assert.h>
-#include <iostream>
+#include <functional>
+#include <limits>
 #include <memory>
-#include <set>
+#include <thread>
 
 namespace apache {
 namespace thrift {
@@ -32,17 +34,50 @@ namespace concurrency {
 using std::shared_ptr;
 using std::weak_ptr;
 
+namespace {
+
+const uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+/**
+ * A node of the circular, doubly linked lists that make up the wheel slots.
+ * Each slot has a sentinel node, so that a task can be unlinked without
+ * knowing which slot it is in.
+ */
+struct Link {
+  Link() : prev(this), next(this) {}
+
+  bool empty() const { return next == this; }
+
+  void pushBack(Link* link) {
+    link->prev = prev;
+    link->next = this;
+    prev->next = link;
+    prev = link;
+  }
+
+  void unlink() {
+    prev->next = next;
+    next->prev = prev;
+    prev = next = this;
+  }
+
+  Link* prev;
+  Link* next;
+};
+}
+
 /**
  * TimerManager class
  *
  * @version $Id:$
  */
-class TimerManager::Task : public Runnable {
+class TimerManager::Task : public Runnable, private Link {
 
 public:
   enum STATE { WAITING, EXECUTING, CANCELLED, COMPLETE };
 
-  Task(shared_ptr<Runnable> runnable) : runnable_(runnable), state_(WAITING) {}
+  Task(shared_ptr<Runnable> runnable, uint64_t tick, Shard* shard)
+    : runnable_(runnable), state_(WAITING), tick_(tick), shard_(shard) {}
 
   ~Task() override = default;
 
@@ -55,12 +90,181 @@ public:
 
   bool operator==(const shared_ptr<Runnable> & runnable) const { return runnable_ == runnable; }
 
-  task_iterator it_;
-
 private:
+  static Task* from(Link* link) { return static_cast<Task*>(link); }
+
   shared_ptr<Runnable> runnable_;
-  friend class TimerManager::Dispatcher;
-  STATE state_;
+  friend class TimerManager;
+  friend class TimerManager::Shard;
+  std::atomic<STATE> state_;
+  // Tick at which the task falls due
+  uint64_t tick_;
+  Shard* shard_;
+  // The wheel's reference to the task, held while it is WAITING
+  shared_ptr<Task> self_;
+};
+
+/**
+ * Hierarchical timing wheel
+ *
+ * Level 0 has a slot for each of the next SLOTS ticks, and each slot of level
+ * n covers SLOTS times as many ticks as a slot of level n - 1. A task is put
+ * in the lowest level whose span reaches its tick, and when the lower levels
+ * have gone round, the next slot of the level above is emptied into them.
+ * Tasks beyond the span of the top level wait in its last slot, and are
+ * placed again each time it is emptied.
+ */
+class TimerManager::Shard {
+
+public:
+  static const unsigned BITS = 8;
+  static const unsigned LEVELS = 4;
+  static const uint64_t SLOTS = 1 << BITS;
+  static const uint64_t MASK = SLOTS - 1;
+
+  Shard() : current_(0), count_(0) {}
+
+  ~Shard() { assert(count_ == 0); }
+
+  /**
+   * Puts a task in the wheel, taking a reference to it.
+   */
+  void add(shared_ptr<Task> task) {
+    Task* raw = task.get();
+    raw->self_ = std::move(task);
+    place(raw);
+    count_++;
+  }
+
+  /**
+   * Takes a waiting task out of the wheel, and returns the wheel's reference
+   * to it.
+   */
+  shared_ptr<Task> cancel(Task* task) {
+    task->unlink();
+    task->state_ = Task::CANCELLED;
+    count_--;
+    return std::move(task->self_);
+  }
+
+  /**
+   * Takes out every task due at or before tick, and appends them to
+   * expired.
+   */
+  void advance(uint64_t tick, std::vector<shared_ptr<Task> >& expired) {
+    while (current_ <= tick) {
+      if (count_ == 0) {
+        // Nothing to cascade, so skip straight to tick
+        current_ = tick + 1;
+        return;
+      }
+      uint64_t index = current_ & MASK;
+      if (index == 0) {
+        cascade(1);
+      }
+      Link& slot = wheel_[0][index];
+      while (!slot.empty()) {
+        Task* task = Task::from(slot.next);
+        task->unlink();
+        task->state_ = Task::EXECUTING;
+        count_--;
+        expired.push_back(std::move(task->self_));
+      }
+      current_++;
+    }
+  }
+
+  /**
+   * Returns the next tick advance() has work to do at: the next tick with
+   * tasks due, or at the latest the next time level 0 goes round and tasks
+   * are cascaded into it. Returns NEVER if the shard is empty.
+   */
+  uint64_t nextTick() const {
+    if (count_ == 0) {
+      return NEVER;
+    }
+    for (uint64_t tick = current_;; ++tick) {
+      if (!wheel_[0][tick & MASK].empty() || (tick & MASK) == 0) {
+        return tick;
+      }
+    }
+  }
+
+  /**
+   * Takes out every task whose runnable is the given one, and appends the
+   * wheel's references to them to removed.
+   */
+  void remove(const shared_ptr<Runnable>& runnable, std::vector<shared_ptr<Task> >& removed) {
+    for (auto& level : wheel_) {
+      for (auto& slot : level) {
+        for (Link* link = slot.next; link != &slot;) {
+          Task* task = Task::from(link);
+          link = link->next;
+          if (*task == runnable) {
+            removed.push_back(cancel(task));
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Takes out every task, and appends the wheel's references to them to
+   * removed.
+   */
+  void clear(std::vector<shared_ptr<Task> >& removed) {
+    for (auto& level : wheel_) {
+      for (auto& slot : level) {
+        while (!slot.empty()) {
+          removed.push_back(cancel(Task::from(slot.next)));
+        }
+      }
+    }
+  }
+
+  size_t count() const { return count_; }
+
+  Mutex mutex_;
+
+private:
+  void place(Task* task) {
+    uint64_t tick = (std::max)(task->tick_, current_);
+    uint64_t delta = tick - current_;
+    unsigned level = 0;
+    while (level + 1 < LEVELS && delta >= (uint64_t(1) << (BITS * (level + 1)))) {
+      level++;
+    }
+    if (delta >= (uint64_t(1) << (BITS * LEVELS))) {
+      tick = current_ + (uint64_t(1) << (BITS * LEVELS)) - 1;
+    }
+    wheel_[level][(tick >> (BITS * level)) & MASK].pushBack(task);
+  }
+
+  // Empties the slot of the given level that current_ has reached into the
+  // levels below, and carries on up if that level has gone round too
+  void cascade(unsigned level) {
+    uint64_t index = (current_ >> (BITS * level)) & MASK;
+    Link pending;
+    Link& slot = wheel_[level][index];
+    while (!slot.empty()) {
+      Link* link = slot.next;
+      link->unlink();
+      pending.pushBack(link);
+    }
+    while (!pending.empty()) {
+      Link* link = pending.next;
+      link->unlink();
+      place(Task::from(link));
+    }
+    if (index == 0 && level + 1 < LEVELS) {
+      cascade(level + 1);
+    }
+  }
+
+  Link wheel_[LEVELS][SLOTS];
+  // The next tick to expire
+  uint64_t current_;
+  size_t count_;
 };
 
 class TimerManager::Dispatcher : public Runnable {
@@ -73,8 +277,9 @@ public:
   /**
    * Dispatcher entry point
    *
-   * As long as dispatcher thread is running, pull tasks off the task taskMap_
-   * and execute.
+   * As long as dispatcher thread is running, take the tasks that have fallen
+   * due out of every shard, run them, and sleep until the next one is due
+   * or a task that is due earlier is added.
    */
   void run() override {
     {
@@ -85,48 +290,40 @@ public:
       }
     }
 
+    std::vector<shared_ptr<TimerManager::Task> > expiredTasks;
     do {
-      std::set<shared_ptr<TimerManager::Task> > expiredTasks;
-      {
-        Synchronized s(manager_->monitor_);
-        task_iterator expiredTaskEnd;
-        auto now = std::chrono::steady_clock::now();
-        while (manager_->state_ == TimerManager::STARTED
-               && (expiredTaskEnd = manager_->taskMap_.upper_bound(now))
-                  == manager_->taskMap_.begin()) {
-          std::chrono::milliseconds timeout(0);
-          if (!manager_->taskMap_.empty()) {
-            timeout = std::chrono::duration_cast<std::chrono::milliseconds>(manager_->taskMap_.begin()->first - now);
-            //because the unit of steady_clock is smaller than millisecond,timeout may be 0.
-            if (timeout.count() == 0) {
-              timeout = std::chrono::milliseconds(1);
-            }
-            manager_->monitor_.waitForTimeRelative(timeout);
-          } else {
-            manager_->monitor_.waitForTimeRelative(0);
-          }
-          now = std::chrono::steady_clock::now();
-        }
-
-        if (manager_->state_ == TimerManager::STARTED) {
-          for (auto ix = manager_->taskMap_.begin(); ix != expiredTaskEnd; ix++) {
-            shared_ptr<TimerManager::Task> task = ix->second;
-            expiredTasks.insert(task);
-            task->it_ = manager_->taskMap_.end();
-            if (task->state_ == TimerManager::Task::WAITING) {
-              task->state_ = TimerManager::Task::EXECUTING;
-            }
-            manager_->taskCount_--;
-          }
-          manager_->taskMap_.erase(manager_->taskMap_.begin(), expiredTaskEnd);
-        }
+      // Ticks up to this one have come
+      uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - manager_->epoch_).count());
+      uint64_t next = NEVER;
+      for (auto& shard : manager_->shards_) {
+        Guard g(shard->mutex_);
+        shard->advance(now, expiredTasks);
+        next = (std::min)(next, shard->nextTick());
       }
 
       for (const auto & expiredTask : expiredTasks) {
         expiredTask->run();
       }
+      expiredTasks.clear();
 
-    } while (manager_->state_ == TimerManager::STARTED);
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ != TimerManager::STARTED) {
+        break;
+      }
+      if (!manager_->wakePending_) {
+        manager_->wakeTick_ = next;
+        if (next == NEVER) {
+          manager_->monitor_.waitForever();
+        } else {
+          manager_->monitor_.waitForTime(manager_->epoch_ + std::chrono::milliseconds(next));
+        }
+      }
+      // Until the shards have been looked at again, any task added may have
+      // been missed
+      manager_->wakeTick_ = NEVER;
+      manager_->wakePending_ = false;
+    } while (true);
 
     {
       Synchronized s(manager_->monitor_);
@@ -149,9 +346,15 @@ private:
 #endif
 
 TimerManager::TimerManager()
-  : taskCount_(0),
+  : epoch_(std::chrono::steady_clock::now()),
     state_(TimerManager::UNINITIALIZED),
+    wakeTick_(NEVER),
+    wakePending_(false),
     dispatcher_(std::make_shared<Dispatcher>(this)) {
+  unsigned count = (std::max)(std::thread::hardware_concurrency(), 1u);
+  for (unsigned i = 0; i < count; ++i) {
+    shards_.emplace_back(new Shard());
+  }
 }
 
 #if defined(_MSC_VER)
@@ -216,8 +419,14 @@ void TimerManager::stop() {
   }
 
   if (doStop) {
-    // Clean up any outstanding tasks
-    taskMap_.clear();
+    // Clean up any outstanding tasks, outside the shard locks, as their
+    // destructors may call back into us
+    std::vector<shared_ptr<Task> > removed;
+    for (auto& shard : shards_) {
+      Guard g(shard->mutex_);
+      shard->clear(removed);
+    }
+    removed.clear();
 
     // Remove dispatcher's reference to us.
     dispatcher_->manager_ = nullptr;
@@ -235,7 +444,24 @@ void TimerManager::threadFactory(shared_ptr<const ThreadFactory> value) {
 }
 
 size_t TimerManager::taskCount() const {
-  return taskCount_;
+  size_t count = 0;
+  for (const auto& shard : shards_) {
+    Guard g(shard->mutex_);
+    count += shard->count();
+  }
+  return count;
+}
+
+uint64_t TimerManager::tickAt(const std::chrono::time_point<std::chrono::steady_clock>& abstime) const {
+  if (abstime <= epoch_) {
+    return 0;
+  }
+  auto elapsed = abstime - epoch_;
+  auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+  if (ticks < elapsed) {
+    ticks += std::chrono::milliseconds(1);
+  }
+  return static_cast<uint64_t>(ticks.count());
 }
 
 TimerManager::Timer TimerManager::add(shared_ptr<Runnable> task, const std::chrono::milliseconds &timeout) {
@@ -249,24 +475,25 @@ TimerManager::Timer TimerManager::add(shared_ptr<Runnable> task,
   if (abstime < now) {
     throw InvalidArgumentException();
   }
-  Synchronized s(monitor_);
-  if (state_ != TimerManager::STARTED) {
-    throw IllegalStateException();
-  }
 
-  // If the task map is empty, we will kick the dispatcher for sure. Otherwise, we kick him
-  // if the expiration time is shorter than the current value. Need to test before we insert,
-  // because the new task might insert at the front.
-  bool notifyRequired = (taskCount_ == 0) ? true : abstime < taskMap_.begin()->first;
-
-  shared_ptr<Task> timer(new Task(task));
-  taskCount_++;
-  timer->it_ = taskMap_.emplace(abstime, timer);
+  uint64_t tick = tickAt(abstime);
+  Shard* shard = shards_[std::hash<std::thread::id>()(std::this_thread::get_id()) % shards_.size()].get();
+  shared_ptr<Task> timer = std::make_shared<Task>(task, tick, shard);
+  {
+    // The state is checked under the shard lock, so that stop(), which
+    // changes it before clearing the shards, cannot miss this task
+    Guard g(shard->mutex_);
+    if (state_ != TimerManager::STARTED) {
+      throw IllegalStateException();
+    }
+    shard->add(timer);
+  }
 
-  // If the task map was empty, or if we have an expiration that is earlier
-  // than any previously seen, kick the dispatcher so it can update its
-  // timeout
-  if (notifyRequired) {
+  // If the dispatcher means to sleep past this task, or may not have seen it,
+  // kick it so it can update its timeout
+  if (tick < wakeTick_) {
+    Synchronized s(monitor_);
+    wakePending_ = true;
     monitor_.notify();
   }
 
@@ -274,27 +501,20 @@ TimerManager::Timer TimerManager::add(shared_ptr<Runnable> task,
 }
 
 void TimerManager::remove(shared_ptr<Runnable> task) {
-  Synchronized s(monitor_);
   if (state_ != TimerManager::STARTED) {
     throw IllegalStateException();
   }
-  bool found = false;
-  for (auto ix = taskMap_.begin(); ix != taskMap_.end();) {
-    if (*ix->second == task) {
-      found = true;
-      taskCount_--;
-      taskMap_.erase(ix++);
-    } else {
-      ++ix;
-    }
+  std::vector<shared_ptr<Task> > removed;
+  for (auto& shard : shards_) {
+    Guard g(shard->mutex_);
+    shard->remove(task, removed);
   }
-  if (!found) {
+  if (removed.empty()) {
     throw NoSuchTaskException();
   }
 }
 
 void TimerManager::remove(Timer handle) {
-  Synchronized s(monitor_);
   if (state_ != TimerManager::STARTED) {
     throw IllegalStateException();
   }
@@ -304,13 +524,17 @@ void TimerManager::remove(Timer handle) {
     throw NoSuchTaskException();
   }
 
-  if (task->it_ == taskMap_.end()) {
-    // Task is being executed
-    throw UncancellableTaskException();
+  shared_ptr<Task> removed;
+  {
+    Guard g(task->shard_->mutex_);
+    if (task->state_ == Task::CANCELLED) {
+      throw NoSuchTaskException();
+    } else if (task->state_ != Task::WAITING) {
+      // Task is being executed
+      throw UncancellableTaskException();
+    }
+    removed = task->shard_->cancel(task.get());
   }
-
-  taskMap_.erase(task->it_);
-  taskCount_--;
 }
 
 TimerManager::STATE TimerManager::state() const {
@@ -23,8 +23,9 @@
 #include <thrift/concurrency/Monitor.h>
 #include <thrift/concurrency/ThreadFactory.h>
 
+#include <atomic>
 #include <memory>
-#include <map>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -35,6 +36,13 @@ namespace concurrency {
  *
  * This class dispatches timer tasks when they fall due.
  *
+ * Tasks are kept in hierarchical timing wheels with millisecond ticks, so
+ * adding and removing a timer take constant time whatever the number of
+ * pending timers. The wheels are split into shards, one per hardware thread,
+ * and add() uses the shard picked by the calling thread's id, so threads
+ * adding timers seldom contend on a lock. A single dispatcher thread takes
+ * the tasks that have fallen due from every shard, and runs them as a batch.
+ *
  * @version $Id:$
  */
 class TimerManager {
@@ -117,18 +125,29 @@ public:
   virtual STATE state() const;
 
 private:
+  class Shard;
+  friend class Shard;
+
+  /**
+   * Returns the tick, counted in milliseconds since the manager was created,
+   * that abstime falls in, rounded up.
+   */
+  uint64_t tickAt(const std::chrono::time_point<std::chrono::steady_clock>& abstime) const;
+
   std::shared_ptr<const ThreadFactory> threadFactory_;
   friend class Task;
-  std::multimap<std::chrono::time_point<std::chrono::steady_clock>, std::shared_ptr<Task> > taskMap_;
-  size_t taskCount_;
+  const std::chrono::time_point<std::chrono::steady_clock> epoch_;
+  std::vector<std::unique_ptr<Shard> > shards_;
   Monitor monitor_;
-  STATE state_;
+  std::atomic<STATE> state_;
+  // Tasks due before this tick must wake the dispatcher
+  std::atomic<uint64_t> wakeTick_;
+  // Set, under monitor_, when a task was added that the dispatcher may have missed
+  bool wakePending_;
   class Dispatcher;
   friend class Dispatcher;
   std::shared_ptr<Dispatcher> dispatcher_;
   std::shared_ptr<Thread> dispatcherThread_;
-  using task_iterator = decltype(taskMap_)::iterator;
-  typedef std::pair<task_iterator, task_iterator> task_range;
 };
 }
 }
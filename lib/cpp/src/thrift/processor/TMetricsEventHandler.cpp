@@ -0,0 +1,449 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/processor/TMetricsEventHandler.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <locale>
+#include <map>
+#include <sstream>
+
+#include <thrift/concurrency/ThreadManager.h>
+
+namespace apache {
+namespace thrift {
+namespace processor {
+
+using std::chrono::steady_clock;
+
+namespace {
+
+uint64_t toMicros(steady_clock::duration duration) {
+  int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  return micros > 0 ? static_cast<uint64_t>(micros) : 0;
+}
+
+// Returns the number of the thread, in the order threads first ask
+size_t threadIndex() {
+  static std::atomic<size_t> next(0);
+  thread_local size_t index = next++;
+  return index;
+}
+
+uint32_t hashName(const char* name, size_t len) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+  }
+  return hash;
+}
+
+std::string escapeLabel(const std::string& value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      escaped += '\\';
+      escaped += c;
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+}
+
+const int TLatencyHistogram::SUB_BUCKET_BITS;
+const int TLatencyHistogram::SUB_BUCKETS;
+const int TLatencyHistogram::MAX_BITS;
+const int TLatencyHistogram::BUCKETS;
+
+int TLatencyHistogram::bucketOf(uint64_t micros) {
+  if (micros < static_cast<uint64_t>(SUB_BUCKETS)) {
+    return static_cast<int>(micros);
+  }
+  if (micros >> MAX_BITS) {
+    micros = (uint64_t(1) << MAX_BITS) - 1;
+  }
+#if defined(__GNUC__)
+  int exponent = 63 - __builtin_clzll(micros);
+#else
+  int exponent = SUB_BUCKET_BITS;
+  while (micros >> (exponent + 1)) {
+    exponent++;
+  }
+#endif
+  int sub = static_cast<int>(micros >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+  return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t TLatencyHistogram::bucketLow(int bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return static_cast<uint64_t>(bucket);
+  }
+  int exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+  uint64_t sub = static_cast<uint64_t>(bucket % SUB_BUCKETS);
+  return (SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS);
+}
+
+TLatencyHistogram::TLatencyHistogram() : sum_(0) {
+  for (auto& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+void TLatencyHistogram::addTo(Snapshot& snapshot) const {
+  for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+    uint64_t count = counts_[bucket].load(std::memory_order_relaxed);
+    snapshot.counts_[bucket] += count;
+    snapshot.count_ += count;
+  }
+  snapshot.sum_ += sum_.load(std::memory_order_relaxed);
+}
+
+uint64_t TLatencyHistogram::Snapshot::countAtMost(uint64_t micros) const {
+  uint64_t count = 0;
+  for (int bucket = 0; bucket < BUCKETS && bucketLow(bucket) <= micros; ++bucket) {
+    count += counts_[bucket];
+  }
+  return count;
+}
+
+uint64_t TLatencyHistogram::Snapshot::quantile(double q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count_)));
+  if (rank < 1) {
+    rank = 1;
+  } else if (rank > count_) {
+    rank = count_;
+  }
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+    seen += counts_[bucket];
+    if (seen >= rank) {
+      return bucketHigh(bucket);
+    }
+  }
+  return bucketHigh(BUCKETS - 1);
+}
+
+void TLatencyHistogram::Snapshot::merge(const Snapshot& other) {
+  for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+    counts_[bucket] += other.counts_[bucket];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+}
+
+/** The counters of a method, in one shard. */
+struct TMetricsEventHandler::Method {
+  Method(const char* name, size_t len, uint32_t hash)
+    : name(name, len), hash(hash), calls(0), errors(0), requestBytes(0), responseBytes(0) {}
+
+  const std::string name;
+  const uint32_t hash;
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> errors;
+  std::atomic<uint64_t> requestBytes;
+  std::atomic<uint64_t> responseBytes;
+  TLatencyHistogram queueTime;
+  TLatencyHistogram handlerTime;
+  TLatencyHistogram serializationTime;
+};
+
+/**
+ * The methods called from a set of threads, in an open addressed table that
+ * is only ever added to. A method is added by the first thread to swap it
+ * into an empty slot.
+ */
+class TMetricsEventHandler::Shard {
+public:
+  Shard() {
+    for (auto& slot : slots_) {
+      slot.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  ~Shard() {
+    for (auto& slot : slots_) {
+      delete slot.load(std::memory_order_relaxed);
+    }
+  }
+
+  Method* find(const char* name) {
+    size_t len = std::strlen(name);
+    uint32_t hash = hashName(name, len);
+    Method* added = nullptr;
+    for (size_t probe = 0; probe < MAX_METHODS; ++probe) {
+      std::atomic<Method*>& slot = slots_[(hash + probe) & (MAX_METHODS - 1)];
+      Method* method = slot.load(std::memory_order_acquire);
+      if (method == nullptr) {
+        if (added == nullptr) {
+          added = new Method(name, len, hash);
+        }
+        if (slot.compare_exchange_strong(method, added, std::memory_order_acq_rel)) {
+          return added;
+        }
+        // Another thread took the slot; method is what it put there
+      }
+      if (method->hash == hash && method->name.size() == len
+          && std::memcmp(method->name.data(), name, len) == 0) {
+        delete added;
+        return method;
+      }
+    }
+    delete added;
+    return nullptr;
+  }
+
+  template <class F>
+  void forEach(F f) const {
+    for (const auto& slot : slots_) {
+      const Method* method = slot.load(std::memory_order_acquire);
+      if (method != nullptr) {
+        f(*method);
+      }
+    }
+  }
+
+private:
+  std::atomic<Method*> slots_[MAX_METHODS];
+};
+
+/** The context of a call in progress. */
+struct TMetricsEventHandler::Call {
+  explicit Call(Method* method)
+    : method(method),
+      queued(false),
+      read(false),
+      handled(false),
+      error(false),
+      serialization(0),
+      requestBytes(0),
+      responseBytes(0) {}
+
+  Method* method;
+  bool queued;
+  bool read;
+  bool handled;
+  bool error;
+  steady_clock::duration queueTime;
+  steady_clock::duration serialization;
+  steady_clock::time_point readStart;
+  steady_clock::time_point readEnd;
+  steady_clock::time_point handlerEnd;
+  steady_clock::time_point writeStart;
+  uint32_t requestBytes;
+  uint32_t responseBytes;
+
+  void endHandler(steady_clock::time_point now) {
+    if (!handled) {
+      handlerEnd = now;
+      handled = true;
+    }
+  }
+};
+
+const size_t TMetricsEventHandler::MAX_METHODS;
+
+TMetricsEventHandler::TMetricsEventHandler(const std::string& prefix, size_t shards)
+  : prefix_(prefix) {
+  if (shards == 0) {
+    shards = 1;
+  }
+  for (size_t i = 0; i < shards; ++i) {
+    shards_.emplace_back(new Shard());
+  }
+}
+
+TMetricsEventHandler::~TMetricsEventHandler() = default;
+
+void* TMetricsEventHandler::getContext(const char* fn_name, void* serverContext) {
+  (void)serverContext;
+  Method* method = shards_[threadIndex() % shards_.size()]->find(fn_name);
+  if (method == nullptr) {
+    return nullptr;
+  }
+  Call* call = new Call(method);
+  call->queued = concurrency::ThreadManager::takeQueueTime(call->queueTime);
+  return call;
+}
+
+void TMetricsEventHandler::preRead(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    static_cast<Call*>(ctx)->readStart = steady_clock::now();
+  }
+}
+
+void TMetricsEventHandler::postRead(void* ctx, const char* fn_name, uint32_t bytes) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    auto* call = static_cast<Call*>(ctx);
+    call->readEnd = steady_clock::now();
+    call->serialization += call->readEnd - call->readStart;
+    call->requestBytes = bytes;
+    call->read = true;
+  }
+}
+
+void TMetricsEventHandler::preWrite(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    auto* call = static_cast<Call*>(ctx);
+    call->writeStart = steady_clock::now();
+    call->endHandler(call->writeStart);
+  }
+}
+
+void TMetricsEventHandler::postWrite(void* ctx, const char* fn_name, uint32_t bytes) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    auto* call = static_cast<Call*>(ctx);
+    call->serialization += steady_clock::now() - call->writeStart;
+    call->responseBytes = bytes;
+  }
+}
+
+void TMetricsEventHandler::asyncComplete(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    static_cast<Call*>(ctx)->endHandler(steady_clock::now());
+  }
+}
+
+void TMetricsEventHandler::handlerError(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    auto* call = static_cast<Call*>(ctx);
+    call->endHandler(steady_clock::now());
+    call->error = true;
+  }
+}
+
+void TMetricsEventHandler::freeContext(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx == nullptr) {
+    return;
+  }
+  std::unique_ptr<Call> call(static_cast<Call*>(ctx));
+  Method* method = call->method;
+
+  method->calls.fetch_add(1, std::memory_order_relaxed);
+  if (call->error || !call->read) {
+    method->errors.fetch_add(1, std::memory_order_relaxed);
+  }
+  method->requestBytes.fetch_add(call->requestBytes, std::memory_order_relaxed);
+  method->responseBytes.fetch_add(call->responseBytes, std::memory_order_relaxed);
+  if (call->queued) {
+    method->queueTime.record(toMicros(call->queueTime));
+  }
+  if (call->read) {
+    call->endHandler(steady_clock::now());
+    method->handlerTime.record(toMicros(call->handlerEnd - call->readEnd));
+    method->serializationTime.record(toMicros(call->serialization));
+  }
+}
+
+std::vector<TMetricsEventHandler::MethodMetrics> TMetricsEventHandler::snapshot() const {
+  std::map<std::string, MethodMetrics> byName;
+  for (const auto& shard : shards_) {
+    shard->forEach([&byName](const Method& method) {
+      MethodMetrics& metrics = byName[method.name];
+      metrics.method = method.name;
+      metrics.calls += method.calls.load(std::memory_order_relaxed);
+      metrics.errors += method.errors.load(std::memory_order_relaxed);
+      metrics.requestBytes += method.requestBytes.load(std::memory_order_relaxed);
+      metrics.responseBytes += method.responseBytes.load(std::memory_order_relaxed);
+      method.queueTime.addTo(metrics.queueTime);
+      method.handlerTime.addTo(metrics.handlerTime);
+      method.serializationTime.addTo(metrics.serializationTime);
+    });
+  }
+
+  std::vector<MethodMetrics> result;
+  result.reserve(byName.size());
+  for (auto& entry : byName) {
+    result.push_back(std::move(entry.second));
+  }
+  return result;
+}
+
+std::string TMetricsEventHandler::renderPrometheus() const {
+  std::vector<MethodMetrics> methods = snapshot();
+  std::ostringstream out;
+  out.imbue(std::locale::classic());
+  out << std::setprecision(12);
+
+  auto counter = [&](const char* name, const char* help, uint64_t MethodMetrics::*field) {
+    out << "# HELP " << prefix_ << '_' << name << ' ' << help << '\n';
+    out << "# TYPE " << prefix_ << '_' << name << " counter\n";
+    for (const MethodMetrics& method : methods) {
+      out << prefix_ << '_' << name << "{method=\"" << escapeLabel(method.method) << "\"} "
+          << method.*field << '\n';
+    }
+  };
+  counter("calls_total", "Calls processed.", &MethodMetrics::calls);
+  counter("errors_total", "Calls that failed.", &MethodMetrics::errors);
+  counter("request_bytes_total", "Bytes of the requests read.", &MethodMetrics::requestBytes);
+  counter("response_bytes_total",
+          "Bytes of the responses written.",
+          &MethodMetrics::responseBytes);
+
+  auto histogram = [&](const char* name,
+                       const char* help,
+                       TLatencyHistogram::Snapshot MethodMetrics::*field) {
+    out << "# HELP " << prefix_ << '_' << name << ' ' << help << '\n';
+    out << "# TYPE " << prefix_ << '_' << name << " histogram\n";
+    for (const MethodMetrics& method : methods) {
+      const TLatencyHistogram::Snapshot& snapshot = method.*field;
+      std::string label = "method=\"" + escapeLabel(method.method) + "\"";
+      for (int bits = 4; bits <= 25; ++bits) {
+        uint64_t bound = uint64_t(1) << bits;
+        out << prefix_ << '_' << name << "_bucket{" << label << ",le=\""
+            << static_cast<double>(bound) / 1e6 << "\"} " << snapshot.countAtMost(bound - 1)
+            << '\n';
+      }
+      out << prefix_ << '_' << name << "_bucket{" << label << ",le=\"+Inf\"} "
+          << snapshot.count() << '\n';
+      out << prefix_ << '_' << name << "_sum{" << label << "} "
+          << static_cast<double>(snapshot.sum()) / 1e6 << '\n';
+      out << prefix_ << '_' << name << "_count{" << label << "} " << snapshot.count() << '\n';
+    }
+  };
+  histogram("queue_seconds",
+            "Time calls waited for a worker thread.",
+            &MethodMetrics::queueTime);
+  histogram("handler_seconds", "Time calls spent in the handler.", &MethodMetrics::handlerTime);
+  histogram("serialization_seconds",
+            "Time calls spent reading requests and writing responses.",
+            &MethodMetrics::serializationTime);
+
+  return out.str();
+}
+}
+}
+} // apache::thrift::processor
@@ -0,0 +1,207 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROCESSOR_TMETRICSEVENTHANDLER_H_
+#define _THRIFT_PROCESSOR_TMETRICSEVENTHANDLER_H_ 1
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <thrift/TProcessor.h>
+
+namespace apache {
+namespace thrift {
+namespace processor {
+
+/**
+ * A histogram of durations in microseconds, in the manner of HdrHistogram:
+ * each power of two is split into 8 buckets, so a value is known to within
+ * 12.5%, whatever its magnitude. Values of 2^40 microseconds, about 12 days,
+ * and above are counted as 2^40 - 1.
+ *
+ * Values are recorded with relaxed atomic increments, without locking.
+ */
+class TLatencyHistogram {
+public:
+  static const int SUB_BUCKET_BITS = 3;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int MAX_BITS = 40;
+  static const int BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  /** Returns the bucket a value falls in. */
+  static int bucketOf(uint64_t micros);
+
+  /** Returns the least value that falls in a bucket. */
+  static uint64_t bucketLow(int bucket);
+
+  /** Returns the greatest value that falls in a bucket. */
+  static uint64_t bucketHigh(int bucket) { return bucketLow(bucket + 1) - 1; }
+
+  /**
+   * The counts of a histogram at one time, and of several histograms merged.
+   */
+  class Snapshot {
+  public:
+    Snapshot() : counts_(BUCKETS, 0), count_(0), sum_(0) {}
+
+    /** The number of values recorded. */
+    uint64_t count() const { return count_; }
+
+    /** The sum of the values recorded, in microseconds. */
+    uint64_t sum() const { return sum_; }
+
+    /** The number of values recorded in a bucket. */
+    uint64_t bucketCount(int bucket) const { return counts_[bucket]; }
+
+    /**
+     * Returns the number of values recorded that are at most micros, which
+     * is exact when micros + 1 is a power of two, and otherwise also counts
+     * the values in the bucket holding micros.
+     */
+    uint64_t countAtMost(uint64_t micros) const;
+
+    /**
+     * Returns the greatest value of the bucket holding the given quantile,
+     * from 0 to 1, of the values recorded, or 0 if none were.
+     */
+    uint64_t quantile(double q) const;
+
+    void merge(const Snapshot& other);
+
+  private:
+    friend class TLatencyHistogram;
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+  };
+
+  TLatencyHistogram();
+
+  void record(uint64_t micros) {
+    counts_[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(micros, std::memory_order_relaxed);
+  }
+
+  /** Adds the counts recorded so far to snapshot. */
+  void addTo(Snapshot& snapshot) const;
+
+private:
+  std::atomic<uint64_t> counts_[BUCKETS];
+  std::atomic<uint64_t> sum_;
+};
+
+/**
+ * A TProcessorEventHandler that records, for each method of the processors
+ * it is set on, the calls made and how many failed, the bytes of the
+ * requests and responses, and histograms of the time calls spent:
+ *
+ * <ul>
+ *   <li>queued, waiting for a ThreadManager worker (see
+ *       ThreadManager::takeQueueTime()), for servers that queue them;</li>
+ *   <li>in the handler;</li>
+ *   <li>reading the request and writing the response.</li>
+ * </ul>
+ *
+ * Calls that throw from the handler, or whose request cannot be read, are
+ * errors.
+ *
+ * Recording takes no locks. Each thread records into one of a number of
+ * shards, each holding counters for the methods called from its threads, so
+ * threads seldom update the same counters; snapshot() adds the shards up.
+ * Each shard holds up to MAX_METHODS methods, beyond which calls are not
+ * recorded.
+ *
+ * <p>The metrics can be rendered in the Prometheus text format with
+ * renderPrometheus(), and served with a server::TMetricsEndpoint:</p>
+ *
+ * <blockquote><code>
+ *     auto metrics = std::make_shared<TMetricsEventHandler>();
+ *     processor->setEventHandler(metrics);
+ *     TMetricsEndpoint endpoint([metrics] { return metrics->renderPrometheus(); }, 9100);
+ *     endpoint.start();
+ * </code></blockquote>
+ */
+class TMetricsEventHandler : public TProcessorEventHandler {
+public:
+  static const size_t MAX_METHODS = 1024;
+
+  /**
+   * @param prefix Prefix of the names of the metrics rendered.
+   * @param shards Number of shards threads record into.
+   */
+  TMetricsEventHandler(const std::string& prefix = "thrift", size_t shards = 8);
+
+  ~TMetricsEventHandler() override;
+
+  /** What was recorded for a method, added up over all threads. */
+  struct MethodMetrics {
+    MethodMetrics() : calls(0), errors(0), requestBytes(0), responseBytes(0) {}
+
+    /** The method name, as "Service.method". */
+    std::string method;
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t requestBytes;
+    uint64_t responseBytes;
+    TLatencyHistogram::Snapshot queueTime;
+    TLatencyHistogram::Snapshot handlerTime;
+    TLatencyHistogram::Snapshot serializationTime;
+  };
+
+  /**
+   * Returns what has been recorded, for each method called, by method name.
+   * Calls still in progress are not included.
+   */
+  std::vector<MethodMetrics> snapshot() const;
+
+  /**
+   * Returns the metrics in the Prometheus text exposition format: the
+   * counters PREFIX_calls_total, PREFIX_errors_total,
+   * PREFIX_request_bytes_total and PREFIX_response_bytes_total, and the
+   * histograms PREFIX_queue_seconds, PREFIX_handler_seconds and
+   * PREFIX_serialization_seconds, all labelled by method. Histogram buckets
+   * are bounded at powers of two microseconds, from 16us to about 34s.
+   */
+  std::string renderPrometheus() const;
+
+  void* getContext(const char* fn_name, void* serverContext) override;
+  void freeContext(void* ctx, const char* fn_name) override;
+  void preRead(void* ctx, const char* fn_name) override;
+  void postRead(void* ctx, const char* fn_name, uint32_t bytes) override;
+  void preWrite(void* ctx, const char* fn_name) override;
+  void postWrite(void* ctx, const char* fn_name, uint32_t bytes) override;
+  void asyncComplete(void* ctx, const char* fn_name) override;
+  void handlerError(void* ctx, const char* fn_name) override;
+
+private:
+  struct Method;
+  class Shard;
+  struct Call;
+
+  std::string prefix_;
+  std::vector<std::unique_ptr<Shard> > shards_;
+};
+}
+}
+} // apache::thrift::processor
+
+#endif // #ifndef _THRIFT_PROCESSOR_TMETRICSEVENTHANDLER_H_
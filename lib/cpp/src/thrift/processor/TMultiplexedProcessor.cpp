@@ -0,0 +1,457 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/processor/TMultiplexedProcessor.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TRawValue.h>
+#include <thrift/transport/TBufferTransports.h>
+
+namespace apache {
+namespace thrift {
+
+using protocol::TProtocol;
+using protocol::TType;
+using transport::TMemoryBuffer;
+using transport::TTransport;
+
+namespace {
+
+// Reads the next value, of the given type, from one protocol and writes it
+// to another. Strings are read as text, as only the IDL tells which are
+// binary.
+void translateValue(TProtocol& from, TProtocol& to, TType type) {
+  protocol::TInputRecursionTracker inputTracker(from);
+  protocol::TOutputRecursionTracker outputTracker(to);
+
+  switch (type) {
+  case protocol::T_BOOL: {
+    bool boolv;
+    from.readBool(boolv);
+    to.writeBool(boolv);
+    return;
+  }
+  case protocol::T_BYTE: {
+    int8_t bytev;
+    from.readByte(bytev);
+    to.writeByte(bytev);
+    return;
+  }
+  case protocol::T_I16: {
+    int16_t i16;
+    from.readI16(i16);
+    to.writeI16(i16);
+    return;
+  }
+  case protocol::T_I32: {
+    int32_t i32;
+    from.readI32(i32);
+    to.writeI32(i32);
+    return;
+  }
+  case protocol::T_I64: {
+    int64_t i64;
+    from.readI64(i64);
+    to.writeI64(i64);
+    return;
+  }
+  case protocol::T_DOUBLE: {
+    double dub;
+    from.readDouble(dub);
+    to.writeDouble(dub);
+    return;
+  }
+  case protocol::T_STRING: {
+    std::string str;
+    from.readString(str);
+    to.writeString(str);
+    return;
+  }
+  case protocol::T_STRUCT: {
+    std::string name;
+    int16_t fid;
+    TType ftype;
+    from.readStructBegin(name);
+    to.writeStructBegin(name.c_str());
+    while (true) {
+      from.readFieldBegin(name, ftype, fid);
+      if (ftype == protocol::T_STOP) {
+        break;
+      }
+      to.writeFieldBegin(name.c_str(), ftype, fid);
+      translateValue(from, to, ftype);
+      from.readFieldEnd();
+      to.writeFieldEnd();
+    }
+    to.writeFieldStop();
+    from.readStructEnd();
+    to.writeStructEnd();
+    return;
+  }
+  case protocol::T_MAP: {
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    from.readMapBegin(keyType, valType, size);
+    to.writeMapBegin(keyType, valType, size);
+    for (uint32_t i = 0; i < size; i++) {
+      translateValue(from, to, keyType);
+      translateValue(from, to, valType);
+    }
+    from.readMapEnd();
+    to.writeMapEnd();
+    return;
+  }
+  case protocol::T_SET: {
+    TType elemType;
+    uint32_t size;
+    from.readSetBegin(elemType, size);
+    to.writeSetBegin(elemType, size);
+    for (uint32_t i = 0; i < size; i++) {
+      translateValue(from, to, elemType);
+    }
+    from.readSetEnd();
+    to.writeSetEnd();
+    return;
+  }
+  case protocol::T_LIST: {
+    TType elemType;
+    uint32_t size;
+    from.readListBegin(elemType, size);
+    to.writeListBegin(elemType, size);
+    for (uint32_t i = 0; i < size; i++) {
+      translateValue(from, to, elemType);
+    }
+    from.readListEnd();
+    to.writeListEnd();
+    return;
+  }
+  default:
+    break;
+  }
+
+  throw protocol::TProtocolException(protocol::TProtocolException::INVALID_DATA,
+                                     "invalid TType");
+}
+
+// Copies the next value, of the given type, from one protocol to another,
+// as the bytes it was read as when both use the same raw encoding
+void copyValue(TProtocol& from, TProtocol& to, TType type) {
+  protocol::TRawEncoding encoding = protocol::rawEncoding(&from);
+  if (encoding != protocol::T_RAW_NONE && encoding == protocol::rawEncoding(&to)) {
+    uint32_t size;
+    const uint8_t* buf = protocol::borrowRawValue(&from, type, size);
+    if (buf != nullptr) {
+      to.getTransport()->write(buf, size);
+      from.getTransport()->consume(size);
+      return;
+    }
+  }
+  translateValue(from, to, type);
+}
+
+// Copies a whole message from one protocol to another
+void copyMessage(TProtocol& from, TProtocol& to) {
+  std::string name;
+  protocol::TMessageType type;
+  int32_t seqid;
+  from.readMessageBegin(name, type, seqid);
+  to.writeMessageBegin(name, type, seqid);
+  copyValue(from, to, protocol::T_STRUCT);
+  from.readMessageEnd();
+  from.getTransport()->readEnd();
+  to.writeMessageEnd();
+}
+
+// Drops whatever trans has buffered to read and reconnects it, so that what
+// is left of a message cut short is not read as the next one
+void resetTransport(TTransport& trans) {
+  try {
+    uint32_t len = 0;
+    if (trans.borrow(nullptr, &len) != nullptr && len > 0) {
+      trans.consume(len);
+    }
+    trans.close();
+  } catch (const TException&) {
+    // it is being reopened anyway
+  }
+  trans.open();
+}
+}
+
+void TMultiplexedProcessor::registerProcessor(const std::string& serviceName,
+                                              std::shared_ptr<TProcessor> processor) {
+  Service service;
+  service.name = serviceName;
+  service.processor = processor;
+  addService(std::move(service));
+}
+
+void TMultiplexedProcessor::registerForwarder(
+    const std::string& serviceName,
+    std::shared_ptr<protocol::TProtocol> backend,
+    std::shared_ptr<protocol::TProtocolFactory> bufferFactory) {
+  if (!backend) {
+    throw std::invalid_argument("TMultiplexedProcessor: backend is null");
+  }
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TProtocol> bufferProtocol;
+  if (bufferFactory) {
+    bufferProtocol = bufferFactory->getProtocol(buffer);
+  } else if (protocol::rawEncoding(backend.get()) == protocol::T_RAW_BINARY) {
+    bufferProtocol = std::make_shared<protocol::TBinaryProtocolT<TMemoryBuffer> >(buffer);
+  } else if (protocol::rawEncoding(backend.get()) == protocol::T_RAW_COMPACT) {
+    bufferProtocol = std::make_shared<protocol::TCompactProtocolT<TMemoryBuffer> >(buffer);
+  } else {
+    throw std::invalid_argument("TMultiplexedProcessor: bufferFactory is needed for the backend");
+  }
+  Service service;
+  service.name = serviceName;
+  service.forwarder = std::make_shared<Forwarder>();
+  service.forwarder->backend = backend;
+  service.forwarder->buffer = buffer;
+  service.forwarder->bufferProtocol = bufferProtocol;
+  addService(std::move(service));
+}
+
+uint32_t TMultiplexedProcessor::hashName(const char* name, size_t len) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+  }
+  return hash;
+}
+
+void TMultiplexedProcessor::addService(Service service) {
+  service.hash = hashName(service.name.data(), service.name.size());
+  for (auto& existing : services) {
+    if (existing.name == service.name) {
+      existing = std::move(service);
+      return;
+    }
+  }
+  services.push_back(std::move(service));
+
+  size_t size = 4;
+  while (size < services.size() * 2) {
+    size *= 2;
+  }
+  slots.assign(size, 0);
+  for (size_t i = 0; i < services.size(); ++i) {
+    size_t slot = services[i].hash & (size - 1);
+    while (slots[slot] != 0) {
+      slot = (slot + 1) & (size - 1);
+    }
+    slots[slot] = static_cast<uint32_t>(i + 1);
+  }
+}
+
+size_t TMultiplexedProcessor::splitName(const std::string& name, size_t begin[2], size_t end[2]) {
+  size_t count = 0;
+  for (size_t pos = 0; pos < name.size();) {
+    size_t sep = name.find(':', pos);
+    if (sep == std::string::npos) {
+      sep = name.size();
+    }
+    if (sep > pos) {
+      if (count < 2) {
+        begin[count] = pos;
+        end[count] = sep;
+      }
+      ++count;
+    }
+    pos = sep + 1;
+  }
+  return count;
+}
+
+const TMultiplexedProcessor::Service* TMultiplexedProcessor::findService(const char* name,
+                                                                         size_t len) const {
+  if (slots.empty()) {
+    return nullptr;
+  }
+  uint32_t hash = hashName(name, len);
+  size_t mask = slots.size() - 1;
+  for (size_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+    const Service& service = services[slots[slot] - 1];
+    if (service.hash == hash && service.name.size() == len
+        && std::memcmp(service.name.data(), name, len) == 0) {
+      return &service;
+    }
+  }
+  return nullptr;
+}
+
+bool TMultiplexedProcessor::process(std::shared_ptr<protocol::TProtocol> in,
+                                    std::shared_ptr<protocol::TProtocol> out,
+                                    void* connectionContext) {
+  std::string name;
+  protocol::TMessageType type;
+  int32_t seqid;
+
+  // Use the actual underlying protocol (e.g. TBinaryProtocol) to read the
+  // message header.  This pulls the message "off the wire", which we'll
+  // deal with at the end of this method.
+  in->readMessageBegin(name, type, seqid);
+
+  if (type != protocol::T_CALL && type != protocol::T_ONEWAY) {
+    // Unexpected message type.
+    throw protocol_error(in, out, name, seqid, "Unexpected message type");
+  }
+
+  // Find the service name and the name of the method to call
+  size_t begin[2] = {0, 0};
+  size_t end[2] = {0, 0};
+  size_t count = splitName(name, begin, end);
+
+  // A valid message should consist of two tokens: the service
+  // name and the name of the method to call.
+  if (count == 2) {
+    // Search for a processor associated with this service name.
+    const Service* service = findService(name.data() + begin[0], end[0] - begin[0]);
+
+    if (service == nullptr) {
+      // Unknown service.
+      throw protocol_error(in, out, name, seqid,
+          "Unknown service: " + name.substr(begin[0], end[0] - begin[0]) +
+          ". Did you forget to call registerProcessor()?");
+    } else if (service->forwarder) {
+      return forward(*service->forwarder, in, out, name, type, seqid);
+    }
+
+    // Let the processor registered for this service name
+    // process the message, reusing name for the method name.
+    std::shared_ptr<TProcessor> processor = service->processor;
+    name.erase(end[1]);
+    name.erase(0, begin[1]);
+    return processor->process(
+        std::make_shared<protocol::StoredMessageProtocol>(in, std::move(name), type, seqid),
+        out,
+        connectionContext);
+  } else if (count == 1) {
+    if (defaultProcessor) {
+      // non-multiplexed client forwards to default processor
+      name.erase(end[0]);
+      name.erase(0, begin[0]);
+      return defaultProcessor->process(
+          std::make_shared<protocol::StoredMessageProtocol>(in, std::move(name), type, seqid),
+          out,
+          connectionContext);
+    } else {
+      throw protocol_error(in, out, name, seqid,
+          "Non-multiplexed client request dropped. "
+          "Did you forget to call defaultProcessor()?");
+    }
+  } else {
+    throw protocol_error(in, out, name, seqid,
+        "Wrong number of tokens.");
+  }
+}
+
+const TProcessor* TMultiplexedProcessor::findProcessor(const std::string& fname,
+                                                       std::string& method) const {
+  size_t begin[2] = {0, 0};
+  size_t end[2] = {0, 0};
+  size_t count = splitName(fname, begin, end);
+  if (count == 2) {
+    const Service* service = findService(fname.data() + begin[0], end[0] - begin[0]);
+    if (service != nullptr && service->processor) {
+      method = fname.substr(begin[1], end[1] - begin[1]);
+      return service->processor.get();
+    }
+  } else if (count == 1 && defaultProcessor) {
+    method = fname.substr(begin[0], end[0] - begin[0]);
+    return defaultProcessor.get();
+  }
+  return nullptr;
+}
+
+concurrency::PRIORITY TMultiplexedProcessor::getPriority(const std::string& fname) const {
+  std::string method;
+  const TProcessor* processor = findProcessor(fname, method);
+  return processor != nullptr ? processor->getPriority(method) : concurrency::NORMAL;
+}
+
+bool TMultiplexedProcessor::isInline(const std::string& fname) const {
+  std::string method;
+  const TProcessor* processor = findProcessor(fname, method);
+  return processor != nullptr && processor->isInline(method);
+}
+
+bool TMultiplexedProcessor::forward(Forwarder& forwarder,
+                                    std::shared_ptr<protocol::TProtocol> in,
+                                    std::shared_ptr<protocol::TProtocol> out,
+                                    const std::string& name,
+                                    protocol::TMessageType type,
+                                    int32_t seqid) {
+  concurrency::Guard g(forwarder.mutex);
+  TProtocol& backend = *forwarder.backend;
+  TProtocol& buffered = *forwarder.bufferProtocol;
+  TTransport& backendTransport = *backend.getTransport();
+
+  // Read the whole call before any of it goes to the backend
+  forwarder.buffer->resetBuffer();
+  buffered.writeMessageBegin(name, type, seqid);
+  copyValue(*in, buffered, protocol::T_STRUCT);
+  in->readMessageEnd();
+  in->getTransport()->readEnd();
+  buffered.writeMessageEnd();
+
+  // and the whole reply before any of it goes to the client
+  try {
+    if (forwarder.broken) {
+      resetTransport(backendTransport);
+      forwarder.broken = false;
+    }
+    uint8_t* buf;
+    uint32_t size;
+    forwarder.buffer->getBuffer(&buf, &size);
+    backendTransport.write(buf, size);
+    backendTransport.writeEnd();
+    backendTransport.flush();
+
+    if (type == protocol::T_ONEWAY) {
+      return true;
+    }
+
+    forwarder.buffer->resetBuffer();
+    copyMessage(backend, buffered);
+  } catch (...) {
+    forwarder.broken = true;
+    try {
+      resetTransport(backendTransport);
+      forwarder.broken = false;
+    } catch (const TException&) {
+      // tried again before the next call
+    }
+    throw;
+  }
+
+  copyMessage(buffered, *out);
+  out->getTransport()->writeEnd();
+  out->getTransport()->flush();
+  return true;
+}
+}
+} // apache::thrift
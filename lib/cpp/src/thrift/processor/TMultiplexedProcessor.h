@@ -23,10 +23,16 @@
 #include <thrift/protocol/TProtocolDecorator.h>
 #include <thrift/TApplicationException.h>
 #include <thrift/TProcessor.h>
-#include <boost/tokenizer.hpp>
+#include <thrift/concurrency/Mutex.h>
+#include <map>
+#include <utility>
+#include <vector>
 
 namespace apache {
 namespace thrift {
+namespace transport {
+class TMemoryBuffer;
+}
 namespace protocol {
 
 /**
@@ -37,10 +43,10 @@ namespace protocol {
 class StoredMessageProtocol : public TProtocolDecorator {
 public:
   StoredMessageProtocol(std::shared_ptr<protocol::TProtocol> _protocol,
-                        const std::string& _name,
+                        std::string _name,
                         const TMessageType _type,
                         const int32_t _seqid)
-    : TProtocolDecorator(_protocol), name(_name), type(_type), seqid(_seqid) {}
+    : TProtocolDecorator(_protocol), name(std::move(_name)), type(_type), seqid(_seqid) {}
 
   uint32_t readMessageBegin_virt(std::string& _name, TMessageType& _type, int32_t& _seqid) override {
 
@@ -82,9 +88,17 @@ public:
  *
  *     server.serve();
  * </code></blockquote>
+ *
+ * <p>Services may also be forwarded, as they are, to another server with
+ * <code>registerForwarder()</code>, making the processor a gateway in front
+ * of services that live elsewhere.</p>
  */
 class TMultiplexedProcessor : public TProcessor {
 public:
+  /**
+   * @deprecated Services are no longer kept in a map, and nothing uses this
+   * type any more. Kept so that code naming it still compiles.
+   */
   typedef std::map<std::string, std::shared_ptr<TProcessor> > services_t;
 
   /**
@@ -98,9 +112,35 @@ public:
     *                         as "handlers", e.g. WeatherReportHandler,
     *                         implementing WeatherReportIf interface.
     */
-  void registerProcessor(const std::string& serviceName, std::shared_ptr<TProcessor> processor) {
-    services[serviceName] = processor;
-  }
+  void registerProcessor(const std::string& serviceName, std::shared_ptr<TProcessor> processor);
+
+  /**
+   * Register a service whose calls are passed on to another server, through
+   * backend, and whose replies are passed back. Messages keep their
+   * "service:method" names, so the other server is normally multiplexed as
+   * well.
+   *
+   * If the client and backend protocols are both TBinaryProtocol or both
+   * TCompactProtocol (see protocol::rawEncoding()), message bodies buffered
+   * by the transport are copied without being decoded. Otherwise they are
+   * translated, value by value, from one protocol to the other, with strings
+   * read as text.
+   *
+   * Calls through one backend are made one at a time. Each message is
+   * buffered whole before being passed on, so a bad call never reaches the
+   * backend. If the backend fails partway through a call, what it has
+   * buffered is dropped and its transport is closed and reopened.
+   *
+   * \param [in] serviceName   Name of the service.
+   * \param [in] backend       Protocol connected to the server providing it.
+   * \param [in] bufferFactory Makes protocols in the backend's encoding, over
+   *                           a TMemoryBuffer, to buffer messages with. May
+   *                           be left out if the backend is a TBinaryProtocol
+   *                           or TCompactProtocol.
+   */
+  void registerForwarder(const std::string& serviceName,
+                         std::shared_ptr<protocol::TProtocol> backend,
+                         std::shared_ptr<protocol::TProtocolFactory> bufferFactory = nullptr);
 
   /**
    * Register a service to be called to process queries without service name
@@ -140,7 +180,8 @@ public:
    *     <li>Extract the service name from the message.</li>
    *     <li>Using the service name to locate the appropriate processor.</li>
    *     <li>Dispatch to the processor, with a decorated instance of TProtocol
-   *         that allows readMessageBegin() to return the original TMessage.</li>
+   *         that allows readMessageBegin() to return the original TMessage,
+   *         or forward the message to the service's backend.</li>
    * </ol>
    *
    * \throws TException If the message type is not T_CALL or T_ONEWAY, if
@@ -149,71 +190,77 @@ public:
    */
   bool process(std::shared_ptr<protocol::TProtocol> in,
                std::shared_ptr<protocol::TProtocol> out,
-               void* connectionContext) override {
-    std::string name;
-    protocol::TMessageType type;
-    int32_t seqid;
-
-    // Use the actual underlying protocol (e.g. TBinaryProtocol) to read the
-    // message header.  This pulls the message "off the wire", which we'll
-    // deal with at the end of this method.
-    in->readMessageBegin(name, type, seqid);
-
-    if (type != protocol::T_CALL && type != protocol::T_ONEWAY) {
-      // Unexpected message type.
-      throw protocol_error(in, out, name, seqid, "Unexpected message type");
-    }
-
-    // Extract the service name
-    boost::tokenizer<boost::char_separator<char> > tok(name, boost::char_separator<char>(":"));
-
-    std::vector<std::string> tokens;
-    std::copy(tok.begin(), tok.end(), std::back_inserter(tokens));
-
-    // A valid message should consist of two tokens: the service
-    // name and the name of the method to call.
-    if (tokens.size() == 2) {
-      // Search for a processor associated with this service name.
-      auto it = services.find(tokens[0]);
-
-      if (it != services.end()) {
-        std::shared_ptr<TProcessor> processor = it->second;
-        // Let the processor registered for this service name
-        // process the message.
-        return processor
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[1], type, seqid)),
-                      out,
-                      connectionContext);
-      } else {
-        // Unknown service.
-        throw protocol_error(in, out, name, seqid, 
-            "Unknown service: " + tokens[0] +
-				". Did you forget to call registerProcessor()?");
-      }
-    } else if (tokens.size() == 1) {
-	  if (defaultProcessor) {
-        // non-multiplexed client forwards to default processor
-        return defaultProcessor            
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[0], type, seqid)),
-                      out,
-                      connectionContext);
-	  } else {
-		throw protocol_error(in, out, name, seqid,
-			"Non-multiplexed client request dropped. "
-			"Did you forget to call defaultProcessor()?");
-	  }
-    } else {
-		throw protocol_error(in, out, name, seqid,
-		    "Wrong number of tokens.");
-    }
-  }
+               void* connectionContext) override;
+
+  /**
+   * Returns the priority the processor registered for the service gives the
+   * method, for "service:method" names, and the priority the default
+   * processor gives unprefixed names. Forwarded calls are NORMAL.
+   */
+  concurrency::PRIORITY getPriority(const std::string& fname) const override;
+
+  /**
+   * Returns whether the processor registered for the service processes
+   * calls to the method inline, for "service:method" names, and whether the
+   * default processor does for unprefixed names. Forwarded calls are not
+   * inline.
+   */
+  bool isInline(const std::string& fname) const override;
 
 private:
-  /** Map of service processor objects, indexed by service names. */
-  services_t services;
-  
+  /** A service passed on to another server. */
+  struct Forwarder {
+    std::shared_ptr<protocol::TProtocol> backend;
+    std::shared_ptr<transport::TMemoryBuffer> buffer;
+    std::shared_ptr<protocol::TProtocol> bufferProtocol;
+    bool broken = false;
+    concurrency::Mutex mutex;
+  };
+
+  struct Service {
+    std::string name;
+    uint32_t hash;
+    std::shared_ptr<TProcessor> processor;
+    std::shared_ptr<Forwarder> forwarder;
+  };
+
+  static uint32_t hashName(const char* name, size_t len);
+
+  /**
+   * Finds the tokens of a "service:method" name, ignoring empty ones, and
+   * returns how many there are. The bounds of the first two are stored.
+   */
+  static size_t splitName(const std::string& name, size_t begin[2], size_t end[2]);
+
+  void addService(Service service);
+
+  /** Returns the service with the given name, or nullptr. */
+  const Service* findService(const char* name, size_t len) const;
+
+  /**
+   * Returns the processor that processes calls to the given function, and
+   * sets method to its name without the service, or returns nullptr if the
+   * calls are forwarded or unknown.
+   */
+  const TProcessor* findProcessor(const std::string& fname, std::string& method) const;
+
+  bool forward(Forwarder& forwarder,
+               std::shared_ptr<protocol::TProtocol> in,
+               std::shared_ptr<protocol::TProtocol> out,
+               const std::string& name,
+               protocol::TMessageType type,
+               int32_t seqid);
+
+  /** Registered services, in no particular order. */
+  std::vector<Service> services;
+
+  /**
+   * Open addressed hash table of services, indexed by the hash of their
+   * names. Each slot holds an index in services plus one, or 0 if empty.
+   * It has a power of two size, at least twice the number of services.
+   */
+  std::vector<uint32_t> slots;
+
   //! If a non-multi client requests something, it goes to the
   //! default processor (if one is defined) for backwards compatibility.
   std::shared_ptr<TProcessor> defaultProcessor;
@@ -0,0 +1,200 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/processor/TTracingEventHandler.h>
+
+#include <chrono>
+
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/transport/THeaderTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace processor {
+
+using std::chrono::steady_clock;
+
+namespace {
+
+uint64_t toMicros(steady_clock::duration duration) {
+  int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  return micros > 0 ? static_cast<uint64_t>(micros) : 0;
+}
+}
+
+/** A connection, and the context next_ made for it. */
+struct TTracingEventHandler::Connection {
+  std::shared_ptr<transport::THeaderTransport> headers;
+  void* nextContext;
+};
+
+/** A call being traced. */
+struct TTracingEventHandler::Call {
+  TSpan span;
+  TTraceContext callerContext;
+  bool handled;
+  steady_clock::time_point start;
+  steady_clock::time_point readStart;
+  steady_clock::time_point readEnd;
+  steady_clock::time_point writeStart;
+  steady_clock::time_point handlerEnd;
+
+  void endHandler(steady_clock::time_point now) {
+    if (!handled) {
+      handlerEnd = now;
+      handled = true;
+    }
+  }
+};
+
+TTracingEventHandler::TTracingEventHandler(std::shared_ptr<TTracer> tracer,
+                                           std::shared_ptr<server::TServerEventHandler> next)
+  : tracer_(tracer), next_(next) {}
+
+void TTracingEventHandler::preServe() {
+  if (next_) {
+    next_->preServe();
+  }
+}
+
+void* TTracingEventHandler::createContext(std::shared_ptr<protocol::TProtocol> input,
+                                          std::shared_ptr<protocol::TProtocol> output) {
+  auto* connection = new Connection();
+  connection->headers
+      = std::dynamic_pointer_cast<transport::THeaderTransport>(input->getTransport());
+  connection->nextContext = next_ ? next_->createContext(input, output) : nullptr;
+  return connection;
+}
+
+void TTracingEventHandler::deleteContext(void* serverContext,
+                                         std::shared_ptr<protocol::TProtocol> input,
+                                         std::shared_ptr<protocol::TProtocol> output) {
+  std::unique_ptr<Connection> connection(static_cast<Connection*>(serverContext));
+  if (next_) {
+    next_->deleteContext(connection ? connection->nextContext : nullptr, input, output);
+  }
+}
+
+void TTracingEventHandler::processContext(void* serverContext,
+                                          std::shared_ptr<transport::TTransport> transport) {
+  if (next_) {
+    auto* connection = static_cast<Connection*>(serverContext);
+    next_->processContext(connection ? connection->nextContext : nullptr, transport);
+  }
+}
+
+void* TTracingEventHandler::getContext(const char* fn_name, void* serverContext) {
+  steady_clock::time_point now = steady_clock::now();
+
+  // The message, and so its headers, have been read by now
+  TTraceContext caller;
+  auto* connection = static_cast<Connection*>(serverContext);
+  if (connection != nullptr && connection->headers) {
+    caller = TTracer::extract(connection->headers->getHeaders());
+  }
+  TTraceContext context = tracer_->startSpan(caller);
+  if (!context.valid()) {
+    return nullptr;
+  }
+
+  auto* call = new Call();
+  call->span.context = context;
+  call->span.kind = T_SPAN_SERVER;
+  call->span.name = fn_name;
+  call->span.startMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::system_clock::now().time_since_epoch()).count();
+  steady_clock::duration queueTime;
+  if (concurrency::ThreadManager::takeQueueTime(queueTime)) {
+    call->span.queueMicros = toMicros(queueTime);
+  }
+  call->handled = false;
+  call->start = now;
+  call->readStart = now;
+  call->readEnd = now;
+  call->callerContext = TTracer::setCurrent(context);
+  return call;
+}
+
+void TTracingEventHandler::preRead(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    static_cast<Call*>(ctx)->readStart = steady_clock::now();
+  }
+}
+
+void TTracingEventHandler::postRead(void* ctx, const char* fn_name, uint32_t bytes) {
+  (void)fn_name;
+  (void)bytes;
+  if (ctx != nullptr) {
+    auto* call = static_cast<Call*>(ctx);
+    call->readEnd = steady_clock::now();
+    call->span.deserializeMicros = toMicros(call->readEnd - call->readStart);
+  }
+}
+
+void TTracingEventHandler::preWrite(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    auto* call = static_cast<Call*>(ctx);
+    call->writeStart = steady_clock::now();
+    call->endHandler(call->writeStart);
+  }
+}
+
+void TTracingEventHandler::postWrite(void* ctx, const char* fn_name, uint32_t bytes) {
+  (void)fn_name;
+  (void)bytes;
+  if (ctx != nullptr) {
+    auto* call = static_cast<Call*>(ctx);
+    call->span.serializeMicros = toMicros(steady_clock::now() - call->writeStart);
+  }
+}
+
+void TTracingEventHandler::asyncComplete(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    static_cast<Call*>(ctx)->endHandler(steady_clock::now());
+  }
+}
+
+void TTracingEventHandler::handlerError(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx != nullptr) {
+    auto* call = static_cast<Call*>(ctx);
+    call->endHandler(steady_clock::now());
+    call->span.error = true;
+  }
+}
+
+void TTracingEventHandler::freeContext(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx == nullptr) {
+    return;
+  }
+  std::unique_ptr<Call> call(static_cast<Call*>(ctx));
+  steady_clock::time_point now = steady_clock::now();
+  call->endHandler(now);
+  call->span.handlerMicros = toMicros(call->handlerEnd - call->readEnd);
+  call->span.durationMicros = toMicros(now - call->start) + call->span.queueMicros;
+  TTracer::setCurrent(call->callerContext);
+  tracer_->record(std::move(call->span));
+}
+}
+}
+} // apache::thrift::processor
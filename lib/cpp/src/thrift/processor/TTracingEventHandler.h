@@ -0,0 +1,89 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROCESSOR_TTRACINGEVENTHANDLER_H_
+#define _THRIFT_PROCESSOR_TTRACINGEVENTHANDLER_H_ 1
+
+#include <memory>
+
+#include <thrift/TProcessor.h>
+#include <thrift/TTracing.h>
+#include <thrift/server/TServer.h>
+
+namespace apache {
+namespace thrift {
+namespace processor {
+
+/**
+ * Records a server span, in a TTracer, for each call a processor handles.
+ *
+ * To continue the traces of callers, it reads their trace headers, so it
+ * must also be the server's event handler, which gives it the connections'
+ * protocols; a server event handler the server would otherwise have is
+ * passed as next, and called in turn:
+ *
+ * <blockquote><code>
+ *     auto tracing = std::make_shared<TTracingEventHandler>(tracer, server->getEventHandler());
+ *     processor->setEventHandler(tracing);
+ *     server->setServerEventHandler(tracing);
+ * </code></blockquote>
+ *
+ * Only THeaderProtocol connections carry headers. Calls on other
+ * connections, and calls without trace headers, start new traces, as
+ * sampled by the tracer.
+ *
+ * The queue time of a call is taken from ThreadManager::takeQueueTime().
+ */
+class TTracingEventHandler : public TProcessorEventHandler, public server::TServerEventHandler {
+public:
+  TTracingEventHandler(std::shared_ptr<TTracer> tracer,
+                       std::shared_ptr<server::TServerEventHandler> next = nullptr);
+
+  const std::shared_ptr<TTracer>& getTracer() const { return tracer_; }
+
+  void preServe() override;
+  void* createContext(std::shared_ptr<protocol::TProtocol> input,
+                      std::shared_ptr<protocol::TProtocol> output) override;
+  void deleteContext(void* serverContext,
+                     std::shared_ptr<protocol::TProtocol> input,
+                     std::shared_ptr<protocol::TProtocol> output) override;
+  void processContext(void* serverContext,
+                      std::shared_ptr<transport::TTransport> transport) override;
+
+  void* getContext(const char* fn_name, void* serverContext) override;
+  void freeContext(void* ctx, const char* fn_name) override;
+  void preRead(void* ctx, const char* fn_name) override;
+  void postRead(void* ctx, const char* fn_name, uint32_t bytes) override;
+  void preWrite(void* ctx, const char* fn_name) override;
+  void postWrite(void* ctx, const char* fn_name, uint32_t bytes) override;
+  void asyncComplete(void* ctx, const char* fn_name) override;
+  void handlerError(void* ctx, const char* fn_name) override;
+
+private:
+  struct Connection;
+  struct Call;
+
+  std::shared_ptr<TTracer> tracer_;
+  std::shared_ptr<server::TServerEventHandler> next_;
+};
+}
+}
+} // apache::thrift::processor
+
+#endif // #ifndef _THRIFT_PROCESSOR_TTRACINGEVENTHANDLER_H_
@@ -166,6 +166,13 @@ public:
 
   inline uint32_t readBinary(std::string& str);
 
+  /**
+   * Skips a value without the virtual calls and copies of the generic
+   * skip(). Fixed width values, and containers of them, are passed over in
+   * one step, and strings are consumed from the transport's buffer.
+   */
+  uint32_t skip(TType type);
+
   int getMinSerializedSize(TType type);
 
   void checkReadBytesAvailable(TSet& set)
@@ -188,6 +195,15 @@ protected:
   template <typename StrType>
   uint32_t readStringBody(StrType& str, int32_t sz);
 
+  // Size of a value on the wire, or 0 if it varies
+  static uint32_t getFixedSize(TType type);
+
+  // Skips count values of the given fixed size
+  uint32_t skipFixed(uint32_t count, uint32_t size);
+
+  // Skips the elements of a list or set
+  uint32_t skipElements(TType elemType, uint32_t count);
+
   Transport_* trans_;
 
   int32_t string_limit_;
@@ -461,6 +461,126 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str,
   return (uint32_t)size;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+
+  uint32_t fixedSize = getFixedSize(type);
+  if (fixedSize != 0) {
+    return skipFixed(1, fixedSize);
+  }
+
+  uint32_t result = 0;
+  switch (type) {
+  case T_STRING: {
+    int32_t size;
+    result += readI32(size);
+    if (size < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (this->string_limit_ > 0 && size > this->string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    return result + skipFixed(1, (uint32_t)size);
+  }
+  case T_STRUCT: {
+    std::string name;
+    int16_t fid;
+    TType ftype;
+    result += readStructBegin(name);
+    while (true) {
+      result += readFieldBegin(name, ftype, fid);
+      if (ftype == T_STOP) {
+        break;
+      }
+      result += skip(ftype);
+      result += readFieldEnd();
+    }
+    result += readStructEnd();
+    return result;
+  }
+  case T_MAP: {
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    result += readMapBegin(keyType, valType, size);
+    uint32_t keySize = getFixedSize(keyType);
+    uint32_t valSize = getFixedSize(valType);
+    if (keySize != 0 && valSize != 0) {
+      result += skipFixed(size, keySize + valSize);
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        result += skip(keyType);
+        result += skip(valType);
+      }
+    }
+    result += readMapEnd();
+    return result;
+  }
+  case T_SET: {
+    TType elemType;
+    uint32_t size;
+    result += readSetBegin(elemType, size);
+    result += skipElements(elemType, size);
+    result += readSetEnd();
+    return result;
+  }
+  case T_LIST: {
+    TType elemType;
+    uint32_t size;
+    result += readListBegin(elemType, size);
+    result += skipElements(elemType, size);
+    result += readListEnd();
+    return result;
+  }
+  default:
+    break;
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::skipElements(TType elemType, uint32_t count) {
+  uint32_t elemSize = getFixedSize(elemType);
+  if (elemSize != 0) {
+    return skipFixed(count, elemSize);
+  }
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    result += skip(elemType);
+  }
+  return result;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::getFixedSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_I16:
+    return 2;
+  case T_I32:
+    return 4;
+  case T_I64:
+  case T_DOUBLE:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::skipFixed(uint32_t count, uint32_t size) {
+  uint64_t bytes = (uint64_t)count * size;
+  if (bytes > (uint64_t)(std::numeric_limits<int32_t>::max)()) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  apache::thrift::transport::skipAll(*this->trans_, (uint32_t)bytes);
+  return (uint32_t)bytes;
+}
+
 // Return the minimum number of bytes a type will consume on the wire
 template <class Transport_, class ByteOrder_>
 int TBinaryProtocolT<Transport_, ByteOrder_>::getMinSerializedSize(TType type)
@@ -22,8 +22,8 @@
 
 #include <thrift/protocol/TVirtualProtocol.h>
 
-#include <stack>
 #include <memory>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -67,16 +67,42 @@ protected:
 
   /**
    * Used to keep track of the last field for the current and previous structs,
-   * so we can do the delta stuff.
+   * so we can do the delta stuff. The previous structs' last fields are kept
+   * in lastFieldInline_, until nesting gets deeper than LAST_FIELD_INLINE
+   * and they spill into lastFieldOverflow_, so that most structs are entered
+   * and left without allocating.
    */
-
-  std::stack<int16_t> lastField_;
+  static const uint32_t LAST_FIELD_INLINE = 16;
+  int16_t lastFieldInline_[LAST_FIELD_INLINE];
+  std::vector<int16_t> lastFieldOverflow_;
+  uint32_t lastFieldDepth_;
   int16_t lastFieldId_;
 
+  void pushLastField() {
+    if (lastFieldDepth_ < LAST_FIELD_INLINE) {
+      lastFieldInline_[lastFieldDepth_] = lastFieldId_;
+    } else {
+      lastFieldOverflow_.push_back(lastFieldId_);
+    }
+    ++lastFieldDepth_;
+    lastFieldId_ = 0;
+  }
+
+  void popLastField() {
+    --lastFieldDepth_;
+    if (lastFieldDepth_ < LAST_FIELD_INLINE) {
+      lastFieldId_ = lastFieldInline_[lastFieldDepth_];
+    } else {
+      lastFieldId_ = lastFieldOverflow_.back();
+      lastFieldOverflow_.pop_back();
+    }
+  }
+
 public:
   TCompactProtocolT(std::shared_ptr<Transport_> trans)
     : TVirtualProtocol<TCompactProtocolT<Transport_> >(trans),
       trans_(trans.get()),
+      lastFieldDepth_(0),
       lastFieldId_(0),
       string_limit_(0),
       string_buf_(nullptr),
@@ -91,6 +117,7 @@ public:
                     int32_t container_limit)
     : TVirtualProtocol<TCompactProtocolT<Transport_> >(trans),
       trans_(trans.get()),
+      lastFieldDepth_(0),
       lastFieldId_(0),
       string_limit_(string_limit),
       string_buf_(nullptr),
@@ -213,6 +240,13 @@ public:
 
   uint32_t readBinary(std::string& str);
 
+  /**
+   * Skips a value without the virtual calls and copies of the generic
+   * skip(). Containers of fixed width values or of varints are passed over
+   * in one step, and strings are consumed from the transport's buffer.
+   */
+  uint32_t skip(TType type);
+
   /*
    *These methods are here for the struct to call, but don't have any wire
    * encoding.
@@ -230,6 +264,13 @@ protected:
   int64_t zigzagToI64(uint64_t n);
   TType getTType(int8_t type);
 
+  // Size of a value on the wire, or 0 if it varies
+  static uint32_t getFixedSize(TType type);
+  static bool isVarint(TType type);
+  uint32_t skipFixed(uint32_t count, uint32_t size);
+  uint32_t skipVarints(uint32_t count);
+  uint32_t skipElements(TType elemType, uint32_t count);
+
   // Buffer for reading strings, save for the lifetime of the protocol to
   // avoid memory churn allocating memory on every string read
   int32_t string_limit_;
@@ -134,8 +134,7 @@ uint32_t TCompactProtocolT<Transport_>::writeFieldStop() {
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeStructBegin(const char* name) {
   (void) name;
-  lastField_.push(lastFieldId_);
-  lastFieldId_ = 0;
+  pushLastField();
   return 0;
 }
 
@@ -146,8 +145,7 @@ uint32_t TCompactProtocolT<Transport_>::writeStructBegin(const char* name) {
  */
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeStructEnd() {
-  lastFieldId_ = lastField_.top();
-  lastField_.pop();
+  popLastField();
   return 0;
 }
 
@@ -449,8 +447,7 @@ uint32_t TCompactProtocolT<Transport_>::readMessageBegin(
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::readStructBegin(std::string& name) {
   name = "";
-  lastField_.push(lastFieldId_);
-  lastFieldId_ = 0;
+  pushLastField();
   return 0;
 }
 
@@ -460,8 +457,7 @@ uint32_t TCompactProtocolT<Transport_>::readStructBegin(std::string& name) {
  */
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::readStructEnd() {
-  lastFieldId_ = lastField_.top();
-  lastField_.pop();
+  popLastField();
   return 0;
 }
 
@@ -829,6 +825,176 @@ TType TCompactProtocolT<Transport_>::getTType(int8_t type) {
   }
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+
+  uint32_t result = 0;
+  switch (type) {
+  case T_BOOL: {
+    // Boolean fields are held in the field header
+    bool value;
+    return readBool(value);
+  }
+  case T_BYTE:
+  case T_DOUBLE:
+    return skipFixed(1, getFixedSize(type));
+  case T_I16:
+  case T_I32:
+  case T_I64:
+    return skipVarints(1);
+  case T_STRING: {
+    int32_t size;
+    result += readVarint32(size);
+    if (size < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (string_limit_ > 0 && size > string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    return result + skipFixed(1, (uint32_t)size);
+  }
+  case T_STRUCT: {
+    std::string name;
+    int16_t fid;
+    TType ftype;
+    result += readStructBegin(name);
+    while (true) {
+      result += readFieldBegin(name, ftype, fid);
+      if (ftype == T_STOP) {
+        break;
+      }
+      result += skip(ftype);
+      result += readFieldEnd();
+    }
+    result += readStructEnd();
+    return result;
+  }
+  case T_MAP: {
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    result += readMapBegin(keyType, valType, size);
+    uint32_t keySize = getFixedSize(keyType);
+    uint32_t valSize = getFixedSize(valType);
+    if (keySize != 0 && valSize != 0) {
+      result += skipFixed(size, keySize + valSize);
+    } else if (isVarint(keyType) && isVarint(valType)) {
+      result += skipVarints(size * 2);
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        result += skip(keyType);
+        result += skip(valType);
+      }
+    }
+    result += readMapEnd();
+    return result;
+  }
+  case T_SET: {
+    TType elemType;
+    uint32_t size;
+    result += readSetBegin(elemType, size);
+    result += skipElements(elemType, size);
+    result += readSetEnd();
+    return result;
+  }
+  case T_LIST: {
+    TType elemType;
+    uint32_t size;
+    result += readListBegin(elemType, size);
+    result += skipElements(elemType, size);
+    result += readListEnd();
+    return result;
+  }
+  default:
+    break;
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::getFixedSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_DOUBLE:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+template <class Transport_>
+bool TCompactProtocolT<Transport_>::isVarint(TType type) {
+  return type == T_I16 || type == T_I32 || type == T_I64;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skipFixed(uint32_t count, uint32_t size) {
+  uint64_t bytes = (uint64_t)count * size;
+  if (bytes > (uint64_t)(std::numeric_limits<int32_t>::max)()) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  apache::thrift::transport::skipAll(*trans_, (uint32_t)bytes);
+  return (uint32_t)bytes;
+}
+
+/**
+ * Skips count varints by looking for their last bytes, which have the MSB
+ * clear, in whatever the transport has buffered.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skipVarints(uint32_t count) {
+  uint32_t rsize = 0;
+  uint32_t run = 0; // bytes of the current varint so far
+
+  while (count > 0) {
+    uint8_t byte;
+    uint32_t got = 1;
+    const uint8_t* buf = trans_->borrow(nullptr, &got);
+    if (buf == nullptr) {
+      trans_->readAll(&byte, 1);
+      buf = &byte;
+      got = 1;
+    }
+
+    uint32_t used = 0;
+    while (used < got && count > 0) {
+      if (buf[used++] & 0x80) {
+        if (UNLIKELY(++run == 10)) {
+          throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+        }
+      } else {
+        run = 0;
+        --count;
+      }
+    }
+
+    if (buf != &byte) {
+      trans_->consume(used);
+    }
+    rsize += used;
+  }
+  return rsize;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skipElements(TType elemType, uint32_t count) {
+  uint32_t elemSize = getFixedSize(elemType);
+  if (elemSize != 0) {
+    return skipFixed(count, elemSize);
+  } else if (isVarint(elemType)) {
+    return skipVarints(count);
+  }
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    result += skip(elemType);
+  }
+  return result;
+}
+
 // Return the minimum number of bytes a type will consume on the wire
 template <class Transport_>
 int TCompactProtocolT<Transport_>::getMinSerializedSize(TType type)
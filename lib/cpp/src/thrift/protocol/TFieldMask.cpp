@@ -0,0 +1,129 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TFieldMask.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+namespace {
+
+// Returns the field named, or numbered, name
+const TFieldDescriptor* findField(const TStructDescriptor& desc, const std::string& name) {
+  const char* begin = name.c_str();
+  if (*begin == '-' || (*begin >= '0' && *begin <= '9')) {
+    char* end;
+    errno = 0;
+    long id = std::strtol(begin, &end, 10);
+    if (*end != '\0' || errno != 0 || id < std::numeric_limits<int16_t>::min()
+        || id > std::numeric_limits<int16_t>::max()) {
+      return nullptr;
+    }
+    return desc.findField(static_cast<int16_t>(id));
+  }
+  return desc.findField(begin);
+}
+
+// Returns the struct held by a field of the given type, looking through
+// containers, or nullptr
+const TStructDescriptor* heldStruct(const TTypeDescriptor* type) {
+  while (type->type == T_LIST || type->type == T_SET || type->type == T_MAP) {
+    type = type->type == T_MAP ? type->value : type->elem;
+  }
+  return type->type == T_STRUCT ? type->structType : nullptr;
+}
+}
+
+TFieldMask::TFieldMask(const TStructDescriptor& desc)
+  : desc_(&desc), selected_(desc.fieldCount), children_(desc.fieldCount) {
+}
+
+TFieldMask::TFieldMask(const TStructDescriptor& desc, const std::vector<std::string>& paths)
+  : TFieldMask(desc) {
+  for (const auto& path : paths) {
+    add(path);
+  }
+}
+
+TFieldMask::TFieldMask(const TFieldMask& other)
+  : desc_(other.desc_), selected_(other.selected_), children_(other.children_.size()) {
+  for (size_t i = 0; i < children_.size(); ++i) {
+    if (other.children_[i]) {
+      children_[i].reset(new TFieldMask(*other.children_[i]));
+    }
+  }
+}
+
+TFieldMask& TFieldMask::operator=(const TFieldMask& other) {
+  if (this != &other) {
+    TFieldMask copy(other);
+    desc_ = copy.desc_;
+    selected_.swap(copy.selected_);
+    children_.swap(copy.children_);
+  }
+  return *this;
+}
+
+TFieldMask& TFieldMask::add(const std::string& path) {
+  add(path, 0);
+  return *this;
+}
+
+void TFieldMask::add(const std::string& path, std::string::size_type begin) {
+  std::string::size_type dot = path.find('.', begin);
+  std::string name = path.substr(begin, dot == std::string::npos ? dot : dot - begin);
+  const TFieldDescriptor* field = findField(*desc_, name);
+  if (field == nullptr) {
+    throw std::invalid_argument("Field mask path \"" + path + "\": " + desc_->name
+                                + " has no field \"" + name + "\"");
+  }
+
+  auto index = static_cast<uint32_t>(field - desc_->fields);
+  if (dot == std::string::npos) {
+    selected_[index] = true;
+    children_[index].reset();
+    return;
+  }
+
+  const TStructDescriptor* nested = heldStruct(field->type);
+  if (nested == nullptr) {
+    throw std::invalid_argument("Field mask path \"" + path + "\": " + desc_->name + "."
+                                + field->name + " holds no struct");
+  }
+  // The rest of the path is added to a copy, so that the mask is unchanged
+  // if it turns out to be invalid
+  std::unique_ptr<TFieldMask> child(children_[index] ? new TFieldMask(*children_[index])
+                                                     : new TFieldMask(*nested));
+  child->add(path, dot + 1);
+  // A field already selected whole stays so
+  if (!selected_[index] || children_[index]) {
+    selected_[index] = true;
+    children_[index] = std::move(child);
+  }
+}
+}
+}
+} // apache::thrift::protocol
@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TFIELDMASK_H_
+#define _THRIFT_PROTOCOL_TFIELDMASK_H_ 1
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <thrift/protocol/TTypeDescriptor.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Selects the fields of a struct that readPartial() decodes. The rest are
+ * skipped on the wire and left untouched in the object.
+ *
+ * A mask is built from field paths: field names or ids separated by dots,
+ * such as "header.route" or "entries.2". A path may continue through list,
+ * set and map fields into the structs they hold, and then applies to every
+ * element (or map value; map keys are always read whole). A field at the
+ * end of a path is read whole.
+ *
+ * Required fields outside the mask are not checked for.
+ */
+class TFieldMask {
+public:
+  /**
+   * Creates a mask of desc that selects no fields.
+   */
+  explicit TFieldMask(const TStructDescriptor& desc);
+
+  /**
+   * Creates a mask of desc that selects the given paths.
+   *
+   * \throws std::invalid_argument if a path does not name a field
+   */
+  TFieldMask(const TStructDescriptor& desc, const std::vector<std::string>& paths);
+
+  TFieldMask(const TFieldMask& other);
+  TFieldMask& operator=(const TFieldMask& other);
+
+  /**
+   * Selects the field at path.
+   *
+   * \throws std::invalid_argument if path does not name a field
+   */
+  TFieldMask& add(const std::string& path);
+
+  const TStructDescriptor& descriptor() const { return *desc_; }
+
+  /**
+   * Returns true if any part of desc.fields[index] is selected.
+   */
+  bool selected(uint32_t index) const { return selected_[index]; }
+
+  /**
+   * Returns the mask of the structs within desc.fields[index], or nullptr if
+   * the field is selected whole.
+   */
+  const TFieldMask* child(uint32_t index) const { return children_[index].get(); }
+
+private:
+  void add(const std::string& path, std::string::size_type begin);
+
+  const TStructDescriptor* desc_;
+  std::vector<bool> selected_;
+  std::vector<std::unique_ptr<TFieldMask> > children_;
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TFIELDMASK_H_ 1
@@ -0,0 +1,90 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TFIELDNAMETABLE_H_
+#define _THRIFT_PROTOCOL_TFIELDNAMETABLE_H_ 1
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <thrift/protocol/TEnum.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Name, id and type of one field of a struct.
+ */
+struct TFieldName {
+  const char* name;
+  int16_t id;
+  TType type;
+};
+
+/**
+ * Maps the field names of a struct to field ids and types, for protocols
+ * that identify fields by name only (see TSimpleJSONProtocol). The code
+ * generator emits one table per struct, with the cpp:simple_json option,
+ * as a perfect hash: slot
+ * hash(name, seed) & mask of slots holds the index of the field with that
+ * name in fields, or -1, so a lookup costs one hash and one comparison.
+ */
+struct TFieldNameTable {
+  const TFieldName* fields;
+  const int16_t* slots;
+  uint32_t mask;
+  uint32_t seed;
+
+  /**
+   * FNV-1a with a final mix, so that the low bits used as the slot index
+   * depend on every bit of the seed. The code generator computes the same
+   * function.
+   */
+  static uint32_t hash(const char* name, size_t len, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; ++i) {
+      h ^= static_cast<uint8_t>(name[i]);
+      h *= 16777619u;
+    }
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    return h ^ (h >> 15);
+  }
+
+  /**
+   * Sets fieldId and fieldType to those of the field called name. Returns
+   * false, leaving both alone, if the struct has no such field.
+   */
+  bool find(const std::string& name, int16_t& fieldId, TType& fieldType) const {
+    int16_t index = slots[hash(name.data(), name.size(), seed) & mask];
+    if (index < 0 || name.compare(fields[index].name) != 0) {
+      return false;
+    }
+    fieldId = fields[index].id;
+    fieldType = fields[index].type;
+    return true;
+  }
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TFIELDNAMETABLE_H_ 1
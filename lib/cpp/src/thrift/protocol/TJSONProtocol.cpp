@@ -19,17 +19,15 @@
 
 #include <thrift/protocol/TJSONProtocol.h>
 
-#include <boost/locale.hpp>
-
+#include <clocale>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
-#include <locale>
-#include <sstream>
-#include <stdexcept>
 
 #include <thrift/protocol/TBase64Utils.h>
 #include <thrift/transport/TTransportException.h>
-#include <thrift/TToString.h>
 
 using namespace apache::thrift::transport;
 
@@ -294,124 +292,236 @@ static bool isLowSurrogate(uint16_t val) {
   return val >= 0xDC00 && val <= 0xDFFF;
 }
 
-/**
- * Class to serve as base JSON context and as base class for other context
- * implementations
- */
-class TJSONContext {
-
-public:
-  TJSONContext() = default;
-
-  virtual ~TJSONContext() = default;
-
-  /**
-   * Write context data to the transport. Default is to do nothing.
-   */
-  virtual uint32_t write(TTransport& trans) {
-    (void)trans;
-    return 0;
-  };
-
-  /**
-   * Read context data from the transport. Default is to do nothing.
-   */
-  virtual uint32_t read(TJSONProtocol::LookaheadReader& reader) {
-    (void)reader;
-    return 0;
-  };
-
-  /**
-   * Return true if numbers need to be escaped as strings in this context.
-   * Default behavior is to return false.
-   */
-  virtual bool escapeNum() { return false; }
-};
-
-// Context class for object member key-value pairs
-class JSONPairContext : public TJSONContext {
-
-public:
-  JSONPairContext() : first_(true), colon_(true) {}
-
-  uint32_t write(TTransport& trans) override {
-    if (first_) {
-      first_ = false;
-      colon_ = true;
-      return 0;
-    } else {
-      trans.write(colon_ ? &kJSONPairSeparator : &kJSONElemSeparator, 1);
-      colon_ = !colon_;
-      return 1;
+// Return the number of leading bytes of [p, p + len) that can be written
+// inside a JSON string as they are, i.e. that are not control characters,
+// '"' or '\\'. Eight bytes are tested at a time while none of them match.
+static size_t safeJSONChars(const uint8_t* p, size_t len) {
+  static const uint64_t kOnes = 0x0101010101010101ULL;
+  static const uint64_t kHighs = 0x8080808080808080ULL;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t v;
+    memcpy(&v, p + i, 8);
+    uint64_t control = (v - kOnes * 0x20) & ~v;
+    uint64_t quote = ((v ^ (kOnes * kJSONStringDelimiter)) - kOnes) & ~(v ^ (kOnes * kJSONStringDelimiter));
+    uint64_t backslash = ((v ^ (kOnes * kJSONBackslash)) - kOnes) & ~(v ^ (kOnes * kJSONBackslash));
+    if ((control | quote | backslash) & kHighs) {
+      break;
     }
   }
-
-  uint32_t read(TJSONProtocol::LookaheadReader& reader) override {
-    if (first_) {
-      first_ = false;
-      colon_ = true;
-      return 0;
-    } else {
-      uint8_t ch = (colon_ ? kJSONPairSeparator : kJSONElemSeparator);
-      colon_ = !colon_;
-      return readSyntaxChar(reader, ch);
+  for (; i < len; ++i) {
+    uint8_t ch = p[i];
+    if (ch < 0x20 || ch == kJSONStringDelimiter || ch == kJSONBackslash) {
+      break;
     }
   }
+  return i;
+}
+
+// Return the number of leading bytes of [p, p + len) that are neither '"'
+// nor '\\', i.e. that can be copied out of a JSON string as they are.
+static size_t plainJSONChars(const uint8_t* p, size_t len) {
+  static const uint64_t kOnes = 0x0101010101010101ULL;
+  static const uint64_t kHighs = 0x8080808080808080ULL;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t v;
+    memcpy(&v, p + i, 8);
+    uint64_t quote = ((v ^ (kOnes * kJSONStringDelimiter)) - kOnes) & ~(v ^ (kOnes * kJSONStringDelimiter));
+    uint64_t backslash = ((v ^ (kOnes * kJSONBackslash)) - kOnes) & ~(v ^ (kOnes * kJSONBackslash));
+    if ((quote | backslash) & kHighs) {
+      break;
+    }
+  }
+  for (; i < len; ++i) {
+    if (p[i] == kJSONStringDelimiter || p[i] == kJSONBackslash) {
+      break;
+    }
+  }
+  return i;
+}
+
+// Append the UTF-8 encoding of the code point cp to str
+static void appendUTF8(std::string& str, uint32_t cp) {
+  if (cp < 0x80) {
+    str += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    str += static_cast<char>(0xC0 | (cp >> 6));
+    str += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    str += static_cast<char>(0xE0 | (cp >> 12));
+    str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    str += static_cast<char>(0xF0 | (cp >> 18));
+    str += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
 
-  // Numbers must be turned into strings if they are the key part of a pair
-  bool escapeNum() override { return colon_; }
-
-private:
-  bool first_;
-  bool colon_;
-};
-
-// Context class for lists
-class JSONListContext : public TJSONContext {
-
-public:
-  JSONListContext() : first_(true) {}
+// Format an integer into out, which must hold at least 20 characters, and
+// return the number of characters written.
+static uint32_t formatJSONInteger(char* out, uint64_t magnitude, bool negative) {
+  char digits[20];
+  char* end = digits + sizeof(digits);
+  char* p = end;
+  do {
+    *--p = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  uint32_t len = 0;
+  if (negative) {
+    out[len++] = '-';
+  }
+  memcpy(out + len, p, end - p);
+  return len + static_cast<uint32_t>(end - p);
+}
 
-  uint32_t write(TTransport& trans) override {
-    if (first_) {
-      first_ = false;
-      return 0;
-    } else {
-      trans.write(&kJSONElemSeparator, 1);
-      return 1;
+// Parse str as an integer of type NumberType. Returns false if str is not
+// a plain decimal integer or does not fit.
+template <typename NumberType>
+static bool parseJSONInteger(const std::string& str, NumberType& num) {
+  const char* p = str.c_str();
+  const char* end = p + str.size();
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+  if (p == end) {
+    return false;
+  }
+  uint64_t magnitude = 0;
+  for (; p != end; ++p) {
+    if (*p < '0' || *p > '9') {
+      return false;
+    }
+    uint64_t digit = static_cast<uint64_t>(*p - '0');
+    if (magnitude > ((std::numeric_limits<uint64_t>::max)() - digit) / 10) {
+      return false;
     }
+    magnitude = magnitude * 10 + digit;
   }
-
-  uint32_t read(TJSONProtocol::LookaheadReader& reader) override {
-    if (first_) {
-      first_ = false;
-      return 0;
+  if (negative) {
+    if (!std::numeric_limits<NumberType>::is_signed) {
+      return magnitude == 0 ? (num = 0, true) : false;
+    }
+    // magnitude may be one more than the maximum of a signed type
+    uint64_t limit = static_cast<uint64_t>((std::numeric_limits<NumberType>::max)()) + 1;
+    if (magnitude > limit) {
+      return false;
+    }
+    num = static_cast<NumberType>(-static_cast<int64_t>(magnitude - 1) - 1);
+  } else {
+    if (magnitude > static_cast<uint64_t>((std::numeric_limits<NumberType>::max)())) {
+      return false;
+    }
+    num = static_cast<NumberType>(magnitude);
+  }
+  return true;
+}
+
+// The C library formats and parses doubles using the decimal point of the
+// current locale, while JSON always uses '.'.
+static const char* localeDecimalPoint() {
+  const char* point = localeconv()->decimal_point;
+  return (point != nullptr && *point != '\0') ? point : ".";
+}
+
+// Format a finite double with 17 significant digits, enough to round trip,
+// and return the number of characters written to out (at least 32 bytes).
+static uint32_t formatJSONDouble(char* out, size_t size, double num) {
+  char buf[64];
+  int len = snprintf(buf, sizeof(buf), "%.17g", num);
+  const char* point = localeDecimalPoint();
+  size_t pointLen = strlen(point);
+  uint32_t outLen = 0;
+  for (int i = 0; i < len && outLen < size; ++i) {
+    if (pointLen > 0 && strncmp(buf + i, point, pointLen) == 0
+        && (point[0] != '.' || pointLen != 1)) {
+      out[outLen++] = '.';
+      i += static_cast<int>(pointLen) - 1;
     } else {
-      return readSyntaxChar(reader, kJSONElemSeparator);
+      out[outLen++] = buf[i];
     }
   }
+  return outLen;
+}
 
-private:
-  bool first_;
-};
+// Parse str as a JSON number. Returns false unless all of str was used.
+static bool parseJSONDouble(const std::string& str, double& num) {
+  if (str.empty()) {
+    return false;
+  }
+  const char* point = localeDecimalPoint();
+  std::string localized;
+  const char* text = str.c_str();
+  if (strcmp(point, ".") != 0 && str.find('.') != std::string::npos) {
+    localized = str;
+    localized.replace(localized.find('.'), 1, point);
+    text = localized.c_str();
+  }
+  char* end = nullptr;
+  num = strtod(text, &end);
+  return end != nullptr && *end == '\0';
+}
 
 TJSONProtocol::TJSONProtocol(std::shared_ptr<TTransport> ptrans)
   : TVirtualProtocol<TJSONProtocol>(ptrans),
     trans_(ptrans.get()),
-    context_(new TJSONContext()),
     reader_(*ptrans) {
+  contexts_.reserve(16);
+  contexts_.push_back(JSONContext(JSONContext::BASE));
 }
 
 TJSONProtocol::~TJSONProtocol() = default;
 
-void TJSONProtocol::pushContext(std::shared_ptr<TJSONContext> c) {
-  contexts_.push(context_);
-  context_ = c;
+void TJSONProtocol::pushContext(JSONContext::Kind kind) {
+  contexts_.push_back(JSONContext(kind));
 }
 
 void TJSONProtocol::popContext() {
-  context_ = contexts_.top();
-  contexts_.pop();
+  if (contexts_.size() > 1) {
+    contexts_.pop_back();
+  }
+}
+
+// Advance the current context and return the separator that precedes the
+// next value, or 0 if none does.
+uint8_t TJSONProtocol::nextContextSeparator() {
+  JSONContext& c = contexts_.back();
+  if (c.kind == JSONContext::BASE) {
+    return 0;
+  }
+  if (c.first) {
+    c.first = false;
+    c.colon = true;
+    return 0;
+  }
+  if (c.kind == JSONContext::PAIR) {
+    uint8_t ch = c.colon ? kJSONPairSeparator : kJSONElemSeparator;
+    c.colon = !c.colon;
+    return ch;
+  }
+  return kJSONElemSeparator;
+}
+
+uint32_t TJSONProtocol::writeContext() {
+  uint8_t ch = nextContextSeparator();
+  if (ch == 0) {
+    return 0;
+  }
+  trans_->write(&ch, 1);
+  return 1;
+}
+
+uint32_t TJSONProtocol::readContext() {
+  uint8_t ch = nextContextSeparator();
+  if (ch == 0) {
+    return 0;
+  }
+  return readSyntaxChar(reader_, ch);
 }
 
 // Write the character ch as a JSON escape sequence ("\u00xx")
@@ -453,15 +563,35 @@ uint32_t TJSONProtocol::writeJSONChar(uint8_t ch) {
 }
 
 // Write out the contents of the string str as a JSON string, escaping
-// characters as appropriate.
+// characters as appropriate. Runs of characters that need no escaping are
+// written with a single call.
 uint32_t TJSONProtocol::writeJSONString(const std::string& str) {
-  uint32_t result = context_->write(*trans_);
-  result += 2; // For quotes
-  trans_->write(&kJSONStringDelimiter, 1);
-  std::string::const_iterator iter(str.begin());
-  std::string::const_iterator end(str.end());
-  while (iter != end) {
-    result += writeJSONChar(*iter++);
+  uint8_t prefix[2];
+  uint32_t prefixLen = 0;
+  uint8_t separator = nextContextSeparator();
+  if (separator != 0) {
+    prefix[prefixLen++] = separator;
+  }
+  prefix[prefixLen++] = kJSONStringDelimiter;
+  trans_->write(prefix, prefixLen);
+  uint32_t result = prefixLen + 1; // and the closing quote
+
+  const auto* p = (const uint8_t*)str.data();
+  size_t len = str.size();
+  while (len > 0) {
+    size_t run = safeJSONChars(p, len);
+    if (run > 0) {
+      if (run > (std::numeric_limits<uint32_t>::max)())
+        throw TProtocolException(TProtocolException::SIZE_LIMIT);
+      trans_->write(p, static_cast<uint32_t>(run));
+      result += static_cast<uint32_t>(run);
+      p += run;
+      len -= run;
+    }
+    if (len > 0) {
+      result += writeJSONChar(*p++);
+      --len;
+    }
   }
   trans_->write(&kJSONStringDelimiter, 1);
   return result;
@@ -470,26 +600,34 @@ uint32_t TJSONProtocol::writeJSONString(const std::string& str) {
 // Write out the contents of the string as JSON string, base64-encoding
 // the string's contents, and escaping as appropriate
 uint32_t TJSONProtocol::writeJSONBase64(const std::string& str) {
-  uint32_t result = context_->write(*trans_);
+  uint32_t result = writeContext();
   result += 2; // For quotes
   trans_->write(&kJSONStringDelimiter, 1);
-  uint8_t b[4];
+  uint8_t b[256];
+  uint32_t used = 0;
   const auto* bytes = (const uint8_t*)str.c_str();
   if (str.length() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
   auto len = static_cast<uint32_t>(str.length());
   while (len >= 3) {
-    // Encode 3 bytes at a time
-    base64_encode(bytes, 3, b);
-    trans_->write(b, 4);
-    result += 4;
+    // Encode 3 bytes at a time, writing out a buffer full at once
+    base64_encode(bytes, 3, b + used);
+    used += 4;
+    if (used == sizeof(b)) {
+      trans_->write(b, used);
+      result += used;
+      used = 0;
+    }
     bytes += 3;
     len -= 3;
   }
   if (len) { // Handle remainder
-    base64_encode(bytes, len, b);
-    trans_->write(b, len + 1);
-    result += len + 1;
+    base64_encode(bytes, len, b + used);
+    used += len + 1;
+  }
+  if (used) {
+    trans_->write(b, used);
+    result += used;
   }
   trans_->write(&kJSONStringDelimiter, 1);
   return result;
@@ -499,80 +637,75 @@ uint32_t TJSONProtocol::writeJSONBase64(const std::string& str) {
 // if the context requires it (eg: key in a map pair).
 template <typename NumberType>
 uint32_t TJSONProtocol::writeJSONInteger(NumberType num) {
-  uint32_t result = context_->write(*trans_);
-  std::string val(to_string(num));
-  bool escapeNum = context_->escapeNum();
+  // separator, quotes, sign and 20 digits
+  uint8_t buf[24];
+  uint32_t len = 0;
+  uint8_t separator = nextContextSeparator();
+  if (separator != 0) {
+    buf[len++] = separator;
+  }
+  bool escapeNum = contextEscapeNum();
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    buf[len++] = kJSONStringDelimiter;
+  }
+  if (std::numeric_limits<NumberType>::is_signed && static_cast<int64_t>(num) < 0) {
+    len += formatJSONInteger((char*)buf + len,
+                             0 - static_cast<uint64_t>(static_cast<int64_t>(num)),
+                             true);
+  } else {
+    len += formatJSONInteger((char*)buf + len, static_cast<uint64_t>(num), false);
   }
-  if (val.length() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t*)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    buf[len++] = kJSONStringDelimiter;
   }
-  return result;
-}
-
-namespace {
-std::string doubleToString(double d) {
-  std::ostringstream str;
-  str.imbue(std::locale::classic());
-  const std::streamsize max_digits10 = 2 + std::numeric_limits<double>::digits10;
-  str.precision(max_digits10);
-  str << d;
-  return str.str();
-}
+  trans_->write(buf, len);
+  return len;
 }
 
 // Convert the given double to a JSON string, which is either the number,
 // "NaN" or "Infinity" or "-Infinity".
 uint32_t TJSONProtocol::writeJSONDouble(double num) {
-  uint32_t result = context_->write(*trans_);
-  std::string val;
+  // separator, quotes and the longest %.17g output
+  uint8_t buf[40];
+  uint32_t len = 0;
+  uint8_t separator = nextContextSeparator();
+  if (separator != 0) {
+    buf[len++] = separator;
+  }
 
-  bool special = false;
+  const std::string* special = nullptr;
   switch (std::fpclassify(num)) {
   case FP_INFINITE:
-    if (std::signbit(num)) {
-      val = kThriftNegativeInfinity;
-    } else {
-      val = kThriftInfinity;
-    }
-    special = true;
+    special = std::signbit(num) ? &kThriftNegativeInfinity : &kThriftInfinity;
     break;
   case FP_NAN:
-    val = kThriftNan;
-    special = true;
+    special = &kThriftNan;
     break;
   default:
-    val = doubleToString(num);
     break;
   }
 
-  bool escapeNum = special || context_->escapeNum();
+  bool escapeNum = special != nullptr || contextEscapeNum();
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    buf[len++] = kJSONStringDelimiter;
+  }
+  if (special != nullptr) {
+    memcpy(buf + len, special->data(), special->size());
+    len += static_cast<uint32_t>(special->size());
+  } else {
+    len += formatJSONDouble((char*)buf + len, sizeof(buf) - len - 1, num);
   }
-  if (val.length() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t*)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    buf[len++] = kJSONStringDelimiter;
   }
-  return result;
+  trans_->write(buf, len);
+  return len;
 }
 
 uint32_t TJSONProtocol::writeJSONObjectStart() {
-  uint32_t result = context_->write(*trans_);
+  uint32_t result = writeContext();
   trans_->write(&kJSONObjectStart, 1);
-  pushContext(std::shared_ptr<TJSONContext>(new JSONPairContext()));
+  pushContext(JSONContext::PAIR);
   return result + 1;
 }
 
@@ -583,9 +716,9 @@ uint32_t TJSONProtocol::writeJSONObjectEnd() {
 }
 
 uint32_t TJSONProtocol::writeJSONArrayStart() {
-  uint32_t result = context_->write(*trans_);
+  uint32_t result = writeContext();
   trans_->write(&kJSONArrayStart, 1);
-  pushContext(std::shared_ptr<TJSONContext>(new JSONListContext()));
+  pushContext(JSONContext::LIST);
   return result + 1;
 }
 
@@ -734,14 +867,37 @@ uint32_t TJSONProtocol::readJSONEscapeChar(uint16_t* out) {
   return 4;
 }
 
+// Appends the characters of a JSON string that need no unescaping to str,
+// up to the next '"' or '\\', straight from the transport's buffer. Returns
+// false if the transport has no buffered data to lend.
+bool TJSONProtocol::readJSONStringChars(std::string& str, uint32_t& result) {
+  while (true) {
+    uint32_t len = 0;
+    const uint8_t* buf = reader_.borrow(&len);
+    if (buf == nullptr) {
+      return false;
+    }
+    auto run = static_cast<uint32_t>(plainJSONChars(buf, len));
+    reader_.append(str, run);
+    result += run;
+    if (run < len) {
+      return true;
+    }
+  }
+}
+
 // Decodes a JSON string, including unescaping, and returns the string via str
 uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
-  uint32_t result = (skipContext ? 0 : context_->read(reader_));
+  uint32_t result = (skipContext ? 0 : readContext());
   result += readJSONSyntaxChar(kJSONStringDelimiter);
-  std::vector<uint16_t> codeunits;
+  uint16_t highSurrogate = 0;
+  bool borrowable = true;
   uint8_t ch;
   str.clear();
   while (true) {
+    if (borrowable && highSurrogate == 0) {
+      borrowable = readJSONStringChars(str, result);
+    }
     ch = reader_.read();
     ++result;
     if (ch == kJSONStringDelimiter) {
@@ -754,17 +910,24 @@ uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
         uint16_t cp;
         result += readJSONEscapeChar(&cp);
         if (isHighSurrogate(cp)) {
-          codeunits.push_back(cp);
-        } else {
-          if (isLowSurrogate(cp)
-               && codeunits.empty()) {
+          if (highSurrogate != 0) {
+            throw TProtocolException(TProtocolException::INVALID_DATA,
+                                     "Missing UTF-16 low surrogate pair.");
+          }
+          highSurrogate = cp;
+        } else if (isLowSurrogate(cp)) {
+          if (highSurrogate == 0) {
             throw TProtocolException(TProtocolException::INVALID_DATA,
                                      "Missing UTF-16 high surrogate pair.");
           }
-          codeunits.push_back(cp);
-          codeunits.push_back(0);
-          str += boost::locale::conv::utf_to_utf<char>(codeunits.data());
-          codeunits.clear();
+          appendUTF8(str, 0x10000 + ((highSurrogate - 0xD800) << 10) + (cp - 0xDC00));
+          highSurrogate = 0;
+        } else {
+          if (highSurrogate != 0) {
+            throw TProtocolException(TProtocolException::INVALID_DATA,
+                                     "Missing UTF-16 low surrogate pair.");
+          }
+          appendUTF8(str, cp);
         }
         continue;
       } else {
@@ -777,14 +940,14 @@ uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
         ch = kEscapeCharVals[pos];
       }
     }
-    if (!codeunits.empty()) {
+    if (highSurrogate != 0) {
       throw TProtocolException(TProtocolException::INVALID_DATA,
                                "Missing UTF-16 low surrogate pair.");
     }
     str += ch;
   }
 
-  if (!codeunits.empty()) {
+  if (highSurrogate != 0) {
     throw TProtocolException(TProtocolException::INVALID_DATA,
                              "Missing UTF-16 low surrogate pair.");
   }
@@ -828,6 +991,20 @@ uint32_t TJSONProtocol::readJSONNumericChars(std::string& str) {
   uint32_t result = 0;
   str.clear();
   while (true) {
+    uint32_t len = 0;
+    const uint8_t* buf = reader_.borrow(&len);
+    if (buf != nullptr) {
+      uint32_t run = 0;
+      while (run < len && isJSONNumeric(buf[run])) {
+        ++run;
+      }
+      reader_.append(str, run);
+      result += run;
+      if (run < len) {
+        break;
+      }
+      continue;
+    }
     uint8_t ch = reader_.peek();
     if (!isJSONNumeric(ch)) {
       break;
@@ -839,36 +1016,21 @@ uint32_t TJSONProtocol::readJSONNumericChars(std::string& str) {
   return result;
 }
 
-namespace {
-template <typename T>
-T fromString(const std::string& s) {
-  T t;
-  std::istringstream str(s);
-  str.imbue(std::locale::classic());
-  str >> t;
-  if (str.bad() || !str.eof())
-    throw std::runtime_error(s);
-  return t;
-}
-}
-
 // Reads a sequence of characters and assembles them into a number,
 // returning them via num
 template <typename NumberType>
 uint32_t TJSONProtocol::readJSONInteger(NumberType& num) {
-  uint32_t result = context_->read(reader_);
-  if (context_->escapeNum()) {
+  uint32_t result = readContext();
+  bool escapeNum = contextEscapeNum();
+  if (escapeNum) {
     result += readJSONSyntaxChar(kJSONStringDelimiter);
   }
-  std::string str;
-  result += readJSONNumericChars(str);
-  try {
-    num = fromString<NumberType>(str);
-  } catch (const std::runtime_error&) {
+  result += readJSONNumericChars(scratch_);
+  if (!parseJSONInteger(scratch_, num)) {
     throw TProtocolException(TProtocolException::INVALID_DATA,
-                             "Expected numeric value; got \"" + str + "\"");
+                             "Expected numeric value; got \"" + scratch_ + "\"");
   }
-  if (context_->escapeNum()) {
+  if (escapeNum) {
     result += readJSONSyntaxChar(kJSONStringDelimiter);
   }
   return result;
@@ -876,50 +1038,45 @@ uint32_t TJSONProtocol::readJSONInteger(NumberType& num) {
 
 // Reads a JSON number or string and interprets it as a double.
 uint32_t TJSONProtocol::readJSONDouble(double& num) {
-  uint32_t result = context_->read(reader_);
-  std::string str;
+  uint32_t result = readContext();
   if (reader_.peek() == kJSONStringDelimiter) {
-    result += readJSONString(str, true);
+    result += readJSONString(scratch_, true);
     // Check for NaN, Infinity and -Infinity
-    if (str == kThriftNan) {
+    if (scratch_ == kThriftNan) {
       num = HUGE_VAL / HUGE_VAL; // generates NaN
-    } else if (str == kThriftInfinity) {
+    } else if (scratch_ == kThriftInfinity) {
       num = HUGE_VAL;
-    } else if (str == kThriftNegativeInfinity) {
+    } else if (scratch_ == kThriftNegativeInfinity) {
       num = -HUGE_VAL;
     } else {
-      if (!context_->escapeNum()) {
+      if (!contextEscapeNum()) {
         // Throw exception -- we should not be in a string in this case
         throw TProtocolException(TProtocolException::INVALID_DATA,
                                      "Numeric data unexpectedly quoted");
       }
-      try {
-        num = fromString<double>(str);
-      } catch (const std::runtime_error&) {
+      if (!parseJSONDouble(scratch_, num)) {
         throw TProtocolException(TProtocolException::INVALID_DATA,
-                                     "Expected numeric value; got \"" + str + "\"");
+                                     "Expected numeric value; got \"" + scratch_ + "\"");
       }
     }
   } else {
-    if (context_->escapeNum()) {
+    if (contextEscapeNum()) {
       // This will throw - we should have had a quote if escapeNum == true
       readJSONSyntaxChar(kJSONStringDelimiter);
     }
-    result += readJSONNumericChars(str);
-    try {
-      num = fromString<double>(str);
-    } catch (const std::runtime_error&) {
+    result += readJSONNumericChars(scratch_);
+    if (!parseJSONDouble(scratch_, num)) {
       throw TProtocolException(TProtocolException::INVALID_DATA,
-                                   "Expected numeric value; got \"" + str + "\"");
+                                   "Expected numeric value; got \"" + scratch_ + "\"");
     }
   }
   return result;
 }
 
 uint32_t TJSONProtocol::readJSONObjectStart() {
-  uint32_t result = context_->read(reader_);
+  uint32_t result = readContext();
   result += readJSONSyntaxChar(kJSONObjectStart);
-  pushContext(std::shared_ptr<TJSONContext>(new JSONPairContext()));
+  pushContext(JSONContext::PAIR);
   return result;
 }
 
@@ -930,9 +1087,9 @@ uint32_t TJSONProtocol::readJSONObjectEnd() {
 }
 
 uint32_t TJSONProtocol::readJSONArrayStart() {
-  uint32_t result = context_->read(reader_);
+  uint32_t result = readContext();
   result += readJSONSyntaxChar(kJSONArrayStart);
-  pushContext(std::shared_ptr<TJSONContext>(new JSONListContext()));
+  pushContext(JSONContext::LIST);
   return result;
 }
 
@@ -22,15 +22,12 @@
 
 #include <thrift/protocol/TVirtualProtocol.h>
 
-#include <stack>
+#include <vector>
 
 namespace apache {
 namespace thrift {
 namespace protocol {
 
-// Forward declaration
-class TJSONContext;
-
 /**
  * JSON protocol for Thrift.
  *
@@ -101,10 +98,36 @@ public:
   ~TJSONProtocol() override;
 
 private:
-  void pushContext(std::shared_ptr<TJSONContext> c);
+  /**
+   * Nesting state of the JSON value being written or read: the top level,
+   * the members of an object or the elements of an array. Kept by value in
+   * contexts_ so that entering a container does not allocate.
+   */
+  struct JSONContext {
+    enum Kind { BASE, PAIR, LIST };
+
+    JSONContext(Kind k) : kind(k), first(true), colon(true) {}
+
+    Kind kind;
+    bool first;
+    bool colon;
+  };
+
+  void pushContext(JSONContext::Kind kind);
 
   void popContext();
 
+  uint8_t nextContextSeparator();
+
+  uint32_t writeContext();
+
+  uint32_t readContext();
+
+  bool contextEscapeNum() const {
+    const JSONContext& c = contexts_.back();
+    return c.kind == JSONContext::PAIR && c.colon;
+  }
+
   uint32_t writeJSONEscapeChar(uint8_t ch);
 
   uint32_t writeJSONChar(uint8_t ch);
@@ -136,6 +159,8 @@ private:
 
   uint32_t readJSONNumericChars(std::string& str);
 
+  bool readJSONStringChars(std::string& str, uint32_t& result);
+
   template <typename NumberType>
   uint32_t readJSONInteger(NumberType& num);
 
@@ -285,6 +310,30 @@ public:
       return data_;
     }
 
+    /**
+     * Returns the bytes the transport already holds in memory, without
+     * consuming them, or nullptr if it cannot lend any (or a peeked byte is
+     * pending). Used to scan strings and numbers in bulk.
+     */
+    const uint8_t* borrow(uint32_t* len) {
+      if (hasData_) {
+        return nullptr;
+      }
+      *len = 1;
+      return trans_->borrow(nullptr, len);
+    }
+
+    /**
+     * Moves the first len borrowed bytes to the end of str. They are taken
+     * with readAll() rather than consume(), so that the transport accounts
+     * for them just as if they had been read one at a time.
+     */
+    void append(std::string& str, uint32_t len) {
+      size_t size = str.size();
+      str.resize(size + len);
+      trans_->readAll(reinterpret_cast<uint8_t*>(&str[size]), len);
+    }
+
   private:
     TTransport* trans_;
     bool hasData_;
@@ -294,8 +343,9 @@ public:
 private:
   TTransport* trans_;
 
-  std::stack<std::shared_ptr<TJSONContext> > contexts_;
-  std::shared_ptr<TJSONContext> context_;
+  // contexts_.back() is the current context
+  std::vector<JSONContext> contexts_;
+  std::string scratch_;
   LookaheadReader reader_;
 };
 
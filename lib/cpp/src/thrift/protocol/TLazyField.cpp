@@ -0,0 +1,56 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TLazyField.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+bool TLazyFieldBase::capture(TProtocol* iprot, TType type, uint32_t& xfer) {
+  uint32_t size;
+  const uint8_t* buf = borrowRawValue(iprot, type, size);
+  if (buf == nullptr) {
+    return false;
+  }
+
+  raw_.assign(reinterpret_cast<const char*>(buf), size);
+  encoding_ = rawEncoding(iprot);
+  iprot->getInputTransport()->consume(size);
+  xfer = size;
+  return true;
+}
+
+bool TLazyFieldBase::replay(TProtocol* oprot, uint32_t& xfer) const {
+  if (rawEncoding(oprot) != encoding_) {
+    return false;
+  }
+  xfer = static_cast<uint32_t>(raw_.size());
+  oprot->getOutputTransport()->write(reinterpret_cast<const uint8_t*>(raw_.data()), xfer);
+  return true;
+}
+
+std::shared_ptr<TProtocol> TLazyFieldBase::rawReader() const {
+  return protocol::rawReader(encoding_,
+                             reinterpret_cast<const uint8_t*>(raw_.data()),
+                             static_cast<uint32_t>(raw_.size()));
+}
+}
+}
+} // apache::thrift::protocol
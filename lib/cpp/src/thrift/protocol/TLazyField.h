@@ -0,0 +1,187 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TLAZYFIELD_H_
+#define _THRIFT_PROTOCOL_TLAZYFIELD_H_ 1
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <thrift/TToString.h>
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/protocol/TRawValue.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * The serialized form kept by a TLazyField, and the code that captures,
+ * decodes and re-emits it, which does not depend on the field's type.
+ */
+class TLazyFieldBase {
+public:
+  /**
+   * Returns true if the value is still held serialized, and has not been
+   * decoded since it was read.
+   */
+  bool isSerialized() const { return encoding_ != T_RAW_NONE; }
+
+protected:
+  TLazyFieldBase() : encoding_(T_RAW_NONE) {}
+
+  /**
+   * Moves the next value, of the given type, from iprot into raw_, if iprot
+   * has a raw encoding and its transport has the whole value buffered.
+   * Returns false, having read nothing, otherwise.
+   */
+  bool capture(TProtocol* iprot, TType type, uint32_t& xfer);
+
+  /**
+   * Writes raw_ to oprot and returns true, if oprot uses the encoding raw_
+   * is in. Returns false, having written nothing, otherwise.
+   */
+  bool replay(TProtocol* oprot, uint32_t& xfer) const;
+
+  /**
+   * Returns a protocol that reads raw_.
+   */
+  std::shared_ptr<TProtocol> rawReader() const;
+
+  void clearRaw() const {
+    std::string().swap(raw_);
+    encoding_ = T_RAW_NONE;
+  }
+
+  mutable std::string raw_;
+  mutable TRawEncoding encoding_;
+};
+
+/**
+ * Holds a field declared with the cpp.lazy annotation.
+ *
+ * When read from a TBinaryProtocol or TCompactProtocol (see rawEncoding()),
+ * the field keeps the serialized bytes of its value rather than decoding
+ * them, and decodes them the first time the value is accessed. If it is
+ * written before then, to a protocol of the same kind, the bytes are written
+ * back as they were read. This saves decoding and re-encoding values that
+ * are passed on without being looked at. Other protocols read the value as
+ * usual.
+ *
+ * As get() may decode the value, a TLazyField is not safe to access from
+ * several threads at once, even through const references.
+ */
+template <class T>
+class TLazyField : public TLazyFieldBase {
+public:
+  typedef uint32_t (*Reader)(TProtocol* iprot, T& value);
+  typedef uint32_t (*Writer)(TProtocol* oprot, const T& value);
+
+  TLazyField() : value_(), reader_(nullptr) {}
+
+  TLazyField(const T& value) : value_(value), reader_(nullptr) {}
+
+  TLazyField(T&& value) : value_(std::move(value)), reader_(nullptr) {}
+
+  TLazyField& operator=(const T& value) {
+    value_ = value;
+    clearRaw();
+    return *this;
+  }
+
+  TLazyField& operator=(T&& value) {
+    value_ = std::move(value);
+    clearRaw();
+    return *this;
+  }
+
+  /**
+   * Returns the value, decoding it if needed.
+   */
+  const T& get() const {
+    if (isSerialized()) {
+      decode();
+    }
+    return value_;
+  }
+
+  /**
+   * Returns the value for modification. Its serialized form is dropped.
+   */
+  T& mutate() {
+    get();
+    return value_;
+  }
+
+  operator const T&() const { return get(); }
+
+  const T* operator->() const { return &get(); }
+
+  /**
+   * Reads the value with reader, or keeps it serialized.
+   */
+  uint32_t read(TProtocol* iprot, TType type, Reader reader) {
+    uint32_t xfer;
+    if (capture(iprot, type, xfer)) {
+      value_ = T();
+      reader_ = reader;
+      return xfer;
+    }
+    clearRaw();
+    return reader(iprot, value_);
+  }
+
+  /**
+   * Writes the serialized value if it is still held and oprot can take it,
+   * and the value with writer otherwise.
+   */
+  uint32_t write(TProtocol* oprot, Writer writer) const {
+    uint32_t xfer;
+    if (isSerialized() && replay(oprot, xfer)) {
+      return xfer;
+    }
+    return writer(oprot, get());
+  }
+
+  bool operator==(const TLazyField& rhs) const { return get() == rhs.get(); }
+
+  bool operator!=(const TLazyField& rhs) const { return !(*this == rhs); }
+
+private:
+  void decode() const {
+    std::shared_ptr<TProtocol> iprot = rawReader();
+    reader_(iprot.get(), value_);
+    clearRaw();
+  }
+
+  mutable T value_;
+  Reader reader_;
+};
+
+template <class T>
+std::string to_string(const TLazyField<T>& field) {
+  using ::apache::thrift::to_string;
+  return to_string(field.get());
+}
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TLAZYFIELD_H_ 1
@@ -0,0 +1,103 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TRawValue.h>
+
+#include <typeinfo>
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+namespace {
+
+// Wraps size bytes at buf, which the caller keeps alive, in a transport
+// that refuses to read past them
+std::shared_ptr<TMemoryBuffer> wrap(const uint8_t* buf,
+                                    uint32_t size,
+                                    const std::shared_ptr<TConfiguration>& config) {
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer(const_cast<uint8_t*>(buf), size, TMemoryBuffer::OBSERVE, config));
+  buffer->updateKnownMessageSize(size);
+  return buffer;
+}
+}
+
+TRawEncoding rawEncoding(TProtocol* prot) {
+  const std::type_info& type = typeid(*prot);
+  if (type == typeid(TBinaryProtocol) || type == typeid(TBinaryProtocolT<TMemoryBuffer>)) {
+    return T_RAW_BINARY;
+  } else if (type == typeid(TCompactProtocol)
+             || type == typeid(TCompactProtocolT<TMemoryBuffer>)) {
+    return T_RAW_COMPACT;
+  }
+  return T_RAW_NONE;
+}
+
+const uint8_t* borrowRawValue(TProtocol* iprot, TType type, uint32_t& size) {
+  TRawEncoding encoding = rawEncoding(iprot);
+  if (encoding == T_RAW_NONE) {
+    return nullptr;
+  }
+
+  TTransport* trans = iprot->getInputTransport().get();
+  uint32_t available = 1;
+  const uint8_t* buf = trans->borrow(nullptr, &available);
+  if (buf == nullptr) {
+    return nullptr;
+  }
+
+  // Find the end of the value by skipping it in the buffered bytes
+  std::shared_ptr<TMemoryBuffer> view = wrap(buf, available, trans->getConfiguration());
+  try {
+    if (encoding == T_RAW_BINARY) {
+      size = TBinaryProtocolT<TMemoryBuffer>(view).skip(type);
+    } else {
+      size = TCompactProtocolT<TMemoryBuffer>(view).skip(type);
+    }
+  } catch (const TTransportException& e) {
+    if (e.getType() == TTransportException::END_OF_FILE) {
+      // Not all of the value is buffered
+      return nullptr;
+    }
+    throw;
+  }
+  return buf;
+}
+
+std::shared_ptr<TProtocol> rawReader(TRawEncoding encoding, const uint8_t* buf, uint32_t size) {
+  std::shared_ptr<TMemoryBuffer> buffer = wrap(buf, size, nullptr);
+  if (encoding == T_RAW_BINARY) {
+    return std::make_shared<TBinaryProtocolT<TMemoryBuffer> >(buffer);
+  } else if (encoding == T_RAW_COMPACT) {
+    return std::make_shared<TCompactProtocolT<TMemoryBuffer> >(buffer);
+  }
+  throw TProtocolException(TProtocolException::NOT_IMPLEMENTED, "No raw encoding");
+}
+}
+}
+} // apache::thrift::protocol
@@ -0,0 +1,62 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TRAWVALUE_H_
+#define _THRIFT_PROTOCOL_TRAWVALUE_H_ 1
+
+#include <memory>
+
+#include <thrift/protocol/TProtocol.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Encodings whose values can be moved between protocols as the bytes they
+ * were read as, because their output does not depend on what was written
+ * before.
+ */
+enum TRawEncoding { T_RAW_NONE, T_RAW_BINARY, T_RAW_COMPACT };
+
+/**
+ * Returns the encoding prot reads and writes, if it is a TBinaryProtocol or
+ * TCompactProtocol, or their TMemoryBuffer instantiations, and T_RAW_NONE
+ * otherwise.
+ */
+TRawEncoding rawEncoding(TProtocol* prot);
+
+/**
+ * Returns the serialized bytes of the next value, of the given type, that
+ * iprot would read, and sets size to their length, if its transport has the
+ * whole value buffered. The bytes are not consumed. Returns nullptr if iprot
+ * has no raw encoding or the value is not all buffered.
+ */
+const uint8_t* borrowRawValue(TProtocol* iprot, TType type, uint32_t& size);
+
+/**
+ * Returns a protocol that reads size bytes at buf, in the given encoding.
+ * The caller keeps buf alive while the protocol is in use.
+ */
+std::shared_ptr<TProtocol> rawReader(TRawEncoding encoding, const uint8_t* buf, uint32_t size);
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TRAWVALUE_H_ 1
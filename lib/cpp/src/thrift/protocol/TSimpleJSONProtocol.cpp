@@ -0,0 +1,854 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TSimpleJSONProtocol.h>
+
+#include <cerrno>
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <thrift/protocol/TBase64Utils.h>
+#include <thrift/transport/TTransportException.h>
+
+using namespace apache::thrift::transport;
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+static const uint8_t kJSONObjectStart = '{';
+static const uint8_t kJSONObjectEnd = '}';
+static const uint8_t kJSONArrayStart = '[';
+static const uint8_t kJSONArrayEnd = ']';
+static const uint8_t kJSONPairSeparator = ':';
+static const uint8_t kJSONElemSeparator = ',';
+static const uint8_t kJSONStringDelimiter = '"';
+
+static const std::string kThriftNan("NaN");
+static const std::string kThriftInfinity("Infinity");
+static const std::string kThriftNegativeInfinity("-Infinity");
+
+static bool isJSONNumeric(uint8_t ch) {
+  return (ch >= '0' && ch <= '9') || ch == '+' || ch == '-' || ch == '.' || ch == 'E'
+         || ch == 'e';
+}
+
+static uint8_t hexVal(uint8_t ch) {
+  if ((ch >= '0') && (ch <= '9')) {
+    return ch - '0';
+  } else if ((ch >= 'a') && (ch <= 'f')) {
+    return ch - 'a' + 10;
+  } else if ((ch >= 'A') && (ch <= 'F')) {
+    return ch - 'A' + 10;
+  }
+  throw TProtocolException(TProtocolException::INVALID_DATA,
+                           "Expected hex val ([0-9a-fA-F]); got '" + std::string((char*)&ch, 1)
+                           + "'.");
+}
+
+static void appendUTF8(std::string& str, uint32_t cp) {
+  if (cp < 0x80) {
+    str += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    str += static_cast<char>(0xC0 | (cp >> 6));
+    str += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    str += static_cast<char>(0xE0 | (cp >> 12));
+    str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    str += static_cast<char>(0xF0 | (cp >> 18));
+    str += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+TSimpleJSONProtocol::TSimpleJSONProtocol(std::shared_ptr<TTransport> ptrans)
+  : TVirtualProtocol<TSimpleJSONProtocol>(ptrans),
+    trans_(ptrans.get()),
+    pos_(0),
+    hasPeeked_(false),
+    peeked_(0),
+    parsed_(0) {
+  contexts_.push_back(Context(Context::BASE));
+}
+
+TSimpleJSONProtocol::~TSimpleJSONProtocol() = default;
+
+/**
+ * Writing functions
+ */
+
+// Writes the separator that precedes a value in the current context, and
+// tells whether a number must be quoted because it is a map key.
+uint32_t TSimpleJSONProtocol::writeValuePrefix(bool& quoteNumber, bool container) {
+  Context& c = contexts_.back();
+  uint8_t separator = 0;
+  quoteNumber = false;
+  switch (c.kind) {
+  case Context::LIST:
+    if (!c.first) {
+      separator = kJSONElemSeparator;
+    }
+    c.first = false;
+    break;
+  case Context::MAP:
+    if (c.key) {
+      if (container) {
+        throw TProtocolException(TProtocolException::INVALID_DATA,
+                                 "Map keys must be strings, numbers, bools or enums");
+      }
+      if (!c.first) {
+        separator = kJSONElemSeparator;
+      }
+      c.first = false;
+      quoteNumber = true;
+    } else {
+      separator = kJSONPairSeparator;
+    }
+    c.key = !c.key;
+    break;
+  default:
+    // At the top level, or a struct field whose name is already written
+    break;
+  }
+  if (separator == 0) {
+    return 0;
+  }
+  trans_->write(&separator, 1);
+  return 1;
+}
+
+uint32_t TSimpleJSONProtocol::writeContainerBegin(uint8_t ch, Context::Kind kind) {
+  bool quoteNumber;
+  uint32_t result = writeValuePrefix(quoteNumber, true);
+  trans_->write(&ch, 1);
+  contexts_.push_back(Context(kind));
+  return result + 1;
+}
+
+uint32_t TSimpleJSONProtocol::writeContainerEnd(uint8_t ch) {
+  trans_->write(&ch, 1);
+  if (contexts_.size() > 1) {
+    contexts_.pop_back();
+  }
+  return 1;
+}
+
+// Writes str as a JSON string, escaping '"', '\\' and control characters
+uint32_t TSimpleJSONProtocol::writeJSONString(const char* str, size_t len) {
+  trans_->write(&kJSONStringDelimiter, 1);
+  uint32_t result = 2;
+  size_t start = 0;
+  for (size_t i = 0; i < len; ++i) {
+    auto ch = static_cast<uint8_t>(str[i]);
+    if (ch >= 0x20 && ch != '"' && ch != '\\') {
+      continue;
+    }
+    trans_->write((const uint8_t*)str + start, static_cast<uint32_t>(i - start));
+    char escape[8];
+    int escapeLen;
+    switch (ch) {
+    case '"':
+    case '\\':
+      escape[0] = '\\';
+      escape[1] = static_cast<char>(ch);
+      escapeLen = 2;
+      break;
+    case '\b':
+      escapeLen = snprintf(escape, sizeof(escape), "\\b");
+      break;
+    case '\f':
+      escapeLen = snprintf(escape, sizeof(escape), "\\f");
+      break;
+    case '\n':
+      escapeLen = snprintf(escape, sizeof(escape), "\\n");
+      break;
+    case '\r':
+      escapeLen = snprintf(escape, sizeof(escape), "\\r");
+      break;
+    case '\t':
+      escapeLen = snprintf(escape, sizeof(escape), "\\t");
+      break;
+    default:
+      escapeLen = snprintf(escape, sizeof(escape), "\\u%04x", ch);
+      break;
+    }
+    trans_->write((const uint8_t*)escape, static_cast<uint32_t>(escapeLen));
+    result += static_cast<uint32_t>(i - start + escapeLen);
+    start = i + 1;
+  }
+  trans_->write((const uint8_t*)str + start, static_cast<uint32_t>(len - start));
+  trans_->write(&kJSONStringDelimiter, 1);
+  return result + static_cast<uint32_t>(len - start);
+}
+
+template <typename NumberType>
+uint32_t TSimpleJSONProtocol::writeJSONInteger(NumberType num) {
+  bool quoteNumber;
+  uint32_t result = writeValuePrefix(quoteNumber, false);
+  char buf[24];
+  int len = snprintf(buf, sizeof(buf), quoteNumber ? "\"%lld\"" : "%lld", (long long)num);
+  trans_->write((const uint8_t*)buf, static_cast<uint32_t>(len));
+  return result + static_cast<uint32_t>(len);
+}
+
+uint32_t TSimpleJSONProtocol::writeMessageBegin(const std::string& name,
+                                                const TMessageType messageType,
+                                                const int32_t seqid) {
+  uint32_t result = writeContainerBegin(kJSONArrayStart, Context::LIST);
+  result += writeString(name);
+  result += writeI32(messageType);
+  result += writeI32(seqid);
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::writeMessageEnd() {
+  return writeContainerEnd(kJSONArrayEnd);
+}
+
+uint32_t TSimpleJSONProtocol::writeStructBegin(const char* name) {
+  (void)name;
+  return writeContainerBegin(kJSONObjectStart, Context::STRUCT);
+}
+
+uint32_t TSimpleJSONProtocol::writeStructEnd() {
+  return writeContainerEnd(kJSONObjectEnd);
+}
+
+uint32_t TSimpleJSONProtocol::writeFieldBegin(const char* name,
+                                              const TType fieldType,
+                                              const int16_t fieldId) {
+  (void)fieldType;
+  (void)fieldId;
+  Context& c = contexts_.back();
+  uint32_t result = 0;
+  if (!c.first) {
+    trans_->write(&kJSONElemSeparator, 1);
+    ++result;
+  }
+  c.first = false;
+  result += writeJSONString(name, strlen(name));
+  trans_->write(&kJSONPairSeparator, 1);
+  return result + 1;
+}
+
+uint32_t TSimpleJSONProtocol::writeFieldEnd() {
+  return 0;
+}
+
+uint32_t TSimpleJSONProtocol::writeFieldStop() {
+  return 0;
+}
+
+uint32_t TSimpleJSONProtocol::writeMapBegin(const TType keyType,
+                                            const TType valType,
+                                            const uint32_t size) {
+  (void)keyType;
+  (void)valType;
+  (void)size;
+  return writeContainerBegin(kJSONObjectStart, Context::MAP);
+}
+
+uint32_t TSimpleJSONProtocol::writeMapEnd() {
+  return writeContainerEnd(kJSONObjectEnd);
+}
+
+uint32_t TSimpleJSONProtocol::writeListBegin(const TType elemType, const uint32_t size) {
+  (void)elemType;
+  (void)size;
+  return writeContainerBegin(kJSONArrayStart, Context::LIST);
+}
+
+uint32_t TSimpleJSONProtocol::writeListEnd() {
+  return writeContainerEnd(kJSONArrayEnd);
+}
+
+uint32_t TSimpleJSONProtocol::writeSetBegin(const TType elemType, const uint32_t size) {
+  (void)elemType;
+  (void)size;
+  return writeContainerBegin(kJSONArrayStart, Context::LIST);
+}
+
+uint32_t TSimpleJSONProtocol::writeSetEnd() {
+  return writeContainerEnd(kJSONArrayEnd);
+}
+
+uint32_t TSimpleJSONProtocol::writeBool(const bool value) {
+  bool quoteNumber;
+  uint32_t result = writeValuePrefix(quoteNumber, false);
+  const char* text = quoteNumber ? (value ? "\"true\"" : "\"false\"") : (value ? "true" : "false");
+  auto len = static_cast<uint32_t>(strlen(text));
+  trans_->write((const uint8_t*)text, len);
+  return result + len;
+}
+
+uint32_t TSimpleJSONProtocol::writeByte(const int8_t byte) {
+  return writeJSONInteger(byte);
+}
+
+uint32_t TSimpleJSONProtocol::writeI16(const int16_t i16) {
+  return writeJSONInteger(i16);
+}
+
+uint32_t TSimpleJSONProtocol::writeI32(const int32_t i32) {
+  return writeJSONInteger(i32);
+}
+
+uint32_t TSimpleJSONProtocol::writeI64(const int64_t i64) {
+  return writeJSONInteger(i64);
+}
+
+uint32_t TSimpleJSONProtocol::writeDouble(const double dub) {
+  bool quoteNumber;
+  uint32_t result = writeValuePrefix(quoteNumber, false);
+  if (std::isnan(dub)) {
+    return result + writeJSONString(kThriftNan.data(), kThriftNan.size());
+  } else if (std::isinf(dub)) {
+    const std::string& text = dub > 0 ? kThriftInfinity : kThriftNegativeInfinity;
+    return result + writeJSONString(text.data(), text.size());
+  }
+
+  char buf[40];
+  int len = snprintf(buf + 1, sizeof(buf) - 2, "%.17g", dub);
+  // The C library uses the decimal point of the current locale
+  char point = localeconv()->decimal_point[0];
+  if (point != '.') {
+    char* p = strchr(buf + 1, point);
+    if (p != nullptr) {
+      *p = '.';
+    }
+  }
+  char* start = buf + 1;
+  if (quoteNumber) {
+    buf[0] = '"';
+    buf[len + 1] = '"';
+    start = buf;
+    len += 2;
+  }
+  trans_->write((const uint8_t*)start, static_cast<uint32_t>(len));
+  return result + static_cast<uint32_t>(len);
+}
+
+uint32_t TSimpleJSONProtocol::writeString(const std::string& str) {
+  bool quoteNumber;
+  uint32_t result = writeValuePrefix(quoteNumber, false);
+  return result + writeJSONString(str.data(), str.size());
+}
+
+uint32_t TSimpleJSONProtocol::writeBinary(const std::string& str) {
+  bool quoteNumber;
+  uint32_t result = writeValuePrefix(quoteNumber, false);
+  std::string encoded;
+  encoded.reserve((str.size() + 2) / 3 * 4);
+  const auto* bytes = (const uint8_t*)str.data();
+  size_t len = str.size();
+  uint8_t b[4];
+  while (len > 0) {
+    auto n = static_cast<uint32_t>(len < 3 ? len : 3);
+    base64_encode(bytes, n, b);
+    encoded.append((const char*)b, n + 1);
+    bytes += n;
+    len -= n;
+  }
+  return result + writeJSONString(encoded.data(), encoded.size());
+}
+
+/**
+ * Reading functions
+ */
+
+uint8_t TSimpleJSONProtocol::nextChar() {
+  if (hasPeeked_) {
+    hasPeeked_ = false;
+    return peeked_;
+  }
+  uint8_t ch;
+  trans_->readAll(&ch, 1);
+  ++parsed_;
+  return ch;
+}
+
+uint8_t TSimpleJSONProtocol::nextNonSpace() {
+  uint8_t ch;
+  do {
+    ch = nextChar();
+  } while (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n');
+  return ch;
+}
+
+// Reads one JSON value from the transport and appends its tokens
+void TSimpleJSONProtocol::parseValue(uint32_t depth) {
+  if (depth > getRecursionLimit()) {
+    throw TProtocolException(TProtocolException::DEPTH_LIMIT);
+  }
+  uint8_t ch = nextNonSpace();
+  size_t index = tokens_.size();
+  Token token = {Token::OBJECT, 0, 0, 0, 0};
+  if (ch == kJSONObjectStart || ch == kJSONArrayStart) {
+    bool object = (ch == kJSONObjectStart);
+    uint8_t close = object ? kJSONObjectEnd : kJSONArrayEnd;
+    token.kind = object ? Token::OBJECT : Token::ARRAY;
+    tokens_.push_back(token);
+    uint32_t count = 0;
+    ch = nextNonSpace();
+    while (ch != close) {
+      if (count > 0) {
+        if (ch != kJSONElemSeparator) {
+          throw TProtocolException(TProtocolException::INVALID_DATA,
+                                   "Expected ',' or '" + std::string((char*)&close, 1) + "'");
+        }
+        ch = nextNonSpace();
+      }
+      if (object) {
+        if (ch != kJSONStringDelimiter) {
+          throw TProtocolException(TProtocolException::INVALID_DATA,
+                                   "Expected JSON object member name");
+        }
+        parseString();
+        if (nextNonSpace() != kJSONPairSeparator) {
+          throw TProtocolException(TProtocolException::INVALID_DATA, "Expected ':'");
+        }
+      } else {
+        hasPeeked_ = true;
+        peeked_ = ch;
+      }
+      parseValue(depth + 1);
+      ++count;
+      ch = nextNonSpace();
+    }
+    tokens_[index].count = count;
+  } else if (ch == kJSONStringDelimiter) {
+    parseString();
+  } else if (isJSONNumeric(ch)) {
+    parseNumber(ch);
+  } else {
+    parseLiteral(ch);
+  }
+  tokens_[index].end = static_cast<uint32_t>(tokens_.size());
+}
+
+// Decodes the four hex digits of a \u escape
+uint16_t TSimpleJSONProtocol::parseEscapedCodeUnit() {
+  uint16_t cp = 0;
+  for (int i = 0; i < 4; ++i) {
+    cp = static_cast<uint16_t>((cp << 4) | hexVal(nextChar()));
+  }
+  return cp;
+}
+
+// Reads the rest of a JSON string, whose opening quote has been read
+void TSimpleJSONProtocol::parseString() {
+  Token token = {Token::STRING, 0, 0, static_cast<uint32_t>(text_.size()), 0};
+  token.end = static_cast<uint32_t>(tokens_.size() + 1);
+  while (true) {
+    uint8_t ch = nextChar();
+    if (ch == kJSONStringDelimiter) {
+      break;
+    }
+    if (ch != '\\') {
+      text_ += static_cast<char>(ch);
+      continue;
+    }
+    ch = nextChar();
+    switch (ch) {
+    case '"':
+    case '\\':
+    case '/':
+      text_ += static_cast<char>(ch);
+      break;
+    case 'b':
+      text_ += '\b';
+      break;
+    case 'f':
+      text_ += '\f';
+      break;
+    case 'n':
+      text_ += '\n';
+      break;
+    case 'r':
+      text_ += '\r';
+      break;
+    case 't':
+      text_ += '\t';
+      break;
+    case 'u': {
+      uint32_t cp = parseEscapedCodeUnit();
+      if (cp >= 0xDC00 && cp <= 0xDFFF) {
+        throw TProtocolException(TProtocolException::INVALID_DATA,
+                                 "Missing UTF-16 high surrogate pair.");
+      }
+      if (cp >= 0xD800 && cp <= 0xDBFF) {
+        if (nextChar() != '\\' || nextChar() != 'u') {
+          throw TProtocolException(TProtocolException::INVALID_DATA,
+                                   "Missing UTF-16 low surrogate pair.");
+        }
+        uint32_t low = parseEscapedCodeUnit();
+        if (low < 0xDC00 || low > 0xDFFF) {
+          throw TProtocolException(TProtocolException::INVALID_DATA,
+                                   "Missing UTF-16 low surrogate pair.");
+        }
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+      }
+      appendUTF8(text_, cp);
+      break;
+    }
+    default:
+      throw TProtocolException(TProtocolException::INVALID_DATA,
+                               "Expected control char, got '" + std::string((char*)&ch, 1)
+                               + "'.");
+    }
+  }
+  token.length = static_cast<uint32_t>(text_.size() - token.offset);
+  tokens_.push_back(token);
+}
+
+void TSimpleJSONProtocol::parseNumber(uint8_t first) {
+  Token token = {Token::NUMBER, 0, 0, static_cast<uint32_t>(text_.size()), 0};
+  token.end = static_cast<uint32_t>(tokens_.size() + 1);
+  uint8_t ch = first;
+  do {
+    text_ += static_cast<char>(ch);
+    ch = nextChar();
+  } while (isJSONNumeric(ch));
+  // The number ended one character early; keep that character
+  hasPeeked_ = true;
+  peeked_ = ch;
+  token.length = static_cast<uint32_t>(text_.size() - token.offset);
+  tokens_.push_back(token);
+}
+
+void TSimpleJSONProtocol::parseLiteral(uint8_t first) {
+  const char* rest;
+  Token token = {Token::LITERAL_NULL, 0, 0, 0, 0};
+  switch (first) {
+  case 't':
+    token.kind = Token::LITERAL_TRUE;
+    rest = "rue";
+    break;
+  case 'f':
+    token.kind = Token::LITERAL_FALSE;
+    rest = "alse";
+    break;
+  case 'n':
+    rest = "ull";
+    break;
+  default:
+    throw TProtocolException(TProtocolException::INVALID_DATA,
+                             "Unexpected character '" + std::string((char*)&first, 1) + "'");
+  }
+  for (; *rest != '\0'; ++rest) {
+    if (nextChar() != static_cast<uint8_t>(*rest)) {
+      throw TProtocolException(TProtocolException::INVALID_DATA, "Invalid JSON literal");
+    }
+  }
+  token.end = static_cast<uint32_t>(tokens_.size() + 1);
+  tokens_.push_back(token);
+}
+
+// Returns the next token, reading the next value from the transport once
+// the current one has been used up.
+const TSimpleJSONProtocol::Token& TSimpleJSONProtocol::nextToken(uint32_t& result) {
+  if (pos_ >= tokens_.size()) {
+    tokens_.clear();
+    text_.clear();
+    remaining_.clear();
+    pos_ = 0;
+    parsed_ = 0;
+    parseValue(0);
+    result += parsed_;
+  }
+  return tokens_[pos_];
+}
+
+const TSimpleJSONProtocol::Token& TSimpleJSONProtocol::expectToken(Token::Kind kind,
+                                                                   const char* what,
+                                                                   uint32_t& result) {
+  const Token& token = nextToken(result);
+  if (token.kind != kind) {
+    throw TProtocolException(TProtocolException::INVALID_DATA,
+                             std::string("Expected JSON ") + what);
+  }
+  return token;
+}
+
+std::string TSimpleJSONProtocol::tokenText(const Token& token) const {
+  return text_.substr(token.offset, token.length);
+}
+
+// Reads a number, or a string holding one as map keys do
+template <typename NumberType>
+uint32_t TSimpleJSONProtocol::readJSONInteger(NumberType& num) {
+  uint32_t result = 0;
+  const Token& token = nextToken(result);
+  if (token.kind != Token::NUMBER && token.kind != Token::STRING) {
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Expected JSON number");
+  }
+  std::string text = tokenText(token);
+  ++pos_;
+  char* end = nullptr;
+  errno = 0;
+  long long value = strtoll(text.c_str(), &end, 10);
+  if (text.empty() || *end != '\0' || errno == ERANGE
+      || value < (long long)(std::numeric_limits<NumberType>::min)()
+      || value > (long long)(std::numeric_limits<NumberType>::max)()) {
+    throw TProtocolException(TProtocolException::INVALID_DATA,
+                             "Expected numeric value; got \"" + text + "\"");
+  }
+  num = static_cast<NumberType>(value);
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::readMessageBegin(std::string& name,
+                                               TMessageType& messageType,
+                                               int32_t& seqid) {
+  uint32_t result = 0;
+  expectToken(Token::ARRAY, "array", result);
+  ++pos_;
+  result += readString(name);
+  int32_t type;
+  result += readI32(type);
+  if (type < T_CALL || type > T_ONEWAY) {
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Invalid message type");
+  }
+  messageType = (TMessageType)type;
+  result += readI32(seqid);
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::readMessageEnd() {
+  return 0;
+}
+
+uint32_t TSimpleJSONProtocol::readStructBegin(std::string& name) {
+  uint32_t result = 0;
+  const Token& token = expectToken(Token::OBJECT, "object", result);
+  remaining_.push_back(token.count);
+  ++pos_;
+  name.clear();
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::readStructEnd() {
+  if (!remaining_.empty()) {
+    remaining_.pop_back();
+  }
+  return 0;
+}
+
+uint32_t TSimpleJSONProtocol::readFieldBegin(std::string& name,
+                                             TType& fieldType,
+                                             int16_t& fieldId) {
+  if (remaining_.empty()) {
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Not reading a struct");
+  }
+  fieldId = 0;
+  while (remaining_.back() > 0) {
+    --remaining_.back();
+    const Token& key = tokens_[pos_++];
+    if (tokens_[pos_].kind == Token::LITERAL_NULL) {
+      ++pos_;
+      continue;
+    }
+    name.assign(text_, key.offset, key.length);
+    fieldType = T_VOID;
+    return 0;
+  }
+  fieldType = T_STOP;
+  return 0;
+}
+
+uint32_t TSimpleJSONProtocol::readFieldEnd() {
+  return 0;
+}
+
+uint32_t TSimpleJSONProtocol::readMapBegin(TType& keyType, TType& valType, uint32_t& size) {
+  uint32_t result = 0;
+  const Token& token = expectToken(Token::OBJECT, "object", result);
+  keyType = T_STRING;
+  valType = T_VOID;
+  size = token.count;
+  ++pos_;
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::readMapEnd() {
+  return 0;
+}
+
+uint32_t TSimpleJSONProtocol::readListBegin(TType& elemType, uint32_t& size) {
+  uint32_t result = 0;
+  const Token& token = expectToken(Token::ARRAY, "array", result);
+  elemType = T_VOID;
+  size = token.count;
+  ++pos_;
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::readListEnd() {
+  return 0;
+}
+
+uint32_t TSimpleJSONProtocol::readSetBegin(TType& elemType, uint32_t& size) {
+  return readListBegin(elemType, size);
+}
+
+uint32_t TSimpleJSONProtocol::readSetEnd() {
+  return 0;
+}
+
+uint32_t TSimpleJSONProtocol::readBool(bool& value) {
+  uint32_t result = 0;
+  const Token& token = nextToken(result);
+  if (token.kind == Token::LITERAL_TRUE || token.kind == Token::LITERAL_FALSE) {
+    value = (token.kind == Token::LITERAL_TRUE);
+    ++pos_;
+    return result;
+  }
+  if (token.kind == Token::STRING) {
+    // a map key
+    std::string text = tokenText(token);
+    if (text == "true" || text == "false") {
+      value = (text == "true");
+      ++pos_;
+      return result;
+    }
+  }
+  int8_t num;
+  result += readJSONInteger(num);
+  if (num != 0 && num != 1) {
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Expected JSON bool");
+  }
+  value = (num == 1);
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::readByte(int8_t& byte) {
+  return readJSONInteger(byte);
+}
+
+uint32_t TSimpleJSONProtocol::readI16(int16_t& i16) {
+  return readJSONInteger(i16);
+}
+
+uint32_t TSimpleJSONProtocol::readI32(int32_t& i32) {
+  return readJSONInteger(i32);
+}
+
+uint32_t TSimpleJSONProtocol::readI64(int64_t& i64) {
+  return readJSONInteger(i64);
+}
+
+uint32_t TSimpleJSONProtocol::readDouble(double& dub) {
+  uint32_t result = 0;
+  const Token& token = nextToken(result);
+  if (token.kind != Token::NUMBER && token.kind != Token::STRING) {
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Expected JSON number");
+  }
+  std::string text = tokenText(token);
+  ++pos_;
+  if (text == kThriftNan) {
+    dub = std::numeric_limits<double>::quiet_NaN();
+    return result;
+  } else if (text == kThriftInfinity) {
+    dub = HUGE_VAL;
+    return result;
+  } else if (text == kThriftNegativeInfinity) {
+    dub = -HUGE_VAL;
+    return result;
+  }
+  // The C library uses the decimal point of the current locale
+  char point = localeconv()->decimal_point[0];
+  if (point != '.') {
+    size_t dot = text.find('.');
+    if (dot != std::string::npos) {
+      text[dot] = point;
+    }
+  }
+  char* end = nullptr;
+  dub = strtod(text.c_str(), &end);
+  if (text.empty() || *end != '\0') {
+    throw TProtocolException(TProtocolException::INVALID_DATA,
+                             "Expected numeric value; got \"" + text + "\"");
+  }
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::readString(std::string& str) {
+  uint32_t result = 0;
+  const Token& token = expectToken(Token::STRING, "string", result);
+  str.assign(text_, token.offset, token.length);
+  ++pos_;
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::readBinary(std::string& str) {
+  std::string encoded;
+  uint32_t result = readString(encoded);
+  auto* b = (uint8_t*)&encoded[0];
+  auto len = static_cast<uint32_t>(encoded.size());
+  // Ignore padding
+  while (len > 0 && b[len - 1] == '=') {
+    --len;
+  }
+  str.clear();
+  while (len >= 4) {
+    base64_decode(b, 4);
+    str.append((const char*)b, 3);
+    b += 4;
+    len -= 4;
+  }
+  if (len > 1) {
+    base64_decode(b, len);
+    str.append((const char*)b, len - 1);
+  }
+  return result;
+}
+
+uint32_t TSimpleJSONProtocol::skip(TType type) {
+  (void)type;
+  uint32_t result = 0;
+  const Token& token = nextToken(result);
+  pos_ = token.end;
+  return result;
+}
+
+int TSimpleJSONProtocol::getMinSerializedSize(TType type) {
+  switch (type) {
+  case T_STOP:
+  case T_VOID:
+    return 0;
+  case T_STRING:
+  case T_STRUCT:
+  case T_MAP:
+  case T_SET:
+  case T_LIST:
+    return 2; // "" {} []
+  default:
+    return 1;
+  }
+}
+}
+}
+} // apache::thrift::protocol
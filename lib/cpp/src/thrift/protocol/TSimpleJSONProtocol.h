@@ -0,0 +1,256 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TSIMPLEJSONPROTOCOL_H_
+#define _THRIFT_PROTOCOL_TSIMPLEJSONPROTOCOL_H_ 1
+
+#include <thrift/protocol/TVirtualProtocol.h>
+
+#include <string>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Human readable JSON protocol for Thrift.
+ *
+ * Unlike TJSONProtocol, values carry no type tags and structs are JSON
+ * objects keyed by field name, so the output is what a web client or any
+ * other JSON consumer expects:
+ *
+ * 1. Structs are JSON objects with one member per set field, named after
+ *    the field.
+ *
+ * 2. Integers are JSON numbers and bools are true or false. Doubles are JSON
+ *    numbers, except for the strings "NaN", "Infinity" and "-Infinity".
+ *
+ * 3. Strings are JSON strings and binary values are Base64 encoded strings.
+ *
+ * 4. Lists and sets are JSON arrays. Maps are JSON objects, so their keys
+ *    must be strings, numbers, bools or enums; the latter are written as
+ *    strings.
+ *
+ * 5. Messages are JSON arrays holding the name, type, sequence id and the
+ *    argument or result struct.
+ *
+ * A JSON object on the wire does not say which of its members is which
+ * field, so readFieldBegin() reports members by name, with field id 0 and
+ * type T_VOID. Code generated with the cpp:simple_json option looks the
+ * name up in its TFieldNameTable to obtain the id and type, as does
+ * TTableSerializer in its TStructDescriptor. Members with unknown names or
+ * null values are skipped. Each top-level value is read in full before it
+ * is handed out, which is how container sizes are known up front.
+ */
+class TSimpleJSONProtocol : public TVirtualProtocol<TSimpleJSONProtocol> {
+public:
+  TSimpleJSONProtocol(std::shared_ptr<TTransport> ptrans);
+
+  ~TSimpleJSONProtocol() override;
+
+  /**
+   * Writing functions.
+   */
+
+  uint32_t writeMessageBegin(const std::string& name,
+                             const TMessageType messageType,
+                             const int32_t seqid);
+
+  uint32_t writeMessageEnd();
+
+  uint32_t writeStructBegin(const char* name);
+
+  uint32_t writeStructEnd();
+
+  uint32_t writeFieldBegin(const char* name, const TType fieldType, const int16_t fieldId);
+
+  uint32_t writeFieldEnd();
+
+  uint32_t writeFieldStop();
+
+  uint32_t writeMapBegin(const TType keyType, const TType valType, const uint32_t size);
+
+  uint32_t writeMapEnd();
+
+  uint32_t writeListBegin(const TType elemType, const uint32_t size);
+
+  uint32_t writeListEnd();
+
+  uint32_t writeSetBegin(const TType elemType, const uint32_t size);
+
+  uint32_t writeSetEnd();
+
+  uint32_t writeBool(const bool value);
+
+  uint32_t writeByte(const int8_t byte);
+
+  uint32_t writeI16(const int16_t i16);
+
+  uint32_t writeI32(const int32_t i32);
+
+  uint32_t writeI64(const int64_t i64);
+
+  uint32_t writeDouble(const double dub);
+
+  uint32_t writeString(const std::string& str);
+
+  uint32_t writeBinary(const std::string& str);
+
+  /**
+   * Reading functions
+   */
+
+  uint32_t readMessageBegin(std::string& name, TMessageType& messageType, int32_t& seqid);
+
+  uint32_t readMessageEnd();
+
+  uint32_t readStructBegin(std::string& name);
+
+  uint32_t readStructEnd();
+
+  uint32_t readFieldBegin(std::string& name, TType& fieldType, int16_t& fieldId);
+
+  uint32_t readFieldEnd();
+
+  uint32_t readMapBegin(TType& keyType, TType& valType, uint32_t& size);
+
+  uint32_t readMapEnd();
+
+  uint32_t readListBegin(TType& elemType, uint32_t& size);
+
+  uint32_t readListEnd();
+
+  uint32_t readSetBegin(TType& elemType, uint32_t& size);
+
+  uint32_t readSetEnd();
+
+  uint32_t readBool(bool& value);
+
+  // Provide the default readBool() implementation for std::vector<bool>
+  using TVirtualProtocol<TSimpleJSONProtocol>::readBool;
+
+  uint32_t readByte(int8_t& byte);
+
+  uint32_t readI16(int16_t& i16);
+
+  uint32_t readI32(int32_t& i32);
+
+  uint32_t readI64(int64_t& i64);
+
+  uint32_t readDouble(double& dub);
+
+  uint32_t readString(std::string& str);
+
+  uint32_t readBinary(std::string& str);
+
+  /**
+   * Skips the next value whatever its type, which is all a JSON reader can
+   * do for a member it does not know.
+   */
+  uint32_t skip(TType type);
+
+  int getMinSerializedSize(TType type);
+
+private:
+  /**
+   * Writer nesting state: the top level, a struct, a map (whose keys and
+   * values alternate) or a list or set.
+   */
+  struct Context {
+    enum Kind { BASE, STRUCT, MAP, LIST };
+
+    Context(Kind k) : kind(k), first(true), key(true) {}
+
+    Kind kind;
+    bool first;
+    bool key;
+  };
+
+  /**
+   * One token of the value being read, in document order. Containers are
+   * followed by their elements and object members are preceded by their
+   * name as a STRING; end is the index just past a value's last token.
+   */
+  struct Token {
+    enum Kind { OBJECT, ARRAY, STRING, NUMBER, LITERAL_TRUE, LITERAL_FALSE, LITERAL_NULL };
+
+    Kind kind;
+    uint32_t count;  // members or elements of a container
+    uint32_t end;
+    uint32_t offset; // text of a string or number in text_
+    uint32_t length;
+  };
+
+  uint32_t writeValuePrefix(bool& quoteNumber, bool container);
+  uint32_t writeContainerBegin(uint8_t ch, Context::Kind kind);
+  uint32_t writeContainerEnd(uint8_t ch);
+  uint32_t writeJSONString(const char* str, size_t len);
+  template <typename NumberType>
+  uint32_t writeJSONInteger(NumberType num);
+
+  const Token& nextToken(uint32_t& result);
+  const Token& expectToken(Token::Kind kind, const char* what, uint32_t& result);
+  std::string tokenText(const Token& token) const;
+  template <typename NumberType>
+  uint32_t readJSONInteger(NumberType& num);
+
+  void parseValue(uint32_t depth);
+  void parseString();
+  void parseNumber(uint8_t first);
+  void parseLiteral(uint8_t first);
+  uint16_t parseEscapedCodeUnit();
+  uint8_t nextChar();
+  uint8_t nextNonSpace();
+
+  TTransport* trans_;
+
+  std::vector<Context> contexts_;
+
+  // The value being read, its text, and the position of the next token
+  std::vector<Token> tokens_;
+  std::string text_;
+  size_t pos_;
+  // Members of each struct being read that have not been read yet
+  std::vector<uint32_t> remaining_;
+  // One character of lookahead left over from parsing a number
+  bool hasPeeked_;
+  uint8_t peeked_;
+  // Bytes read from the transport for the value being parsed
+  uint32_t parsed_;
+};
+
+/**
+ * Constructs input and output protocol objects given transports.
+ */
+class TSimpleJSONProtocolFactory : public TProtocolFactory {
+public:
+  TSimpleJSONProtocolFactory() = default;
+
+  ~TSimpleJSONProtocolFactory() override = default;
+
+  std::shared_ptr<TProtocol> getProtocol(std::shared_ptr<TTransport> trans) override {
+    return std::shared_ptr<TProtocol>(new TSimpleJSONProtocol(trans));
+  }
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TSIMPLEJSONPROTOCOL_H_ 1
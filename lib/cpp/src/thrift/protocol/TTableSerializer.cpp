@@ -0,0 +1,346 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TTableSerializer.h>
+
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <typeinfo>
+#include <vector>
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+namespace {
+
+template <class Protocol_>
+uint32_t readStruct(Protocol_* iprot,
+                    const TStructDescriptor& desc,
+                    void* obj,
+                    const TFieldMask* mask);
+
+template <class Protocol_>
+uint32_t writeStruct(Protocol_* oprot, const TStructDescriptor& desc, const void* obj);
+
+// State passed through TContainerOps to the element callbacks
+template <class Protocol_>
+struct ElementContext {
+  Protocol_* prot;
+  const TTypeDescriptor* type;
+  // Mask of the structs held by the container, or nullptr to read them whole
+  const TFieldMask* mask;
+  uint32_t xfer;
+};
+
+template <class Protocol_>
+uint32_t readValue(Protocol_* iprot,
+                   const TTypeDescriptor& type,
+                   void* value,
+                   const TFieldMask* mask);
+
+template <class Protocol_>
+uint32_t writeValue(Protocol_* oprot, const TTypeDescriptor& type, const void* value);
+
+template <class Protocol_>
+void readElement(void* ctx, void* elem, bool value) {
+  auto* context = static_cast<ElementContext<Protocol_>*>(ctx);
+  const TTypeDescriptor& type = value ? *context->type->value : *context->type->elem;
+  // Map keys are read whole
+  const TFieldMask* mask = value || context->type->type != T_MAP ? context->mask : nullptr;
+  context->xfer += readValue(context->prot, type, elem, mask);
+}
+
+template <class Protocol_>
+void writeElement(void* ctx, const void* elem, bool value) {
+  auto* context = static_cast<ElementContext<Protocol_>*>(ctx);
+  const TTypeDescriptor& type = value ? *context->type->value : *context->type->elem;
+  context->xfer += writeValue(context->prot, type, elem);
+}
+
+template <class Protocol_>
+uint32_t readValue(Protocol_* iprot,
+                   const TTypeDescriptor& type,
+                   void* value,
+                   const TFieldMask* mask) {
+  switch (type.type) {
+  case T_BOOL:
+    return iprot->readBool(*static_cast<bool*>(value));
+  case T_BYTE:
+    return iprot->readByte(*static_cast<int8_t*>(value));
+  case T_I16:
+    return iprot->readI16(*static_cast<int16_t*>(value));
+  case T_I32: {
+    // Enums are T_I32 too, so the value is copied rather than aliased
+    int32_t i32;
+    uint32_t xfer = iprot->readI32(i32);
+    std::memcpy(value, &i32, sizeof(i32));
+    return xfer;
+  }
+  case T_I64:
+    return iprot->readI64(*static_cast<int64_t*>(value));
+  case T_DOUBLE:
+    return iprot->readDouble(*static_cast<double*>(value));
+  case T_STRING:
+    if (type.binary) {
+      return iprot->readBinary(*static_cast<std::string*>(value));
+    }
+    return iprot->readString(*static_cast<std::string*>(value));
+  case T_STRUCT:
+    return readStruct(iprot, *type.structType, value, mask);
+  case T_LIST: {
+    ElementContext<Protocol_> context = {iprot, &type, mask, 0};
+    TType elemType;
+    uint32_t size;
+    context.xfer += iprot->readListBegin(elemType, size);
+    type.ops->read(value, size, &readElement<Protocol_>, &context);
+    context.xfer += iprot->readListEnd();
+    return context.xfer;
+  }
+  case T_SET: {
+    ElementContext<Protocol_> context = {iprot, &type, mask, 0};
+    TType elemType;
+    uint32_t size;
+    context.xfer += iprot->readSetBegin(elemType, size);
+    type.ops->read(value, size, &readElement<Protocol_>, &context);
+    context.xfer += iprot->readSetEnd();
+    return context.xfer;
+  }
+  case T_MAP: {
+    ElementContext<Protocol_> context = {iprot, &type, mask, 0};
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    context.xfer += iprot->readMapBegin(keyType, valType, size);
+    type.ops->read(value, size, &readElement<Protocol_>, &context);
+    context.xfer += iprot->readMapEnd();
+    return context.xfer;
+  }
+  default:
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Invalid type descriptor");
+  }
+}
+
+template <class Protocol_>
+uint32_t writeValue(Protocol_* oprot, const TTypeDescriptor& type, const void* value) {
+  switch (type.type) {
+  case T_BOOL:
+    return oprot->writeBool(*static_cast<const bool*>(value));
+  case T_BYTE:
+    return oprot->writeByte(*static_cast<const int8_t*>(value));
+  case T_I16:
+    return oprot->writeI16(*static_cast<const int16_t*>(value));
+  case T_I32: {
+    int32_t i32;
+    std::memcpy(&i32, value, sizeof(i32));
+    return oprot->writeI32(i32);
+  }
+  case T_I64:
+    return oprot->writeI64(*static_cast<const int64_t*>(value));
+  case T_DOUBLE:
+    return oprot->writeDouble(*static_cast<const double*>(value));
+  case T_STRING:
+    if (type.binary) {
+      return oprot->writeBinary(*static_cast<const std::string*>(value));
+    }
+    return oprot->writeString(*static_cast<const std::string*>(value));
+  case T_STRUCT:
+    return writeStruct(oprot, *type.structType, value);
+  case T_LIST: {
+    ElementContext<Protocol_> context = {oprot, &type, nullptr, 0};
+    context.xfer += oprot->writeListBegin(type.elem->type, type.ops->size(value));
+    type.ops->write(value, &writeElement<Protocol_>, &context);
+    context.xfer += oprot->writeListEnd();
+    return context.xfer;
+  }
+  case T_SET: {
+    ElementContext<Protocol_> context = {oprot, &type, nullptr, 0};
+    context.xfer += oprot->writeSetBegin(type.elem->type, type.ops->size(value));
+    type.ops->write(value, &writeElement<Protocol_>, &context);
+    context.xfer += oprot->writeSetEnd();
+    return context.xfer;
+  }
+  case T_MAP: {
+    ElementContext<Protocol_> context = {oprot, &type, nullptr, 0};
+    context.xfer += oprot->writeMapBegin(type.elem->type, type.value->type, type.ops->size(value));
+    type.ops->write(value, &writeElement<Protocol_>, &context);
+    context.xfer += oprot->writeMapEnd();
+    return context.xfer;
+  }
+  default:
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Invalid type descriptor");
+  }
+}
+
+template <class Protocol_>
+uint32_t readStruct(Protocol_* iprot,
+                    const TStructDescriptor& desc,
+                    void* obj,
+                    const TFieldMask* mask) {
+  // Structs the interpreter cannot handle are read whole, mask or not
+  if (!desc.generic) {
+    return desc.read(iprot, obj);
+  }
+
+  TInputRecursionTracker tracker(*iprot);
+  uint32_t xfer = 0;
+  std::string fname;
+  TType ftype;
+  int16_t fid;
+
+  // Required fields read so far, by index; the vector is only needed for
+  // structs with more than 64 fields
+  uint64_t requiredRead = 0;
+  std::vector<bool> requiredReadMore;
+  // Fields usually arrive in id order, so the one after the last field read
+  // is tried before searching
+  uint32_t next = 0;
+
+  xfer += iprot->readStructBegin(fname);
+
+  while (true) {
+    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    if (ftype == T_STOP) {
+      break;
+    }
+    const TFieldDescriptor* field;
+    if (fid == 0 && ftype == T_VOID) {
+      // A protocol that identifies fields by name only
+      field = desc.findField(fname.c_str());
+      if (field != nullptr) {
+        ftype = field->type->type;
+      }
+    } else if (next < desc.fieldCount && desc.fields[next].id == fid) {
+      field = &desc.fields[next];
+    } else {
+      field = desc.findField(fid);
+    }
+
+    auto index = field != nullptr ? static_cast<uint32_t>(field - desc.fields) : 0;
+    if (field == nullptr || ftype != field->type->type
+        || (mask != nullptr && !mask->selected(index))) {
+      xfer += iprot->skip(ftype);
+    } else {
+      xfer += readValue(iprot,
+                        *field->type,
+                        TStructDescriptor::member(obj, *field),
+                        mask != nullptr ? mask->child(index) : nullptr);
+      if (field->requiredness != T_REQUIRED_FIELD) {
+        desc.setIsSet(obj, index, true);
+      } else if (index < 64) {
+        requiredRead |= uint64_t(1) << index;
+      } else {
+        requiredReadMore.resize(desc.fieldCount);
+        requiredReadMore[index] = true;
+      }
+      next = index + 1;
+    }
+    xfer += iprot->readFieldEnd();
+  }
+
+  xfer += iprot->readStructEnd();
+
+  for (uint32_t i = 0; i < desc.fieldCount; ++i) {
+    if (desc.fields[i].requiredness == T_REQUIRED_FIELD
+        && (mask == nullptr || mask->selected(i))) {
+      bool read = i < 64 ? (requiredRead & (uint64_t(1) << i)) != 0
+                         : i < requiredReadMore.size() && requiredReadMore[i];
+      if (!read) {
+        throw TProtocolException(TProtocolException::INVALID_DATA);
+      }
+    }
+  }
+  return xfer;
+}
+
+template <class Protocol_>
+uint32_t writeStruct(Protocol_* oprot, const TStructDescriptor& desc, const void* obj) {
+  if (!desc.generic) {
+    return desc.write(oprot, obj);
+  }
+
+  uint32_t xfer = 0;
+  TOutputRecursionTracker tracker(*oprot);
+  xfer += oprot->writeStructBegin(desc.name);
+
+  for (uint32_t i = 0; i < desc.fieldCount; ++i) {
+    const TFieldDescriptor& field = desc.fields[i];
+    const TTypeDescriptor& type = *field.type;
+    bool checkIfSet = field.requiredness == T_OPTIONAL_FIELD
+                      || (type.type == T_STRUCT && type.structType->exception);
+    if (checkIfSet && !desc.isSet(obj, i)) {
+      continue;
+    }
+    xfer += oprot->writeFieldBegin(field.name, type.type, field.id);
+    xfer += writeValue(oprot, type, TStructDescriptor::member(obj, field));
+    xfer += oprot->writeFieldEnd();
+  }
+
+  xfer += oprot->writeFieldStop();
+  xfer += oprot->writeStructEnd();
+  return xfer;
+}
+
+// Reads through the concrete class of iprot where the interpreter is
+// instantiated for it
+uint32_t readStructAs(TProtocol* iprot,
+                      const TStructDescriptor& desc,
+                      void* obj,
+                      const TFieldMask* mask) {
+  const std::type_info& type = typeid(*iprot);
+  if (type == typeid(TBinaryProtocol)) {
+    return readStruct(static_cast<TBinaryProtocol*>(iprot), desc, obj, mask);
+  } else if (type == typeid(TCompactProtocol)) {
+    return readStruct(static_cast<TCompactProtocol*>(iprot), desc, obj, mask);
+  }
+  return readStruct(iprot, desc, obj, mask);
+}
+}
+
+uint32_t TTableSerializer::read(TProtocol* iprot, const TStructDescriptor& desc, void* obj) {
+  return readStructAs(iprot, desc, obj, nullptr);
+}
+
+uint32_t TTableSerializer::readPartial(TProtocol* iprot,
+                                       const TStructDescriptor& desc,
+                                       const TFieldMask& mask,
+                                       void* obj) {
+  if (&mask.descriptor() != &desc) {
+    throw std::invalid_argument(std::string("Field mask of ") + mask.descriptor().name
+                                + " used to read " + desc.name);
+  }
+  return readStructAs(iprot, desc, obj, &mask);
+}
+
+uint32_t TTableSerializer::write(TProtocol* oprot, const TStructDescriptor& desc, const void* obj) {
+  const std::type_info& type = typeid(*oprot);
+  if (type == typeid(TBinaryProtocol)) {
+    return writeStruct(static_cast<TBinaryProtocol*>(oprot), desc, obj);
+  } else if (type == typeid(TCompactProtocol)) {
+    return writeStruct(static_cast<TCompactProtocol*>(oprot), desc, obj);
+  }
+  return writeStruct(oprot, desc, obj);
+}
+}
+}
+} // apache::thrift::protocol
@@ -0,0 +1,87 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TTABLESERIALIZER_H_
+#define _THRIFT_PROTOCOL_TTABLESERIALIZER_H_ 1
+
+#include <thrift/protocol/TFieldMask.h>
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/protocol/TTypeDescriptor.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Reads and writes generated structs by interpreting their
+ * TStructDescriptor, rather than through code generated for each struct.
+ * The result on the wire is the same as that of the generated read() and
+ * write() methods.
+ *
+ * Generated code calls this from read() and write() when the compiler is
+ * run with the cpp:table_driven option, which trades some speed for much
+ * smaller and faster to compile generated code. The interpreter is
+ * compiled once for TBinaryProtocol and TCompactProtocol, which it calls
+ * directly, and once for any other protocol, which it calls through
+ * TProtocol.
+ *
+ * Nested structs whose descriptors are not generic are handed to their own
+ * read() or write() method.
+ *
+ * readPartial() reads only the fields selected by a TFieldMask, and skips
+ * the rest. The generated readPartial() methods of classes compiled with
+ * the cpp:reflection option call it.
+ */
+class TTableSerializer {
+public:
+  static uint32_t read(TProtocol* iprot, const TStructDescriptor& desc, void* obj);
+
+  static uint32_t write(TProtocol* oprot, const TStructDescriptor& desc, const void* obj);
+
+  /**
+   * Reads the fields of obj selected by mask. Structs whose descriptors are
+   * not generic are read whole.
+   *
+   * \throws std::invalid_argument if mask is not a mask of desc
+   */
+  static uint32_t readPartial(TProtocol* iprot,
+                              const TStructDescriptor& desc,
+                              const TFieldMask& mask,
+                              void* obj);
+
+  template <class Struct_>
+  static uint32_t read(TProtocol* iprot, Struct_& obj) {
+    return read(iprot, Struct_::__descriptor, &obj);
+  }
+
+  template <class Struct_>
+  static uint32_t write(TProtocol* oprot, const Struct_& obj) {
+    return write(oprot, Struct_::__descriptor, &obj);
+  }
+
+  template <class Struct_>
+  static uint32_t readPartial(TProtocol* iprot, const TFieldMask& mask, Struct_& obj) {
+    return readPartial(iprot, Struct_::__descriptor, mask, &obj);
+  }
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TTABLESERIALIZER_H_ 1
@@ -0,0 +1,125 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TTracingProtocol.h>
+
+#include <thrift/transport/THeaderTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+using std::chrono::steady_clock;
+
+namespace {
+
+uint64_t toMicros(steady_clock::duration duration) {
+  int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  return micros > 0 ? static_cast<uint64_t>(micros) : 0;
+}
+}
+
+TTracingProtocol::TTracingProtocol(std::shared_ptr<TProtocol> protocol,
+                                   std::shared_ptr<TTracer> tracer)
+  : TProtocolDecorator(protocol), tracer_(tracer), pending_(false), oneway_(false) {}
+
+TTracingProtocol::~TTracingProtocol() {
+  if (pending_) {
+    finish(true);
+  }
+}
+
+uint32_t TTracingProtocol::writeMessageBegin_virt(const std::string& name,
+                                                  const TMessageType messageType,
+                                                  const int32_t seqid) {
+  if (messageType == T_CALL || messageType == T_ONEWAY) {
+    if (pending_) {
+      finish(true);
+    }
+    TTraceContext context = tracer_->startSpan(TTracer::current());
+    if (context.valid()) {
+      auto headers = std::dynamic_pointer_cast<transport::THeaderTransport>(getTransport());
+      if (headers) {
+        TTracer::inject(context, headers->getWriteHeaders());
+      }
+      span_ = TSpan();
+      span_.context = context;
+      span_.kind = T_SPAN_CLIENT;
+      span_.name = name;
+      span_.startMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now().time_since_epoch()).count();
+      oneway_ = messageType == T_ONEWAY;
+      start_ = steady_clock::now();
+      written_ = start_;
+      replied_ = start_;
+      pending_ = true;
+    }
+  }
+  return TProtocolDecorator::writeMessageBegin_virt(name, messageType, seqid);
+}
+
+uint32_t TTracingProtocol::writeMessageEnd_virt() {
+  uint32_t size = TProtocolDecorator::writeMessageEnd_virt();
+  if (pending_) {
+    written_ = steady_clock::now();
+    span_.serializeMicros = toMicros(written_ - start_);
+    replied_ = written_;
+    if (oneway_) {
+      finish(false);
+    }
+  }
+  return size;
+}
+
+uint32_t TTracingProtocol::readMessageBegin_virt(std::string& name,
+                                                 TMessageType& messageType,
+                                                 int32_t& seqid) {
+  uint32_t size = TProtocolDecorator::readMessageBegin_virt(name, messageType, seqid);
+  if (pending_) {
+    // The reply arrived by the time its first bytes have been read
+    replied_ = steady_clock::now();
+    span_.networkMicros = toMicros(replied_ - written_);
+    if (messageType == T_EXCEPTION) {
+      span_.error = true;
+    }
+  }
+  return size;
+}
+
+uint32_t TTracingProtocol::readMessageEnd_virt() {
+  uint32_t size = TProtocolDecorator::readMessageEnd_virt();
+  if (pending_) {
+    finish(span_.error);
+  }
+  return size;
+}
+
+void TTracingProtocol::finish(bool error) {
+  steady_clock::time_point now = steady_clock::now();
+  if (!oneway_ && replied_ != written_) {
+    span_.deserializeMicros = toMicros(now - replied_);
+  }
+  span_.durationMicros = toMicros(now - start_);
+  span_.error = error;
+  pending_ = false;
+  tracer_->record(std::move(span_));
+}
+}
+}
+} // apache::thrift::protocol
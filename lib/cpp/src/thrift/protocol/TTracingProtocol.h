@@ -0,0 +1,84 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TTRACINGPROTOCOL_H_
+#define _THRIFT_PROTOCOL_TTRACINGPROTOCOL_H_ 1
+
+#include <chrono>
+
+#include <thrift/TTracing.h>
+#include <thrift/protocol/TProtocolDecorator.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * A decorator that records, in a TTracer, a client span for each call made
+ * through it, as a child of the calling thread's current context (see
+ * TTracer::current()), so calls a traced handler makes join its trace.
+ *
+ * When the wrapped protocol is a THeaderProtocol, the span's ids are sent
+ * with the call as headers, for a server's processor::TTracingEventHandler
+ * to continue the trace:
+ *
+ * <blockquote><code>
+ *     shared_ptr<TProtocol> protocol(new THeaderProtocol(transport));
+ *     CalculatorClient client(std::make_shared<TTracingProtocol>(protocol, tracer));
+ * </code></blockquote>
+ *
+ * A client must use the same TTracingProtocol for its input and output, as
+ * a span is begun by writing a call and ended by reading its reply.
+ *
+ * A span ends when its reply has been read, or when its request has been
+ * written, for oneway calls. A call whose reply is never read, because the
+ * client threw, ends as an error when the next call starts.
+ */
+class TTracingProtocol : public TProtocolDecorator {
+public:
+  TTracingProtocol(std::shared_ptr<TProtocol> protocol, std::shared_ptr<TTracer> tracer);
+
+  ~TTracingProtocol() override;
+
+  uint32_t writeMessageBegin_virt(const std::string& name,
+                                  const TMessageType messageType,
+                                  const int32_t seqid) override;
+  uint32_t writeMessageEnd_virt() override;
+  uint32_t readMessageBegin_virt(std::string& name,
+                                 TMessageType& messageType,
+                                 int32_t& seqid) override;
+  uint32_t readMessageEnd_virt() override;
+
+private:
+  void finish(bool error);
+
+  std::shared_ptr<TTracer> tracer_;
+  /** Whether span_ is a call in progress. */
+  bool pending_;
+  bool oneway_;
+  TSpan span_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point written_;
+  std::chrono::steady_clock::time_point replied_;
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TTRACINGPROTOCOL_H_
@@ -0,0 +1,320 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TTYPEDESCRIPTOR_H_
+#define _THRIFT_PROTOCOL_TTYPEDESCRIPTOR_H_ 1
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <thrift/protocol/TEnum.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+class TProtocol;
+struct TStructDescriptor;
+
+/**
+ * Type erased access to the C++ container holding a list, set or map, for
+ * generic code that cannot name its type. The element callbacks are passed
+ * an element (or a map key, with value false) or a map value (with value
+ * true), and the ctx given by the caller.
+ */
+struct TContainerOps {
+  uint32_t (*size)(const void* container);
+  // Replaces the contents of container with size elements, or map entries,
+  // each filled in by calls to readElem
+  void (*read)(void* container,
+               uint32_t size,
+               void (*readElem)(void* ctx, void* elem, bool value),
+               void* ctx);
+  // Passes each element, or map entry, of container to writeElem, in order
+  void (*write)(const void* container,
+                void (*writeElem)(void* ctx, const void* elem, bool value),
+                void* ctx);
+};
+
+/**
+ * Describes a Thrift type: its wire type and, for containers and structs,
+ * the types it is made of. Typedefs are resolved, and enums are T_I32.
+ */
+struct TTypeDescriptor {
+  TType type;
+  // True for a T_STRING declared as binary
+  bool binary;
+  // Element type of a list or set, or key type of a map
+  const TTypeDescriptor* elem;
+  // Value type of a map
+  const TTypeDescriptor* value;
+  // The struct, for T_STRUCT
+  const TStructDescriptor* structType;
+  // Access to the C++ container, for T_LIST, T_SET and T_MAP. nullptr if
+  // the IDL gives the container a custom C++ type.
+  const TContainerOps* ops;
+};
+
+/**
+ * TContainerOps of a std::vector, or another container with the same
+ * interface, holding a list.
+ */
+template <class List_>
+struct TListOps {
+  static uint32_t size(const void* container) {
+    return static_cast<uint32_t>(static_cast<const List_*>(container)->size());
+  }
+
+  static void read(void* container,
+                   uint32_t size,
+                   void (*readElem)(void*, void*, bool),
+                   void* ctx) {
+    List_& list = *static_cast<List_*>(container);
+    list.clear();
+    list.resize(size);
+    for (auto& elem : list) {
+      readElem(ctx, &elem, false);
+    }
+  }
+
+  static void write(const void* container,
+                    void (*writeElem)(void*, const void*, bool),
+                    void* ctx) {
+    for (const auto& elem : *static_cast<const List_*>(container)) {
+      writeElem(ctx, &elem, false);
+    }
+  }
+
+  static const TContainerOps ops;
+};
+
+template <class List_>
+const TContainerOps TListOps<List_>::ops = {&size, &read, &write};
+
+/**
+ * std::vector<bool> has no bool elements to point at, so they are passed
+ * through a temporary.
+ */
+template <class Allocator_>
+struct TListOps<std::vector<bool, Allocator_> > {
+  typedef std::vector<bool, Allocator_> List_;
+
+  static uint32_t size(const void* container) {
+    return static_cast<uint32_t>(static_cast<const List_*>(container)->size());
+  }
+
+  static void read(void* container,
+                   uint32_t size,
+                   void (*readElem)(void*, void*, bool),
+                   void* ctx) {
+    List_& list = *static_cast<List_*>(container);
+    list.clear();
+    list.reserve(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      bool elem = false;
+      readElem(ctx, &elem, false);
+      list.push_back(elem);
+    }
+  }
+
+  static void write(const void* container,
+                    void (*writeElem)(void*, const void*, bool),
+                    void* ctx) {
+    for (bool elem : *static_cast<const List_*>(container)) {
+      writeElem(ctx, &elem, false);
+    }
+  }
+
+  static const TContainerOps ops;
+};
+
+template <class Allocator_>
+const TContainerOps TListOps<std::vector<bool, Allocator_> >::ops = {&size, &read, &write};
+
+/**
+ * TContainerOps of a std::set, or another container with the same
+ * interface, holding a set.
+ */
+template <class Set_>
+struct TSetOps {
+  static uint32_t size(const void* container) {
+    return static_cast<uint32_t>(static_cast<const Set_*>(container)->size());
+  }
+
+  static void read(void* container,
+                   uint32_t size,
+                   void (*readElem)(void*, void*, bool),
+                   void* ctx) {
+    Set_& set = *static_cast<Set_*>(container);
+    set.clear();
+    for (uint32_t i = 0; i < size; ++i) {
+      typename Set_::value_type elem;
+      readElem(ctx, &elem, false);
+      set.insert(std::move(elem));
+    }
+  }
+
+  static void write(const void* container,
+                    void (*writeElem)(void*, const void*, bool),
+                    void* ctx) {
+    for (const auto& elem : *static_cast<const Set_*>(container)) {
+      writeElem(ctx, &elem, false);
+    }
+  }
+
+  static const TContainerOps ops;
+};
+
+template <class Set_>
+const TContainerOps TSetOps<Set_>::ops = {&size, &read, &write};
+
+/**
+ * TContainerOps of a std::map, or another container with the same
+ * interface, holding a map.
+ */
+template <class Map_>
+struct TMapOps {
+  static uint32_t size(const void* container) {
+    return static_cast<uint32_t>(static_cast<const Map_*>(container)->size());
+  }
+
+  static void read(void* container,
+                   uint32_t size,
+                   void (*readElem)(void*, void*, bool),
+                   void* ctx) {
+    Map_& map = *static_cast<Map_*>(container);
+    map.clear();
+    for (uint32_t i = 0; i < size; ++i) {
+      typename Map_::key_type key;
+      readElem(ctx, &key, false);
+      readElem(ctx, &map[key], true);
+    }
+  }
+
+  static void write(const void* container,
+                    void (*writeElem)(void*, const void*, bool),
+                    void* ctx) {
+    for (const auto& entry : *static_cast<const Map_*>(container)) {
+      writeElem(ctx, &entry.first, false);
+      writeElem(ctx, &entry.second, true);
+    }
+  }
+
+  static const TContainerOps ops;
+};
+
+template <class Map_>
+const TContainerOps TMapOps<Map_>::ops = {&size, &read, &write};
+
+/**
+ * Requiredness of a field, as declared in the IDL.
+ */
+enum TFieldRequiredness { T_REQUIRED_FIELD, T_OPTIONAL_FIELD, T_DEFAULT_FIELD };
+
+/**
+ * Describes one field of a struct, including where the generated class
+ * keeps its value.
+ */
+struct TFieldDescriptor {
+  int16_t id;
+  TFieldRequiredness requiredness;
+  const char* name;
+  const TTypeDescriptor* type;
+  // Offset of the data member in the generated class
+  size_t offset;
+  // True if the member is a std::shared_ptr to the value (cpp.ref)
+  bool reference;
+  // True if the member is a TLazyField holding the value (cpp.lazy)
+  bool lazy;
+};
+
+/**
+ * Describes a generated struct, exception or union, so that generic code
+ * (table driven serializers, diffing, field masks, tools) can walk its
+ * fields without being compiled against the class.
+ *
+ * The code generator emits one as the static member __descriptor of each
+ * class when run with the cpp:reflection option. Descriptors are constant
+ * initialized, so they may be used during static initialization. Fields
+ * are listed in field id order.
+ */
+struct TStructDescriptor {
+  const char* name;
+  const TFieldDescriptor* fields;
+  uint32_t fieldCount;
+  bool exception;
+  // True if every field has a standard C++ type and is held by value, so
+  // that generic code can serialize the struct from this description
+  bool generic;
+  // Reads and writes the __isset flag of fields[index]. Fields without one
+  // (required fields) always count as set.
+  bool (*isSet)(const void* obj, uint32_t index);
+  void (*setIsSet)(void* obj, uint32_t index, bool value);
+  // The read() and write() methods of the class
+  uint32_t (*read)(TProtocol* iprot, void* obj);
+  uint32_t (*write)(TProtocol* oprot, const void* obj);
+
+  /**
+   * Returns the field with the given id, or nullptr.
+   */
+  const TFieldDescriptor* findField(int16_t id) const {
+    uint32_t lo = 0;
+    uint32_t hi = fieldCount;
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (fields[mid].id < id) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return (lo < fieldCount && fields[lo].id == id) ? &fields[lo] : nullptr;
+  }
+
+  /**
+   * Returns the field with the given name, or nullptr.
+   */
+  const TFieldDescriptor* findField(const char* name) const {
+    for (uint32_t i = 0; i < fieldCount; ++i) {
+      if (std::strcmp(fields[i].name, name) == 0) {
+        return &fields[i];
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * Returns the data member of obj that holds field.
+   */
+  static void* member(void* obj, const TFieldDescriptor& field) {
+    return static_cast<char*>(obj) + field.offset;
+  }
+
+  static const void* member(const void* obj, const TFieldDescriptor& field) {
+    return static_cast<const char*>(obj) + field.offset;
+  }
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TTYPEDESCRIPTOR_H_ 1
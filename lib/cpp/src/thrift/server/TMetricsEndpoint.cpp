@@ -0,0 +1,185 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/server/TMetricsEndpoint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <thrift/TOutput.h>
+#include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/transport/TServerSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+
+namespace {
+
+// Largest request read, and how long by default a client has to send it
+const size_t MAX_REQUEST = 8192;
+const int REQUEST_TIMEOUT_MS = 5000;
+
+// Bounds of the pause after a failed accept(), which doubles while it fails
+const int MIN_ACCEPT_BACKOFF_MS = 10;
+const int MAX_ACCEPT_BACKOFF_MS = 1000;
+}
+
+class TMetricsEndpoint::Acceptor : public concurrency::Runnable {
+public:
+  explicit Acceptor(TMetricsEndpoint* endpoint) : endpoint_(endpoint) {}
+
+  void run() override {
+    int backoffMs = 0;
+    while (true) {
+      std::shared_ptr<TTransport> client;
+      try {
+        client = endpoint_->socket_->accept();
+        backoffMs = 0;
+      } catch (const TTransportException& e) {
+        if (e.getType() == TTransportException::INTERRUPTED) {
+          return;
+        } else if (e.getType() == TTransportException::TIMED_OUT) {
+          continue;
+        }
+        // Errors such as running out of file descriptors last a while, so
+        // wait rather than spin; stop() still interrupts the next accept()
+        if (backoffMs == 0) {
+          GlobalOutput.printf("TMetricsEndpoint: accept failed: %s", e.what());
+        }
+        backoffMs = std::min(std::max(backoffMs * 2, MIN_ACCEPT_BACKOFF_MS), MAX_ACCEPT_BACKOFF_MS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(backoffMs));
+        continue;
+      }
+
+      try {
+        endpoint_->serve(client);
+      } catch (const TException& e) {
+        GlobalOutput.printf("TMetricsEndpoint: %s", e.what());
+      }
+      try {
+        client->close();
+      } catch (const TException&) {
+      }
+    }
+  }
+
+private:
+  TMetricsEndpoint* endpoint_;
+};
+
+TMetricsEndpoint::TMetricsEndpoint(std::function<std::string()> render,
+                                   int port,
+                                   const std::string& address)
+  : render_(std::move(render)),
+    socket_(std::make_shared<TServerSocket>(address, port)),
+    requestTimeoutMs_(REQUEST_TIMEOUT_MS) {
+  setRequestTimeout(REQUEST_TIMEOUT_MS);
+}
+
+TMetricsEndpoint::~TMetricsEndpoint() {
+  stop();
+}
+
+void TMetricsEndpoint::start() {
+  if (thread_) {
+    return;
+  }
+  socket_->listen();
+  thread_ = concurrency::ThreadFactory(false).newThread(std::make_shared<Acceptor>(this));
+  thread_->start();
+}
+
+void TMetricsEndpoint::stop() {
+  if (!thread_) {
+    return;
+  }
+  socket_->interrupt();
+  thread_->join();
+  thread_.reset();
+  socket_->close();
+}
+
+void TMetricsEndpoint::setRequestTimeout(int timeoutMs) {
+  if (thread_) {
+    throw std::logic_error("TMetricsEndpoint: cannot set the request timeout once started");
+  }
+  requestTimeoutMs_ = timeoutMs;
+  socket_->setRecvTimeout(timeoutMs);
+  socket_->setSendTimeout(timeoutMs);
+}
+
+int TMetricsEndpoint::getPort() {
+  return socket_->getPort();
+}
+
+void TMetricsEndpoint::serve(std::shared_ptr<TTransport> client) {
+  // Read the request head; its body, if any, is of no interest. Each read
+  // times out on its own, so the head as a whole has a deadline too, or a
+  // client trickling bytes in would hold up every other one.
+  std::chrono::steady_clock::time_point deadline
+      = std::chrono::steady_clock::now() + std::chrono::milliseconds(requestTimeoutMs_);
+  std::string request;
+  uint8_t buf[1024];
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST) {
+    uint32_t got = client->read(buf, sizeof(buf));
+    if (got == 0) {
+      return;
+    } else if (std::chrono::steady_clock::now() > deadline) {
+      throw TTransportException(TTransportException::TIMED_OUT, "Request not sent in time");
+    }
+    request.append(reinterpret_cast<const char*>(buf), got);
+  }
+
+  std::string line = request.substr(0, request.find("\r\n"));
+  std::string path;
+  if (line.compare(0, 4, "GET ") == 0) {
+    path = line.substr(4, line.find(' ', 4) - 4);
+    path = path.substr(0, path.find('?'));
+  }
+
+  std::string status;
+  std::string body;
+  if (path == "/metrics") {
+    status = "200 OK";
+    body = render_();
+  } else {
+    status = "404 Not Found";
+    body = "Not found\n";
+  }
+
+  std::string response = "HTTP/1.1 " + status + "\r\n"
+                         "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                         "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                         "Connection: close\r\n"
+                         "\r\n";
+  response += body;
+  client->write(reinterpret_cast<const uint8_t*>(response.data()),
+                static_cast<uint32_t>(response.size()));
+  client->flush();
+}
+}
+}
+} // apache::thrift::server
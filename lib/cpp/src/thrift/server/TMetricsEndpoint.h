@@ -0,0 +1,95 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TMETRICSENDPOINT_H_
+#define _THRIFT_SERVER_TMETRICSENDPOINT_H_ 1
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <thrift/concurrency/Thread.h>
+#include <thrift/transport/TTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+class TServerSocket;
+}
+
+namespace server {
+
+/**
+ * A minimal HTTP server, on its own thread, that answers GET requests for
+ * /metrics with the text returned by a function, such as
+ * processor::TMetricsEventHandler::renderPrometheus(), for Prometheus to
+ * scrape. Other requests get a 404. Requests are answered one at a time, and
+ * each connection is closed after its response.
+ */
+class TMetricsEndpoint {
+public:
+  /**
+   * @param render  Returns the body of each response.
+   * @param port    Port to listen on, or 0 for one chosen by the system.
+   * @param address Address to listen on; by default only local clients can
+   *                connect.
+   */
+  TMetricsEndpoint(std::function<std::string()> render,
+                   int port,
+                   const std::string& address = "127.0.0.1");
+
+  ~TMetricsEndpoint();
+
+  /**
+   * Starts listening and answering requests.
+   *
+   * @throws TTransportException if the port cannot be listened on.
+   */
+  void start();
+
+  /** Stops answering requests and closes the port. */
+  void stop();
+
+  /**
+   * Sets how long a client has to send its request, 5 seconds by default,
+   * and to take its response. Requests are answered one at a time, so this
+   * is how long one stalled client can hold up the rest.
+   *
+   * @throws std::logic_error once started.
+   */
+  void setRequestTimeout(int timeoutMs);
+
+  /** The port listened on, once started. */
+  int getPort();
+
+private:
+  class Acceptor;
+
+  void serve(std::shared_ptr<transport::TTransport> client);
+
+  std::function<std::string()> render_;
+  std::shared_ptr<transport::TServerSocket> socket_;
+  std::shared_ptr<concurrency::Thread> thread_;
+  int requestTimeoutMs_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TMETRICSENDPOINT_H_
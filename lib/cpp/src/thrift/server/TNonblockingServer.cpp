@@ -23,10 +23,14 @@
 #include <thrift/concurrency/Exception.h>
 #include <thrift/transport/TSocket.h>
 #include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/protocol/TRawValue.h>
 #include <thrift/transport/PlatformSocket.h>
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
 
 #ifdef HAVE_POLL_H
 #include <poll.h>
@@ -194,6 +198,21 @@ private:
   /// Set socket idle
   void setIdle() { setFlags(0); }
 
+  /**
+   * An operation on the socket returned early without progress: wait for
+   * the readiness the socket asks for (a TLS handshake or record layer step
+   * may need the opposite direction), or else for eventFlags.
+   */
+  void setWanted(short eventFlags) {
+    if (tSocket_->wantWrite()) {
+      setWrite();
+    } else if (tSocket_->wantRead()) {
+      setRead();
+    } else {
+      setFlags(eventFlags);
+    }
+  }
+
   /**
    * Set event flags for this connection.
    *
@@ -288,6 +307,33 @@ public:
    */
   int getIOThreadNumber() const { return ioThread_->getThreadNumber(); }
 
+  /// Returns the IO thread this connection is assigned to.
+  TNonblockingIOThread* getIOThread() const { return ioThread_; }
+
+  /*
+   * Returns whether the connection is waiting for a request, none of which
+   * has arrived.
+   */
+  bool isAwaitingRequest() const;
+
+  /*
+   * Reads the name of the function called by the call in the read buffer,
+   * and returns whether it could.
+   */
+  bool readCallName(std::string& name) const;
+
+  /*
+   * Returns the priority of the call in the read buffer, by the name of its
+   * function, or NORMAL if it cannot be read.
+   */
+  PRIORITY getCallPriority() const;
+
+  /*
+   * Returns whether the call in the read buffer is processed on the IO
+   * thread, by the name of its function, or false if it cannot be read.
+   */
+  bool isInlineCall() const;
+
   /// Force connection shutdown for this connection.
   void forceClose() {
     appState_ = APP_CLOSE_CONNECTION;
@@ -411,7 +457,11 @@ void TNonblockingServer::TConnection::init(TNonblockingIOThread* ioThread) {
   }
 
   // Get the processor
-  processor_ = server_->getProcessor(inputProtocol_, outputProtocol_, tSocket_);
+  if (server_->isThreadPerCore()) {
+    processor_ = ioThread->getProcessor();
+  } else {
+    processor_ = server_->getProcessor(inputProtocol_, outputProtocol_, tSocket_);
+  }
 }
 
 void TNonblockingServer::TConnection::setSocket(std::shared_ptr<TSocket> socket) {
@@ -451,7 +501,11 @@ void TNonblockingServer::TConnection::workSocket() {
 
         return;
       }
+      // handshake or record not complete yet
+      setWanted(EV_READ | EV_PERSIST);
+      return;
     }
+    setRead();
 
     if (readBufferPos_ < sizeof(framing.size)) {
       // more needed before frame size is known -- save what we have so far
@@ -508,10 +562,13 @@ void TNonblockingServer::TConnection::workSocket() {
       if(!strstr(te.what(), "retry")) {
         GlobalOutput.printf("TConnection::workSocket(): %s", te.what());
         close();
+      } else {
+        setWanted(EV_READ | EV_PERSIST);
       }
 
       return;
     }
+    setRead();
 
     if (got > 0) {
       // Move along in the buffer
@@ -553,6 +610,11 @@ void TNonblockingServer::TConnection::workSocket() {
     }
 
     writeBufferPos_ += sent;
+    if (sent == 0) {
+      setWanted(EV_WRITE | EV_PERSIST);
+      return;
+    }
+    setWrite();
 
     // Did we overdo it?
     assert(writeBufferPos_ <= writeBufferSize_);
@@ -610,7 +672,7 @@ void TNonblockingServer::TConnection::transition() {
 
     server_->incrementActiveProcessors();
 
-    if (server_->isThreadPoolProcessing()) {
+    if (server_->isThreadPoolProcessing() && !isInlineCall()) {
       // We are setting up a Task to do this work and we will wait on it
 
       // Create task and dispatch to the thread manager
@@ -625,7 +687,9 @@ void TNonblockingServer::TConnection::transition() {
       setIdle();
 
       try {
-        server_->addTask(task);
+        server_->addTask(task,
+                         getIOThreadNumber(),
+                         server_->useCallPriorities() ? getCallPriority() : NORMAL);
       } catch (IllegalStateException& ise) {
         // The ThreadManager is not ready to handle any more tasks (it's probably shutting down).
         GlobalOutput.printf("IllegalStateException: Server::process() %s", ise.what());
@@ -734,6 +798,12 @@ void TNonblockingServer::TConnection::transition() {
 
     readBufferPos_ = 0;
 
+    // A draining server closes connections between requests
+    if (server_->isDraining() && isAwaitingRequest()) {
+      close();
+      return;
+    }
+
     // Register read event
     setRead();
 
@@ -898,20 +968,68 @@ TNonblockingServer::~TNonblockingServer() {
   }
 }
 
+bool TNonblockingServer::TConnection::isAwaitingRequest() const {
+  if (appState_ != APP_READ_FRAME_SIZE || readBufferPos_ != 0) {
+    return false;
+  }
+  // The socket is nonblocking, so this fails if nothing has arrived
+  uint8_t byte;
+  return recv(tSocket_->getSocketFD(), cast_sockopt(&byte), 1, MSG_PEEK) <= 0;
+}
+
+bool TNonblockingServer::TConnection::readCallName(std::string& name) const {
+  protocol::TRawEncoding encoding = protocol::rawEncoding(inputProtocol_.get());
+  if (encoding == protocol::T_RAW_NONE || factoryInputTransport_ != inputTransport_
+      || server_->getHeaderTransport()) {
+    return false;
+  }
+
+  protocol::TMessageType type;
+  int32_t seqid;
+  try {
+    protocol::rawReader(encoding, readBuffer_ + 4, readBufferPos_ - 4)
+        ->readMessageBegin(name, type, seqid);
+  } catch (const TException&) {
+    // The processor reports the error
+    return false;
+  }
+  return true;
+}
+
+PRIORITY TNonblockingServer::TConnection::getCallPriority() const {
+  std::string name;
+  return readCallName(name) ? processor_->getPriority(name) : NORMAL;
+}
+
+bool TNonblockingServer::TConnection::isInlineCall() const {
+  if (!server_->useInlineCalls()) {
+    return false;
+  }
+  std::string name;
+  return readCallName(name)
+         && (server_->getInlineFunctions().count(name) != 0 || processor_->isInline(name));
+}
+
 /**
  * Creates a new connection either by reusing an object off the stack or
  * by allocating a new one entirely
  */
-TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::shared_ptr<TSocket> socket) {
+TNonblockingServer::TConnection* TNonblockingServer::createConnection(
+    std::shared_ptr<TSocket> socket,
+    TNonblockingIOThread* acceptThread) {
   // Check the stack
   Guard g(connMutex_);
 
-  // pick an IO thread to handle this connection -- currently round robin
-  assert(nextIOThread_ < ioThreads_.size());
-  int selectedThreadIdx = nextIOThread_;
-  nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
+  // pick an IO thread to handle this connection -- currently round robin,
+  // unless each thread handles the connections it accepts
+  TNonblockingIOThread* ioThread = acceptThread;
+  if (!threadPerCore_) {
+    assert(nextIOThread_ < ioThreads_.size());
+    int selectedThreadIdx = nextIOThread_;
+    nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
 
-  TNonblockingIOThread* ioThread = ioThreads_[selectedThreadIdx].get();
+    ioThread = ioThreads_[selectedThreadIdx].get();
+  }
 
   // Check the connection stack to see if we can re-use
   TConnection* result = nullptr;
@@ -938,6 +1056,9 @@ void TNonblockingServer::returnConnection(TConnection* connection) {
                                        activeConnections_.end(),
                                        connection),
                            activeConnections_.end());
+  if (activeConnections_.empty() && isDraining()) {
+    drainMonitor_.notifyAll();
+  }
 
   if (connectionStackLimit_ && (connectionStack_.size() >= connectionStackLimit_)) {
     delete connection;
@@ -952,15 +1073,26 @@ void TNonblockingServer::returnConnection(TConnection* connection) {
  * Server socket had something happen.  We accept all waiting client
  * connections on fd and assign TConnection objects to handle those requests.
  */
-void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
+void TNonblockingServer::handleEvent(TNonblockingIOThread* ioThread, THRIFT_SOCKET fd, short which) {
   (void)which;
+  const std::shared_ptr<TNonblockingServerTransport>& listenTransport
+      = threadPerCore_ ? listenTransports_[ioThread->getThreadNumber()] : serverTransport_;
   // Make sure that libevent didn't mess up the socket handles
-  assert(fd == serverSocket_);
+  assert(fd == listenTransport->getSocketFD());
+  (void)fd;
 
   // Going to accept a new client socket
   std::shared_ptr<TSocket> clientSocket;
 
-  clientSocket = serverTransport_->accept();
+  try {
+    clientSocket = listenTransport->accept();
+  } catch (const TTransportException& ttx) {
+    // Another process sharing the socket may have accepted the connection
+    if (ttx.getType() != TTransportException::TIMED_OUT) {
+      throw;
+    }
+    return;
+  }
   if (clientSocket) {
     // If we're overloaded, take action here
     if (overloadAction_ != T_OVERLOAD_NO_ACTION && serverOverloaded()) {
@@ -980,7 +1112,7 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
     }
 
     // Create a new TConnection for this client socket.
-    TConnection* clientConnection = createConnection(clientSocket);
+    TConnection* clientConnection = createConnection(clientSocket, ioThread);
 
     // Fail fast if we could not create a TConnection object
     if (clientConnection == nullptr) {
@@ -996,12 +1128,8 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
      *
      * (We need to avoid writing to our own notification pipe, to
      * avoid possible deadlocks if the pipe is full.)
-     *
-     * The IO thread #0 is the only one that handles these listen
-     * events, so unless the connection has been assigned to thread #0
-     * we know it's not on our thread.
      */
-    if (clientConnection->getIOThreadNumber() == 0) {
+    if (clientConnection->getIOThreadNumber() == ioThread->getThreadNumber()) {
       clientConnection->transition();
     } else {
       if (!clientConnection->notifyIOThread()) {
@@ -1023,6 +1151,7 @@ void TNonblockingServer::createAndListenOnSocket() {
 
 void TNonblockingServer::setThreadManager(std::shared_ptr<ThreadManager> threadManager) {
   threadManager_ = threadManager;
+  ioThreadManagers_.clear();
   if (threadManager) {
     threadManager->setExpireCallback(
         std::bind(&TNonblockingServer::expireClose,
@@ -1034,15 +1163,31 @@ void TNonblockingServer::setThreadManager(std::shared_ptr<ThreadManager> threadM
   }
 }
 
+void TNonblockingServer::setIOThreadManagers(
+    const std::vector<std::shared_ptr<ThreadManager> >& threadManagers) {
+  if (threadManagers.empty()
+      || std::find(threadManagers.begin(), threadManagers.end(), nullptr)
+         != threadManagers.end()) {
+    throw std::invalid_argument("TNonblockingServer: no thread manager");
+  }
+  setThreadManager(threadManagers[0]);
+  for (const auto& threadManager : threadManagers) {
+    threadManager->setExpireCallback(
+        std::bind(&TNonblockingServer::expireClose, this, std::placeholders::_1));
+  }
+  ioThreadManagers_ = threadManagers;
+}
+
 bool TNonblockingServer::serverOverloaded() {
   size_t activeConnections = numTConnections_ - connectionStack_.size();
-  if (numActiveProcessors_ > maxActiveProcessors_ || activeConnections > maxConnections_) {
+  size_t activeProcessors = numActiveProcessors_.load(std::memory_order_relaxed);
+  if (activeProcessors > maxActiveProcessors_ || activeConnections > maxConnections_) {
     if (!overloaded_) {
       GlobalOutput.printf("TNonblockingServer: overload condition begun.");
       overloaded_ = true;
     }
   } else {
-    if (overloaded_ && (numActiveProcessors_ <= overloadHysteresis_ * maxActiveProcessors_)
+    if (overloaded_ && (activeProcessors <= overloadHysteresis_ * maxActiveProcessors_)
         && (activeConnections <= overloadHysteresis_ * maxConnections_)) {
       GlobalOutput.printf(
           "TNonblockingServer: overload ended; "
@@ -1058,15 +1203,22 @@ bool TNonblockingServer::serverOverloaded() {
 }
 
 bool TNonblockingServer::drainPendingTask() {
-  if (threadManager_) {
-    std::shared_ptr<Runnable> task = threadManager_->removeNextPending();
-    if (task) {
-      TConnection* connection = static_cast<TConnection::Task*>(task.get())->getTConnection();
-      assert(connection && connection->getServer() && connection->getState() == APP_WAIT_TASK);
-      connection->forceClose();
-      return true;
+  std::shared_ptr<Runnable> task;
+  if (ioThreadManagers_.empty()) {
+    if (threadManager_) {
+      task = threadManager_->removeNextPending();
+    }
+  } else {
+    for (size_t i = 0; !task && i < ioThreadManagers_.size(); ++i) {
+      task = ioThreadManagers_[i]->removeNextPending();
     }
   }
+  if (task) {
+    TConnection* connection = static_cast<TConnection::Task*>(task.get())->getTConnection();
+    assert(connection && connection->getServer() && connection->getState() == APP_WAIT_TASK);
+    connection->forceClose();
+    return true;
+  }
   return false;
 }
 
@@ -1083,6 +1235,48 @@ void TNonblockingServer::stop() {
   }
 }
 
+bool TNonblockingServer::drain(int64_t timeoutMs) {
+  std::chrono::steady_clock::time_point deadline
+      = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  draining_ = true;
+  for (auto& ioThread : ioThreads_) {
+    ioThread->drain();
+  }
+
+  bool drained;
+  {
+    Synchronized s(drainMonitor_);
+    while (drainedIOThreads_ < ioThreads_.size() || !activeConnections_.empty()) {
+      if (drainMonitor_.waitForTime(deadline) == THRIFT_ETIMEDOUT) {
+        break;
+      }
+    }
+    drained = drainedIOThreads_ == ioThreads_.size() && activeConnections_.empty();
+  }
+
+  stop();
+  return drained;
+}
+
+void TNonblockingServer::drainIOThread(TNonblockingIOThread* ioThread) {
+  std::vector<TConnection*> idle;
+  {
+    Guard g(connMutex_);
+    for (auto connection : activeConnections_) {
+      if (connection->getIOThread() == ioThread && connection->isAwaitingRequest()) {
+        idle.push_back(connection);
+      }
+    }
+  }
+  for (auto connection : idle) {
+    connection->close();
+  }
+
+  Guard g(connMutex_);
+  ++drainedIOThreads_;
+  drainMonitor_.notifyAll();
+}
+
 void TNonblockingServer::registerEvents(event_base* user_event_base) {
   userEventBase_ = user_event_base;
 
@@ -1094,13 +1288,32 @@ void TNonblockingServer::registerEvents(event_base* user_event_base) {
   assert(ioThreads_.empty());
   if (!numIOThreads_) {
     numIOThreads_ = DEFAULT_IO_THREADS;
+    if (threadPerCore_) {
+      numIOThreads_ = (std::max)(std::thread::hardware_concurrency(), 1u);
+    }
   }
   // User-provided event-base doesn't works for multi-threaded servers
   assert(numIOThreads_ == 1 || !userEventBase_);
 
+  if (threadPerCore_) {
+    if (threadPoolProcessing_) {
+      throw std::invalid_argument(
+          "TNonblockingServer: a thread-per-core server cannot have a thread manager");
+    }
+    // Every IO thread listens on a socket of its own
+    listenTransports_.push_back(serverTransport_);
+    while (listenTransports_.size() < numIOThreads_) {
+      listenTransports_.push_back(serverTransport_->listenAlongside());
+    }
+  }
+
   for (uint32_t id = 0; id < numIOThreads_; ++id) {
-    // the first IO thread also does the listening on server socket
+    // the first IO thread also does the listening on server socket, unless
+    // they all listen
     THRIFT_SOCKET listenFd = (id == 0 ? serverSocket_ : THRIFT_INVALID_SOCKET);
+    if (threadPerCore_) {
+      listenFd = listenTransports_[id]->getSocketFD();
+    }
 
     shared_ptr<TNonblockingIOThread> thread(
         new TNonblockingIOThread(this, id, listenFd, useHighPriorityIOThreads_));
@@ -1122,9 +1335,11 @@ void TNonblockingServer::registerEvents(event_base* user_event_base) {
 
   // Launch all the secondary IO threads in separate threads
   if (ioThreads_.size() > 1) {
-    ioThreadFactory_.reset(new ThreadFactory(
-        false // detached
-        ));
+    if (!ioThreadFactory_) {
+      ioThreadFactory_.reset(new ThreadFactory(
+          false // detached
+          ));
+    }
 
     assert(ioThreadFactory_.get());
 
@@ -1258,7 +1473,7 @@ void TNonblockingIOThread::registerEvents() {
               listenSocket_,
               EV_READ | EV_PERSIST,
               TNonblockingIOThread::listenHandler,
-              server_);
+              this);
     event_base_set(eventBase_, &serverEvent_);
 
     // Add the event and start up the server
@@ -1373,6 +1588,13 @@ bool TNonblockingIOThread::notify(TNonblockingServer::TConnection* conn) {
   return true;
 }
 
+namespace {
+
+// Written to an IO thread's notification pipe, in place of a connection, to
+// have it drain
+char drainCommand;
+}
+
 /* static */
 void TNonblockingIOThread::notifyHandler(evutil_socket_t fd, short which, void* v) {
   auto* ioThread = (TNonblockingIOThread*)v;
@@ -1389,6 +1611,10 @@ void TNonblockingIOThread::notifyHandler(evutil_socket_t fd, short which, void*
         ioThread->breakLoop(false);
         return;
       }
+      if (connection == reinterpret_cast<TNonblockingServer::TConnection*>(&drainCommand)) {
+        ioThread->drainConnections();
+        continue;
+      }
       connection->transition();
     } else if (nBytes > 0) {
       // throw away these bytes and hope that next time we get a solid read
@@ -1488,6 +1714,13 @@ void TNonblockingIOThread::run() {
   GlobalOutput.printf("TNonblockingServer: IO thread #%d run() done!", number_);
 }
 
+std::shared_ptr<TProcessor> TNonblockingIOThread::getProcessor() {
+  if (!processor_) {
+    processor_ = server_->getProcessorFactory()->getProcessor(TConnectionInfo());
+  }
+  return processor_;
+}
+
 void TNonblockingIOThread::cleanupEvents() {
   // stop the listen socket, if any
   if (listenSocket_ != THRIFT_INVALID_SOCKET) {
@@ -1499,6 +1732,24 @@ void TNonblockingIOThread::cleanupEvents() {
   event_del(&notificationEvent_);
 }
 
+void TNonblockingIOThread::drain() {
+  if (!Thread::is_current(threadId_)) {
+    notify(reinterpret_cast<TNonblockingServer::TConnection*>(&drainCommand));
+  } else {
+    drainConnections();
+  }
+}
+
+void TNonblockingIOThread::drainConnections() {
+  // stop accepting
+  if (listenSocket_ != THRIFT_INVALID_SOCKET) {
+    if (event_del(&serverEvent_) == -1) {
+      GlobalOutput.perror("TNonblockingIOThread::drain() event_del: ", THRIFT_GET_SOCKET_ERROR);
+    }
+  }
+  server_->drainIOThread(this);
+}
+
 void TNonblockingIOThread::stop() {
   // This should cause the thread to fall out of its event loop ASAP.
   breakLoop(false);
@@ -28,10 +28,13 @@
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TNonblockingServerTransport.h>
 #include <thrift/concurrency/ThreadManager.h>
+#include <atomic>
 #include <climits>
 #include <thrift/concurrency/Thread.h>
 #include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/concurrency/Monitor.h>
 #include <thrift/concurrency/Mutex.h>
+#include <set>
 #include <stack>
 #include <vector>
 #include <string>
@@ -55,6 +58,7 @@ using apache::thrift::concurrency::Runnable;
 using apache::thrift::concurrency::ThreadManager;
 using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::Monitor;
 using apache::thrift::concurrency::Mutex;
 using apache::thrift::concurrency::Guard;
 
@@ -161,10 +165,28 @@ private:
   /// For processing via thread pool, may be nullptr
   std::shared_ptr<ThreadManager> threadManager_;
 
+  /// Thread pool for each IO thread, by IO thread number, if not all share threadManager_
+  std::vector<std::shared_ptr<ThreadManager> > ioThreadManagers_;
+
   /// Is thread pool processing?
   bool threadPoolProcessing_;
 
-  // Factory to create the IO threads
+  /// Whether calls are queued with the priority the processor gives them
+  bool useCallPriorities_;
+
+  /// Whether calls to inline functions skip the thread pool
+  bool useInlineCalls_;
+
+  /// Functions processed inline, besides those the processor marks
+  std::set<std::string> inlineFunctions_;
+
+  /// Whether each IO thread accepts, and processes, its own connections
+  bool threadPerCore_;
+
+  /// Listening transport of each IO thread, by IO thread number, in thread-per-core mode
+  std::vector<std::shared_ptr<TNonblockingServerTransport> > listenTransports_;
+
+  // Factory to create the IO threads, other than the first
   std::shared_ptr<ThreadFactory> ioThreadFactory_;
 
   // Vector of IOThread objects that will handle our IO
@@ -176,11 +198,20 @@ private:
   // Synchronizes access to connection stack and similar data
   Mutex connMutex_;
 
+  /// Notified, with connMutex_ held, as connections and IO threads drain
+  Monitor drainMonitor_{&connMutex_};
+
+  /// Whether drain() has been called
+  std::atomic<bool> draining_;
+
+  /// Number of IO threads that have stopped accepting and closed idle connections
+  size_t drainedIOThreads_;
+
   /// Number of TConnection object we've created
   size_t numTConnections_;
 
   /// Number of Connections processing or waiting to process
-  size_t numActiveProcessors_;
+  std::atomic<size_t> numActiveProcessors_;
 
   /// Limit for how many TConnection objects to cache
   size_t connectionStackLimit_;
@@ -270,9 +301,10 @@ private:
    * client connections on listen socket fd and assign TConnection objects
    * to handle those requests.
    *
+   * @param ioThread the IO thread listening on fd.
    * @param which the event flag that triggered the handler.
    */
-  void handleEvent(THRIFT_SOCKET fd, short which);
+  void handleEvent(TNonblockingIOThread* ioThread, THRIFT_SOCKET fd, short which);
 
   void init() {
     serverSocket_ = THRIFT_INVALID_SOCKET;
@@ -281,6 +313,11 @@ private:
     useHighPriorityIOThreads_ = false;
     userEventBase_ = nullptr;
     threadPoolProcessing_ = false;
+    useCallPriorities_ = false;
+    useInlineCalls_ = false;
+    threadPerCore_ = false;
+    draining_ = false;
+    drainedIOThreads_ = 0;
     numTConnections_ = 0;
     numActiveProcessors_ = 0;
     connectionStackLimit_ = CONNECTION_STACK_LIMIT;
@@ -383,9 +420,35 @@ public:
 
   std::shared_ptr<ThreadManager> getThreadManager() { return threadManager_; }
 
+  /**
+   * Gives each IO thread a thread pool of its own to process its calls, in
+   * place of the one set by setThreadManager(). IO thread i uses
+   * threadManagers[i % threadManagers.size()], and getThreadManager()
+   * returns the first.
+   *
+   * Together with setIOThreadFactory(), this lets each IO thread run on the
+   * same CPUs, or NUMA node, as the workers it hands calls to, so a call's
+   * buffers stay local to the node that reads, processes and writes it.
+   * Can only be used before the call to serve().
+   *
+   * @throws std::invalid_argument if threadManagers is empty or holds nullptr.
+   */
+  void setIOThreadManagers(const std::vector<std::shared_ptr<ThreadManager> >& threadManagers);
+
+  /**
+   * Returns the thread pool that processes the calls of the given IO thread.
+   */
+  const std::shared_ptr<ThreadManager>& getIOThreadManager(int ioThreadNumber) const {
+    if (ioThreadManagers_.empty()) {
+      return threadManager_;
+    }
+    return ioThreadManagers_[ioThreadNumber % ioThreadManagers_.size()];
+  }
+
   /**
    * Sets the number of IO threads used by this server. Can only be used before
-   * the call to serve() and has no effect afterwards.
+   * the call to serve() and has no effect afterwards. In thread-per-core
+   * mode, 0 starts one for each CPU.
    */
   void setNumIOThreads(size_t numThreads) {
     numIOThreads_ = numThreads;
@@ -402,6 +465,48 @@ public:
   /** Return the number of IO threads used by this server. */
   size_t getNumIOThreads() const { return numIOThreads_; }
 
+  /**
+   * Sets the factory that creates the IO threads, such as an
+   * AffinityThreadFactory that binds them to CPUs or NUMA nodes. The first IO
+   * thread is the one that calls serve(), so is not created by the factory;
+   * see AffinityThreadFactory::bindCurrentThread(). The factory is set to
+   * create joinable threads. Can only be used before the call to serve().
+   */
+  void setIOThreadFactory(std::shared_ptr<ThreadFactory> factory) {
+    if (factory) {
+      factory->setDetached(false);
+    }
+    ioThreadFactory_ = factory;
+  }
+
+  /** Return the factory set by setIOThreadFactory(), if any. */
+  std::shared_ptr<ThreadFactory> getIOThreadFactory() const { return ioThreadFactory_; }
+
+  /**
+   * Sets whether the server runs in thread-per-core mode, where the IO
+   * threads share nothing: each listens on a socket of its own, bound to the
+   * same port with SO_REUSEPORT so that the kernel spreads connections over
+   * them, and reads, processes and writes the calls of the connections it
+   * accepts itself, without handing them to another thread. Each IO thread
+   * gets a processor of its own from the processor factory, whose
+   * TConnectionInfo has no protocols or transport, and uses it for all its
+   * connections, so handlers need no locking if the factory makes one for
+   * each processor.
+   *
+   * The server transport must be a TNonblockingServerSocket set to reuse its
+   * port (see TNonblockingServerSocket::setReusePort()), and no thread
+   * manager may be set, as calls run on the IO threads. Handlers should
+   * return quickly, as each one holds up the other connections of its IO
+   * thread. Together with an AffinityThreadFactory, for setIOThreadFactory(),
+   * that binds each IO thread to a CPU of its own, each thread keeps its
+   * connections, buffers and handler in its CPU's cache. Can only be used
+   * before the call to serve().
+   */
+  void setThreadPerCore(bool val) { threadPerCore_ = val; }
+
+  /** Return whether the server runs in thread-per-core mode. */
+  bool isThreadPerCore() const { return threadPerCore_; }
+
   /**
    * Get the maximum number of unused TConnection we will hold in reserve.
    *
@@ -422,6 +527,55 @@ public:
     threadManager_->add(task, 0LL, taskExpireTime_);
   }
 
+  /**
+   * Hands a task from the given IO thread to that thread's pool, in the
+   * given priority class.
+   */
+  void addTask(std::shared_ptr<Runnable> task,
+               int ioThreadNumber,
+               concurrency::PRIORITY priority = concurrency::NORMAL) {
+    getIOThreadManager(ioThreadNumber)->add(task, 0LL, taskExpireTime_, priority);
+  }
+
+  /** Return whether calls are queued with the priority of their function. */
+  bool useCallPriorities() const { return useCallPriorities_; }
+
+  /**
+   * Set whether calls are queued with the priority the processor gives
+   * their function (see TProcessor::getPriority()), which a thread pool made
+   * by ThreadManager::newPriorityThreadManager() orders them by. Names are
+   * only read from TBinaryProtocol and TCompactProtocol calls that are not
+   * transformed by the input transport factory; other calls are NORMAL.
+   */
+  void setUseCallPriorities(bool val) { useCallPriorities_ = val; }
+
+  /** Return whether calls to inline functions are processed on the IO threads. */
+  bool useInlineCalls() const { return useInlineCalls_; }
+
+  /**
+   * Set whether calls to functions the processor marks inline (see
+   * TProcessor::isInline()), or that are named by setInlineFunctions(), are
+   * processed on the IO thread that read them, rather than handed to the
+   * thread manager, which saves the handoff for calls that take less time
+   * than it. An inline call holds up the other connections of its IO thread
+   * while it runs. Names are only read from TBinaryProtocol and
+   * TCompactProtocol calls that are not transformed by the input transport
+   * factory; other calls go to the thread manager. Without a thread
+   * manager, every call is processed on the IO threads anyway.
+   */
+  void setUseInlineCalls(bool val) { useInlineCalls_ = val; }
+
+  /**
+   * Names functions whose calls are processed inline, as well as those the
+   * processor marks, when setUseInlineCalls(true) is set. Names are as calls
+   * carry them, so "Service:method" for calls to a TMultiplexedProcessor.
+   * Can only be used before the call to serve().
+   */
+  void setInlineFunctions(const std::set<std::string>& names) { inlineFunctions_ = names; }
+
+  /** Return the functions named by setInlineFunctions(). */
+  const std::set<std::string>& getInlineFunctions() const { return inlineFunctions_; }
+
   /**
    * Return the count of sockets currently connected to.
    *
@@ -454,16 +608,13 @@ public:
   size_t getNumActiveProcessors() const { return numActiveProcessors_; }
 
   /// Increment the count of connections currently processing.
-  void incrementActiveProcessors() {
-    Guard g(connMutex_);
-    ++numActiveProcessors_;
-  }
+  void incrementActiveProcessors() { numActiveProcessors_.fetch_add(1, std::memory_order_relaxed); }
 
   /// Decrement the count of connections currently processing.
   void decrementActiveProcessors() {
-    Guard g(connMutex_);
-    if (numActiveProcessors_ > 0) {
-      --numActiveProcessors_;
+    size_t active = numActiveProcessors_.load(std::memory_order_relaxed);
+    while (active > 0 && !numActiveProcessors_.compare_exchange_weak(active, active - 1,
+                                                                     std::memory_order_relaxed)) {
     }
   }
 
@@ -675,6 +826,25 @@ public:
    */
   void stop() override;
 
+  /**
+   * Stops accepting connections, and closes each connection once it has
+   * replied to the request it is reading or processing, or straight away if
+   * it is waiting for one; then, once none are left or timeoutMs
+   * milliseconds have passed, stops the server as stop() does. Connections
+   * still open then are closed when the server is destroyed. Connections
+   * not yet accepted are reset when the listening socket closes, unless it
+   * was first handed to a new process to accept them (see
+   * TNonblockingServerSocket::handOff()). Can be called from any thread but
+   * the IO threads.
+   *
+   * @param timeoutMs how long to let connections finish, in milliseconds.
+   * @return whether every connection finished before the deadline.
+   */
+  bool drain(int64_t timeoutMs);
+
+  /// Return whether drain() has been called.
+  bool isDraining() const { return draining_; }
+
   /// Creates a socket to listen on and binds it to the local port.
   void createAndListenOnSocket();
 
@@ -714,11 +884,11 @@ private:
    * and flags.
    *
    * @param socket FD of socket associated with this connection.
-   * @param addr the sockaddr of the client
-   * @param addrLen the length of addr
+   * @param acceptThread the IO thread that accepted the connection, which
+   * handles it in thread-per-core mode.
    * @return pointer to initialized TConnection object.
    */
-  TConnection* createConnection(std::shared_ptr<TSocket> socket);
+  TConnection* createConnection(std::shared_ptr<TSocket> socket, TNonblockingIOThread* acceptThread);
 
   /**
    * Returns a connection to pool or deletion.  If the connection pool
@@ -728,6 +898,15 @@ private:
    * @param connection the TConection being returned.
    */
   void returnConnection(TConnection* connection);
+
+  /**
+   * Has the server stop accepting on an IO thread, and closes the
+   * connections of the thread waiting for a request. Called on the IO
+   * thread, after drain().
+   *
+   * @param ioThread the IO thread to drain.
+   */
+  void drainIOThread(TNonblockingIOThread* ioThread);
 };
 
 class TNonblockingIOThread : public Runnable {
@@ -751,6 +930,11 @@ public:
   // Returns the number of this IO thread.
   int getThreadNumber() const { return number_; }
 
+  // Returns the processor for all the connections of this thread, in
+  // thread-per-core mode, getting it from the server's processor factory on
+  // first use. Must be called from this thread.
+  std::shared_ptr<TProcessor> getProcessor();
+
   // Returns the thread id associated with this object.  This should
   // only be called after the thread has been started.
   Thread::id_t getThreadId() const { return threadId_; }
@@ -773,6 +957,10 @@ public:
   // Enters the event loop and does not return until a call to stop().
   void run() override;
 
+  // Stops accepting, and closes the connections waiting for a request, as
+  // TNonblockingServer::drain() does. Can be called from any thread.
+  void drain();
+
   // Exits the event loop as soon as possible.
   void stop();
 
@@ -799,15 +987,19 @@ private:
    *
    * @param fd the descriptor the event occurred on.
    * @param which the flags associated with the event.
-   * @param v void* callback arg where we placed TNonblockingServer's "this".
+   * @param v void* callback arg where we placed TNonblockingIOThread's "this".
    */
   static void listenHandler(evutil_socket_t fd, short which, void* v) {
-    ((TNonblockingServer*)v)->handleEvent(fd, which);
+    auto* ioThread = static_cast<TNonblockingIOThread*>(v);
+    ioThread->server_->handleEvent(ioThread, fd, which);
   }
 
   /// Exits the loop ASAP in case of shutdown or error.
   void breakLoop(bool error);
 
+  /// Drains this thread, on this thread.
+  void drainConnections();
+
   /// Create the pipe used to notify I/O process of task completion.
   void createNotificationPipe();
 
@@ -851,6 +1043,9 @@ private:
 
   /// Actual IO Thread
   std::shared_ptr<Thread> thread_;
+
+  /// Processor shared by this thread's connections, in thread-per-core mode
+  std::shared_ptr<TProcessor> processor_;
 };
 }
 }
@@ -18,6 +18,7 @@
  */
 
 #include <algorithm>
+#include <chrono>
 #include <stdexcept>
 #include <stdint.h>
 #include <thrift/server/TServerFramework.h>
@@ -44,7 +45,8 @@ TServerFramework::TServerFramework(const shared_ptr<TProcessorFactory>& processo
   : TServer(processorFactory, serverTransport, transportFactory, protocolFactory),
     clients_(0),
     hwm_(0),
-    limit_(INT64_MAX) {
+    limit_(INT64_MAX),
+    draining_(false) {
 }
 
 TServerFramework::TServerFramework(const shared_ptr<TProcessor>& processor,
@@ -54,7 +56,8 @@ TServerFramework::TServerFramework(const shared_ptr<TProcessor>& processor,
   : TServer(processor, serverTransport, transportFactory, protocolFactory),
     clients_(0),
     hwm_(0),
-    limit_(INT64_MAX) {
+    limit_(INT64_MAX),
+    draining_(false) {
 }
 
 TServerFramework::TServerFramework(const shared_ptr<TProcessorFactory>& processorFactory,
@@ -71,7 +74,8 @@ TServerFramework::TServerFramework(const shared_ptr<TProcessorFactory>& processo
             outputProtocolFactory),
     clients_(0),
     hwm_(0),
-    limit_(INT64_MAX) {
+    limit_(INT64_MAX),
+    draining_(false) {
 }
 
 TServerFramework::TServerFramework(const shared_ptr<TProcessor>& processor,
@@ -88,7 +92,8 @@ TServerFramework::TServerFramework(const shared_ptr<TProcessor>& processor,
             outputProtocolFactory),
     clients_(0),
     hwm_(0),
-    limit_(INT64_MAX) {
+    limit_(INT64_MAX),
+    draining_(false) {
 }
 
 TServerFramework::~TServerFramework() = default;
@@ -137,7 +142,7 @@ void TServerFramework::serve() {
       // accepting another.
       {
         Synchronized sync(mon_);
-        while (clients_ >= limit_) {
+        while (clients_ >= limit_ && !draining_) {
           mon_.wait();
         }
       }
@@ -184,6 +189,15 @@ void TServerFramework::serve() {
     }
   }
 
+  // Closing the serverTransport interrupts the clients, so when draining
+  // it waits for them to finish
+  {
+    Synchronized sync(mon_);
+    while (draining_ && clients_ > 0) {
+      mon_.wait();
+    }
+  }
+
   releaseOneDescriptor("serverTransport", serverTransport_);
 }
 
@@ -220,6 +234,33 @@ void TServerFramework::stop() {
   serverTransport_->interrupt();
 }
 
+bool TServerFramework::drain(int64_t timeoutMs) {
+  std::chrono::steady_clock::time_point deadline
+      = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  {
+    Synchronized sync(mon_);
+    draining_ = true;
+    mon_.notifyAll();
+  }
+  serverTransport_->interrupt();
+  serverTransport_->interruptIdleChildren();
+
+  bool drained;
+  {
+    Synchronized sync(mon_);
+    while (clients_ > 0) {
+      if (mon_.waitForTime(deadline) == THRIFT_ETIMEDOUT) {
+        break;
+      }
+    }
+    drained = (clients_ == 0);
+  }
+  if (!drained) {
+    serverTransport_->interruptChildren();
+  }
+  return drained;
+}
+
 void TServerFramework::newlyConnectedClient(const shared_ptr<TConnectedClient>& pClient) {
   {
     Synchronized sync(mon_);
@@ -238,6 +279,9 @@ void TServerFramework::disposeConnectedClient(TConnectedClient* pClient) {
   if (limit_ - --clients_ > 0) {
     mon_.notify();
   }
+  if (draining_ && clients_ == 0) {
+    mon_.notifyAll();
+  }
 }
 
 }
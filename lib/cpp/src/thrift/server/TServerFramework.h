@@ -91,6 +91,25 @@ public:
    */
   void stop() override;
 
+  /**
+   * Stop accepting clients, and close each connected client once it has
+   * replied to the request it is reading or processing, or straight away
+   * if it is waiting for one. Clients still connected after timeoutMs
+   * milliseconds are interrupted, as by stop(). serve() returns once none
+   * are left, and only then closes the serverTransport.
+   *
+   * Clients waiting for a request are only closed early if the
+   * serverTransport can interrupt them while idle (see
+   * TServerTransport::interruptIdleChildren()), as TServerSocket can its
+   * TSockets; others stay connected until the deadline. Connections not yet
+   * accepted when the serverTransport closes are reset, unless it was first
+   * handed to a new process to accept them (see TServerSocket::handOff()).
+   *
+   * \param[in]  timeoutMs  how long to let clients finish, in milliseconds
+   * \returns whether every client finished before the deadline
+   */
+  virtual bool drain(int64_t timeoutMs);
+
   /**
    * Get the concurrent client limit.
    * \returns the concurrent client limit
@@ -176,6 +195,11 @@ private:
    * The limit on the number of concurrent clients.
    */
   int64_t limit_;
+
+  /**
+   * Whether drain() has been called.
+   */
+  bool draining_;
 };
 }
 }
@@ -92,7 +92,9 @@ TFileTransport::TFileTransport(string path, bool readOnly, std::shared_ptr<TConf
     offset_(0),
     lastBadChunk_(0),
     numCorruptedEventsInChunk_(0),
-    readOnly_(readOnly) {
+    readOnly_(readOnly),
+    indexEnabled_(false),
+    indexFd_(0) {
   threadFactory_.setDetached(false);
   openLogFile();
 }
@@ -229,6 +231,10 @@ void TFileTransport::enqueueEvent(const uint8_t* buf, uint32_t eventLen) {
   // actual event contents
   memcpy(toEnqueue->eventBuff_ + 4, buf, eventLen);
   toEnqueue->eventSize_ = eventLen + 4;
+  if (indexEnabled_) {
+    toEnqueue->eventTime_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::system_clock::now().time_since_epoch()).count();
+  }
 
   // lock mutex
   Guard g(mutex_);
@@ -336,6 +342,15 @@ void TFileTransport::writerThread() {
     }
   }
 
+  // the index is best effort: failing to open it must not stop logging
+  if (indexEnabled_ && !hasIOError) {
+    try {
+      openIndexFile();
+    } catch (...) {
+      GlobalOutput.printf("TFileTransport: unable to open index for %s", filename_.c_str());
+    }
+  }
+
   // Figure out the next time by which a flush must take place
   auto ts_next_flush = getNextFlushTime();
   uint32_t unflushed = 0;
@@ -349,6 +364,7 @@ void TFileTransport::writerThread() {
 
       // Try to empty buffers before exit
       if (enqueueBuffer_->isEmpty() && dequeueBuffer_->isEmpty()) {
+        closeIndexFile();
         ::THRIFT_FSYNC(fd_);
         if (-1 == ::THRIFT_CLOSE(fd_)) {
           int errno_copy = THRIFT_ERRNO;
@@ -448,6 +464,9 @@ void TFileTransport::writerThread() {
             hasIOError = true;
             continue;
           }
+          if (indexFd_ > 0) {
+            updateIndex(offset_, outEvent);
+          }
           unflushed += outEvent->eventSize_;
           offset_ += outEvent->eventSize_;
         }
@@ -504,6 +523,10 @@ void TFileTransport::writerThread() {
     if (flush) {
       // sync (force flush) file to disk
       THRIFT_FSYNC(fd_);
+      if (indexFd_ > 0) {
+        writeIndexEntry();
+        THRIFT_FSYNC(indexFd_);
+      }
       unflushed = 0;
       ts_next_flush = getNextFlushTime();
 
@@ -907,6 +930,107 @@ void TFileTransport::openLogFile() {
   }
 }
 
+void TFileTransport::openIndexFile() {
+  std::string indexPath = TFileTransportIndex::getIndexPath(filename_);
+#ifndef _WIN32
+  indexFd_ = ::THRIFT_OPEN(indexPath.c_str(),
+                           O_RDWR | O_CREAT,
+                           S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+#else
+  indexFd_ = ::THRIFT_OPEN(indexPath.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+  if (indexFd_ == -1) {
+    int errno_copy = THRIFT_ERRNO;
+    indexFd_ = 0;
+    GlobalOutput.perror("TFileTransport: openIndexFile() ::open() file: " + indexPath, errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN, indexPath, errno_copy);
+  }
+
+  // pick up the summary of the chunk we are appending to, if any
+  indexEntry_ = TFileChunkIndexEntry();
+  uint32_t chunk = getCurChunk();
+  uint8_t record[TFileChunkIndexEntry::RECORD_SIZE];
+  off_t recordOffset = off_t(chunk) * TFileChunkIndexEntry::RECORD_SIZE;
+  if (::THRIFT_LSEEK(indexFd_, recordOffset, SEEK_SET) == recordOffset
+      && ::THRIFT_READ(indexFd_, record, sizeof(record)) == static_cast<int>(sizeof(record))) {
+    TFileChunkIndexEntry entry;
+    entry.decode(record);
+    if (entry.numEvents > 0 && entry.chunk == chunk) {
+      indexEntry_ = entry;
+    }
+  }
+}
+
+void TFileTransport::closeIndexFile() {
+  if (indexFd_ <= 0) {
+    return;
+  }
+  writeIndexEntry();
+  ::THRIFT_FSYNC(indexFd_);
+  if (-1 == ::THRIFT_CLOSE(indexFd_)) {
+    GlobalOutput.perror("TFileTransport: closeIndexFile() ::close() ", THRIFT_ERRNO);
+  }
+  indexFd_ = 0;
+}
+
+void TFileTransport::updateIndex(off_t eventOffset, const eventInfo* event) {
+  auto chunk = static_cast<uint32_t>(chunkSize_ ? eventOffset / chunkSize_ : 0);
+
+  // the previous chunk is complete: persist it and start a new summary
+  if (indexEntry_.numEvents > 0 && indexEntry_.chunk != chunk) {
+    writeIndexEntry();
+    indexEntry_ = TFileChunkIndexEntry();
+  }
+
+  if (indexEntry_.numEvents == 0) {
+    indexEntry_.chunk = chunk;
+    indexEntry_.minTimestamp = event->eventTime_;
+    indexEntry_.maxTimestamp = event->eventTime_;
+  } else {
+    indexEntry_.minTimestamp = (std::min)(indexEntry_.minTimestamp, event->eventTime_);
+    indexEntry_.maxTimestamp = (std::max)(indexEntry_.maxTimestamp, event->eventTime_);
+  }
+  ++indexEntry_.numEvents;
+
+  // the first 4 bytes of the buffer are the event length
+  int64_t key;
+  if (indexKeyExtractor_
+      && indexKeyExtractor_(event->eventBuff_ + 4, event->eventSize_ - 4, key)) {
+    if (indexEntry_.numKeyedEvents == 0) {
+      indexEntry_.minKey = key;
+      indexEntry_.maxKey = key;
+    } else {
+      indexEntry_.minKey = (std::min)(indexEntry_.minKey, key);
+      indexEntry_.maxKey = (std::max)(indexEntry_.maxKey, key);
+    }
+    ++indexEntry_.numKeyedEvents;
+  }
+}
+
+void TFileTransport::writeIndexEntry() {
+  if (indexEntry_.numEvents == 0) {
+    return;
+  }
+  uint8_t record[TFileChunkIndexEntry::RECORD_SIZE];
+  indexEntry_.encode(record);
+  off_t recordOffset = off_t(indexEntry_.chunk) * TFileChunkIndexEntry::RECORD_SIZE;
+  if (::THRIFT_LSEEK(indexFd_, recordOffset, SEEK_SET) != recordOffset
+      || -1 == ::THRIFT_WRITE(indexFd_, record, sizeof(record))) {
+    GlobalOutput.perror("TFileTransport: error while writing index entry ", THRIFT_ERRNO);
+  }
+}
+
+bool TFileTransport::seekToTimestamp(int64_t timestampMs) {
+  TFileTransportIndex index(TFileTransportIndex::getIndexPath(filename_));
+  for (const auto& entry : index.getEntries()) {
+    if (entry.maxTimestamp >= timestampMs) {
+      seekToChunk(static_cast<int32_t>(entry.chunk));
+      return true;
+    }
+  }
+  return false;
+}
+
 std::chrono::time_point<std::chrono::steady_clock> TFileTransport::getNextFlushTime() {
   return std::chrono::steady_clock::now() + std::chrono::microseconds(flushMaxUs_);
 }
@@ -972,6 +1096,87 @@ bool TFileTransportBuffer::isEmpty() {
   return writePoint_ == 0;
 }
 
+void TFileChunkIndexEntry::encode(uint8_t* buf) const {
+  // same host byte order as the event sizes in the log itself
+  uint32_t reserved = 0;
+  memcpy(buf, &chunk, 4);
+  memcpy(buf + 4, &numEvents, 4);
+  memcpy(buf + 8, &numKeyedEvents, 4);
+  memcpy(buf + 12, &reserved, 4);
+  memcpy(buf + 16, &minTimestamp, 8);
+  memcpy(buf + 24, &maxTimestamp, 8);
+  memcpy(buf + 32, &minKey, 8);
+  memcpy(buf + 40, &maxKey, 8);
+}
+
+void TFileChunkIndexEntry::decode(const uint8_t* buf) {
+  memcpy(&chunk, buf, 4);
+  memcpy(&numEvents, buf + 4, 4);
+  memcpy(&numKeyedEvents, buf + 8, 4);
+  memcpy(&minTimestamp, buf + 16, 8);
+  memcpy(&maxTimestamp, buf + 24, 8);
+  memcpy(&minKey, buf + 32, 8);
+  memcpy(&maxKey, buf + 40, 8);
+}
+
+TFileTransportIndex::TFileTransportIndex(const std::string& indexPath) : indexPath_(indexPath) {
+  reload();
+}
+
+void TFileTransportIndex::reload() {
+  entries_.clear();
+
+#ifndef _WIN32
+  int fd = ::THRIFT_OPEN(indexPath_.c_str(), O_RDONLY, S_IRUSR | S_IRGRP | S_IROTH);
+#else
+  int fd = ::THRIFT_OPEN(indexPath_.c_str(), _O_RDONLY | _O_BINARY, _S_IREAD);
+#endif
+  if (fd == -1) {
+    // no index has been written (yet)
+    return;
+  }
+
+  uint8_t record[TFileChunkIndexEntry::RECORD_SIZE];
+  uint32_t have = 0;
+  while (true) {
+    auto got = ::THRIFT_READ(fd, record + have, TFileChunkIndexEntry::RECORD_SIZE - have);
+    if (got <= 0) {
+      // a trailing partial record is still being written
+      break;
+    }
+    have += static_cast<uint32_t>(got);
+    if (have == TFileChunkIndexEntry::RECORD_SIZE) {
+      TFileChunkIndexEntry entry;
+      entry.decode(record);
+      if (entry.numEvents > 0) {
+        entries_.push_back(entry);
+      }
+      have = 0;
+    }
+  }
+  ::THRIFT_CLOSE(fd);
+}
+
+std::vector<uint32_t> TFileTransportIndex::findChunksByTime(int64_t fromMs, int64_t toMs) const {
+  std::vector<uint32_t> chunks;
+  for (const auto& entry : entries_) {
+    if (entry.maxTimestamp >= fromMs && entry.minTimestamp <= toMs) {
+      chunks.push_back(entry.chunk);
+    }
+  }
+  return chunks;
+}
+
+std::vector<uint32_t> TFileTransportIndex::findChunksByKey(int64_t minKey, int64_t maxKey) const {
+  std::vector<uint32_t> chunks;
+  for (const auto& entry : entries_) {
+    if (entry.numKeyedEvents > 0 && entry.maxKey >= minKey && entry.minKey <= maxKey) {
+      chunks.push_back(entry.chunk);
+    }
+  }
+  return chunks;
+}
+
 TFileProcessor::TFileProcessor(shared_ptr<TProcessor> processor,
                                shared_ptr<TProtocolFactory> protocolFactory,
                                shared_ptr<TFileReaderTransport> inputTransport)
@@ -25,7 +25,9 @@
 #include <thrift/TProcessor.h>
 
 #include <atomic>
+#include <functional>
 #include <string>
+#include <vector>
 #include <stdio.h>
 
 #include <thrift/concurrency/Mutex.h>
@@ -47,8 +49,10 @@ typedef struct eventInfo {
   uint8_t* eventBuff_;
   uint32_t eventSize_;
   uint32_t eventBuffPos_;
+  // enqueue time in milliseconds since the epoch, only set when indexing
+  int64_t eventTime_;
 
-  eventInfo() : eventBuff_(nullptr), eventSize_(0), eventBuffPos_(0){};
+  eventInfo() : eventBuff_(nullptr), eventSize_(0), eventBuffPos_(0), eventTime_(0){};
   ~eventInfo() {
     if (eventBuff_) {
       delete[] eventBuff_;
@@ -143,6 +147,69 @@ private:
   eventInfo** buffer_;
 };
 
+/**
+ * Summary of a single chunk of a log file, as stored in the sidecar index
+ * written next to it by TFileTransport ("<logfile>.idx"). The index holds one
+ * fixed-size record per chunk, at offset chunk * RECORD_SIZE; holes and
+ * records with numEvents == 0 describe chunks without events.
+ */
+struct TFileChunkIndexEntry {
+  uint32_t chunk;
+  uint32_t numEvents;
+  // number of events for which the key extractor produced a key
+  uint32_t numKeyedEvents;
+  int64_t minTimestamp;
+  int64_t maxTimestamp;
+  int64_t minKey;
+  int64_t maxKey;
+
+  static const uint32_t RECORD_SIZE = 48;
+
+  TFileChunkIndexEntry()
+    : chunk(0),
+      numEvents(0),
+      numKeyedEvents(0),
+      minTimestamp(0),
+      maxTimestamp(0),
+      minKey(0),
+      maxKey(0) {}
+
+  void encode(uint8_t* buf) const;
+  void decode(const uint8_t* buf);
+};
+
+/**
+ * Read-only view of the sidecar index of a log file, used to find the chunks
+ * holding events in a time or key range without scanning the log itself.
+ * Feed the returned chunk numbers to TFileReaderTransport::seekToChunk() and
+ * TFileProcessor::processChunk().
+ */
+class TFileTransportIndex {
+public:
+  /**
+   * Loads the index at indexPath. A missing index file yields an empty index.
+   */
+  TFileTransportIndex(const std::string& indexPath);
+
+  static std::string getIndexPath(const std::string& logPath) { return logPath + ".idx"; }
+
+  // re-reads the index file, e.g. while the log is still being written
+  void reload();
+
+  // entries for all chunks that contain events, in chunk order
+  const std::vector<TFileChunkIndexEntry>& getEntries() const { return entries_; }
+
+  // chunks holding events enqueued within [fromMs, toMs] (inclusive)
+  std::vector<uint32_t> findChunksByTime(int64_t fromMs, int64_t toMs) const;
+
+  // chunks holding events whose extracted key may lie within [minKey, maxKey]
+  std::vector<uint32_t> findChunksByKey(int64_t minKey, int64_t maxKey) const;
+
+private:
+  std::string indexPath_;
+  std::vector<TFileChunkIndexEntry> entries_;
+};
+
 /**
  * Abstract interface for transports used to read files
  */
@@ -255,6 +322,35 @@ public:
   }
   uint32_t getEofSleepTimeUs() { return eofSleepTime_; }
 
+  /**
+   * Extracts an application key from the payload of an event. Returns false
+   * if the event carries no key. Called on the writer thread.
+   */
+  typedef std::function<bool(const uint8_t* buf, uint32_t len, int64_t& key)> IndexKeyExtractor;
+
+  /**
+   * Makes the writer thread maintain a sidecar index of the log file (see
+   * TFileChunkIndexEntry) holding the event count, the enqueue time range
+   * and, if a key extractor is given, the key range of every chunk.
+   * Must be called before the first write.
+   */
+  void enableIndex(IndexKeyExtractor keyExtractor = IndexKeyExtractor()) {
+    if (bufferAndThreadInitialized_) {
+      GlobalOutput("Cannot enable the index after writer thread started");
+      return;
+    }
+    indexEnabled_ = true;
+    indexKeyExtractor_ = keyExtractor;
+  }
+  bool isIndexEnabled() const { return indexEnabled_; }
+
+  /**
+   * Uses the sidecar index to seek to the first chunk that holds events
+   * enqueued at or after timestampMs (milliseconds since the epoch).
+   * Returns false, leaving the read position untouched, if there is none.
+   */
+  bool seekToTimestamp(int64_t timestampMs);
+
   /*
    * Override TTransport *_virt() functions to invoke our implementations.
    * We cannot use TVirtualTransport to provide these, since we need to inherit
@@ -284,6 +380,12 @@ private:
   bool isEventCorrupted();
   void performRecovery();
 
+  // sidecar index maintenance, only used by the writer thread
+  void openIndexFile();
+  void closeIndexFile();
+  void updateIndex(off_t eventOffset, const eventInfo* event);
+  void writeIndexEntry();
+
   // Utility functions
   void openLogFile();
   std::chrono::time_point<std::chrono::steady_clock> getNextFlushTime();
@@ -370,6 +472,12 @@ private:
   uint32_t numCorruptedEventsInChunk_;
 
   bool readOnly_;
+
+  // sidecar index state
+  bool indexEnabled_;
+  IndexKeyExtractor indexKeyExtractor_;
+  int indexFd_;
+  TFileChunkIndexEntry indexEntry_;
 };
 
 // Exception thrown when EOF is hit
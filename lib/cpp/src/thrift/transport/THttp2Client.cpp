@@ -0,0 +1,378 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <nghttp2/nghttp2.h>
+
+#include <thrift/config.h>
+#include <thrift/transport/THttp2Client.h>
+
+using std::shared_ptr;
+using std::string;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+using concurrency::Guard;
+
+namespace {
+
+nghttp2_nv makeNv(const char* name, const string& value) {
+  nghttp2_nv nv;
+  nv.name = (uint8_t*)name;
+  nv.namelen = strlen(name);
+  nv.value = (uint8_t*)value.data();
+  nv.valuelen = value.size();
+  nv.flags = NGHTTP2_NV_FLAG_NONE;
+  return nv;
+}
+
+ssize_t readRequestBody(nghttp2_session*,
+                        int32_t,
+                        uint8_t* buf,
+                        size_t length,
+                        uint32_t* dataFlags,
+                        nghttp2_data_source* source,
+                        void*) {
+  THttp2ClientSession::Stream* stream = static_cast<THttp2ClientSession::Stream*>(source->ptr);
+  size_t give = stream->request.size() - stream->requestOffset;
+  if (give > length) {
+    give = length;
+  }
+  memcpy(buf, stream->request.data() + stream->requestOffset, give);
+  stream->requestOffset += give;
+  if (stream->requestOffset == stream->request.size()) {
+    *dataFlags |= NGHTTP2_DATA_FLAG_EOF;
+  }
+  return static_cast<ssize_t>(give);
+}
+}
+
+/**
+ * nghttp2 callbacks. These run inside nghttp2_session_send() and
+ * nghttp2_session_mem_recv(), always with the session mutex held, and must
+ * not let exceptions escape into C code.
+ */
+class THttp2ClientSession::Callbacks {
+public:
+  static ssize_t send(nghttp2_session*, const uint8_t* data, size_t length, int, void* userData) {
+    THttp2ClientSession* self = static_cast<THttp2ClientSession*>(userData);
+    try {
+      self->transport_->write(data, static_cast<uint32_t>(length));
+    } catch (const std::exception& e) {
+      self->error_ = e.what();
+      return NGHTTP2_ERR_CALLBACK_FAILURE;
+    }
+    return static_cast<ssize_t>(length);
+  }
+
+  static int onHeader(nghttp2_session* session,
+                      const nghttp2_frame* frame,
+                      const uint8_t* name,
+                      size_t namelen,
+                      const uint8_t* value,
+                      size_t valuelen,
+                      uint8_t,
+                      void*) {
+    if (frame->hd.type != NGHTTP2_HEADERS) {
+      return 0;
+    }
+    Stream* stream
+        = static_cast<Stream*>(nghttp2_session_get_stream_user_data(session, frame->hd.stream_id));
+    if (stream != nullptr && namelen == 7 && memcmp(name, ":status", 7) == 0) {
+      stream->status = atoi(string((const char*)value, valuelen).c_str());
+    }
+    return 0;
+  }
+
+  static int onDataChunk(nghttp2_session* session,
+                         uint8_t,
+                         int32_t streamId,
+                         const uint8_t* data,
+                         size_t len,
+                         void*) {
+    Stream* stream = static_cast<Stream*>(nghttp2_session_get_stream_user_data(session, streamId));
+    if (stream == nullptr) {
+      return 0;
+    }
+    if (stream->response.size() + len > stream->maxResponseSize) {
+      // Too large to buffer: reset the stream, and fail the call once it closes
+      stream->tooLarge = true;
+      string().swap(stream->response);
+      nghttp2_session_set_stream_user_data(session, streamId, nullptr);
+      return nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, streamId, NGHTTP2_INTERNAL_ERROR)
+                     == 0
+                 ? 0
+                 : NGHTTP2_ERR_CALLBACK_FAILURE;
+    }
+    stream->response.append((const char*)data, len);
+    return 0;
+  }
+
+  static int onStreamClose(nghttp2_session*, int32_t streamId, uint32_t errorCode, void* userData) {
+    THttp2ClientSession* self = static_cast<THttp2ClientSession*>(userData);
+    std::map<int32_t, shared_ptr<Stream> >::iterator it = self->streams_.find(streamId);
+    if (it != self->streams_.end()) {
+      it->second->closed = true;
+      it->second->errorCode = errorCode;
+      self->streams_.erase(it);
+    }
+    return 0;
+  }
+};
+
+THttp2ClientSession::THttp2ClientSession(shared_ptr<TTransport> transport,
+                                         string host,
+                                         string path)
+  : transport_(transport),
+    host_(host),
+    path_(path),
+    session_(nullptr),
+    monitor_(&mutex_),
+    pumping_(false) {
+  nghttp2_session_callbacks* callbacks;
+  if (nghttp2_session_callbacks_new(&callbacks) != 0) {
+    throw std::bad_alloc();
+  }
+  nghttp2_session_callbacks_set_send_callback(callbacks, &Callbacks::send);
+  nghttp2_session_callbacks_set_on_header_callback(callbacks, &Callbacks::onHeader);
+  nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, &Callbacks::onDataChunk);
+  nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, &Callbacks::onStreamClose);
+  int rv = nghttp2_session_client_new(&session_, callbacks, this);
+  nghttp2_session_callbacks_del(callbacks);
+  if (rv != 0) {
+    throw TTransportException(string("nghttp2_session_client_new: ") + nghttp2_strerror(rv));
+  }
+  nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, nullptr, 0);
+}
+
+THttp2ClientSession::~THttp2ClientSession() {
+  nghttp2_session_del(session_);
+}
+
+void THttp2ClientSession::open() {
+  Guard g(mutex_);
+  if (!transport_->isOpen()) {
+    transport_->open();
+  }
+  // Connection preface and SETTINGS
+  sendPending();
+}
+
+bool THttp2ClientSession::isOpen() const {
+  return transport_->isOpen();
+}
+
+void THttp2ClientSession::close() {
+  Guard g(mutex_);
+  if (transport_->isOpen()) {
+    if (error_.empty()) {
+      nghttp2_session_terminate_session(session_, NGHTTP2_NO_ERROR);
+      try {
+        sendPending();
+      } catch (const TTransportException&) {
+        // closing anyway
+      }
+    }
+    transport_->close();
+  }
+  fail("THttp2ClientSession closed");
+}
+
+shared_ptr<THttp2ClientSession::Stream> THttp2ClientSession::submit(const uint8_t* buf,
+                                                                    uint32_t len,
+                                                                    size_t maxResponseSize) {
+  shared_ptr<Stream> stream(new Stream);
+  stream->request.assign((const char*)buf, len);
+  stream->maxResponseSize = maxResponseSize;
+
+  char contentLength[16];
+  snprintf(contentLength, sizeof(contentLength), "%u", len);
+  static const string post("POST");
+  static const string http("http");
+  static const string contentType("application/x-thrift");
+  static const string userAgent("Thrift/" PACKAGE_VERSION " (C++/THttp2Client)");
+  const string length(contentLength);
+  nghttp2_nv headers[] = {makeNv(":method", post),
+                          makeNv(":scheme", http),
+                          makeNv(":authority", host_),
+                          makeNv(":path", path_),
+                          makeNv("content-type", contentType),
+                          makeNv("accept", contentType),
+                          makeNv("content-length", length),
+                          makeNv("user-agent", userAgent)};
+
+  nghttp2_data_provider body;
+  body.source.ptr = stream.get();
+  body.read_callback = &readRequestBody;
+
+  Guard g(mutex_);
+  if (!error_.empty()) {
+    throw TTransportException(TTransportException::NOT_OPEN, error_);
+  }
+  int32_t id = nghttp2_submit_request(session_,
+                                      nullptr,
+                                      headers,
+                                      sizeof(headers) / sizeof(headers[0]),
+                                      &body,
+                                      stream.get());
+  if (id < 0) {
+    throw TTransportException(string("nghttp2_submit_request: ") + nghttp2_strerror(id));
+  }
+  streams_[id] = stream;
+  sendPending();
+  return stream;
+}
+
+void THttp2ClientSession::wait(const shared_ptr<Stream>& stream) {
+  Guard g(mutex_);
+  while (!stream->closed) {
+    if (pumping_) {
+      monitor_.wait();
+      continue;
+    }
+    pumping_ = true;
+    try {
+      pump(stream);
+    } catch (...) {
+      pumping_ = false;
+      monitor_.notifyAll();
+      throw;
+    }
+    pumping_ = false;
+    // let another waiter take over reading the connection
+    monitor_.notifyAll();
+  }
+}
+
+void THttp2ClientSession::pump(const shared_ptr<Stream>& stream) {
+  uint8_t buf[16384];
+  while (!stream->closed) {
+    uint32_t got;
+    // Read without the lock so other threads can keep submitting calls
+    mutex_.unlock();
+    try {
+      got = transport_->read(buf, sizeof(buf));
+    } catch (const TTransportException& e) {
+      mutex_.lock();
+      fail(e.what());
+      throw;
+    }
+    mutex_.lock();
+
+    if (got == 0) {
+      fail("THttp2ClientSession: connection closed by peer");
+      throw TTransportException(TTransportException::END_OF_FILE, error_);
+    }
+    ssize_t rv = nghttp2_session_mem_recv(session_, buf, got);
+    if (rv < 0) {
+      fail(string("nghttp2_session_mem_recv: ") + nghttp2_strerror(static_cast<int>(rv)));
+      throw TTransportException(TTransportException::CORRUPTED_DATA, error_);
+    }
+    // SETTINGS acks, WINDOW_UPDATEs and request data unblocked by them
+    sendPending();
+    monitor_.notifyAll();
+  }
+}
+
+void THttp2ClientSession::sendPending() {
+  int rv = nghttp2_session_send(session_);
+  if (rv != 0) {
+    if (error_.empty()) {
+      error_ = string("nghttp2_session_send: ") + nghttp2_strerror(rv);
+    }
+    string message = error_;
+    fail(message);
+    throw TTransportException(TTransportException::UNKNOWN, message);
+  }
+  transport_->flush();
+}
+
+void THttp2ClientSession::fail(const string& message) {
+  if (error_.empty()) {
+    error_ = message;
+  }
+  for (std::map<int32_t, shared_ptr<Stream> >::iterator it = streams_.begin();
+       it != streams_.end();
+       ++it) {
+    it->second->closed = true;
+    it->second->errorCode = NGHTTP2_INTERNAL_ERROR;
+  }
+  streams_.clear();
+  monitor_.notifyAll();
+}
+
+THttp2Client::THttp2Client(shared_ptr<THttp2ClientSession> session,
+                           shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config), session_(session) {
+}
+
+THttp2Client::~THttp2Client() = default;
+
+uint32_t THttp2Client::read(uint8_t* buf, uint32_t len) {
+  checkReadBytesAvailable(len);
+  if (readBuffer_.available_read() == 0) {
+    if (!pending_) {
+      return 0;
+    }
+    shared_ptr<THttp2ClientSession::Stream> stream = pending_;
+    pending_.reset();
+    session_->wait(stream);
+    if (stream->tooLarge) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "HTTP/2 response larger than MaxMessageSize");
+    }
+    if (stream->errorCode != NGHTTP2_NO_ERROR) {
+      char code[16];
+      snprintf(code, sizeof(code), "%u", stream->errorCode);
+      throw TTransportException(TTransportException::END_OF_FILE,
+                                string("HTTP/2 stream reset, error code ") + code);
+    }
+    if (stream->status != 200) {
+      char status[16];
+      snprintf(status, sizeof(status), "%d", stream->status);
+      throw TTransportException(string("Bad Status: ") + status);
+    }
+    readBuffer_.resetBuffer();
+    readBuffer_.write((const uint8_t*)stream->response.data(),
+                      static_cast<uint32_t>(stream->response.size()));
+  }
+  return readBuffer_.read(buf, len);
+}
+
+void THttp2Client::write(const uint8_t* buf, uint32_t len) {
+  writeBuffer_.write(buf, len);
+}
+
+void THttp2Client::flush() {
+  resetConsumedMessageSize();
+  uint8_t* buf;
+  uint32_t len;
+  writeBuffer_.getBuffer(&buf, &len);
+  // A oneway call never reads its reply; the session drops it on arrival
+  pending_ = session_->submit(buf, len, static_cast<size_t>(getMaxMessageSize()));
+  writeBuffer_.resetBuffer();
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,162 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_THTTP2CLIENT_H_
+#define _THRIFT_TRANSPORT_THTTP2CLIENT_H_ 1
+
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+struct nghttp2_session;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * @brief One HTTP/2 connection shared by any number of THttp2Client
+ * transports. Every call is sent as its own stream, so calls made from
+ * different threads run concurrently over the same connection. Framing,
+ * HPACK header compression and flow control are provided by nghttp2.
+ *
+ * The wrapped transport must allow one thread to read while another writes,
+ * which holds for TSocket. Whichever caller is waiting for a response reads
+ * from the connection on behalf of all of them.
+ */
+class THttp2ClientSession {
+public:
+  /**
+   * State of a single call. Owned jointly by the session, until the stream
+   * closes, and by the THttp2Client waiting on it.
+   */
+  struct Stream {
+    Stream()
+      : requestOffset(0),
+        maxResponseSize(std::numeric_limits<size_t>::max()),
+        status(0),
+        closed(false),
+        errorCode(0),
+        tooLarge(false) {}
+
+    std::string request;
+    size_t requestOffset;
+    std::string response;
+    size_t maxResponseSize;
+    int status;
+    bool closed;
+    uint32_t errorCode;
+    // the response outgrew maxResponseSize, so the stream was reset
+    bool tooLarge;
+  };
+
+  THttp2ClientSession(std::shared_ptr<TTransport> transport,
+                      std::string host = "localhost",
+                      std::string path = "/service");
+
+  ~THttp2ClientSession();
+
+  void open();
+
+  bool isOpen() const;
+
+  /**
+   * Sends GOAWAY and closes the connection. Calls still in flight fail and
+   * the session cannot be reopened.
+   */
+  void close();
+
+  /**
+   * Starts a call with the given body and returns immediately. A response
+   * longer than maxResponseSize resets the stream instead of being buffered.
+   */
+  std::shared_ptr<Stream> submit(const uint8_t* buf,
+                                 uint32_t len,
+                                 size_t maxResponseSize = std::numeric_limits<size_t>::max());
+
+  /**
+   * Blocks until the stream has closed, reading from the connection if no
+   * other caller is doing so already.
+   */
+  void wait(const std::shared_ptr<Stream>& stream);
+
+private:
+  class Callbacks;
+
+  void sendPending();
+  void pump(const std::shared_ptr<Stream>& stream);
+  void fail(const std::string& message);
+
+  std::shared_ptr<TTransport> transport_;
+  std::string host_;
+  std::string path_;
+  nghttp2_session* session_;
+  std::map<int32_t, std::shared_ptr<Stream> > streams_;
+
+  concurrency::Mutex mutex_;
+  concurrency::Monitor monitor_;
+  bool pumping_;
+  std::string error_;
+};
+
+/**
+ * @brief Client transport that sends each flushed message as one stream of
+ * a shared THttp2ClientSession. Use one THttp2Client per concurrent caller.
+ * Closing the client does not close the shared session. A response longer
+ * than the configuration's MaxMessageSize resets its stream, and reading it
+ * throws CORRUPTED_DATA.
+ */
+class THttp2Client : public TVirtualTransport<THttp2Client> {
+public:
+  THttp2Client(std::shared_ptr<THttp2ClientSession> session,
+               std::shared_ptr<TConfiguration> config = nullptr);
+
+  ~THttp2Client() override;
+
+  void open() override { session_->open(); }
+
+  bool isOpen() const override { return session_->isOpen(); }
+
+  void close() override { pending_.reset(); }
+
+  uint32_t read(uint8_t* buf, uint32_t len);
+
+  void write(const uint8_t* buf, uint32_t len);
+
+  void flush() override;
+
+  std::shared_ptr<THttp2ClientSession> getSession() const { return session_; }
+
+protected:
+  std::shared_ptr<THttp2ClientSession> session_;
+  std::shared_ptr<THttp2ClientSession::Stream> pending_;
+
+  TMemoryBuffer writeBuffer_;
+  TMemoryBuffer readBuffer_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_THTTP2CLIENT_H_
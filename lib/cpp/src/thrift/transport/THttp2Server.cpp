@@ -0,0 +1,294 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <nghttp2/nghttp2.h>
+
+#include <thrift/transport/THttp2Server.h>
+
+using std::shared_ptr;
+using std::string;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+namespace {
+
+nghttp2_nv makeNv(const char* name, const string& value) {
+  nghttp2_nv nv;
+  nv.name = (uint8_t*)name;
+  nv.namelen = strlen(name);
+  nv.value = (uint8_t*)value.data();
+  nv.valuelen = value.size();
+  nv.flags = NGHTTP2_NV_FLAG_NONE;
+  return nv;
+}
+}
+
+/**
+ * nghttp2 callbacks; they must not let exceptions escape into C code.
+ */
+class THttp2Server::Callbacks {
+public:
+  static ssize_t send(nghttp2_session*, const uint8_t* data, size_t length, int, void* userData) {
+    THttp2Server* self = static_cast<THttp2Server*>(userData);
+    try {
+      self->transport_->write(data, static_cast<uint32_t>(length));
+    } catch (const std::exception& e) {
+      self->error_ = e.what();
+      return NGHTTP2_ERR_CALLBACK_FAILURE;
+    }
+    return static_cast<ssize_t>(length);
+  }
+
+  static int onBeginHeaders(nghttp2_session* session, const nghttp2_frame* frame, void* userData) {
+    THttp2Server* self = static_cast<THttp2Server*>(userData);
+    int32_t id = frame->hd.stream_id;
+    if (frame->hd.type != NGHTTP2_HEADERS || self->streams_.count(id) != 0) {
+      // trailers of a request we already track
+      return 0;
+    }
+    shared_ptr<Request> request(new Request(id));
+    self->streams_[id] = request;
+    nghttp2_session_set_stream_user_data(session, id, request.get());
+    return 0;
+  }
+
+  static int onDataChunk(nghttp2_session* session,
+                         uint8_t,
+                         int32_t streamId,
+                         const uint8_t* data,
+                         size_t len,
+                         void* userData) {
+    THttp2Server* self = static_cast<THttp2Server*>(userData);
+    Request* request
+        = static_cast<Request*>(nghttp2_session_get_stream_user_data(session, streamId));
+    if (request == nullptr) {
+      return 0;
+    }
+    if (request->body.size() + len > static_cast<size_t>(self->getMaxMessageSize())) {
+      // Too large to buffer: refuse the stream, not the whole connection
+      nghttp2_session_set_stream_user_data(session, streamId, nullptr);
+      self->streams_.erase(streamId);
+      return nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, streamId, NGHTTP2_REFUSED_STREAM)
+                     == 0
+                 ? 0
+                 : NGHTTP2_ERR_CALLBACK_FAILURE;
+    }
+    request->body.append((const char*)data, len);
+    return 0;
+  }
+
+  static int onFrameRecv(nghttp2_session*, const nghttp2_frame* frame, void* userData) {
+    THttp2Server* self = static_cast<THttp2Server*>(userData);
+    if ((frame->hd.type == NGHTTP2_DATA || frame->hd.type == NGHTTP2_HEADERS)
+        && (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) != 0) {
+      std::map<int32_t, shared_ptr<Request> >::iterator it = self->streams_.find(frame->hd.stream_id);
+      if (it != self->streams_.end()) {
+        self->ready_.push_back(it->second);
+      }
+    }
+    return 0;
+  }
+
+  static int onStreamClose(nghttp2_session*, int32_t streamId, uint32_t, void* userData) {
+    THttp2Server* self = static_cast<THttp2Server*>(userData);
+    std::map<int32_t, shared_ptr<Request> >::iterator it = self->streams_.find(streamId);
+    if (it != self->streams_.end()) {
+      it->second->closed = true;
+      self->streams_.erase(it);
+    }
+    return 0;
+  }
+
+  static ssize_t readResponseBody(nghttp2_session*,
+                                  int32_t,
+                                  uint8_t* buf,
+                                  size_t length,
+                                  uint32_t* dataFlags,
+                                  nghttp2_data_source* source,
+                                  void*) {
+    Request* request = static_cast<Request*>(source->ptr);
+    size_t give = request->response.size() - request->responseOffset;
+    if (give > length) {
+      give = length;
+    }
+    memcpy(buf, request->response.data() + request->responseOffset, give);
+    request->responseOffset += give;
+    if (request->responseOffset == request->response.size()) {
+      *dataFlags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return static_cast<ssize_t>(give);
+  }
+};
+
+THttp2Server::THttp2Server(shared_ptr<TTransport> transport,
+                           shared_ptr<TConfiguration> config,
+                           uint32_t maxConcurrentStreams)
+  : TVirtualTransport(config), transport_(transport), session_(nullptr) {
+  nghttp2_session_callbacks* callbacks;
+  if (nghttp2_session_callbacks_new(&callbacks) != 0) {
+    throw std::bad_alloc();
+  }
+  nghttp2_session_callbacks_set_send_callback(callbacks, &Callbacks::send);
+  nghttp2_session_callbacks_set_on_begin_headers_callback(callbacks, &Callbacks::onBeginHeaders);
+  nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, &Callbacks::onDataChunk);
+  nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, &Callbacks::onFrameRecv);
+  nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, &Callbacks::onStreamClose);
+  int rv = nghttp2_session_server_new(&session_, callbacks, this);
+  nghttp2_session_callbacks_del(callbacks);
+  if (rv != 0) {
+    throw TTransportException(string("nghttp2_session_server_new: ") + nghttp2_strerror(rv));
+  }
+
+  nghttp2_settings_entry settings[] = {{NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS,
+                                        maxConcurrentStreams}};
+  nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, settings, 1);
+}
+
+THttp2Server::~THttp2Server() {
+  nghttp2_session_del(session_);
+}
+
+bool THttp2Server::peek() {
+  if (readBuffer_.available_read() > 0 || !ready_.empty()) {
+    return true;
+  }
+  return transport_->peek();
+}
+
+void THttp2Server::close() {
+  if (!transport_->isOpen()) {
+    return;
+  }
+  if (error_.empty()) {
+    try {
+      if (current_) {
+        respond(nullptr, 0);
+      }
+      nghttp2_session_terminate_session(session_, NGHTTP2_NO_ERROR);
+      sendPending();
+    } catch (const TTransportException&) {
+      // closing anyway
+    }
+  }
+  transport_->close();
+}
+
+uint32_t THttp2Server::read(uint8_t* buf, uint32_t len) {
+  checkReadBytesAvailable(len);
+  if (readBuffer_.available_read() == 0) {
+    if (current_) {
+      // The last request was oneway; close its stream with an empty reply
+      respond(nullptr, 0);
+    }
+    while (ready_.empty()) {
+      if (!pump()) {
+        return 0;
+      }
+    }
+    current_ = ready_.front();
+    ready_.pop_front();
+    readBuffer_.resetBuffer();
+    readBuffer_.write((const uint8_t*)current_->body.data(),
+                      static_cast<uint32_t>(current_->body.size()));
+  }
+  return readBuffer_.read(buf, len);
+}
+
+void THttp2Server::write(const uint8_t* buf, uint32_t len) {
+  writeBuffer_.write(buf, len);
+}
+
+void THttp2Server::flush() {
+  resetConsumedMessageSize();
+  uint8_t* buf;
+  uint32_t len;
+  writeBuffer_.getBuffer(&buf, &len);
+  if (current_) {
+    respond(buf, len);
+  }
+  writeBuffer_.resetBuffer();
+}
+
+bool THttp2Server::pump() {
+  uint8_t buf[16384];
+  uint32_t got = transport_->read(buf, sizeof(buf));
+  if (got == 0) {
+    return false;
+  }
+  ssize_t rv = nghttp2_session_mem_recv(session_, buf, got);
+  if (rv < 0) {
+    error_ = string("nghttp2_session_mem_recv: ") + nghttp2_strerror(static_cast<int>(rv));
+    throw TTransportException(TTransportException::CORRUPTED_DATA, error_);
+  }
+  // SETTINGS acks, WINDOW_UPDATEs and response data unblocked by them
+  sendPending();
+  return true;
+}
+
+void THttp2Server::respond(const uint8_t* buf, uint32_t len) {
+  shared_ptr<Request> request = current_;
+  current_.reset();
+  if (request->closed) {
+    // the client reset the stream while we were processing it
+    return;
+  }
+  request->response.assign((const char*)buf, len);
+
+  char contentLength[16];
+  snprintf(contentLength, sizeof(contentLength), "%u", len);
+  static const string ok("200");
+  static const string contentType("application/x-thrift");
+  const string length(contentLength);
+  nghttp2_nv headers[] = {makeNv(":status", ok),
+                          makeNv("content-type", contentType),
+                          makeNv("content-length", length)};
+
+  nghttp2_data_provider body;
+  body.source.ptr = request.get();
+  body.read_callback = &Callbacks::readResponseBody;
+
+  int rv = nghttp2_submit_response(session_,
+                                   request->id,
+                                   headers,
+                                   sizeof(headers) / sizeof(headers[0]),
+                                   &body);
+  if (rv != 0) {
+    throw TTransportException(string("nghttp2_submit_response: ") + nghttp2_strerror(rv));
+  }
+  sendPending();
+}
+
+void THttp2Server::sendPending() {
+  int rv = nghttp2_session_send(session_);
+  if (rv != 0) {
+    if (error_.empty()) {
+      error_ = string("nghttp2_session_send: ") + nghttp2_strerror(rv);
+    }
+    throw TTransportException(TTransportException::UNKNOWN, error_);
+  }
+  transport_->flush();
+}
+}
+}
+} // apache::thrift::transport
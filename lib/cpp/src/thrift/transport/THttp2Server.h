@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_THTTP2SERVER_H_
+#define _THRIFT_TRANSPORT_THTTP2SERVER_H_ 1
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+struct nghttp2_session;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * @brief Server side of an HTTP/2 connection. Requests arriving on
+ * concurrent streams are queued as they complete and handed to the
+ * processor one at a time, so any TServer and protocol factory can serve
+ * them; each flush() answers the stream whose request was read last.
+ * A request body longer than the configuration's MaxMessageSize is not
+ * buffered: its stream is reset with REFUSED_STREAM.
+ */
+class THttp2Server : public TVirtualTransport<THttp2Server> {
+public:
+  THttp2Server(std::shared_ptr<TTransport> transport,
+               std::shared_ptr<TConfiguration> config = nullptr,
+               uint32_t maxConcurrentStreams = 100);
+
+  ~THttp2Server() override;
+
+  void open() override { transport_->open(); }
+
+  bool isOpen() const override { return transport_->isOpen(); }
+
+  bool peek() override;
+
+  void close() override;
+
+  uint32_t read(uint8_t* buf, uint32_t len);
+
+  void write(const uint8_t* buf, uint32_t len);
+
+  void flush() override;
+
+  const std::string getOrigin() const override { return transport_->getOrigin(); }
+
+protected:
+  struct Request {
+    Request(int32_t id) : id(id), responseOffset(0), closed(false) {}
+
+    int32_t id;
+    std::string body;
+    std::string response;
+    size_t responseOffset;
+    bool closed;
+  };
+
+  std::shared_ptr<TTransport> transport_;
+  nghttp2_session* session_;
+  std::map<int32_t, std::shared_ptr<Request> > streams_;
+  std::deque<std::shared_ptr<Request> > ready_;
+  std::shared_ptr<Request> current_;
+  std::string error_;
+
+  TMemoryBuffer writeBuffer_;
+  TMemoryBuffer readBuffer_;
+
+private:
+  class Callbacks;
+
+  bool pump();
+  void respond(const uint8_t* buf, uint32_t len);
+  void sendPending();
+};
+
+/**
+ * Wraps a transport into HTTP/2
+ */
+class THttp2ServerTransportFactory : public TTransportFactory {
+public:
+  THttp2ServerTransportFactory() = default;
+
+  ~THttp2ServerTransportFactory() override = default;
+
+  std::shared_ptr<TTransport> getTransport(std::shared_ptr<TTransport> trans) override {
+    return std::shared_ptr<TTransport>(new THttp2Server(trans));
+  }
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_THTTP2SERVER_H_
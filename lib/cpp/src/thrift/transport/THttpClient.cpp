@@ -18,6 +18,7 @@
  */
 
 #include <limits>
+#include <cstdio>
 #include <cstdlib>
 #include <sstream>
 #include <boost/algorithm/string.hpp>
@@ -39,6 +40,7 @@ THttpClient::THttpClient(std::shared_ptr<TTransport> transport,
   : THttpTransport(transport, config),
     host_(host), 
     path_(path) {
+  buildHeaderPrefix();
 }
 
 THttpClient::THttpClient(string host, int port, string path, 
@@ -46,6 +48,7 @@ THttpClient::THttpClient(string host, int port, string path,
   : THttpTransport(std::shared_ptr<TTransport>(new TSocket(host, port)), config),
     host_(host),
     path_(path) {
+  buildHeaderPrefix();
 }
 
 THttpClient::~THttpClient() = default;
@@ -103,18 +106,18 @@ void THttpClient::flush() {
   uint32_t len;
   writeBuffer_.getBuffer(&buf, &len);
 
-  // Construct the HTTP header
-  std::ostringstream h;
-  h << "POST " << path_ << " HTTP/1.1" << CRLF << "Host: " << host_ << CRLF
-    << "Content-Type: application/x-thrift" << CRLF << "Content-Length: " << len << CRLF
-    << "Accept: application/x-thrift" << CRLF << "User-Agent: Thrift/" << PACKAGE_VERSION
-    << " (C++/THttpClient)" << CRLF << CRLF;
-  string header = h.str();
+  // Construct the HTTP header; only Content-Length changes between requests
+  char contentLength[16];
+  snprintf(contentLength, sizeof(contentLength), "%u", len);
+  header_.assign(headerPrefix_);
+  header_.append(contentLength);
+  header_.append(CRLF, CRLF_LEN);
+  header_.append(CRLF, CRLF_LEN);
 
-  if (header.size() > (std::numeric_limits<uint32_t>::max)())
+  if (header_.size() > (std::numeric_limits<uint32_t>::max)())
     throw TTransportException("Header too big");
   // Write the header, then the data, then flush
-  transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
+  transport_->write((const uint8_t*)header_.data(), static_cast<uint32_t>(header_.size()));
   transport_->write(buf, len);
   transport_->flush();
 
@@ -125,6 +128,16 @@ void THttpClient::flush() {
 
 void THttpClient::setPath(std::string path) {
   path_ = path;
+  buildHeaderPrefix();
+}
+
+void THttpClient::buildHeaderPrefix() {
+  std::ostringstream h;
+  h << "POST " << path_ << " HTTP/1.1" << CRLF << "Host: " << host_ << CRLF
+    << "Content-Type: application/x-thrift" << CRLF << "Accept: application/x-thrift" << CRLF
+    << "User-Agent: Thrift/" << PACKAGE_VERSION << " (C++/THttpClient)" << CRLF
+    << "Content-Length: ";
+  headerPrefix_ = h.str();
 }
 }
 }
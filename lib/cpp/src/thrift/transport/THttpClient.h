@@ -61,6 +61,15 @@ protected:
   std::string host_;
   std::string path_;
 
+  /**
+   * Request header up to and including "Content-Length: ", rebuilt only when
+   * the path changes. Call buildHeaderPrefix() after modifying host_ or path_.
+   */
+  std::string headerPrefix_;
+  std::string header_;
+
+  void buildHeaderPrefix();
+
   void parseHeader(char* header) override;
   bool parseStatusLine(char* status) override;
 };
@@ -17,6 +17,7 @@
  * under the License.
  */
 
+#include <cstdio>
 #include <cstdlib>
 #include <sstream>
 #include <iostream>
@@ -35,7 +36,7 @@ namespace thrift {
 namespace transport {
 
 THttpServer::THttpServer(std::shared_ptr<TTransport> transport, std::shared_ptr<TConfiguration> config) 
-  : THttpTransport(transport, config) {
+  : THttpTransport(transport, config), dateTime_(0) {
 
 }
 
@@ -141,12 +142,20 @@ void THttpServer::flush() {
 }
 
 std::string THttpServer::getHeader(uint32_t len) {
-  std::ostringstream h;
-  h << "HTTP/1.1 200 OK" << CRLF << "Date: " << getTimeRFC1123() << CRLF << "Server: Thrift/"
-    << PACKAGE_VERSION << CRLF << "Access-Control-Allow-Origin: *" << CRLF
-    << "Content-Type: application/x-thrift" << CRLF << "Content-Length: " << len << CRLF
-    << "Connection: Keep-Alive" << CRLF << CRLF;
-  return h.str();
+  char contentLength[16];
+  snprintf(contentLength, sizeof(contentLength), "%u", len);
+
+  std::string h;
+  h.reserve(256);
+  h.append("HTTP/1.1 200 OK").append(CRLF);
+  h.append("Date: ").append(getTimeRFC1123()).append(CRLF);
+  h.append("Server: Thrift/" PACKAGE_VERSION).append(CRLF);
+  h.append("Access-Control-Allow-Origin: *").append(CRLF);
+  h.append("Content-Type: application/x-thrift").append(CRLF);
+  h.append("Content-Length: ").append(contentLength).append(CRLF);
+  h.append("Connection: Keep-Alive").append(CRLF);
+  h.append(CRLF);
+  return h;
 }
 
 std::string THttpServer::getTimeRFC1123() {
@@ -156,6 +165,10 @@ std::string THttpServer::getTimeRFC1123() {
   char buff[128];
 
   time_t t = time(nullptr);
+  if (t == dateTime_ && !date_.empty()) {
+    // Keep-alive connections answer many calls per second
+    return date_;
+  }
   struct tm tmb;
   THRIFT_GMTIME(tmb, t);
 
@@ -168,7 +181,9 @@ std::string THttpServer::getTimeRFC1123() {
           tmb.tm_hour,
           tmb.tm_min,
           tmb.tm_sec);
-  return std::string(buff);
+  dateTime_ = t;
+  date_ = buff;
+  return date_;
 }
 }
 }
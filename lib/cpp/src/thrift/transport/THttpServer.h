@@ -20,6 +20,8 @@
 #ifndef _THRIFT_TRANSPORT_THTTPSERVER_H_
 #define _THRIFT_TRANSPORT_THTTPSERVER_H_ 1
 
+#include <ctime>
+
 #include <thrift/transport/THttpTransport.h>
 
 namespace apache {
@@ -40,6 +42,10 @@ protected:
   void parseHeader(char* header) override;
   bool parseStatusLine(char* status) override;
   std::string getTimeRFC1123();
+
+private:
+  time_t dateTime_;
+  std::string date_;
 };
 
 /**
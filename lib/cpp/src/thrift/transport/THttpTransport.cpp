@@ -17,6 +17,8 @@
  * under the License.
  */
 
+#include <cstring>
+#include <limits>
 #include <sstream>
 
 #include <thrift/transport/THttpTransport.h>
@@ -73,6 +75,15 @@ uint32_t THttpTransport::read(uint8_t* buf, uint32_t len) {
   return readBuffer_.read(buf, len);
 }
 
+bool THttpTransport::peek() {
+  // A pipelined request may already be sitting in our buffers, in which case
+  // the underlying transport has nothing more to say until we answer it
+  if (readBuffer_.available_read() > 0 || httpPos_ < httpBufLen_) {
+    return true;
+  }
+  return transport_->peek();
+}
+
 uint32_t THttpTransport::readEnd() {
   // Read any pending chunked data (footers etc.)
   if (chunked_) {
@@ -125,7 +136,7 @@ void THttpTransport::readChunkedFooters() {
   // End of data, read footer lines until a blank one appears
   while (true) {
     char* line = readLine();
-    if (strlen(line) == 0) {
+    if (*line == '\0') {
       chunkedDone_ = true;
       break;
     }
@@ -137,9 +148,11 @@ uint32_t THttpTransport::parseChunkSize(char* line) {
   if (semi != nullptr) {
     *semi = '\0';
   }
-  uint32_t size = 0;
-  sscanf(line, "%x", &size);
-  return size;
+  unsigned long size = strtoul(line, nullptr, 16);
+  if (size > (std::numeric_limits<uint32_t>::max)()) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA, "Chunk size too large");
+  }
+  return static_cast<uint32_t>(size);
 }
 
 uint32_t THttpTransport::readContent(uint32_t size) {
@@ -150,6 +163,20 @@ uint32_t THttpTransport::readContent(uint32_t size) {
       // We have given all the data, reset position to head of the buffer
       httpPos_ = 0;
       httpBufLen_ = 0;
+      httpBuf_[0] = '\0';
+
+      if (need >= httpBufSize_) {
+        // Large bodies and chunks go straight from the transport into the
+        // read buffer instead of being staged through httpBuf_ first
+        uint32_t got = transport_->read(readBuffer_.getWritePtr(need), need);
+        if (got == 0) {
+          throw TTransportException(TTransportException::END_OF_FILE, "Could not read content");
+        }
+        readBuffer_.wroteBytes(got);
+        need -= got;
+        continue;
+      }
+
       refill();
 
       // Now have available however much we read
@@ -167,14 +194,30 @@ uint32_t THttpTransport::readContent(uint32_t size) {
 }
 
 char* THttpTransport::readLine() {
+  // Lines end with CRLF; scan for the '\n' with memchr and confirm the
+  // preceding '\r' rather than running strstr() over the whole buffer.
+  uint32_t scanPos = httpPos_;
   while (true) {
     char* eol = nullptr;
-
-    eol = strstr(httpBuf_ + httpPos_, CRLF);
+    char* scan = httpBuf_ + scanPos;
+    char* end = httpBuf_ + httpBufLen_;
+    while (scan < end) {
+      char* lf = static_cast<char*>(memchr(scan, '\n', end - scan));
+      if (lf == nullptr) {
+        break;
+      }
+      if (lf > httpBuf_ + httpPos_ && *(lf - 1) == '\r') {
+        eol = lf - 1;
+        break;
+      }
+      scan = lf + 1;
+    }
 
     // No CRLF yet?
     if (eol == nullptr) {
-      // Shift whatever we have now to front and refill
+      // Shift whatever we have now to front and refill, then only scan
+      // the newly arrived bytes
+      scanPos = httpBufLen_ - httpPos_;
       shift();
       refill();
     } else {
@@ -236,7 +279,7 @@ void THttpTransport::readHeaders() {
   while (true) {
     char* line = readLine();
 
-    if (strlen(line) == 0) {
+    if (*line == '\0') {
       if (finished) {
         readHeaders_ = false;
         return;
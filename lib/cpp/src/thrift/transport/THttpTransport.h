@@ -44,7 +44,7 @@ public:
 
   bool isOpen() const override { return transport_->isOpen(); }
 
-  bool peek() override { return transport_->peek(); }
+  bool peek() override;
 
   void close() override { transport_->close(); }
 
@@ -67,6 +67,8 @@ public:
 
 protected:
   std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET socket) override;
+  std::shared_ptr<TNonblockingServerSocket> createServerSocket(const std::string& address,
+                                                               int port) override;
   std::shared_ptr<TSSLSocketFactory> factory_;
 };
 }
@@ -47,6 +47,7 @@
 #include <thrift/transport/PlatformSocket.h>
 #include <thrift/transport/TNonblockingServerSocket.h>
 #include <thrift/transport/TSocket.h>
+#include <thrift/transport/TSocketHandoff.h>
 #include <thrift/transport/TSocketUtils.h>
 #include <thrift/transport/SocketCommon.h>
 
@@ -83,6 +84,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port)
   : port_(port),
     listenPort_(port),
     serverSocket_(THRIFT_INVALID_SOCKET),
+    adoptedSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
     sendTimeout_(0),
     recvTimeout_(0),
@@ -91,13 +93,16 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
-    listening_(false) {
+    reusePort_(false),
+    listening_(false),
+    handedOff_(false) {
 }
 
 TNonblockingServerSocket::TNonblockingServerSocket(int port, int sendTimeout, int recvTimeout)
   : port_(port),
     listenPort_(port),
     serverSocket_(THRIFT_INVALID_SOCKET),
+    adoptedSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
     sendTimeout_(sendTimeout),
     recvTimeout_(recvTimeout),
@@ -106,7 +111,9 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port, int sendTimeout, in
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
-    listening_(false) {
+    reusePort_(false),
+    listening_(false),
+    handedOff_(false) {
 }
 
 TNonblockingServerSocket::TNonblockingServerSocket(const string& address, int port)
@@ -114,6 +121,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& address, int po
     listenPort_(port),
     address_(address),
     serverSocket_(THRIFT_INVALID_SOCKET),
+    adoptedSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
     sendTimeout_(0),
     recvTimeout_(0),
@@ -122,7 +130,9 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& address, int po
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
-    listening_(false) {
+    reusePort_(false),
+    listening_(false),
+    handedOff_(false) {
 }
 
 TNonblockingServerSocket::TNonblockingServerSocket(const string& path)
@@ -130,6 +140,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& path)
     listenPort_(0),
     path_(path),
     serverSocket_(THRIFT_INVALID_SOCKET),
+    adoptedSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
     sendTimeout_(0),
     recvTimeout_(0),
@@ -138,7 +149,9 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& path)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
-    listening_(false) {
+    reusePort_(false),
+    listening_(false),
+    handedOff_(false) {
 }
 
 TNonblockingServerSocket::~TNonblockingServerSocket() {
@@ -299,6 +312,22 @@ void TNonblockingServerSocket::_setup_tcp_sockopts() {
   }
 #endif
 
+  if (reusePort_) {
+#ifdef SO_REUSEPORT
+    if (-1 == setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEPORT, cast_sockopt(&one), sizeof(one))) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      GlobalOutput.perror("TNonblockingServerSocket::listen() setsockopt() SO_REUSEPORT ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "Could not set SO_REUSEPORT",
+                                errno_copy);
+    }
+#else
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN, "SO_REUSEPORT is not supported");
+#endif
+  }
+
 } // _setup_tcp_sockopts()
 
 void TNonblockingServerSocket::listen() {
@@ -307,6 +336,11 @@ void TNonblockingServerSocket::listen() {
   TWinsockSingleton::create();
 #endif // _WIN32
 
+  if (adoptedSocket_ != THRIFT_INVALID_SOCKET) {
+    listenAdopted();
+    return;
+  }
+
   // tcp == false means Unix Domain socket
   bool tcp = (path_.empty());
 
@@ -476,6 +510,59 @@ void TNonblockingServerSocket::listen() {
   // The socket is now listening!
 }
 
+void TNonblockingServerSocket::listenAdopted() {
+  serverSocket_ = adoptedSocket_;
+  adoptedSocket_ = THRIFT_INVALID_SOCKET;
+
+  int flags = THRIFT_FCNTL(serverSocket_, THRIFT_F_GETFL, 0);
+  if (flags == -1 || -1 == THRIFT_FCNTL(serverSocket_, THRIFT_F_SETFL, flags | THRIFT_O_NONBLOCK)) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TNonblockingServerSocket::listen() THRIFT_FCNTL() THRIFT_O_NONBLOCK ",
+                        errno_copy);
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "THRIFT_FCNTL() THRIFT_F_SETFL THRIFT_O_NONBLOCK failed",
+                              errno_copy);
+  }
+
+  struct sockaddr_storage sa;
+  socklen_t len = sizeof(sa);
+  std::memset(&sa, 0, len);
+  if (::getsockname(serverSocket_, reinterpret_cast<struct sockaddr*>(&sa), &len) < 0) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TNonblockingServerSocket::listen() getsockname() ", errno_copy);
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN, "Could not listen", errno_copy);
+  }
+  if (sa.ss_family == AF_INET6) {
+    port_ = listenPort_ = ntohs(reinterpret_cast<const struct sockaddr_in6*>(&sa)->sin6_port);
+  } else if (sa.ss_family == AF_INET) {
+    port_ = listenPort_ = ntohs(reinterpret_cast<const struct sockaddr_in*>(&sa)->sin_port);
+  }
+
+  if (listenCallback_)
+    listenCallback_(serverSocket_);
+}
+
+void TNonblockingServerSocket::setListenSocket(THRIFT_SOCKET socket) {
+  if (serverSocket_ != THRIFT_INVALID_SOCKET) {
+    throw std::logic_error("setListenSocket cannot be called after listen()");
+  }
+  if (adoptedSocket_ != THRIFT_INVALID_SOCKET) {
+    ::THRIFT_CLOSESOCKET(adoptedSocket_);
+  }
+  adoptedSocket_ = socket;
+}
+
+void TNonblockingServerSocket::handOff(THRIFT_SOCKET channel) {
+  if (serverSocket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "TNonblockingServerSocket not listening");
+  }
+  sendSocket(channel, serverSocket_);
+  handedOff_ = true;
+}
+
 int TNonblockingServerSocket::getPort() {
   return port_;
 }
@@ -497,6 +584,10 @@ shared_ptr<TSocket> TNonblockingServerSocket::acceptImpl() {
 
   if (clientSocket == THRIFT_INVALID_SOCKET) {
     int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    if (errno_copy == THRIFT_EAGAIN || errno_copy == THRIFT_EWOULDBLOCK) {
+      // Another process sharing the socket accepted the connection first
+      throw TTransportException(TTransportException::TIMED_OUT, "accept()", errno_copy);
+    }
     GlobalOutput.perror("TNonblockingServerSocket::acceptImpl() ::accept() ", errno_copy);
     throw TTransportException(TTransportException::UNKNOWN, "accept()", errno_copy);
   }
@@ -545,12 +636,49 @@ shared_ptr<TSocket> TNonblockingServerSocket::createSocket(THRIFT_SOCKET clientS
   return std::make_shared<TSocket>(clientSocket);
 }
 
+shared_ptr<TNonblockingServerTransport> TNonblockingServerSocket::listenAlongside() {
+  if (!listening_ || !path_.empty() || !reusePort_) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TNonblockingServerSocket::listenAlongside() needs a TCP socket "
+                              "listening with setReusePort(true)");
+  }
+
+  shared_ptr<TNonblockingServerSocket> sibling = createServerSocket(address_, listenPort_);
+  sibling->acceptBacklog_ = acceptBacklog_;
+  sibling->sendTimeout_ = sendTimeout_;
+  sibling->recvTimeout_ = recvTimeout_;
+  sibling->retryLimit_ = retryLimit_;
+  sibling->retryDelay_ = retryDelay_;
+  sibling->tcpSendBuffer_ = tcpSendBuffer_;
+  sibling->tcpRecvBuffer_ = tcpRecvBuffer_;
+  sibling->keepAlive_ = keepAlive_;
+  sibling->reusePort_ = true;
+  sibling->listenCallback_ = listenCallback_;
+  sibling->acceptCallback_ = acceptCallback_;
+  sibling->listen();
+  return sibling;
+}
+
+shared_ptr<TNonblockingServerSocket> TNonblockingServerSocket::createServerSocket(
+    const string& address,
+    int port) {
+  return std::make_shared<TNonblockingServerSocket>(address, port);
+}
+
 void TNonblockingServerSocket::close() {
   if (serverSocket_ != THRIFT_INVALID_SOCKET) {
-    shutdown(serverSocket_, THRIFT_SHUT_RDWR);
+    // A socket handed off is still listened on elsewhere
+    if (!handedOff_) {
+      shutdown(serverSocket_, THRIFT_SHUT_RDWR);
+    }
     ::THRIFT_CLOSESOCKET(serverSocket_);
   }
+  if (adoptedSocket_ != THRIFT_INVALID_SOCKET) {
+    ::THRIFT_CLOSESOCKET(adoptedSocket_);
+  }
   serverSocket_ = THRIFT_INVALID_SOCKET;
+  adoptedSocket_ = THRIFT_INVALID_SOCKET;
+  handedOff_ = false;
   listening_ = false;
 }
 } // namespace transport
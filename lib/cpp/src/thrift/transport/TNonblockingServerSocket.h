@@ -83,6 +83,13 @@ public:
 
   void setKeepAlive(bool keepAlive) { keepAlive_ = keepAlive; }
 
+  /**
+   * Sets SO_REUSEPORT on the listening socket, so that other sockets can
+   * listen on the same port, as those made by listenAlongside() do. Must be
+   * set before listen(); not supported for Unix domain sockets.
+   */
+  void setReusePort(bool reusePort) { reusePort_ = reusePort; }
+
   void setTcpSendBuffer(int tcpSendBuffer);
   void setTcpRecvBuffer(int tcpRecvBuffer);
 
@@ -97,6 +104,25 @@ public:
   // socket, this is the place to do it.
   void setAcceptCallback(const socket_func_t& acceptCallback) { acceptCallback_ = acceptCallback; }
 
+  /**
+   * Has listen() take over socket, which is already bound and listening,
+   * such as one received from the process this one replaces with
+   * receiveSocket(), rather than create a socket. The options socket was
+   * given where it was created are kept. This server socket owns socket
+   * from then on. Must be called before listen().
+   */
+  void setListenSocket(THRIFT_SOCKET socket);
+
+  /**
+   * Sends the listening socket over channel with sendSocket(), for the
+   * process at the other end to accept connections on as well. close() then
+   * leaves the socket listening for that process, rather than shut it down.
+   * Sockets made by listenAlongside() are not sent.
+   * \throws TTransportException if not listening, or the socket could not
+   *         be sent
+   */
+  void handOff(THRIFT_SOCKET channel);
+
   THRIFT_SOCKET getSocketFD() override { return serverSocket_; }
 
   int getPort() override;
@@ -106,16 +132,31 @@ public:
   void listen() override;
   void close() override;
 
+  /**
+   * Returns a new socket, with the same options as this one, listening on
+   * the port this one listens on. This socket must be listening on a TCP
+   * port with setReusePort(true).
+   */
+  std::shared_ptr<TNonblockingServerTransport> listenAlongside() override;
+
 protected:
   std::shared_ptr<TSocket> acceptImpl() override;
   virtual std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client);
 
+  /**
+   * Creates the server socket that listenAlongside() sets up and listens on.
+   * Subclasses that accept other kinds of TSocket return their own class.
+   */
+  virtual std::shared_ptr<TNonblockingServerSocket> createServerSocket(const std::string& address,
+                                                                       int port);
+
 private:
   int port_;
   int listenPort_;
   std::string address_;
   std::string path_;
   THRIFT_SOCKET serverSocket_;
+  THRIFT_SOCKET adoptedSocket_;
   int acceptBacklog_;
   int sendTimeout_;
   int recvTimeout_;
@@ -124,13 +165,16 @@ private:
   int tcpSendBuffer_;
   int tcpRecvBuffer_;
   bool keepAlive_;
+  bool reusePort_;
   bool listening_;
+  bool handedOff_;
 
   socket_func_t listenCallback_;
   socket_func_t acceptCallback_;
 
   void _setup_sockopts();
   void _setup_tcp_sockopts();
+  void listenAdopted();
 };
 }
 }
@@ -76,6 +76,19 @@ public:
 
   virtual int getListenPort() = 0;
 
+  /**
+   * Returns a new transport listening on the same address as this one, which
+   * must already be listening. The kernel spreads new connections over all
+   * the transports listening on the address, so a server can accept on
+   * several threads, each from a listening socket of its own.
+   *
+   * @throws TTransportException if the transport cannot share its address
+   */
+  virtual std::shared_ptr<TNonblockingServerTransport> listenAlongside() {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "listenAlongside() is not supported by this transport");
+  }
+
   /**
    * Closes this transport such that future calls to accept will do nothing.
    */
@@ -19,6 +19,7 @@
 
 #include <thrift/thrift-config.h>
 
+#include <algorithm>
 #include <cstring>
 #include <errno.h>
 #include <memory>
@@ -39,6 +40,7 @@
 
 #define OPENSSL_VERSION_NO_THREAD_ID_BEFORE    0x10000000L
 #define OPENSSL_ENGINE_CLEANUP_REQUIRED_BEFORE 0x10100000L
+#define OPENSSL_KTLS_SUPPORTED_SINCE           0x30000000L
 
 #include <boost/shared_array.hpp>
 #include <openssl/opensslv.h>
@@ -54,6 +56,11 @@
 #include <thrift/transport/PlatformSocket.h>
 #include <thrift/TToString.h>
 
+#if (OPENSSL_VERSION_NUMBER >= OPENSSL_KTLS_SUPPORTED_SINCE) && defined(SSL_OP_ENABLE_KTLS) \
+    && !defined(OPENSSL_NO_KTLS)
+#define THRIFT_HAVE_KTLS 1
+#endif
+
 using namespace apache::thrift::concurrency;
 using std::string;
 
@@ -163,7 +170,7 @@ static bool matchName(const char* host, const char* pattern, int size);
 static char uppercase(char c);
 
 // SSLContext implementation
-SSLContext::SSLContext(const SSLProtocol& protocol) {
+SSLContext::SSLContext(const SSLProtocol& protocol) : clientSessionCache_(false) {
   if (protocol == SSLTLS) {
     ctx_ = SSL_CTX_new(SSLv23_method());
 #ifndef OPENSSL_NO_SSL3
@@ -187,6 +194,8 @@ SSLContext::SSLContext(const SSLProtocol& protocol) {
     throw TSSLException("SSL_CTX_new: " + errors);
   }
   SSL_CTX_set_mode(ctx_, SSL_MODE_AUTO_RETRY);
+  SSL_CTX_set_app_data(ctx_, this);
+  SSL_CTX_sess_set_new_cb(ctx_, newSessionCallback);
 
   // Disable horribly insecure SSLv2 and SSLv3 protocols but allow a handshake
   // with older clients so they get a graceful denial.
@@ -197,6 +206,7 @@ SSLContext::SSLContext(const SSLProtocol& protocol) {
 }
 
 SSLContext::~SSLContext() {
+  clearSessions();
   if (ctx_ != nullptr) {
     SSL_CTX_free(ctx_);
     ctx_ = nullptr;
@@ -213,6 +223,57 @@ SSL* SSLContext::createSSL() {
   return ssl;
 }
 
+void SSLContext::setClientSessionCache(bool enable) {
+  clientSessionCache_ = enable;
+  if (!enable) {
+    clearSessions();
+  }
+}
+
+bool SSLContext::restoreSession(SSL* ssl, const std::string& key) {
+  Guard guard(sessionMutex_);
+  auto it = sessions_.find(key);
+  if (it == sessions_.end()) {
+    return false;
+  }
+  // SSL_set_session() takes its own reference
+  return SSL_set_session(ssl, it->second) == 1;
+}
+
+void SSLContext::clearSessions() {
+  Guard guard(sessionMutex_);
+  for (auto& session : sessions_) {
+    SSL_SESSION_free(session.second);
+  }
+  sessions_.clear();
+}
+
+/*
+ * Called by OpenSSL whenever a handshake (or, with TLSv1.3, a session
+ * ticket received after it) produced a resumable session. Returning 1 means
+ * we keep the reference to the session.
+ */
+int SSLContext::newSessionCallback(SSL* ssl, SSL_SESSION* session) {
+  auto* context = static_cast<SSLContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  auto* socket = static_cast<TSSLSocket*>(SSL_get_app_data(ssl));
+  if (context == nullptr || socket == nullptr || socket->server()
+      || !context->clientSessionCache_) {
+    return 0;
+  }
+  string key = socket->sessionKey();
+  if (key.empty()) {
+    return 0;
+  }
+
+  Guard guard(context->sessionMutex_);
+  SSL_SESSION*& cached = context->sessions_[key];
+  if (cached != nullptr) {
+    SSL_SESSION_free(cached);
+  }
+  cached = session;
+  return 1;
+}
+
 // TSSLSocket implementation
 TSSLSocket::TSSLSocket(std::shared_ptr<SSLContext> ctx, std::shared_ptr<TConfiguration> config)
   : TSocket(config), server_(false), ssl_(nullptr), ctx_(ctx) {
@@ -268,6 +329,40 @@ void TSSLSocket::init() {
   handshakeCompleted_ = false;
   readRetryCount_ = 0;
   eventSafe_ = false;
+  wantRead_ = false;
+  wantWrite_ = false;
+}
+
+void TSSLSocket::setWant(bool read) {
+  wantRead_ = read;
+  wantWrite_ = !read;
+}
+
+bool TSSLSocket::isSessionReused() const {
+  return ssl_ != nullptr && SSL_session_reused(ssl_) == 1;
+}
+
+bool TSSLSocket::isKernelTLSSend() const {
+#ifdef THRIFT_HAVE_KTLS
+  return ssl_ != nullptr && BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#else
+  return false;
+#endif
+}
+
+bool TSSLSocket::isKernelTLSReceive() const {
+#ifdef THRIFT_HAVE_KTLS
+  return ssl_ != nullptr && BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+#else
+  return false;
+#endif
+}
+
+string TSSLSocket::sessionKey() const {
+  if (host_.empty()) {
+    return string();
+  }
+  return host_ + ":" + to_string(port_);
 }
 
 bool TSSLSocket::isOpen() const {
@@ -359,6 +454,12 @@ void TSSLSocket::close() {
             // fallthrough
             case SSL_ERROR_WANT_READ:
             case SSL_ERROR_WANT_WRITE:
+              if (isLibeventSafe()) {
+                // don't stall the event loop waiting for the peer's close_notify,
+                // our own close_notify has been queued already
+                rc = 1;
+                break;
+              }
               // in the case of SSL_ERROR_SYSCALL we want to wait for an write/read event again
               waitForEvent(error == SSL_ERROR_WANT_READ);
               rc = 2;
@@ -382,6 +483,7 @@ void TSSLSocket::close() {
     SSL_free(ssl_);
     ssl_ = nullptr;
     handshakeCompleted_ = false;
+    clearWant();
     ERR_remove_state(0);
   }
   TSocket::close();
@@ -399,6 +501,7 @@ uint32_t TSSLSocket::read(uint8_t* buf, uint32_t len) {
   if (!checkHandshake())
     throw TTransportException(TTransportException::UNKNOWN, "retry again");
   int32_t bytes = 0;
+  clearWant();
   while (readRetryCount_ < maxRecvRetries_) {
     bytes = SSL_read(ssl_, buf, len);
     int32_t errno_copy = THRIFT_GET_SOCKET_ERROR;
@@ -433,6 +536,13 @@ uint32_t TSSLSocket::read(uint8_t* buf, uint32_t len) {
       case SSL_ERROR_WANT_READ:
       case SSL_ERROR_WANT_WRITE:
         if (isLibeventSafe()) {
+          if (error != SSL_ERROR_SYSCALL || errno_copy == THRIFT_EAGAIN) {
+            // not a failure: the event loop waits for the wanted readiness
+            // and calls us again, so this doesn't count as a retry
+            readRetryCount_--;
+            setWant(error != SSL_ERROR_WANT_WRITE);
+            throw TTransportException(TTransportException::UNKNOWN, "retry again");
+          }
           if (readRetryCount_ < maxRecvRetries_) {
             // THRIFT_EINTR needs to be handled manually and we can tolerate
             // a certain number
@@ -475,6 +585,7 @@ void TSSLSocket::write(const uint8_t* buf, uint32_t len) {
   initializeHandshake();
   if (!checkHandshake())
     return;
+  clearWant();
   // loop in case SSL_MODE_ENABLE_PARTIAL_WRITE is set in SSL_CTX.
   uint32_t written = 0;
   while (written < len) {
@@ -493,6 +604,7 @@ void TSSLSocket::write(const uint8_t* buf, uint32_t len) {
         case SSL_ERROR_WANT_READ:
         case SSL_ERROR_WANT_WRITE:
           if (isLibeventSafe()) {
+            setWant(error == SSL_ERROR_WANT_READ);
             return;
           }
           else {
@@ -520,6 +632,7 @@ uint32_t TSSLSocket::write_partial(const uint8_t* buf, uint32_t len) {
   initializeHandshake();
   if (!checkHandshake())
     return 0;
+  clearWant();
   // loop in case SSL_MODE_ENABLE_PARTIAL_WRITE is set in SSL_CTX.
   uint32_t written = 0;
   while (written < len) {
@@ -538,7 +651,8 @@ uint32_t TSSLSocket::write_partial(const uint8_t* buf, uint32_t len) {
         case SSL_ERROR_WANT_READ:
         case SSL_ERROR_WANT_WRITE:
           if (isLibeventSafe()) {
-            return 0;
+            setWant(error == SSL_ERROR_WANT_READ);
+            return written;
           }
           else {
             // in the case of SSL_ERROR_SYSCALL we want to wait for an write event again
@@ -556,6 +670,61 @@ uint32_t TSSLSocket::write_partial(const uint8_t* buf, uint32_t len) {
   return written;
 }
 
+uint32_t TSSLSocket::sendFile(int fd, off_t offset, uint32_t count) {
+  initializeHandshake();
+  if (!checkHandshake())
+    throw TSSLException("sendFile: Handshake is not completed");
+#ifdef THRIFT_HAVE_KTLS
+  if (isKernelTLSSend()) {
+    uint32_t sent = 0;
+    while (sent < count) {
+      ERR_clear_error();
+      ossl_ssize_t bytes = SSL_sendfile(ssl_, fd, offset + sent, count - sent, 0);
+      if (bytes <= 0) {
+        int errno_copy = THRIFT_GET_SOCKET_ERROR;
+        int error = SSL_get_error(ssl_, static_cast<int>(bytes));
+        if (error == SSL_ERROR_WANT_WRITE && !isLibeventSafe()) {
+          waitForEvent(false);
+          continue;
+        }
+        if (error == SSL_ERROR_WANT_WRITE) {
+          break;
+        }
+        string errors;
+        buildErrors(errors, errno_copy, error);
+        throw TSSLException("SSL_sendfile: " + errors);
+      }
+      sent += static_cast<uint32_t>(bytes);
+    }
+    return sent;
+  }
+#endif
+#ifndef _WIN32
+  // no kernel TLS: copy the file through the user space record layer
+  uint8_t buf[16384];
+  uint32_t sent = 0;
+  while (sent < count) {
+    ssize_t got = ::pread(fd, buf, (std::min)(static_cast<uint32_t>(sizeof(buf)), count - sent),
+                          offset + sent);
+    if (got < 0) {
+      int errno_copy = THRIFT_ERRNO;
+      throw TTransportException(TTransportException::UNKNOWN, "sendFile: pread()", errno_copy);
+    }
+    if (got == 0) {
+      break;
+    }
+    write(buf, static_cast<uint32_t>(got));
+    sent += static_cast<uint32_t>(got);
+  }
+  return sent;
+#else
+  THRIFT_UNUSED_VARIABLE(fd);
+  THRIFT_UNUSED_VARIABLE(offset);
+  THRIFT_UNUSED_VARIABLE(count);
+  throw TTransportException(TTransportException::BAD_ARGS, "sendFile: not supported");
+#endif
+}
+
 void TSSLSocket::flush() {
   resetConsumedMessageSize();
   // Don't throw exception if not open. Thrift servers close socket twice.
@@ -590,6 +759,15 @@ void TSSLSocket::initializeHandshakeParams() {
   ssl_ = ctx_->createSSL();
 
   SSL_set_fd(ssl_, static_cast<int>(socket_));
+  SSL_set_app_data(ssl_, this);
+
+  // offer the last session negotiated with this peer for resumption
+  if (!server()) {
+    string key = sessionKey();
+    if (!key.empty()) {
+      ctx_->restoreSession(ssl_, key);
+    }
+  }
 }
 
 bool TSSLSocket::checkHandshake() {
@@ -627,6 +805,7 @@ void TSSLSocket::initializeHandshake() {
           case SSL_ERROR_WANT_READ:
           case SSL_ERROR_WANT_WRITE:
             if (isLibeventSafe()) {
+              setWant(error == SSL_ERROR_WANT_READ);
               return;
             }
             else {
@@ -660,6 +839,7 @@ void TSSLSocket::initializeHandshake() {
           case SSL_ERROR_WANT_READ:
           case SSL_ERROR_WANT_WRITE:
             if (isLibeventSafe()) {
+              setWant(error == SSL_ERROR_WANT_READ);
               return;
             }
             else {
@@ -679,6 +859,7 @@ void TSSLSocket::initializeHandshake() {
     buildErrors(errors, errno_copy, error);
     throw TSSLException(fname + ": " + errors);
   }
+  clearWant();
   authorize();
   handshakeCompleted_ = true;
 }
@@ -935,6 +1116,42 @@ void TSSLSocketFactory::ciphers(const string& enable) {
   }
 }
 
+void TSSLSocketFactory::sessionCache(bool enable, long timeoutSeconds) {
+  SSL_CTX* ctx = ctx_->get();
+  if (enable) {
+    // a session id context is required to resume sessions of verified peers
+    static const unsigned char sessionIdContext[] = "thrift";
+    SSL_CTX_set_session_id_context(ctx, sessionIdContext, sizeof(sessionIdContext) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_BOTH);
+    SSL_CTX_set_timeout(ctx, timeoutSeconds);
+  } else {
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  }
+  ctx_->setClientSessionCache(enable);
+}
+
+void TSSLSocketFactory::sessionTickets(bool enable) {
+  if (enable) {
+    SSL_CTX_clear_options(ctx_->get(), SSL_OP_NO_TICKET);
+  } else {
+    SSL_CTX_set_options(ctx_->get(), SSL_OP_NO_TICKET);
+  }
+}
+
+void TSSLSocketFactory::kernelTLS(bool enable) {
+#ifdef THRIFT_HAVE_KTLS
+  if (enable) {
+    SSL_CTX_set_options(ctx_->get(), SSL_OP_ENABLE_KTLS);
+  } else {
+    SSL_CTX_clear_options(ctx_->get(), SSL_OP_ENABLE_KTLS);
+  }
+#else
+  if (enable) {
+    throw TSSLException("kernelTLS: not supported by this OpenSSL build");
+  }
+#endif
+}
+
 void TSSLSocketFactory::authenticate(bool required) {
   int mode;
   if (required) {
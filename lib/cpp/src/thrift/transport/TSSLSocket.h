@@ -24,6 +24,7 @@
 #include <thrift/transport/TSocket.h>
 
 #include <openssl/ssl.h>
+#include <map>
 #include <string>
 #include <thrift/concurrency/Mutex.h>
 
@@ -106,6 +107,32 @@ public:
    * Determines whether SSL Socket is libevent safe or not.
    */
   bool isLibeventSafe() const { return eventSafe_; }
+  /**
+   * In libevent safe mode a handshake, read or write that cannot complete
+   * returns early instead of polling the socket. These report which socket
+   * readiness it is waiting for, so the event loop can arm the right event.
+   */
+  bool wantRead() const override { return wantRead_; }
+  bool wantWrite() const override { return wantWrite_; }
+  /**
+   * Determines whether the handshake resumed a previous TLS session
+   * (from the session cache or a session ticket).
+   */
+  bool isSessionReused() const;
+  /**
+   * Determines whether record encryption for sending/receiving was handed
+   * to the kernel (kTLS) after the handshake.
+   */
+  bool isKernelTLSSend() const;
+  bool isKernelTLSReceive() const;
+  /**
+   * Send count bytes of the file fd starting at offset. With kernel TLS
+   * the data is spliced by the kernel without passing through user space,
+   * otherwise it is copied through SSL_write.
+   *
+   * @return number of bytes sent
+   */
+  uint32_t sendFile(int fd, off_t offset, uint32_t count);
 
 protected:
   /**
@@ -170,19 +197,29 @@ protected:
    *         TSSL_DATA  if data is available on the socket.
    */
   unsigned int waitForEvent(bool wantRead);
+  /**
+   * Key under which the client session is cached, empty if the peer is
+   * unknown (e.g. sockets created from an existing descriptor).
+   */
+  std::string sessionKey() const;
 
   bool server_;
   SSL* ssl_;
   std::shared_ptr<SSLContext> ctx_;
   std::shared_ptr<AccessManager> access_;
   friend class TSSLSocketFactory;
+  friend class SSLContext;
 
 private:
   bool handshakeCompleted_;
   int readRetryCount_;
   bool eventSafe_;
+  bool wantRead_;
+  bool wantWrite_;
 
   void init();
+  void setWant(bool read);
+  void clearWant() { wantRead_ = wantWrite_ = false; }
 };
 
 /**
@@ -306,6 +343,32 @@ public:
    * @param manager  The AccessManager instance
    */
   virtual void access(std::shared_ptr<AccessManager> manager) { access_ = manager; }
+  /**
+   * Enable/Disable TLS session resumption. A server keeps sessions in the
+   * OpenSSL session cache; a client remembers the last session per host and
+   * port and offers it when it reconnects, skipping the full handshake.
+   *
+   * @param enable         Resume sessions if true
+   * @param timeoutSeconds Lifetime of a cached session
+   */
+  virtual void sessionCache(bool enable, long timeoutSeconds = 300);
+  /**
+   * Enable/Disable stateless session resumption with session tickets
+   * (RFC 5077). Enabled by default in OpenSSL.
+   *
+   * @param enable Issue and accept session tickets if true
+   */
+  virtual void sessionTickets(bool enable);
+  /**
+   * Enable/Disable kernel TLS offload. After the handshake the record layer
+   * is handed to the kernel where the negotiated cipher permits it, so
+   * SSL_read/SSL_write become plain socket calls and sendFile() can splice.
+   * Requires Linux and OpenSSL 3.0 built with ktls support.
+   *
+   * @param enable Use kernel TLS if true
+   * @throw TSSLException if the OpenSSL build does not support kernel TLS
+   */
+  virtual void kernelTLS(bool enable);
   static void setManualOpenSSLInitialization(bool manualOpenSSLInitialization) {
     manualOpenSSLInitialization_ = manualOpenSSLInitialization;
   }
@@ -359,8 +422,20 @@ public:
   SSL* createSSL();
   SSL_CTX* get() { return ctx_; }
 
+  /**
+   * Client side session cache, keyed by TSSLSocket::sessionKey().
+   */
+  void setClientSessionCache(bool enable);
+  bool restoreSession(SSL* ssl, const std::string& key);
+  void clearSessions();
+
 private:
+  static int newSessionCallback(SSL* ssl, SSL_SESSION* session);
+
   SSL_CTX* ctx_;
+  bool clientSessionCache_;
+  concurrency::Mutex sessionMutex_;
+  std::map<std::string, SSL_SESSION*> sessions_;
 };
 
 /**
@@ -50,6 +50,7 @@
 #include <thrift/transport/PlatformSocket.h>
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TSocket.h>
+#include <thrift/transport/TSocketHandoff.h>
 #include <thrift/transport/TSocketUtils.h>
 #include <thrift/transport/SocketCommon.h>
 
@@ -102,6 +103,7 @@ TServerSocket::TServerSocket(int port)
   : interruptableChildren_(true),
     port_(port),
     serverSocket_(THRIFT_INVALID_SOCKET),
+    adoptedSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
     sendTimeout_(0),
     recvTimeout_(0),
@@ -112,15 +114,18 @@ TServerSocket::TServerSocket(int port)
     tcpRecvBuffer_(0),
     keepAlive_(false),
     listening_(false),
+    handedOff_(false),
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
     interruptSockReader_(THRIFT_INVALID_SOCKET),
-    childInterruptSockWriter_(THRIFT_INVALID_SOCKET) {
+    childInterruptSockWriter_(THRIFT_INVALID_SOCKET),
+    idleInterruptSockWriter_(THRIFT_INVALID_SOCKET) {
 }
 
 TServerSocket::TServerSocket(int port, int sendTimeout, int recvTimeout)
   : interruptableChildren_(true),
     port_(port),
     serverSocket_(THRIFT_INVALID_SOCKET),
+    adoptedSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
     sendTimeout_(sendTimeout),
     recvTimeout_(recvTimeout),
@@ -131,9 +136,11 @@ TServerSocket::TServerSocket(int port, int sendTimeout, int recvTimeout)
     tcpRecvBuffer_(0),
     keepAlive_(false),
     listening_(false),
+    handedOff_(false),
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
     interruptSockReader_(THRIFT_INVALID_SOCKET),
-    childInterruptSockWriter_(THRIFT_INVALID_SOCKET) {
+    childInterruptSockWriter_(THRIFT_INVALID_SOCKET),
+    idleInterruptSockWriter_(THRIFT_INVALID_SOCKET) {
 }
 
 TServerSocket::TServerSocket(const string& address, int port)
@@ -141,6 +148,7 @@ TServerSocket::TServerSocket(const string& address, int port)
     port_(port),
     address_(address),
     serverSocket_(THRIFT_INVALID_SOCKET),
+    adoptedSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
     sendTimeout_(0),
     recvTimeout_(0),
@@ -151,9 +159,11 @@ TServerSocket::TServerSocket(const string& address, int port)
     tcpRecvBuffer_(0),
     keepAlive_(false),
     listening_(false),
+    handedOff_(false),
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
     interruptSockReader_(THRIFT_INVALID_SOCKET),
-    childInterruptSockWriter_(THRIFT_INVALID_SOCKET) {
+    childInterruptSockWriter_(THRIFT_INVALID_SOCKET),
+    idleInterruptSockWriter_(THRIFT_INVALID_SOCKET) {
 }
 
 TServerSocket::TServerSocket(const string& path)
@@ -161,6 +171,7 @@ TServerSocket::TServerSocket(const string& path)
     port_(0),
     path_(path),
     serverSocket_(THRIFT_INVALID_SOCKET),
+    adoptedSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
     sendTimeout_(0),
     recvTimeout_(0),
@@ -171,9 +182,11 @@ TServerSocket::TServerSocket(const string& path)
     tcpRecvBuffer_(0),
     keepAlive_(false),
     listening_(false),
+    handedOff_(false),
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
     interruptSockReader_(THRIFT_INVALID_SOCKET),
-    childInterruptSockWriter_(THRIFT_INVALID_SOCKET) {
+    childInterruptSockWriter_(THRIFT_INVALID_SOCKET),
+    idleInterruptSockWriter_(THRIFT_INVALID_SOCKET) {
 }
 
 TServerSocket::~TServerSocket() {
@@ -248,6 +261,25 @@ void TServerSocket::setInterruptableChildren(bool enable) {
   interruptableChildren_ = enable;
 }
 
+void TServerSocket::setListenSocket(THRIFT_SOCKET socket) {
+  if (listening_) {
+    throw std::logic_error("setListenSocket cannot be called after listen()");
+  }
+  if (adoptedSocket_ != THRIFT_INVALID_SOCKET) {
+    ::THRIFT_CLOSESOCKET(adoptedSocket_);
+  }
+  adoptedSocket_ = socket;
+}
+
+void TServerSocket::handOff(THRIFT_SOCKET channel) {
+  concurrency::Guard g(rwMutex_);
+  if (serverSocket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "TServerSocket not listening");
+  }
+  sendSocket(channel, serverSocket_);
+  handedOff_ = true;
+}
+
 void TServerSocket::_setup_sockopts() {
 
   // Set THRIFT_NO_SOCKET_CACHING to prevent 2MSL delay on accept
@@ -391,6 +423,23 @@ void TServerSocket::listen() {
         = std::shared_ptr<THRIFT_SOCKET>(new THRIFT_SOCKET(sv[0]), destroyer_of_fine_sockets);
   }
 
+  // Create the socket pair used to interrupt idle clients
+  if (-1 == THRIFT_SOCKETPAIR(AF_LOCAL, SOCK_STREAM, 0, sv)) {
+    GlobalOutput.perror("TServerSocket::listen() socketpair() idleInterrupt",
+                        THRIFT_GET_SOCKET_ERROR);
+    idleInterruptSockWriter_ = THRIFT_INVALID_SOCKET;
+    pIdleInterruptSockReader_.reset();
+  } else {
+    idleInterruptSockWriter_ = sv[1];
+    pIdleInterruptSockReader_
+        = std::shared_ptr<THRIFT_SOCKET>(new THRIFT_SOCKET(sv[0]), destroyer_of_fine_sockets);
+  }
+
+  if (adoptedSocket_ != THRIFT_INVALID_SOCKET) {
+    listenAdopted();
+    return;
+  }
+
   // tcp == false means Unix Domain socket
   bool tcp = (path_.empty());
 
@@ -561,6 +610,42 @@ void TServerSocket::listen() {
   listening_ = true;
 }
 
+void TServerSocket::listenAdopted() {
+  serverSocket_ = adoptedSocket_;
+  adoptedSocket_ = THRIFT_INVALID_SOCKET;
+
+  // The socket may be blocking, and others may accept from it too
+  int flags = THRIFT_FCNTL(serverSocket_, THRIFT_F_GETFL, 0);
+  if (flags == -1 || -1 == THRIFT_FCNTL(serverSocket_, THRIFT_F_SETFL, flags | THRIFT_O_NONBLOCK)) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TServerSocket::listen() THRIFT_FCNTL() THRIFT_O_NONBLOCK ", errno_copy);
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "THRIFT_FCNTL() THRIFT_F_SETFL THRIFT_O_NONBLOCK failed",
+                              errno_copy);
+  }
+
+  struct sockaddr_storage sa;
+  socklen_t len = sizeof(sa);
+  std::memset(&sa, 0, len);
+  if (::getsockname(serverSocket_, reinterpret_cast<struct sockaddr*>(&sa), &len) < 0) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TServerSocket::listen() getsockname() ", errno_copy);
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN, "Could not listen", errno_copy);
+  }
+  if (sa.ss_family == AF_INET6) {
+    port_ = ntohs(reinterpret_cast<const struct sockaddr_in6*>(&sa)->sin6_port);
+  } else if (sa.ss_family == AF_INET) {
+    port_ = ntohs(reinterpret_cast<const struct sockaddr_in*>(&sa)->sin_port);
+  }
+
+  if (listenCallback_)
+    listenCallback_(serverSocket_);
+
+  listening_ = true;
+}
+
 int TServerSocket::getPort() {
   return port_;
 }
@@ -575,6 +660,7 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
   int maxEintrs = 5;
   int numEintrs = 0;
 
+try_again:
   while (true) {
     std::memset(fds, 0, sizeof(fds));
     fds[0].fd = serverSocket_;
@@ -627,6 +713,10 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
 
   if (clientSocket == THRIFT_INVALID_SOCKET) {
     int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    if (errno_copy == THRIFT_EAGAIN || errno_copy == THRIFT_EWOULDBLOCK) {
+      // Another process sharing the socket accepted the connection first
+      goto try_again;
+    }
     GlobalOutput.perror("TServerSocket::acceptImpl() ::accept() ", errno_copy);
     throw TTransportException(TTransportException::UNKNOWN, "accept()", errno_copy);
   }
@@ -664,6 +754,9 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
     client->setKeepAlive(keepAlive_);
   }
   client->setCachedAddress((sockaddr*)&clientAddress, size);
+  if (interruptableChildren_ && pIdleInterruptSockReader_) {
+    client->setIdleInterruptListener(pIdleInterruptSockReader_);
+  }
 
   if (acceptCallback_)
     acceptCallback_(clientSocket);
@@ -702,12 +795,25 @@ void TServerSocket::interruptChildren() {
   }
 }
 
+void TServerSocket::interruptIdleChildren() {
+  concurrency::Guard g(rwMutex_);
+  if (idleInterruptSockWriter_ != THRIFT_INVALID_SOCKET) {
+    notify(idleInterruptSockWriter_);
+  }
+}
+
 void TServerSocket::close() {
   concurrency::Guard g(rwMutex_);
   if (serverSocket_ != THRIFT_INVALID_SOCKET) {
-    shutdown(serverSocket_, THRIFT_SHUT_RDWR);
+    // A socket handed off is still listened on elsewhere
+    if (!handedOff_) {
+      shutdown(serverSocket_, THRIFT_SHUT_RDWR);
+    }
     ::THRIFT_CLOSESOCKET(serverSocket_);
   }
+  if (adoptedSocket_ != THRIFT_INVALID_SOCKET) {
+    ::THRIFT_CLOSESOCKET(adoptedSocket_);
+  }
   if (interruptSockWriter_ != THRIFT_INVALID_SOCKET) {
     ::THRIFT_CLOSESOCKET(interruptSockWriter_);
   }
@@ -717,11 +823,18 @@ void TServerSocket::close() {
   if (childInterruptSockWriter_ != THRIFT_INVALID_SOCKET) {
     ::THRIFT_CLOSESOCKET(childInterruptSockWriter_);
   }
+  if (idleInterruptSockWriter_ != THRIFT_INVALID_SOCKET) {
+    ::THRIFT_CLOSESOCKET(idleInterruptSockWriter_);
+  }
   serverSocket_ = THRIFT_INVALID_SOCKET;
+  adoptedSocket_ = THRIFT_INVALID_SOCKET;
   interruptSockWriter_ = THRIFT_INVALID_SOCKET;
   interruptSockReader_ = THRIFT_INVALID_SOCKET;
   childInterruptSockWriter_ = THRIFT_INVALID_SOCKET;
+  idleInterruptSockWriter_ = THRIFT_INVALID_SOCKET;
   pChildInterruptSockReader_.reset();
+  pIdleInterruptSockReader_.reset();
+  handedOff_ = false;
   listening_ = false;
 }
 } // namespace transport
@@ -123,6 +123,24 @@ public:
   // \throws std::logic_error if listen() has been called
   void setInterruptableChildren(bool enable);
 
+  /**
+   * Has listen() take over socket, which is already bound and listening,
+   * such as one received from the process this one replaces with
+   * receiveSocket(), rather than create a socket. The options socket was
+   * given where it was created are kept. This TServerSocket owns socket
+   * from then on. Must be called before listen().
+   */
+  void setListenSocket(THRIFT_SOCKET socket);
+
+  /**
+   * Sends the listening socket over channel with sendSocket(), for the
+   * process at the other end to accept connections on as well. close() then
+   * leaves the socket listening for that process, rather than shut it down.
+   * \throws TTransportException if not listening, or the socket could not
+   *         be sent
+   */
+  void handOff(THRIFT_SOCKET channel);
+
   THRIFT_SOCKET getSocketFD() override { return serverSocket_; }
 
   int getPort();
@@ -130,6 +148,7 @@ public:
   void listen() override;
   void interrupt() override;
   void interruptChildren() override;
+  void interruptIdleChildren() override;
   void close() override;
 
 protected:
@@ -140,6 +159,7 @@ protected:
 
 private:
   void notify(THRIFT_SOCKET notifySock);
+  void listenAdopted();
   void _setup_sockopts();
   void _setup_unixdomain_sockopts();
   void _setup_tcp_sockopts();
@@ -148,6 +168,7 @@ private:
   std::string address_;
   std::string path_;
   THRIFT_SOCKET serverSocket_;
+  THRIFT_SOCKET adoptedSocket_;
   int acceptBacklog_;
   int sendTimeout_;
   int recvTimeout_;
@@ -158,11 +179,14 @@ private:
   int tcpRecvBuffer_;
   bool keepAlive_;
   bool listening_;
+  bool handedOff_;
 
   concurrency::Mutex rwMutex_;                                 // thread-safe interrupt
   THRIFT_SOCKET interruptSockWriter_;                          // is notified on interrupt()
   THRIFT_SOCKET interruptSockReader_;                          // is used in select/poll with serverSocket_ for interruptability
   THRIFT_SOCKET childInterruptSockWriter_;                     // is notified on interruptChildren()
+  THRIFT_SOCKET idleInterruptSockWriter_;                      // is notified on interruptIdleChildren()
+  std::shared_ptr<THRIFT_SOCKET> pIdleInterruptSockReader_;    // shared with child TSockets if interruptableChildren_
 
   socket_func_t listenCallback_;
   socket_func_t acceptCallback_;
@@ -86,6 +86,13 @@ public:
    */
   virtual void interruptChildren() {}
 
+  /**
+   * Like interruptChildren(), but only interrupts children waiting for the
+   * start of a request, now or once they have replied to the one they are
+   * reading or processing. Children that cannot tell are not interrupted.
+   */
+  virtual void interruptIdleChildren() {}
+
   /**
   * Utility method
   *
@@ -91,7 +91,8 @@ TSocket::TSocket(const string& host, int port, std::shared_ptr<TConfiguration> c
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    awaitingRequest_(true) {
 }
 
 TSocket::TSocket(const string& path, std::shared_ptr<TConfiguration> config)
@@ -107,7 +108,8 @@ TSocket::TSocket(const string& path, std::shared_ptr<TConfiguration> config)
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    awaitingRequest_(true) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 }
 
@@ -123,7 +125,8 @@ TSocket::TSocket(std::shared_ptr<TConfiguration> config)
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    awaitingRequest_(true) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 }
 
@@ -139,7 +142,8 @@ TSocket::TSocket(THRIFT_SOCKET socket, std::shared_ptr<TConfiguration> config)
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    awaitingRequest_(true) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 #ifdef SO_NOSIGPIPE
   {
@@ -163,7 +167,8 @@ TSocket::TSocket(THRIFT_SOCKET socket, std::shared_ptr<THRIFT_SOCKET> interruptL
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    awaitingRequest_(true) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 #ifdef SO_NOSIGPIPE
   {
@@ -545,15 +550,27 @@ try_again:
 
   int got = 0;
 
-  if (interruptListener_) {
-    struct THRIFT_POLLFD fds[2];
+  bool idleInterruptible = idleInterruptListener_ && awaitingRequest_;
+  if (interruptListener_ || idleInterruptible) {
+    struct THRIFT_POLLFD fds[3];
     std::memset(fds, 0, sizeof(fds));
     fds[0].fd = socket_;
     fds[0].events = THRIFT_POLLIN;
-    fds[1].fd = *(interruptListener_.get());
-    fds[1].events = THRIFT_POLLIN;
+    int nfds = 1;
+    int interruptFd = 0;
+    int idleInterruptFd = 0;
+    if (interruptListener_) {
+      interruptFd = nfds++;
+      fds[interruptFd].fd = *(interruptListener_.get());
+      fds[interruptFd].events = THRIFT_POLLIN;
+    }
+    if (idleInterruptible) {
+      idleInterruptFd = nfds++;
+      fds[idleInterruptFd].fd = *(idleInterruptListener_.get());
+      fds[idleInterruptFd].events = THRIFT_POLLIN;
+    }
 
-    int ret = THRIFT_POLL(fds, 2, (recvTimeout_ == 0) ? -1 : recvTimeout_);
+    int ret = THRIFT_POLL(fds, nfds, (recvTimeout_ == 0) ? -1 : recvTimeout_);
     int errno_copy = THRIFT_GET_SOCKET_ERROR;
     if (ret < 0) {
       // error cases
@@ -564,9 +581,13 @@ try_again:
       throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
     } else if (ret > 0) {
       // Check the interruptListener
-      if (fds[1].revents & THRIFT_POLLIN) {
+      if (interruptFd && (fds[interruptFd].revents & THRIFT_POLLIN)) {
         throw TTransportException(TTransportException::INTERRUPTED, "Interrupted");
       }
+      // The idleInterruptListener only interrupts if no request has arrived
+      if (idleInterruptFd && (fds[idleInterruptFd].revents & THRIFT_POLLIN) && !fds[0].revents) {
+        throw TTransportException(TTransportException::INTERRUPTED, "Interrupted while idle");
+      }
     } else /* ret == 0 */ {
       throw TTransportException(TTransportException::TIMED_OUT, "THRIFT_EAGAIN (timed out)");
     }
@@ -632,6 +653,9 @@ try_again:
     throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
   }
 
+  if (got > 0) {
+    awaitingRequest_ = false;
+  }
   return got;
 }
 
@@ -685,6 +709,7 @@ uint32_t TSocket::write_partial(const uint8_t* buf, uint32_t len) {
   if (b == 0) {
     throw TTransportException(TTransportException::NOT_OPEN, "Socket send returned 0.");
   }
+  awaitingRequest_ = true;
   return b;
 }
 
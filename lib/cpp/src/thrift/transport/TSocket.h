@@ -114,6 +114,16 @@ public:
    */
   virtual bool hasPendingDataToRead();
 
+  /**
+   * For non-blocking use: whether the last read or write returned early and
+   * can only make progress once the socket becomes readable (resp. writable).
+   * A plain socket always waits in the direction of the operation itself, so
+   * both are false; TSSLSocket reports the direction a handshake or record
+   * layer step is waiting for, which may be the opposite one.
+   */
+  virtual bool wantRead() const { return false; }
+  virtual bool wantWrite() const { return false; }
+
   /**
    * Reads from the underlying socket.
    * \returns the number of bytes read or 0 indicates EOF
@@ -220,6 +230,18 @@ public:
    */
   void setKeepAlive(bool keepAlive);
 
+  /**
+   * Set a shared socket that interrupts a blocking read when data becomes
+   * available on it, like the interruptListener of the constructor, but only
+   * a read made before anything has been read since the socket was created or
+   * last written to, and only while nothing has arrived to read. On a server,
+   * that is a read of the start of the next request, so the connection can be
+   * closed while idle without cutting off a request it is part way through.
+   */
+  void setIdleInterruptListener(std::shared_ptr<THRIFT_SOCKET> idleInterruptListener) {
+    idleInterruptListener_ = idleInterruptListener;
+  }
+
   /**
    * Get socket information formatted as a string <Host: x Port: x>
    */
@@ -325,6 +347,12 @@ protected:
    */
   std::shared_ptr<THRIFT_SOCKET> interruptListener_;
 
+  /**
+   * A shared socket pointer that will interrupt a blocking read of the start
+   * of a request if data becomes available on it
+   */
+  std::shared_ptr<THRIFT_SOCKET> idleInterruptListener_;
+
   /** Connect timeout in ms */
   int connTimeout_;
 
@@ -349,6 +377,9 @@ protected:
   /** Recv EGAIN retries */
   int maxRecvRetries_;
 
+  /** Whether nothing has been read since the socket was opened or last written to */
+  bool awaitingRequest_;
+
   /** Cached peer address */
   union {
     sockaddr_in ipv4;
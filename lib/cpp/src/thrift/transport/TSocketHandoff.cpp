@@ -0,0 +1,161 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <cstring>
+#include <vector>
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+
+#include <thrift/Thrift.h>
+#include <thrift/transport/TSocketHandoff.h>
+#include <thrift/transport/TTransportException.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+#ifndef _WIN32
+
+void sendSocket(THRIFT_SOCKET channel, THRIFT_SOCKET socket) {
+  // At least one byte of data has to go with the ancillary data
+  char byte = 0;
+  struct iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = sizeof(byte);
+
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  std::memset(&control, 0, sizeof(control));
+
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), &socket, sizeof(int));
+
+  int flags = 0;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif
+  ssize_t sent;
+  do {
+    sent = sendmsg(channel, &msg, flags);
+  } while (sent == -1 && THRIFT_GET_SOCKET_ERROR == THRIFT_EINTR);
+
+  if (sent != 1) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("sendSocket() sendmsg() ", errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN, "Could not send socket", errno_copy);
+  }
+}
+
+THRIFT_SOCKET receiveSocket(THRIFT_SOCKET channel) {
+  char byte;
+  struct iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = sizeof(byte);
+
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  std::memset(&control, 0, sizeof(control));
+
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+  flags |= MSG_CMSG_CLOEXEC;
+#endif
+  ssize_t got;
+  do {
+    got = recvmsg(channel, &msg, flags);
+  } while (got == -1 && THRIFT_GET_SOCKET_ERROR == THRIFT_EINTR);
+
+  if (got < 0) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("receiveSocket() recvmsg() ", errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "Could not receive socket",
+                              errno_copy);
+  } else if (got == 0) {
+    throw TTransportException(TTransportException::END_OF_FILE,
+                              "Channel closed before a socket was received");
+  }
+
+  // Collect every descriptor that arrived, so none leak if the message is
+  // rejected; exactly one is expected
+  std::vector<int> received;
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (size_t i = 0; i < count; ++i) {
+        int fd;
+        std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+        received.push_back(fd);
+      }
+    }
+  }
+
+  if ((msg.msg_flags & MSG_CTRUNC) || received.size() != 1) {
+    for (int fd : received) {
+      ::THRIFT_CLOSESOCKET(fd);
+    }
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "No socket was received on the channel");
+  }
+  return received[0];
+}
+
+#else
+
+void sendSocket(THRIFT_SOCKET channel, THRIFT_SOCKET socket) {
+  THRIFT_UNUSED_VARIABLE(channel);
+  THRIFT_UNUSED_VARIABLE(socket);
+  throw TTransportException(TTransportException::BAD_ARGS, "sendSocket: not supported");
+}
+
+THRIFT_SOCKET receiveSocket(THRIFT_SOCKET channel) {
+  THRIFT_UNUSED_VARIABLE(channel);
+  throw TTransportException(TTransportException::BAD_ARGS, "receiveSocket: not supported");
+}
+
+#endif // _WIN32
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,63 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TSOCKETHANDOFF_H_
+#define _THRIFT_TRANSPORT_TSOCKETHANDOFF_H_ 1
+
+#include <thrift/transport/PlatformSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Sends a copy of socket to the process at the other end of channel, a
+ * connected Unix domain socket, as SCM_RIGHTS ancillary data. Used to hand a
+ * listening socket to the process taking over from this one, so that
+ * connections are never refused while a server restarts:
+ *
+ * <blockquote><code>
+ *     // old process, once the new one has connected to it over channel
+ *     serverSocket->handOff(channel);
+ *     server->drain(30000);
+ *
+ *     // new process
+ *     serverSocket->setListenSocket(receiveSocket(channel));
+ *     server->serve();
+ * </code></blockquote>
+ *
+ * The socket stays open in this process. Not supported on Windows.
+ *
+ * @throws TTransportException if the socket could not be sent
+ */
+void sendSocket(THRIFT_SOCKET channel, THRIFT_SOCKET socket);
+
+/**
+ * Receives a socket sent with sendSocket() over channel, blocking until one
+ * arrives. The caller owns the socket returned.
+ *
+ * @throws TTransportException if no socket could be received, or the
+ *         channel was closed first
+ */
+THRIFT_SOCKET receiveSocket(THRIFT_SOCKET channel);
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TSOCKETHANDOFF_H_
@@ -49,6 +49,27 @@ uint32_t readAll(Transport_& trans, uint8_t* buf, uint32_t len) {
   return have;
 }
 
+/**
+ * Discards the next len bytes of trans, consuming what it has buffered
+ * rather than copying it out where possible.
+ */
+template <class Transport_>
+void skipAll(Transport_& trans, uint32_t len) {
+  uint8_t scratch[512];
+
+  while (len > 0) {
+    uint32_t got = 1;
+    if (trans.borrow(nullptr, &got) != nullptr) {
+      got = got < len ? got : len;
+      trans.consume(got);
+    } else {
+      got = len < sizeof(scratch) ? len : static_cast<uint32_t>(sizeof(scratch));
+      trans.readAll(scratch, got);
+    }
+    len -= got;
+  }
+}
+
 /**
  * Generic interface for a method of transporting data. A TTransport may be
  * capable of either reading or writing, but not necessarily both.
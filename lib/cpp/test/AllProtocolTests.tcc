@@ -125,6 +125,109 @@ void testMessage() {
   }
 }
 
+template <typename TProto>
+void writeSkipStruct(TProto& protocol, bool nested) {
+  protocol.writeStructBegin("skip_struct");
+  protocol.writeFieldBegin("bool_field", T_BOOL, 1);
+  protocol.writeBool(nested);
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("i64_field", T_I64, 2);
+  protocol.writeI64(-1);
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("string_field", T_STRING, 3);
+  protocol.writeString(std::string(1000, 'x'));
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("i32_list", T_LIST, 4);
+  protocol.writeListBegin(T_I32, 300);
+  for (int32_t i = 0; i < 300; i++) {
+    protocol.writeI32(i * i * i * (i % 2 ? -1 : 1));
+  }
+  protocol.writeListEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("double_map", T_MAP, 5);
+  protocol.writeMapBegin(T_I16, T_DOUBLE, 50);
+  for (int16_t i = 0; i < 50; i++) {
+    protocol.writeI16(i);
+    protocol.writeDouble(i / 3.0);
+  }
+  protocol.writeMapEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("string_set", T_SET, 6);
+  protocol.writeSetBegin(T_STRING, 3);
+  protocol.writeString(std::string());
+  protocol.writeString(std::string("short"));
+  protocol.writeString(std::string(300, 'y'));
+  protocol.writeSetEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("bool_list", T_LIST, 7);
+  protocol.writeListBegin(T_BOOL, 20);
+  for (int i = 0; i < 20; i++) {
+    protocol.writeBool(i % 3 == 0);
+  }
+  protocol.writeListEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("i64_map", T_MAP, 8);
+  protocol.writeMapBegin(T_I64, T_I64, 10);
+  for (int64_t i = 0; i < 10; i++) {
+    protocol.writeI64(i << (i * 6));
+    protocol.writeI64(-i);
+  }
+  protocol.writeMapEnd();
+  protocol.writeFieldEnd();
+
+  if (!nested) {
+    protocol.writeFieldBegin("struct_list", T_LIST, 9);
+    protocol.writeListBegin(T_STRUCT, 2);
+    writeSkipStruct(protocol, true);
+    writeSkipStruct(protocol, true);
+    protocol.writeListEnd();
+    protocol.writeFieldEnd();
+  }
+
+  protocol.writeFieldStop();
+  protocol.writeStructEnd();
+}
+
+template <typename TProto>
+void testSkip() {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TProto writer(buffer);
+  writeSkipStruct(writer, false);
+  const uint32_t size = buffer->available_read();
+  writer.writeI32(31337);
+  const std::string data = buffer->getBufferAsString();
+  const auto length = static_cast<uint32_t>(data.size());
+
+  // Through the transport's buffer, and through a buffer smaller than the
+  // strings and containers being skipped
+  shared_ptr<TTransport> transports[] = {
+      shared_ptr<TTransport>(new TMemoryBuffer((uint8_t*)data.data(), length)),
+      shared_ptr<TTransport>(new TBufferedTransport(
+          shared_ptr<TTransport>(new TMemoryBuffer((uint8_t*)data.data(), length)), 7))};
+  for (const auto& transport : transports) {
+    TProto protocol(transport);
+    if (protocol.skip(T_STRUCT) != size) {
+      throw TException("skip() returned the wrong size.");
+    }
+    int32_t sentinel;
+    protocol.readI32(sentinel);
+    if (sentinel != 31337) {
+      throw TException("skip() skipped the wrong number of bytes.");
+    }
+  }
+
+  // The same as the generic skip()
+  TProto generic(shared_ptr<TTransport>(new TMemoryBuffer((uint8_t*)data.data(), length)));
+  if (::apache::thrift::protocol::skip(generic, T_STRUCT) != size) {
+    throw TException("Generic skip() returned the wrong size.");
+  }
+}
+
 template <typename TProto>
 void testProtocol(const char* protoname) {
   try {
@@ -215,6 +318,8 @@ void testProtocol(const char* protoname) {
 
     testMessage<TProto>();
 
+    testSkip<TProto>();
+
     printf("%s => OK\n", protoname);
   } catch (const TException &e) {
     THRIFT_SNPRINTF(errorMessage, ERR_LEN, "%s => Test FAILED: %s", protoname, e.what());
@@ -25,6 +25,8 @@
 #include <math.h>
 #include <memory>
 #include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/protocol/TCompactProtocol.h"
+#include "thrift/protocol/TTableSerializer.h"
 #include "thrift/transport/TBufferTransports.h"
 #include "gen-cpp/DebugProtoTest_types.h"
 
@@ -48,6 +50,47 @@ public:
   }
 };
 
+/**
+ * Writes and then reads num copies of obj with Protocol_, once with the
+ * generated read() and write() methods and once with TTableSerializer.
+ */
+template <class Protocol_, class Struct_>
+void compareTableDriven(const char* name, const Struct_& obj, int num) {
+  using namespace apache::thrift::transport;
+  using apache::thrift::protocol::TTableSerializer;
+  using std::cout;
+  using std::endl;
+
+  std::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol_ prot(buf);
+  for (int table = 0; table < 2; table++) {
+    const char* how = table ? "Table driven" : "   Generated";
+    buf->resetBuffer();
+    Timer timer;
+    for (int i = 0; i < num; i++) {
+      if (table) {
+        TTableSerializer::write(&prot, obj);
+      } else {
+        obj.write(&prot);
+      }
+    }
+    double elapsed = timer.frame();
+    cout << how << " write " << name << ": " << num / (1000 * elapsed) << " kHz" << endl;
+
+    Struct_ obj2;
+    timer.start();
+    for (int i = 0; i < num; i++) {
+      if (table) {
+        TTableSerializer::read(&prot, obj2);
+      } else {
+        obj2.read(&prot);
+      }
+    }
+    elapsed = timer.frame();
+    cout << how << "  read " << name << ": " << num / (1000 * elapsed) << " kHz" << endl;
+  }
+}
+
 int main() {
   using namespace thrift::test::debug;
   using namespace apache::thrift::transport;
@@ -239,6 +282,18 @@ int main() {
     cout << " Double read big endian: " << num / (1000 * elapsed) << " kHz" << endl;
   }
 
+  num = 100000;
+
+  HolyMoley hm;
+  hm.big.push_back(ooe);
+  hm.big.push_back(ooe);
+  hm.contain.insert(std::vector<std::string>(2, "and a one"));
+  hm.bonks["something"].resize(3);
+
+  compareTableDriven<TBinaryProtocol>("OneOfEach binary", ooe, num);
+  compareTableDriven<TCompactProtocol>("OneOfEach compact", ooe, num);
+  compareTableDriven<TBinaryProtocol>("HolyMoley binary", hm, num);
+  compareTableDriven<TCompactProtocol>("HolyMoley compact", hm, num);
 
   return 0;
 }
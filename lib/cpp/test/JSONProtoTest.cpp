@@ -350,3 +350,39 @@ BOOST_AUTO_TEST_CASE(test_json_unicode_escaped_missing_hi_surrogate) {
   BOOST_CHECK_THROW(ooe2.read(proto.get()),
     apache::thrift::protocol::TProtocolException);
 }
+
+BOOST_AUTO_TEST_CASE(test_json_string_escapes_roundtrip) {
+  std::string value("plain run long enough to be scanned in blocks \"quoted\" \\ ");
+  value += std::string("\0\x01\x1f\x7f", 4);
+  value += "\xe2\x82\xac \xf0\x9f\x98\x80";
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TJSONProtocol> proto(new TJSONProtocol(buffer));
+  proto->writeString(value);
+
+  std::string decoded;
+  proto->readString(decoded);
+  BOOST_CHECK(decoded == value);
+
+  const char escaped[] = "\"\\u0000\\u20ac\\ud83d\\ude00\"";
+  buffer->resetBuffer((uint8_t*)escaped, sizeof(escaped) - 1);
+  proto->readString(decoded);
+  BOOST_CHECK(decoded == std::string("\0\xe2\x82\xac\xf0\x9f\x98\x80", 8));
+}
+
+BOOST_AUTO_TEST_CASE(test_json_integer_range) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TJSONProtocol> proto(new TJSONProtocol(buffer));
+  int64_t i64;
+  int32_t i32;
+
+  buffer->resetBuffer((uint8_t*)"-9223372036854775808,", 21);
+  proto->readI64(i64);
+  BOOST_CHECK_EQUAL((std::numeric_limits<int64_t>::min)(), i64);
+
+  buffer->resetBuffer((uint8_t*)"2147483648,", 11);
+  BOOST_CHECK_THROW(proto->readI32(i32), apache::thrift::protocol::TProtocolException);
+
+  buffer->resetBuffer((uint8_t*)"16.77216,", 9);
+  BOOST_CHECK_THROW(proto->readI32(i32), apache::thrift::protocol::TProtocolException);
+}
@@ -0,0 +1,186 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <memory>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/protocol/TTableSerializer.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/LazyFieldTest_types.h"
+
+#define BOOST_TEST_MODULE LazyFieldTest
+#include <boost/test/unit_test.hpp>
+
+using namespace apache::thrift::protocol;
+using namespace lazytest;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+
+static Payload makePayload(int32_t id) {
+  Payload payload;
+  payload.__set_id(id);
+  payload.__set_body("payload " + std::to_string(id));
+  payload.__set_samples({0.5, 1.5, -2.25});
+  return payload;
+}
+
+static Envelope makeEnvelope() {
+  Envelope envelope;
+  envelope.__set_route("a.b.c");
+  envelope.__set_payload(makePayload(1));
+  std::map<std::string, std::vector<Payload> > attachments;
+  attachments["first"].push_back(makePayload(2));
+  attachments["second"].push_back(makePayload(3));
+  attachments["second"].push_back(makePayload(4));
+  envelope.__set_attachments(attachments);
+  envelope.__set_tags({7, 8, 9});
+  return envelope;
+}
+
+template <class Protocol_>
+static std::string write(const Envelope& envelope) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ proto(buffer);
+  envelope.write(&proto);
+  return buffer->getBufferAsString();
+}
+
+template <class Protocol_>
+static void read(const std::string& data, Envelope& envelope) {
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size())));
+  Protocol_ proto(buffer);
+  envelope.read(&proto);
+}
+
+template <class Protocol_>
+static void checkProtocol() {
+  const Envelope expected = makeEnvelope();
+  const std::string data = write<Protocol_>(expected);
+
+  Envelope envelope;
+  read<Protocol_>(data, envelope);
+  BOOST_CHECK(envelope.payload.isSerialized());
+  BOOST_CHECK(envelope.attachments.isSerialized());
+  BOOST_CHECK(envelope.tags.isSerialized());
+  BOOST_CHECK(!envelope.extra.isSerialized());
+  BOOST_CHECK(!envelope.__isset.extra);
+  BOOST_CHECK_EQUAL(envelope.route, "a.b.c");
+
+  // Untouched fields are written back as they were read
+  BOOST_CHECK(write<Protocol_>(envelope) == data);
+
+  // and decoded when accessed
+  BOOST_CHECK_EQUAL(envelope.payload->body, "payload 1");
+  BOOST_CHECK(!envelope.payload.isSerialized());
+  BOOST_CHECK(envelope.attachments.isSerialized());
+  BOOST_CHECK(envelope == expected);
+  BOOST_CHECK(!envelope.attachments.isSerialized());
+  BOOST_CHECK(write<Protocol_>(envelope) == data);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary) {
+  checkProtocol<TBinaryProtocol>();
+  checkProtocol<TBinaryProtocolT<TMemoryBuffer> >();
+}
+
+BOOST_AUTO_TEST_CASE(test_compact) {
+  checkProtocol<TCompactProtocol>();
+  checkProtocol<TCompactProtocolT<TMemoryBuffer> >();
+}
+
+BOOST_AUTO_TEST_CASE(test_other_protocols) {
+  const Envelope expected = makeEnvelope();
+
+  // JSON is read as usual
+  Envelope envelope;
+  read<TJSONProtocol>(write<TJSONProtocol>(expected), envelope);
+  BOOST_CHECK(!envelope.payload.isSerialized());
+  BOOST_CHECK(!envelope.attachments.isSerialized());
+  BOOST_CHECK(envelope == expected);
+
+  // Values kept in one encoding are re-encoded for another
+  read<TBinaryProtocol>(write<TBinaryProtocol>(expected), envelope);
+  BOOST_CHECK(envelope.payload.isSerialized());
+  BOOST_CHECK(write<TCompactProtocol>(envelope) == write<TCompactProtocol>(expected));
+  BOOST_CHECK(write<TJSONProtocol>(envelope) == write<TJSONProtocol>(expected));
+}
+
+BOOST_AUTO_TEST_CASE(test_mutate) {
+  const std::string data = write<TBinaryProtocol>(makeEnvelope());
+
+  Envelope envelope;
+  read<TBinaryProtocol>(data, envelope);
+  envelope.payload.mutate().id = 42;
+  envelope.attachments.mutate()["third"];
+  BOOST_CHECK(!envelope.payload.isSerialized());
+
+  Envelope copy;
+  read<TBinaryProtocol>(write<TBinaryProtocol>(envelope), copy);
+  BOOST_CHECK_EQUAL(copy.payload->id, 42);
+  BOOST_CHECK_EQUAL(copy.payload->body, "payload 1");
+  BOOST_CHECK_EQUAL(copy.attachments->size(), 3u);
+
+  read<TBinaryProtocol>(data, envelope);
+  envelope.__set_payload(makePayload(5));
+  BOOST_CHECK(!envelope.payload.isSerialized());
+  read<TBinaryProtocol>(write<TBinaryProtocol>(envelope), copy);
+  BOOST_CHECK_EQUAL(copy.payload->id, 5);
+
+  // Defaults are set through the field
+  BOOST_CHECK(Envelope().tags.get() == std::vector<int32_t>({1, 2, 3}));
+}
+
+BOOST_AUTO_TEST_CASE(test_partly_buffered) {
+  const Envelope expected = makeEnvelope();
+  const std::string data = write<TBinaryProtocol>(expected);
+
+  // A transport buffering only a few bytes at a time cannot hand over whole
+  // values, which are then read as usual
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size())));
+  std::shared_ptr<TTransport> trans(new TBufferedTransport(buffer, 16));
+  TBinaryProtocol proto(trans);
+  Envelope envelope;
+  envelope.read(&proto);
+  BOOST_CHECK(!envelope.attachments.isSerialized());
+  BOOST_CHECK(envelope == expected);
+  BOOST_CHECK(write<TBinaryProtocol>(envelope) == data);
+}
+
+BOOST_AUTO_TEST_CASE(test_descriptor) {
+  const TFieldDescriptor* payload = Envelope::__descriptor.findField("payload");
+  BOOST_REQUIRE(payload != nullptr);
+  BOOST_CHECK(payload->lazy);
+  BOOST_CHECK(!Envelope::__descriptor.findField("route")->lazy);
+  BOOST_CHECK(!Envelope::__descriptor.generic);
+
+  // Generic code hands the struct to its own read and write methods
+  const std::string data = write<TCompactProtocol>(makeEnvelope());
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size())));
+  TCompactProtocol proto(buffer);
+  Envelope envelope;
+  TTableSerializer::read(&proto, envelope);
+  BOOST_CHECK(envelope.payload.isSerialized());
+  BOOST_CHECK(envelope == makeEnvelope());
+}
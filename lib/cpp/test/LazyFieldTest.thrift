@@ -0,0 +1,36 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp lazytest
+
+// Structs with cpp.lazy fields, for use in LazyFieldTest.cpp
+
+struct Payload {
+  1: i32 id,
+  2: string body,
+  3: list<double> samples,
+}
+
+struct Envelope {
+  1: string route,
+  2: Payload payload (cpp.lazy = ""),
+  3: map<string, list<Payload>> attachments (cpp.lazy = ""),
+  4: optional Payload extra (cpp.lazy = ""),
+  5: list<i32> tags = [1, 2, 3] (cpp.lazy = ""),
+}
@@ -0,0 +1,317 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/processor/TMetricsEventHandler.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TMetricsEndpoint.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TSocket.h>
+#include "gen-cpp/OneWayService.h"
+
+#define BOOST_TEST_MODULE MetricsEventHandlerTest
+#include <boost/test/unit_test.hpp>
+
+using namespace apache::thrift;
+using namespace apache::thrift::concurrency;
+using namespace apache::thrift::processor;
+using namespace apache::thrift::protocol;
+using apache::thrift::server::TMetricsEndpoint;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TSocket;
+
+class Handler : public onewaytest::OneWayServiceIf {
+public:
+  Handler() : fail(false) {}
+
+  void roundTripRPC() override {
+    if (fail) {
+      throw std::runtime_error("failed");
+    }
+  }
+
+  void oneWayRPC() override {}
+
+  bool fail;
+};
+
+// Makes a call with no arguments to processor
+static void call(TProcessor& processor, const std::string& name, TMessageType type) {
+  std::shared_ptr<TMemoryBuffer> in(new TMemoryBuffer());
+  std::shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+  TBinaryProtocol proto(in);
+  proto.writeMessageBegin(name, type, 1);
+  proto.writeStructBegin("args");
+  proto.writeFieldStop();
+  proto.writeStructEnd();
+  proto.writeMessageEnd();
+  processor.process(std::make_shared<TBinaryProtocol>(in),
+                    std::make_shared<TBinaryProtocol>(out),
+                    nullptr);
+}
+
+static const TMetricsEventHandler::MethodMetrics* find(
+    const std::vector<TMetricsEventHandler::MethodMetrics>& metrics,
+    const std::string& method) {
+  for (const auto& m : metrics) {
+    if (m.method == method) {
+      return &m;
+    }
+  }
+  return nullptr;
+}
+
+BOOST_AUTO_TEST_CASE(test_histogram) {
+  for (uint64_t value = 0; value < 100000; value += 1 + value / 64) {
+    int bucket = TLatencyHistogram::bucketOf(value);
+    BOOST_REQUIRE(bucket >= 0 && bucket < TLatencyHistogram::BUCKETS);
+    BOOST_CHECK_LE(TLatencyHistogram::bucketLow(bucket), value);
+    BOOST_CHECK_GE(TLatencyHistogram::bucketHigh(bucket), value);
+    // Buckets are no wider than an eighth of their values
+    BOOST_CHECK_LE((TLatencyHistogram::bucketHigh(bucket) - TLatencyHistogram::bucketLow(bucket))
+                       * 8,
+                   TLatencyHistogram::bucketLow(bucket));
+  }
+  BOOST_CHECK_EQUAL(TLatencyHistogram::bucketOf(uint64_t(1) << 50), TLatencyHistogram::BUCKETS - 1);
+
+  TLatencyHistogram histogram;
+  for (uint64_t value = 1; value <= 1000; ++value) {
+    histogram.record(value);
+  }
+  TLatencyHistogram::Snapshot snapshot;
+  histogram.addTo(snapshot);
+  BOOST_CHECK_EQUAL(snapshot.count(), 1000u);
+  BOOST_CHECK_EQUAL(snapshot.sum(), 500500u);
+  BOOST_CHECK_EQUAL(snapshot.countAtMost(255), 255u);
+  BOOST_CHECK_EQUAL(snapshot.countAtMost(1023), 1000u);
+  BOOST_CHECK_GE(snapshot.quantile(0.5), 500u);
+  BOOST_CHECK_LE(snapshot.quantile(0.5), 563u);
+  BOOST_CHECK_GE(snapshot.quantile(1.0), 1000u);
+  BOOST_CHECK_EQUAL(TLatencyHistogram::Snapshot().quantile(0.5), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_calls) {
+  std::shared_ptr<Handler> handler(new Handler());
+  std::shared_ptr<TMetricsEventHandler> metrics(new TMetricsEventHandler());
+  onewaytest::OneWayServiceProcessor processor(handler);
+  processor.setEventHandler(metrics);
+
+  call(processor, "roundTripRPC", T_CALL);
+  call(processor, "roundTripRPC", T_CALL);
+  handler->fail = true;
+  call(processor, "roundTripRPC", T_CALL);
+  call(processor, "oneWayRPC", T_ONEWAY);
+
+  std::vector<TMetricsEventHandler::MethodMetrics> snapshot = metrics->snapshot();
+  BOOST_REQUIRE_EQUAL(snapshot.size(), 2u);
+  const TMetricsEventHandler::MethodMetrics* roundTrip
+      = find(snapshot, "OneWayService.roundTripRPC");
+  BOOST_REQUIRE(roundTrip);
+  BOOST_CHECK_EQUAL(roundTrip->calls, 3u);
+  BOOST_CHECK_EQUAL(roundTrip->errors, 1u);
+  BOOST_CHECK_GT(roundTrip->requestBytes, 0u);
+  BOOST_CHECK_GT(roundTrip->responseBytes, 0u);
+  BOOST_CHECK_EQUAL(roundTrip->handlerTime.count(), 3u);
+  BOOST_CHECK_EQUAL(roundTrip->serializationTime.count(), 3u);
+  // Not run by a thread manager
+  BOOST_CHECK_EQUAL(roundTrip->queueTime.count(), 0u);
+
+  const TMetricsEventHandler::MethodMetrics* oneWay = find(snapshot, "OneWayService.oneWayRPC");
+  BOOST_REQUIRE(oneWay);
+  BOOST_CHECK_EQUAL(oneWay->calls, 1u);
+  BOOST_CHECK_EQUAL(oneWay->errors, 0u);
+  BOOST_CHECK_EQUAL(oneWay->responseBytes, 0u);
+  BOOST_CHECK_EQUAL(oneWay->handlerTime.count(), 1u);
+
+  std::string text = metrics->renderPrometheus();
+  BOOST_CHECK(text.find("# TYPE thrift_calls_total counter\n") != std::string::npos);
+  BOOST_CHECK(text.find("thrift_calls_total{method=\"OneWayService.roundTripRPC\"} 3\n")
+              != std::string::npos);
+  BOOST_CHECK(text.find("thrift_errors_total{method=\"OneWayService.roundTripRPC\"} 1\n")
+              != std::string::npos);
+  BOOST_CHECK(text.find("# TYPE thrift_handler_seconds histogram\n") != std::string::npos);
+  BOOST_CHECK(text.find("thrift_handler_seconds_bucket{method=\"OneWayService.roundTripRPC\","
+                        "le=\"+Inf\"} 3\n")
+              != std::string::npos);
+  BOOST_CHECK(text.find("thrift_queue_seconds_count{method=\"OneWayService.oneWayRPC\"} 0\n")
+              != std::string::npos);
+}
+
+// Makes two calls from a ThreadManager worker
+class CallTask : public Runnable {
+public:
+  CallTask(std::shared_ptr<TProcessor> processor, Monitor& monitor, int& done)
+    : processor_(processor), monitor_(monitor), done_(done) {}
+
+  void run() override {
+    // Only the first call of a task is charged with its wait
+    call(*processor_, "roundTripRPC", T_CALL);
+    call(*processor_, "roundTripRPC", T_CALL);
+    Synchronized s(monitor_);
+    ++done_;
+    monitor_.notify();
+  }
+
+private:
+  std::shared_ptr<TProcessor> processor_;
+  Monitor& monitor_;
+  int& done_;
+};
+
+BOOST_AUTO_TEST_CASE(test_queue_time) {
+  std::shared_ptr<TMetricsEventHandler> metrics(new TMetricsEventHandler("rpc"));
+  std::shared_ptr<onewaytest::OneWayServiceProcessor> processor(
+      new onewaytest::OneWayServiceProcessor(std::make_shared<Handler>()));
+  processor->setEventHandler(metrics);
+
+  std::shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(1);
+  threadManager->threadFactory(std::make_shared<ThreadFactory>());
+  threadManager->start();
+
+  Monitor monitor;
+  int done = 0;
+  for (int i = 0; i < 2; ++i) {
+    threadManager->add(std::make_shared<CallTask>(processor, monitor, done));
+  }
+  {
+    Synchronized s(monitor);
+    while (done < 2) {
+      monitor.wait();
+    }
+  }
+  threadManager->stop();
+
+  std::vector<TMetricsEventHandler::MethodMetrics> snapshot = metrics->snapshot();
+  BOOST_REQUIRE_EQUAL(snapshot.size(), 1u);
+  BOOST_CHECK_EQUAL(snapshot[0].calls, 4u);
+  BOOST_CHECK_EQUAL(snapshot[0].queueTime.count(), 2u);
+  BOOST_CHECK(metrics->renderPrometheus().find("rpc_queue_seconds_count{method=\"OneWayService."
+                                               "roundTripRPC\"} 2\n")
+              != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_threads) {
+  std::shared_ptr<TMetricsEventHandler> metrics(new TMetricsEventHandler("thrift", 2));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([metrics, t] {
+      for (int i = 0; i < 1000; ++i) {
+        std::string name = "Service.method" + std::to_string((t + i) % 3);
+        void* ctx = metrics->getContext(name.c_str(), nullptr);
+        metrics->preRead(ctx, name.c_str());
+        metrics->postRead(ctx, name.c_str(), 10);
+        metrics->preWrite(ctx, name.c_str());
+        metrics->postWrite(ctx, name.c_str(), 20);
+        metrics->freeContext(ctx, name.c_str());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<TMetricsEventHandler::MethodMetrics> snapshot = metrics->snapshot();
+  BOOST_REQUIRE_EQUAL(snapshot.size(), 3u);
+  uint64_t calls = 0;
+  for (const auto& method : snapshot) {
+    calls += method.calls;
+    BOOST_CHECK_EQUAL(method.requestBytes, method.calls * 10);
+    BOOST_CHECK_EQUAL(method.responseBytes, method.calls * 20);
+    BOOST_CHECK_EQUAL(method.handlerTime.count(), method.calls);
+  }
+  BOOST_CHECK_EQUAL(calls, 4000u);
+}
+
+// Sends an HTTP request to the endpoint and returns the whole response
+static std::string get(int port, const std::string& path) {
+  TSocket socket("127.0.0.1", port);
+  socket.open();
+  std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  socket.write(reinterpret_cast<const uint8_t*>(request.data()),
+               static_cast<uint32_t>(request.size()));
+  socket.flush();
+  std::string response;
+  uint8_t buf[1024];
+  uint32_t got;
+  while ((got = socket.read(buf, sizeof(buf))) > 0) {
+    response.append(reinterpret_cast<const char*>(buf), got);
+  }
+  return response;
+}
+
+BOOST_AUTO_TEST_CASE(test_endpoint) {
+  std::shared_ptr<TMetricsEventHandler> metrics(new TMetricsEventHandler());
+  void* ctx = metrics->getContext("Service.method", nullptr);
+  metrics->freeContext(ctx, "Service.method");
+
+  TMetricsEndpoint endpoint([metrics] { return metrics->renderPrometheus(); }, 0);
+  endpoint.start();
+  BOOST_REQUIRE_GT(endpoint.getPort(), 0);
+
+  std::string response = get(endpoint.getPort(), "/metrics");
+  BOOST_CHECK_EQUAL(response.substr(0, 15), "HTTP/1.1 200 OK");
+  BOOST_CHECK(response.find("\r\n\r\n" + metrics->renderPrometheus()) != std::string::npos);
+
+  response = get(endpoint.getPort(), "/other");
+  BOOST_CHECK_EQUAL(response.substr(0, 22), "HTTP/1.1 404 Not Found");
+
+  endpoint.stop();
+}
+
+BOOST_AUTO_TEST_CASE(test_endpoint_slow_client) {
+  TMetricsEndpoint endpoint([] { return std::string("metrics\n"); }, 0);
+  endpoint.setRequestTimeout(300);
+  endpoint.start();
+  BOOST_CHECK_THROW(endpoint.setRequestTimeout(1000), std::logic_error);
+
+  // A client that trickles its request in, a byte well within each read's
+  // timeout, is cut off once the request as a whole is late
+  std::atomic<bool> done(false);
+  TSocket slow("127.0.0.1", endpoint.getPort());
+  slow.open();
+  std::thread trickle([&] {
+    try {
+      for (int i = 0; i < 100 && !done; ++i) {
+        slow.write(reinterpret_cast<const uint8_t*>("x"), 1);
+        slow.flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      }
+    } catch (const TException&) {
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::string response = get(endpoint.getPort(), "/metrics");
+  BOOST_CHECK_EQUAL(response.substr(0, 15), "HTTP/1.1 200 OK");
+  BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+
+  done = true;
+  trickle.join();
+  endpoint.stop();
+}
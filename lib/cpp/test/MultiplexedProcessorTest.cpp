@@ -0,0 +1,301 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <memory>
+#include <string>
+#include <thrift/TApplicationException.h>
+#include <thrift/processor/TMultiplexedProcessor.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+#define BOOST_TEST_MODULE MultiplexedProcessorTest
+#include <boost/test/unit_test.hpp>
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace thrift::test::debug;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+
+/**
+ * Replies to every call with a Bonk naming the service and the method it
+ * was called with.
+ */
+class BonkProcessor : public TProcessor {
+public:
+  BonkProcessor(const std::string& service) : service_(service) {}
+
+  bool process(std::shared_ptr<TProtocol> in,
+               std::shared_ptr<TProtocol> out,
+               void* /* connectionContext */) override {
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    in->readMessageBegin(name, type, seqid);
+    in->skip(T_STRUCT);
+    in->readMessageEnd();
+
+    Bonk bonk;
+    bonk.__set_type(seqid);
+    bonk.__set_message(service_ + "/" + name);
+    out->writeMessageBegin(name, T_REPLY, seqid);
+    bonk.write(out.get());
+    out->writeMessageEnd();
+    return true;
+  }
+
+  concurrency::PRIORITY getPriority(const std::string& fname) const override {
+    return fname == "urgent" ? concurrency::HIGH_IMPORTANT : concurrency::NORMAL;
+  }
+
+  bool isInline(const std::string& fname) const override { return fname == "lookup"; }
+
+private:
+  std::string service_;
+};
+
+static HolyMoley makeArgs() {
+  HolyMoley args;
+  args.big.resize(2);
+  args.big[0].__set_zomg_unicode("\xd3\x80\xe2\x85\xae");
+  args.big[1].__set_integer32(-17);
+  args.contain.insert({"a", "b"});
+  args.bonks["c"].resize(1);
+  return args;
+}
+
+template <class Protocol_>
+static std::string writeCall(const std::string& name, TMessageType type, int32_t seqid) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ proto(buffer);
+  proto.writeMessageBegin(name, type, seqid);
+  makeArgs().write(&proto);
+  proto.writeMessageEnd();
+  return buffer->getBufferAsString();
+}
+
+// Passes data to processor and returns what it replied
+template <class Protocol_>
+static std::string process(TMultiplexedProcessor& processor, const std::string& data) {
+  std::shared_ptr<TMemoryBuffer> inBuffer(
+      new TMemoryBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size())));
+  std::shared_ptr<TMemoryBuffer> outBuffer(new TMemoryBuffer());
+  processor.process(std::make_shared<Protocol_>(inBuffer),
+                    std::make_shared<Protocol_>(outBuffer),
+                    nullptr);
+  BOOST_CHECK_EQUAL(inBuffer->available_read(), 0u);
+  return outBuffer->getBufferAsString();
+}
+
+template <class Protocol_>
+static Bonk readReply(const std::string& data, TMessageType expectedType = T_REPLY) {
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size())));
+  Protocol_ proto(buffer);
+  std::string name;
+  TMessageType type;
+  int32_t seqid;
+  proto.readMessageBegin(name, type, seqid);
+  BOOST_CHECK_EQUAL(type, expectedType);
+  Bonk bonk;
+  if (type == T_REPLY) {
+    bonk.read(&proto);
+  } else {
+    TApplicationException x;
+    x.read(&proto);
+    bonk.__set_message(x.what());
+  }
+  proto.readMessageEnd();
+  return bonk;
+}
+
+BOOST_AUTO_TEST_CASE(test_dispatch) {
+  TMultiplexedProcessor processor;
+  for (int i = 0; i < 60; ++i) {
+    std::string service = "Service" + std::to_string(i);
+    processor.registerProcessor(service, std::make_shared<BonkProcessor>(service));
+  }
+
+  for (int i = 0; i < 60; i += 7) {
+    std::string service = "Service" + std::to_string(i);
+    Bonk reply = readReply<TBinaryProtocol>(
+        process<TBinaryProtocol>(processor, writeCall<TBinaryProtocol>(service + ":ping", T_CALL, i)));
+    BOOST_CHECK_EQUAL(reply.message, service + "/ping");
+    BOOST_CHECK_EQUAL(reply.type, i);
+  }
+
+  // Empty tokens are ignored
+  Bonk reply = readReply<TCompactProtocol>(
+      process<TCompactProtocol>(processor, writeCall<TCompactProtocol>(":Service3::pong:", T_CALL, 3)));
+  BOOST_CHECK_EQUAL(reply.message, "Service3/pong");
+
+  // Registering a service again replaces it
+  processor.registerProcessor("Service3", std::make_shared<BonkProcessor>("Other"));
+  reply = readReply<TCompactProtocol>(
+      process<TCompactProtocol>(processor, writeCall<TCompactProtocol>("Service3:pong", T_CALL, 3)));
+  BOOST_CHECK_EQUAL(reply.message, "Other/pong");
+}
+
+BOOST_AUTO_TEST_CASE(test_errors) {
+  TMultiplexedProcessor processor;
+  processor.registerProcessor("Service", std::make_shared<BonkProcessor>("Service"));
+
+  std::string data = writeCall<TBinaryProtocol>("Unknown:ping", T_CALL, 1);
+  std::shared_ptr<TMemoryBuffer> inBuffer(
+      new TMemoryBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size())));
+  std::shared_ptr<TMemoryBuffer> outBuffer(new TMemoryBuffer());
+  BOOST_CHECK_THROW(processor.process(std::make_shared<TBinaryProtocol>(inBuffer),
+                                      std::make_shared<TBinaryProtocol>(outBuffer),
+                                      nullptr),
+                    TException);
+  BOOST_CHECK_EQUAL(inBuffer->available_read(), 0u);
+  Bonk reply = readReply<TBinaryProtocol>(outBuffer->getBufferAsString(), T_EXCEPTION);
+  BOOST_CHECK(reply.message.find("Unknown service: Unknown.") != std::string::npos);
+
+  data = writeCall<TBinaryProtocol>("a:b:c", T_CALL, 1);
+  inBuffer->resetBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size()));
+  BOOST_CHECK_THROW(processor.process(std::make_shared<TBinaryProtocol>(inBuffer),
+                                      std::make_shared<TBinaryProtocol>(outBuffer),
+                                      nullptr),
+                    TException);
+
+  // Unprefixed names go to the default processor
+  data = writeCall<TBinaryProtocol>("ping", T_CALL, 1);
+  inBuffer->resetBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size()));
+  BOOST_CHECK_THROW(processor.process(std::make_shared<TBinaryProtocol>(inBuffer),
+                                      std::make_shared<TBinaryProtocol>(outBuffer),
+                                      nullptr),
+                    TException);
+  processor.registerDefault(std::make_shared<BonkProcessor>("Default"));
+  reply = readReply<TBinaryProtocol>(process<TBinaryProtocol>(processor, data));
+  BOOST_CHECK_EQUAL(reply.message, "Default/ping");
+
+  BOOST_CHECK_THROW(processor.registerForwarder("Service", nullptr), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_priority) {
+  TMultiplexedProcessor processor;
+  processor.registerProcessor("Service", std::make_shared<BonkProcessor>("Service"));
+  processor.registerForwarder("Remote", std::make_shared<TBinaryProtocol>(
+                                            std::make_shared<TMemoryBuffer>()));
+
+  BOOST_CHECK_EQUAL(processor.getPriority("Service:urgent"), concurrency::HIGH_IMPORTANT);
+  BOOST_CHECK_EQUAL(processor.getPriority(":Service::urgent"), concurrency::HIGH_IMPORTANT);
+  BOOST_CHECK_EQUAL(processor.getPriority("Service:ping"), concurrency::NORMAL);
+  BOOST_CHECK_EQUAL(processor.getPriority("Remote:urgent"), concurrency::NORMAL);
+  BOOST_CHECK_EQUAL(processor.getPriority("Unknown:urgent"), concurrency::NORMAL);
+  BOOST_CHECK_EQUAL(processor.getPriority("urgent"), concurrency::NORMAL);
+  processor.registerDefault(std::make_shared<BonkProcessor>("Default"));
+  BOOST_CHECK_EQUAL(processor.getPriority("urgent"), concurrency::HIGH_IMPORTANT);
+}
+
+BOOST_AUTO_TEST_CASE(test_inline) {
+  TMultiplexedProcessor processor;
+  processor.registerProcessor("Service", std::make_shared<BonkProcessor>("Service"));
+  processor.registerForwarder("Remote", std::make_shared<TBinaryProtocol>(
+                                            std::make_shared<TMemoryBuffer>()));
+
+  BOOST_CHECK(processor.isInline("Service:lookup"));
+  BOOST_CHECK(!processor.isInline("Service:ping"));
+  BOOST_CHECK(!processor.isInline("Remote:lookup"));
+  BOOST_CHECK(!processor.isInline("Unknown:lookup"));
+  BOOST_CHECK(!processor.isInline("lookup"));
+  processor.registerDefault(std::make_shared<BonkProcessor>("Default"));
+  BOOST_CHECK(processor.isInline("lookup"));
+}
+
+// Forwards a call from a Client_ client to a Backend_ backend, which has
+// already queued its reply, and checks what reaches each end
+template <class Client_, class Backend_>
+static void checkForward(TMessageType type) {
+  std::shared_ptr<TMemoryBuffer> backendBuffer(new TMemoryBuffer());
+  std::shared_ptr<TProtocol> backend(new Backend_(backendBuffer));
+  Bonk expected;
+  expected.__set_type(7);
+  expected.__set_message("from the backend");
+  if (type == T_CALL) {
+    backend->writeMessageBegin("ping", T_REPLY, 7);
+    expected.write(backend.get());
+    backend->writeMessageEnd();
+  }
+
+  TMultiplexedProcessor processor;
+  processor.registerProcessor("Local", std::make_shared<BonkProcessor>("Local"));
+  processor.registerForwarder("Remote", backend);
+
+  std::string reply
+      = process<Client_>(processor, writeCall<Client_>("Remote:ping", type, 7));
+
+  // The backend was sent the call as the client made it, after its reply,
+  // if any, was read and passed back
+  BOOST_CHECK(backendBuffer->getBufferAsString() == writeCall<Backend_>("Remote:ping", type, 7));
+  if (type == T_CALL) {
+    Bonk bonk = readReply<Client_>(reply);
+    BOOST_CHECK(bonk == expected);
+  } else {
+    BOOST_CHECK(reply.empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_forward) {
+  checkForward<TBinaryProtocol, TBinaryProtocol>(T_CALL);
+  checkForward<TCompactProtocol, TCompactProtocol>(T_CALL);
+  checkForward<TBinaryProtocol, TBinaryProtocol>(T_ONEWAY);
+  checkForward<TCompactProtocol, TBinaryProtocol>(T_CALL);
+  checkForward<TJSONProtocol, TCompactProtocol>(T_CALL);
+}
+
+BOOST_AUTO_TEST_CASE(test_forward_errors) {
+  std::shared_ptr<TMemoryBuffer> backendBuffer(new TMemoryBuffer());
+  std::shared_ptr<TProtocol> backend(new TBinaryProtocol(backendBuffer));
+  TMultiplexedProcessor processor;
+  processor.registerForwarder("Remote", backend);
+
+  // A call cut short is not passed on
+  std::string call = writeCall<TBinaryProtocol>("Remote:ping", T_CALL, 7);
+  BOOST_CHECK_THROW(
+      process<TBinaryProtocol>(processor, call.substr(0, call.size() / 2)), TTransportException);
+  BOOST_CHECK_EQUAL(backendBuffer->available_read(), 0u);
+
+  // Nor is what is left of a bad reply read as the next one
+  backend->writeMessageBegin("ping", T_REPLY, 7);
+  backend->writeByte(0x55);
+  backend->writeI16(1);
+  backend->writeString("the rest of the reply");
+  BOOST_CHECK_THROW(process<TBinaryProtocol>(processor, call), TProtocolException);
+  BOOST_CHECK_EQUAL(backendBuffer->available_read(), 0u);
+
+  Bonk expected;
+  expected.__set_type(8);
+  expected.__set_message("from the backend");
+  backend->writeMessageBegin("ping", T_REPLY, 8);
+  expected.write(backend.get());
+  backend->writeMessageEnd();
+  Bonk bonk = readReply<TBinaryProtocol>(
+      process<TBinaryProtocol>(processor, writeCall<TBinaryProtocol>("Remote:ping", T_CALL, 8)));
+  BOOST_CHECK(bonk == expected);
+
+  // Backends without a raw encoding need a factory for buffers
+  std::shared_ptr<TProtocol> jsonBackend(new TJSONProtocol(std::make_shared<TMemoryBuffer>()));
+  BOOST_CHECK_THROW(processor.registerForwarder("Json", jsonBackend), std::invalid_argument);
+  processor.registerForwarder("Json", jsonBackend, std::make_shared<TJSONProtocolFactory>());
+}
@@ -23,6 +23,7 @@
 
 #include "gen-cpp/Recursive_types.h"
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
 #include <memory>
 #include <thrift/transport/TBufferTransports.h>
 
@@ -31,6 +32,7 @@
 
 using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
 using std::shared_ptr;
 
 BOOST_AUTO_TEST_CASE(test_recursive_1) {
@@ -90,3 +92,37 @@ BOOST_AUTO_TEST_CASE(test_recursive_4) {
 
   depthLimit->nextitem.reset();
 }
+
+BOOST_AUTO_TEST_CASE(test_recursive_compact) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  shared_ptr<TCompactProtocol> prot(new TCompactProtocol(buf));
+
+  // Nested deeper than the compact protocol keeps field ids inline, so that
+  // the ids written after each nested struct depend on those of enclosing
+  // structs being restored correctly
+  RecList list;
+  RecList* last = &list;
+  for (int16_t i = 0; i < 40; ++i) {
+    last->item = i;
+    last->nextitem.reset(new RecList);
+    last = last->nextitem.get();
+  }
+  last->item = 40;
+
+  list.write(prot.get());
+  list.write(prot.get());
+
+  for (int pass = 0; pass < 2; ++pass) {
+    RecList result;
+    result.read(prot.get());
+    const RecList* item = &result;
+    for (int16_t i = 0; i < 40; ++i) {
+      BOOST_REQUIRE(item->nextitem != nullptr);
+      BOOST_CHECK_EQUAL(item->item, i);
+      item = item->nextitem.get();
+    }
+    BOOST_CHECK_EQUAL(item->item, 40);
+    BOOST_CHECK(item->nextitem == nullptr);
+  }
+  BOOST_CHECK_EQUAL(buf->available_read(), 0u);
+}
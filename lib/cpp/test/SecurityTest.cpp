@@ -276,4 +276,74 @@ BOOST_AUTO_TEST_CASE(ssl_security_matrix)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ssl_session_resumption)
+{
+    const int connections = 3;
+
+    shared_ptr<TSSLSocketFactory> pServerSocketFactory(new TSSLSocketFactory());
+    pServerSocketFactory->loadCertificate(certFile("server.crt").string().c_str());
+    pServerSocketFactory->loadPrivateKey(certFile("server.key").string().c_str());
+    pServerSocketFactory->server(true);
+    pServerSocketFactory->sessionCache(true);
+    shared_ptr<TSSLServerSocket> pServerSocket(new TSSLServerSocket("localhost", 0, pServerSocketFactory));
+    pServerSocket->listen();
+    int port = pServerSocket->getPort();
+
+    boost::thread serverThread([pServerSocket, connections]() {
+        for (int i = 0; i < connections; ++i)
+        {
+            try
+            {
+                shared_ptr<TTransport> connectedClient = pServerSocket->accept();
+                connectedClient->write(reinterpret_cast<const uint8_t*>("OK"), 2);
+                connectedClient->flush();
+                uint8_t done;
+                connectedClient->read(&done, 1);
+                connectedClient->close();
+            }
+            catch (TTransportException& ex)
+            {
+                boost::mutex::scoped_lock lock(gMutex);
+                BOOST_TEST_MESSAGE(boost::format("SRV Exception: %1%") % ex.what());
+                if (ex.getType() == TTransportException::INTERRUPTED)
+                {
+                    return;
+                }
+            }
+        }
+    });
+
+    try
+    {
+        shared_ptr<TSSLSocketFactory> pClientSocketFactory(new TSSLSocketFactory());
+        pClientSocketFactory->authenticate(true);
+        pClientSocketFactory->loadTrustedCertificates(certFile("CA.pem").string().c_str());
+        pClientSocketFactory->sessionCache(true);
+
+        for (int i = 0; i < connections; ++i)
+        {
+            shared_ptr<TSSLSocket> pClientSocket = pClientSocketFactory->createSocket("localhost", port);
+            pClientSocket->open();
+            uint8_t buf[2];
+            BOOST_CHECK_EQUAL(2, pClientSocket->read(&buf[0], 2));
+            // the first connection performs a full handshake, later ones resume
+            BOOST_CHECK_EQUAL(i > 0, pClientSocket->isSessionReused());
+            pClientSocket->write(&buf[0], 1);
+            pClientSocket->flush();
+            pClientSocket->close();
+        }
+    }
+    catch (...)
+    {
+        // don't leave the server thread waiting in accept()
+        pServerSocket->interrupt();
+        serverThread.join();
+        pServerSocket->close();
+        throw;
+    }
+
+    serverThread.join();
+    pServerSocket->close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
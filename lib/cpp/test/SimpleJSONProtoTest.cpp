@@ -0,0 +1,157 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <memory>
+#include <thrift/protocol/TSimpleJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+#define BOOST_TEST_MODULE SimpleJSONProtoTest
+#include <boost/test/unit_test.hpp>
+
+using namespace thrift::test::debug;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::protocol::TSimpleJSONProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+
+template <typename ThriftStruct>
+static std::string toSimpleJSON(const ThriftStruct& ts) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TSimpleJSONProtocol proto(buffer);
+  ts.write(&proto);
+  return buffer->getBufferAsString();
+}
+
+template <typename ThriftStruct>
+static void fromSimpleJSON(const std::string& json, ThriftStruct& ts) {
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer((uint8_t*)json.data(), static_cast<uint32_t>(json.size())));
+  TSimpleJSONProtocol proto(buffer);
+  ts.read(&proto);
+}
+
+static OneOfEach oneOfEach() {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.im_false = false;
+  ooe.a_bite = 0x7f;
+  ooe.integer16 = 27000;
+  ooe.integer32 = 1 << 24;
+  ooe.integer64 = (uint64_t)6000 * 1000 * 1000;
+  ooe.double_precision = M_PI;
+  ooe.some_characters = "JSON THIS! \"\1";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = "\1\2\3\255";
+  return ooe;
+}
+
+BOOST_AUTO_TEST_CASE(test_simple_json_write) {
+  const std::string expected_result(
+      "{\"im_true\":true,\"im_false\":false,\"a_bite\":127,\"integer16\":27000,"
+      "\"integer32\":16777216,\"integer64\":6000000000,\"double_precision\":"
+      "3.1415926535897931,\"some_characters\":\"JSON THIS! \\\"\\u0001\","
+      "\"zomg_unicode\":\"\xd7\\n\\u0007\\t\",\"what_who\":false,\"base64\":"
+      "\"AQIDrQ\",\"byte_list\":[1,2,3],\"i16_list\":[1,2,3],\"i64_list\":[1,2,3]}");
+
+  const std::string result(toSimpleJSON(oneOfEach()));
+
+  BOOST_CHECK_MESSAGE(!expected_result.compare(result),
+    "Expected:\n" << expected_result << "\nGotten:\n" << result);
+}
+
+BOOST_AUTO_TEST_CASE(test_simple_json_roundtrip) {
+  HolyMoley hm;
+  hm.big.push_back(oneOfEach());
+  hm.big.push_back(oneOfEach());
+  hm.big[1].a_bite = -3;
+  hm.big[1].double_precision = -0.5;
+  std::vector<std::string> stage;
+  stage.push_back("and a one");
+  stage.push_back("and a two");
+  hm.contain.insert(stage);
+  hm.contain.insert(std::vector<std::string>());
+  Bonk bonk;
+  bonk.type = 31337;
+  bonk.message = "I am a bonk... xor!";
+  hm.bonks["nothing"] = std::vector<Bonk>();
+  hm.bonks["something"].push_back(bonk);
+
+  HolyMoley hm2;
+  fromSimpleJSON(toSimpleJSON(hm), hm2);
+  BOOST_CHECK(hm == hm2);
+}
+
+BOOST_AUTO_TEST_CASE(test_simple_json_read_by_name) {
+  // Members in any order, with whitespace, unknown members and nulls
+  const std::string json(
+      "{ \"my_ooe\" : { \"integer32\" : -12, \"unknown\" : [ {\"a\": [1, 2]}, null ],"
+      "  \"some_characters\" : \"\\u00e9\\ud83d\\ude00\", \"im_true\" : true,"
+      "  \"double_precision\" : 1.5e3, \"byte_list\" : [ ] },"
+      "  \"ignored\" : \"x\", \"my_bonk\" : null }");
+
+  Nesting n;
+  fromSimpleJSON(json, n);
+  BOOST_CHECK_EQUAL(-12, n.my_ooe.integer32);
+  BOOST_CHECK_EQUAL("\xc3\xa9\xf0\x9f\x98\x80", n.my_ooe.some_characters);
+  BOOST_CHECK(n.my_ooe.im_true);
+  BOOST_CHECK_EQUAL(1500.0, n.my_ooe.double_precision);
+  BOOST_CHECK(n.my_ooe.byte_list.empty());
+  BOOST_CHECK(n.__isset.my_ooe);
+  BOOST_CHECK(!n.__isset.my_bonk);
+}
+
+BOOST_AUTO_TEST_CASE(test_simple_json_rejects_mismatched_types) {
+  // Quoted numbers are accepted, as JavaScript clients send large ones so
+  Bonk bonk;
+  fromSimpleJSON("{\"type\":\"31337\"}", bonk);
+  BOOST_CHECK_EQUAL(31337, bonk.type);
+
+  BOOST_CHECK_THROW(fromSimpleJSON("{\"type\":true}", bonk), TProtocolException);
+  BOOST_CHECK_THROW(fromSimpleJSON("{\"type\":\"x\"}", bonk), TProtocolException);
+  BOOST_CHECK_THROW(fromSimpleJSON("{\"type\":2147483648}", bonk), TProtocolException);
+  BOOST_CHECK_THROW(fromSimpleJSON("{\"type\":1,}", bonk), TProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE(test_simple_json_message) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TSimpleJSONProtocol proto(buffer);
+  Bonk bonk;
+  bonk.type = 7;
+  bonk.message = "hi";
+  proto.writeMessageBegin("bonk", apache::thrift::protocol::T_CALL, 42);
+  bonk.write(&proto);
+  proto.writeMessageEnd();
+  BOOST_CHECK_EQUAL("[\"bonk\",1,42,{\"type\":7,\"message\":\"hi\"}]",
+                    buffer->getBufferAsString());
+
+  std::string name;
+  TMessageType type;
+  int32_t seqid;
+  Bonk bonk2;
+  proto.readMessageBegin(name, type, seqid);
+  bonk2.read(&proto);
+  proto.readMessageEnd();
+  BOOST_CHECK_EQUAL("bonk", name);
+  BOOST_CHECK_EQUAL(apache::thrift::protocol::T_CALL, type);
+  BOOST_CHECK_EQUAL(42, seqid);
+  BOOST_CHECK(bonk == bonk2);
+}
@@ -336,6 +336,72 @@ BOOST_AUTO_TEST_CASE(test_noop_flush) {
   }
 }
 
+/**
+ * Make sure the sidecar index summarizes every chunk and can be queried.
+ */
+BOOST_AUTO_TEST_CASE(test_index) {
+  TempFile f(tmp_dir, "thrift.TFileTransportTest.");
+  std::string indexPath = TFileTransportIndex::getIndexPath(f.getPath());
+
+  int64_t before = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch()).count();
+  {
+    TFileTransport transport(f.getPath());
+    // 4 byte length + 60 byte payload: two events per chunk
+    transport.setChunkSize(128);
+    // the key is the first payload byte, events starting with 'x' have none
+    transport.enableIndex([](const uint8_t* buf, uint32_t len, int64_t& key) {
+      if (len == 0 || buf[0] == 'x') {
+        return false;
+      }
+      key = buf[0];
+      return true;
+    });
+
+    uint8_t buf[60];
+    for (uint8_t n = 0; n < 5; ++n) {
+      memset(buf, n == 4 ? 'x' : 'a' + n, sizeof(buf));
+      transport.write(buf, sizeof(buf));
+    }
+    transport.flush();
+  }
+  int64_t after = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::system_clock::now().time_since_epoch()).count();
+
+  TFileTransportIndex index(indexPath);
+  const std::vector<TFileChunkIndexEntry>& entries = index.getEntries();
+  BOOST_REQUIRE_EQUAL(entries.size(), 3u);
+  BOOST_CHECK_EQUAL(entries[0].chunk, 0u);
+  BOOST_CHECK_EQUAL(entries[0].numEvents, 2u);
+  BOOST_CHECK_EQUAL(entries[0].minKey, 'a');
+  BOOST_CHECK_EQUAL(entries[0].maxKey, 'b');
+  BOOST_CHECK_EQUAL(entries[2].chunk, 2u);
+  BOOST_CHECK_EQUAL(entries[2].numEvents, 1u);
+  BOOST_CHECK_EQUAL(entries[2].numKeyedEvents, 0u);
+  for (const auto& entry : entries) {
+    BOOST_CHECK_GE(entry.minTimestamp, before);
+    BOOST_CHECK_LE(entry.maxTimestamp, after);
+  }
+
+  std::vector<uint32_t> byKey = index.findChunksByKey('c', 'z');
+  BOOST_REQUIRE_EQUAL(byKey.size(), 1u);
+  BOOST_CHECK_EQUAL(byKey[0], 1u);
+  BOOST_CHECK_EQUAL(index.findChunksByTime(before, after).size(), 3u);
+  BOOST_CHECK(index.findChunksByTime(after + 1, after + 1000).empty());
+
+  // seeking by time positions the reader at the start of a chunk
+  TFileTransport reader(f.getPath(), true);
+  reader.setChunkSize(128);
+  BOOST_CHECK(reader.seekToTimestamp(before));
+  BOOST_CHECK_EQUAL(reader.getCurChunk(), 0u);
+  uint8_t first[60];
+  BOOST_CHECK_EQUAL(reader.read(first, sizeof(first)), sizeof(first));
+  BOOST_CHECK_EQUAL(first[0], 'a');
+  BOOST_CHECK(!reader.seekToTimestamp(after + 1000));
+
+  ::unlink(indexPath.c_str());
+}
+
 /**************************************************************************
  * General Initialization
  **************************************************************************/
@@ -0,0 +1,174 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE THttp2Test
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/THttp2Client.h>
+#include <thrift/transport/THttp2Server.h>
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocket.h>
+
+using apache::thrift::TConfiguration;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::transport::THttp2Client;
+using apache::thrift::transport::THttp2ClientSession;
+using apache::thrift::transport::THttp2Server;
+using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+using std::string;
+
+/**
+ * Answers every string on one HTTP/2 connection with the string plus "!",
+ * and echoes oneway-style messages (those starting with "oneway") silently.
+ */
+static void serveEcho(TServerSocket* serverSocket, shared_ptr<TConfiguration> config = nullptr) {
+  shared_ptr<THttp2Server> server(new THttp2Server(serverSocket->accept(), config));
+  TBinaryProtocol protocol(server);
+  try {
+    while (server->peek()) {
+      string s;
+      protocol.readString(s);
+      server->readEnd();
+      if (s.compare(0, 6, "oneway") != 0) {
+        protocol.writeString(s + "!");
+        server->flush();
+      }
+    }
+  } catch (const apache::thrift::transport::TTransportException&) {
+    // client went away
+  }
+  server->close();
+}
+
+static string call(shared_ptr<THttp2ClientSession> session,
+                   const string& s,
+                   shared_ptr<TConfiguration> config = nullptr) {
+  shared_ptr<THttp2Client> client(new THttp2Client(session, config));
+  TBinaryProtocol protocol(client);
+  protocol.writeString(s);
+  client->flush();
+  string reply;
+  protocol.readString(reply);
+  return reply;
+}
+
+BOOST_AUTO_TEST_SUITE(THttp2Test)
+
+BOOST_AUTO_TEST_CASE(test_sequential_calls) {
+  TServerSocket serverSocket("localhost", 0);
+  serverSocket.listen();
+  std::thread serverThread(serveEcho, &serverSocket, nullptr);
+
+  shared_ptr<THttp2ClientSession> session(
+      new THttp2ClientSession(shared_ptr<TTransport>(new TSocket("localhost", serverSocket.getPort()))));
+  session->open();
+  BOOST_CHECK_EQUAL("hello!", call(session, "hello"));
+
+  // a oneway call never gets its reply read; the next call is unaffected
+  shared_ptr<THttp2Client> client(new THttp2Client(session));
+  TBinaryProtocol protocol(client);
+  protocol.writeString(string("oneway"));
+  client->flush();
+  BOOST_CHECK_EQUAL("again!", call(session, "again"));
+
+  // larger than the default 64KB flow control window in both directions
+  string big(200000, 'x');
+  BOOST_CHECK(big + "!" == call(session, big));
+
+  session->close();
+  serverThread.join();
+  serverSocket.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_calls_share_connection) {
+  TServerSocket serverSocket("localhost", 0);
+  serverSocket.listen();
+  std::thread serverThread(serveEcho, &serverSocket, nullptr);
+
+  shared_ptr<THttp2ClientSession> session(
+      new THttp2ClientSession(shared_ptr<TTransport>(new TSocket("localhost", serverSocket.getPort()))));
+  session->open();
+
+  const int threads = 8;
+  const int calls = 50;
+  std::vector<int> failures(threads, 0);
+  std::vector<std::thread> clients;
+  for (int t = 0; t < threads; ++t) {
+    clients.push_back(std::thread([&, t]() {
+      for (int i = 0; i < calls; ++i) {
+        string s = std::to_string(t) + ":" + std::to_string(i);
+        if (call(session, s) != s + "!") {
+          ++failures[t];
+        }
+      }
+    }));
+  }
+  for (size_t t = 0; t < clients.size(); ++t) {
+    clients[t].join();
+    BOOST_CHECK_EQUAL(0, failures[t]);
+  }
+
+  session->close();
+  serverThread.join();
+  serverSocket.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_max_message_size) {
+  TServerSocket serverSocket("localhost", 0);
+  serverSocket.listen();
+  std::thread serverThread(serveEcho, &serverSocket, std::make_shared<TConfiguration>(100000));
+
+  shared_ptr<THttp2ClientSession> session(
+      new THttp2ClientSession(shared_ptr<TTransport>(new TSocket("localhost", serverSocket.getPort()))));
+  session->open();
+
+  // The server resets the stream of a request it will not buffer
+  try {
+    call(session, string(200000, 'x'));
+    BOOST_ERROR("oversized request was answered");
+  } catch (const TTransportException& e) {
+    BOOST_CHECK_EQUAL(TTransportException::END_OF_FILE, e.getType());
+    BOOST_CHECK(string(e.what()).find("reset") != string::npos);
+  }
+
+  // and the client one of a response it will not buffer
+  try {
+    call(session, string(60000, 'x'), std::make_shared<TConfiguration>(50000));
+    BOOST_ERROR("oversized response was read");
+  } catch (const TTransportException& e) {
+    BOOST_CHECK_EQUAL(TTransportException::CORRUPTED_DATA, e.getType());
+  }
+
+  // Either way the connection carries on
+  BOOST_CHECK_EQUAL("hello!", call(session, "hello"));
+
+  session->close();
+  serverThread.join();
+  serverSocket.close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
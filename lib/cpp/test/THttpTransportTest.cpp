@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/THttpClient.h>
+#include <thrift/transport/THttpServer.h>
+
+BOOST_AUTO_TEST_SUITE(THttpTransportTest)
+
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::THttpClient;
+using apache::thrift::transport::THttpServer;
+using std::shared_ptr;
+using std::string;
+
+static string readBody(THttpServer& server) {
+  string body;
+  uint8_t buf[64];
+  do {
+    uint32_t got = server.read(buf, sizeof(buf));
+    body.append(reinterpret_cast<const char*>(buf), got);
+  } while (body.size() < 5);
+  server.readEnd();
+  return body;
+}
+
+BOOST_AUTO_TEST_CASE(test_pipelined_requests) {
+  // Two requests sent back to back on one keep-alive connection, one with
+  // a Content-Length body and one chunked
+  string wire = "POST /service HTTP/1.1\r\n"
+                "Host: localhost\r\n"
+                "Content-Length: 5\r\n"
+                "\r\n"
+                "first"
+                "POST /service HTTP/1.1\r\n"
+                "Host: localhost\r\n"
+                "Transfer-Encoding: chunked\r\n"
+                "\r\n"
+                "2\r\nse\r\n"
+                "3;ext=1\r\ncnd\r\n"
+                "0\r\n"
+                "\r\n";
+  shared_ptr<TMemoryBuffer> in(new TMemoryBuffer(
+      reinterpret_cast<uint8_t*>(&wire[0]), static_cast<uint32_t>(wire.size())));
+  THttpServer server(in);
+
+  BOOST_CHECK(server.peek());
+  BOOST_CHECK_EQUAL("first", readBody(server));
+
+  // The second request is already buffered by the HTTP transport
+  BOOST_CHECK_EQUAL(0u, in->available_read());
+  BOOST_CHECK(server.peek());
+  BOOST_CHECK_EQUAL("secnd", readBody(server));
+  BOOST_CHECK(!server.peek());
+}
+
+BOOST_AUTO_TEST_CASE(test_large_body) {
+  string body(5000, 'x');
+  string wire = "POST /service HTTP/1.1\r\nContent-Length: 5000\r\n\r\n" + body;
+  shared_ptr<TMemoryBuffer> in(new TMemoryBuffer(
+      reinterpret_cast<uint8_t*>(&wire[0]), static_cast<uint32_t>(wire.size())));
+  THttpServer server(in);
+
+  string got(body.size(), '\0');
+  server.readAll(reinterpret_cast<uint8_t*>(&got[0]), static_cast<uint32_t>(got.size()));
+  server.readEnd();
+  BOOST_CHECK(got == body);
+  BOOST_CHECK(!server.peek());
+}
+
+BOOST_AUTO_TEST_CASE(test_client_request_header) {
+  shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+  THttpClient client(out, "example.com", "/svc");
+
+  client.write(reinterpret_cast<const uint8_t*>("abc"), 3);
+  client.flush();
+  client.setPath("/other");
+  client.write(reinterpret_cast<const uint8_t*>("defghijklmno"), 12);
+  client.flush();
+
+  string wire = out->getBufferAsString();
+  size_t second = wire.find("POST /other HTTP/1.1\r\n");
+  BOOST_REQUIRE(second != string::npos);
+  string first = wire.substr(0, second);
+  BOOST_CHECK_EQUAL(0u, first.find("POST /svc HTTP/1.1\r\nHost: example.com\r\n"));
+  BOOST_CHECK(first.find("Content-Length: 3\r\n\r\nabc") != string::npos);
+  BOOST_CHECK(wire.find("Content-Length: 12\r\n\r\ndefghijklmno", second) != string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
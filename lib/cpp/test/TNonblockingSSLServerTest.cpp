@@ -283,4 +283,18 @@ BOOST_FIXTURE_TEST_CASE(provide_event_base, Fixture) {
 #endif
 }
 
+BOOST_FIXTURE_TEST_CASE(stalled_handshake_does_not_block_io_thread, Fixture) {
+  startServer(0);
+  int port = server->getListenPort();
+
+  // a client that starts a handshake and then goes silent, on the only IO thread
+  transport::TSocket stalled("localhost", port);
+  stalled.open();
+  const uint8_t partialClientHello[] = {0x16, 0x03, 0x01, 0x02, 0x00, 0x01};
+  stalled.write(partialClientHello, sizeof(partialClientHello));
+
+  BOOST_CHECK(canCommunicate(port));
+  stalled.close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
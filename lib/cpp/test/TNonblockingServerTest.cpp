@@ -19,8 +19,12 @@
 
 #define BOOST_TEST_MODULE TNonblockingServerTest
 #include <boost/test/unit_test.hpp>
+#include <functional>
 #include <memory>
+#include <set>
+#include <thread>
 
+#include "thrift/concurrency/AffinityThreadFactory.h"
 #include "thrift/concurrency/Monitor.h"
 #include "thrift/concurrency/Thread.h"
 #include "thrift/server/TNonblockingServer.h"
@@ -30,13 +34,16 @@
 
 #include <event.h>
 
+using apache::thrift::concurrency::AffinityThreadFactory;
 using apache::thrift::concurrency::Guard;
 using apache::thrift::concurrency::Monitor;
 using apache::thrift::concurrency::Mutex;
 using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::concurrency::Runnable;
+using apache::thrift::concurrency::Synchronized;
 using apache::thrift::concurrency::Thread;
 using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::concurrency::ThreadManager;
 using apache::thrift::server::TServerEventHandler;
 using std::make_shared;
 using std::shared_ptr;
@@ -57,6 +64,23 @@ struct Handler : public test::ParentServiceIf {
   void unexpectedExceptionWait(const std::string&) override {}
 };
 
+// Makes a handler for each processor, recording the threads that ask for them
+struct HandlerFactory : public test::ParentServiceIfFactory {
+  HandlerFactory() : withoutTransport(true) {}
+
+  test::ParentServiceIf* getHandler(const TConnectionInfo& connInfo) override {
+    Guard g(mutex);
+    withoutTransport = withoutTransport && !connInfo.transport;
+    threads.push_back(std::this_thread::get_id());
+    return new ::Handler;
+  }
+  void releaseHandler(test::ParentServiceIf* handler) override { delete handler; }
+
+  Mutex mutex;
+  std::vector<std::thread::id> threads;
+  bool withoutTransport;
+};
+
 class Fixture {
 private:
   struct ListenEventHandler : public TServerEventHandler {
@@ -77,9 +101,12 @@ private:
     int port;
     shared_ptr<event_base> userEventBase;
     shared_ptr<TProcessor> processor;
+    shared_ptr<TProcessorFactory> processorFactory;
     shared_ptr<server::TNonblockingServer> server;
     shared_ptr<ListenEventHandler> listenHandler;
     shared_ptr<transport::TNonblockingServerSocket> socket;
+    std::function<void(server::TNonblockingServer&)> configure;
+    std::function<void(transport::TNonblockingServerSocket&)> configureSocket;
     Mutex mutex_;
 
     Runner() {
@@ -104,8 +131,18 @@ private:
     void startServer(int retry_count) {
       try {
         socket.reset(new transport::TNonblockingServerSocket(port));
-        server.reset(new server::TNonblockingServer(processor, socket));
+        if (configureSocket) {
+          configureSocket(*socket);
+        }
+        if (processorFactory) {
+          server.reset(new server::TNonblockingServer(processorFactory, socket));
+        } else {
+          server.reset(new server::TNonblockingServer(processor, socket));
+        }
         server->setServerEventHandler(listenHandler);
+        if (configure) {
+          configure(*server);
+        }
         if (userEventBase) {
           server->registerEvents(userEventBase.get());
         }
@@ -145,7 +182,10 @@ protected:
     shared_ptr<Runner> runner(new Runner);
     runner->port = port;
     runner->processor = processor;
+    runner->processorFactory = processorFactory_;
     runner->userEventBase = userEventBase_;
+    runner->configure = configure_;
+    runner->configureSocket = configureSocket_;
 
     shared_ptr<ThreadFactory> threadFactory(
         new ThreadFactory(false));
@@ -168,6 +208,15 @@ protected:
     return strings.size() == 1 && !(strings[0].compare("foo"));
   }
 
+  // Called on the server before it starts serving
+  std::function<void(server::TNonblockingServer&)> configure_;
+
+  // Called on the server socket before it listens
+  std::function<void(transport::TNonblockingServerSocket&)> configureSocket_;
+
+  // Used in place of the fixture's processor, if set
+  shared_ptr<TProcessorFactory> processorFactory_;
+
 private:
   shared_ptr<event_base> userEventBase_;
   shared_ptr<test::ParentServiceProcessor> processor;
@@ -212,4 +261,207 @@ BOOST_FIXTURE_TEST_CASE(provide_event_base, Fixture) {
 #endif
 }
 
+BOOST_FIXTURE_TEST_CASE(io_thread_placement, Fixture) {
+  // One pool per IO thread, with both on the same node as their workers
+  std::vector<shared_ptr<ThreadManager> > threadManagers;
+  for (int i = 0; i < 2; ++i) {
+    shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(1);
+    threadManager->threadFactory(AffinityThreadFactory::forNumaNode(0));
+    threadManager->start();
+    threadManagers.push_back(threadManager);
+  }
+  shared_ptr<ThreadFactory> ioThreadFactory = AffinityThreadFactory::forNumaNode(0);
+  configure_ = [&](server::TNonblockingServer& server) {
+    server.setNumIOThreads(2);
+    server.setIOThreadFactory(ioThreadFactory);
+    server.setIOThreadManagers(threadManagers);
+  };
+  startServer(0);
+
+  BOOST_CHECK(!ioThreadFactory->isDetached());
+  BOOST_CHECK(server->getThreadManager() == threadManagers[0]);
+  BOOST_CHECK(server->getIOThreadManager(1) == threadManagers[1]);
+  BOOST_CHECK(server->getIOThreadManager(2) == threadManagers[0]);
+
+  // Connections go to each IO thread in turn, so calls reach both pools
+  int port = server->getListenPort();
+  BOOST_CHECK(canCommunicate(port));
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+  std::vector<std::string> strings;
+  client.getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 1u);
+
+  BOOST_CHECK_THROW(server->setIOThreadManagers(std::vector<shared_ptr<ThreadManager> >()),
+                    std::invalid_argument);
+}
+
+// Holds a thread manager's worker until released
+struct BlockingTask : public Runnable {
+  BlockingTask() : started(false), released(false) {}
+
+  void run() override {
+    Synchronized s(monitor);
+    started = true;
+    monitor.notifyAll();
+    while (!released) {
+      monitor.wait();
+    }
+  }
+
+  void waitUntilStarted() {
+    Synchronized s(monitor);
+    while (!started) {
+      monitor.wait();
+    }
+  }
+
+  void release() {
+    Synchronized s(monitor);
+    released = true;
+    monitor.notifyAll();
+  }
+
+  Monitor monitor;
+  bool started;
+  bool released;
+};
+
+BOOST_FIXTURE_TEST_CASE(inline_calls, Fixture) {
+  shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(1);
+  threadManager->threadFactory(make_shared<ThreadFactory>());
+  threadManager->start();
+  configure_ = [&](server::TNonblockingServer& server) {
+    server.setThreadManager(threadManager);
+    server.setUseInlineCalls(true);
+    server.setInlineFunctions({"getStrings"});
+  };
+  startServer(0);
+  BOOST_CHECK(server->useInlineCalls());
+
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", server->getListenPort()));
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+
+  // With the only worker busy, inline calls are still answered, both those
+  // annotated in the IDL and those named to the server
+  shared_ptr<BlockingTask> blocker = make_shared<BlockingTask>();
+  threadManager->add(blocker);
+  blocker->waitUntilStarted();
+  BOOST_CHECK_EQUAL(client.getGeneration(), 0);
+  std::vector<std::string> strings;
+  client.getStrings(strings);
+  BOOST_CHECK(strings.empty());
+
+  // Other calls wait for the worker
+  blocker->release();
+  client.addString("foo");
+  client.getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(listen_alongside) {
+  transport::TNonblockingServerSocket plain(0);
+  plain.listen();
+  BOOST_CHECK_THROW(plain.listenAlongside(), transport::TTransportException);
+
+  transport::TNonblockingServerSocket shared(0);
+  shared.setReusePort(true);
+  BOOST_CHECK_THROW(shared.listenAlongside(), transport::TTransportException);
+  shared.listen();
+  shared_ptr<transport::TNonblockingServerTransport> sibling = shared.listenAlongside();
+  BOOST_CHECK_EQUAL(sibling->getListenPort(), shared.getListenPort());
+  BOOST_CHECK_NE(sibling->getSocketFD(), shared.getSocketFD());
+}
+
+BOOST_FIXTURE_TEST_CASE(thread_per_core, Fixture) {
+  const size_t ioThreads = 4;
+  shared_ptr<HandlerFactory> handlerFactory = make_shared<HandlerFactory>();
+  processorFactory_ = make_shared<test::ParentServiceProcessorFactory>(handlerFactory);
+  configureSocket_ = [](transport::TNonblockingServerSocket& socket) {
+    socket.setReusePort(true);
+  };
+  configure_ = [&](server::TNonblockingServer& server) {
+    server.setThreadPerCore(true);
+    server.setNumIOThreads(ioThreads);
+  };
+  startServer(0);
+  BOOST_CHECK(server->isThreadPerCore());
+  int port = server->getListenPort();
+
+  // Keep the connections open, so the kernel spreads them over the sockets
+  std::vector<shared_ptr<test::ParentServiceClient> > clients;
+  for (int i = 0; i < 32; ++i) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+    socket->open();
+    clients.push_back(make_shared<test::ParentServiceClient>(
+        make_shared<protocol::TBinaryProtocol>(make_shared<transport::TFramedTransport>(socket))));
+  }
+  for (size_t i = 0; i < clients.size(); ++i) {
+    std::string s = std::to_string(i);
+    clients[i]->addString(s);
+    std::vector<std::string> strings;
+    clients[i]->getStrings(strings);
+    BOOST_CHECK(std::find(strings.begin(), strings.end(), s) != strings.end());
+  }
+
+  // One handler for each IO thread that accepted a connection, made on that thread
+  Guard g(handlerFactory->mutex);
+  std::set<std::thread::id> threads(handlerFactory->threads.begin(),
+                                    handlerFactory->threads.end());
+  BOOST_CHECK_GE(threads.size(), 1u);
+  BOOST_CHECK_LE(threads.size(), ioThreads);
+  BOOST_CHECK_EQUAL(threads.size(), handlerFactory->threads.size());
+  BOOST_CHECK(handlerFactory->withoutTransport);
+}
+
+BOOST_FIXTURE_TEST_CASE(drain, Fixture) {
+  shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(1);
+  threadManager->threadFactory(make_shared<ThreadFactory>());
+  threadManager->start();
+  configure_ = [&](server::TNonblockingServer& server) { server.setThreadManager(threadManager); };
+  startServer(0);
+  int port = server->getListenPort();
+
+  shared_ptr<transport::TSocket> idleSocket(new transport::TSocket("localhost", port));
+  idleSocket->setRecvTimeout(5000);
+  idleSocket->open();
+  test::ParentServiceClient idleClient(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(idleSocket)));
+  idleClient.addString("idle");
+
+  // With the only worker busy, a call waits in the queue
+  shared_ptr<BlockingTask> blocker = make_shared<BlockingTask>();
+  threadManager->add(blocker);
+  blocker->waitUntilStarted();
+  shared_ptr<transport::TSocket> busySocket(new transport::TSocket("localhost", port));
+  busySocket->setRecvTimeout(5000);
+  busySocket->open();
+  test::ParentServiceClient busyClient(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(busySocket)));
+  std::thread call([&] { busyClient.addString("busy"); });
+  while (threadManager->pendingTaskCount() == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  bool drained = false;
+  std::thread drainer([&] { drained = server->drain(10000); });
+
+  // The idle connection is closed straight away
+  uint8_t buf[1];
+  BOOST_CHECK_EQUAL(idleSocket->read(buf, 1), 0u);
+
+  // The queued call is answered, then its connection closed
+  blocker->release();
+  call.join();
+  BOOST_CHECK_EQUAL(busySocket->read(buf, 1), 0u);
+
+  drainer.join();
+  BOOST_CHECK(drained);
+  BOOST_CHECK_EQUAL(server->getNumActiveConnections(), 0u);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -29,6 +29,7 @@
 #include <thrift/server/TThreadedServer.h>
 #include <memory>
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TTransport.h>
@@ -44,6 +45,7 @@ using apache::thrift::protocol::TBinaryProtocol;
 using apache::thrift::protocol::TBinaryProtocolFactory;
 using apache::thrift::protocol::TProtocol;
 using apache::thrift::protocol::TProtocolFactory;
+using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::transport::TServerSocket;
 using apache::thrift::transport::TServerTransport;
 using apache::thrift::transport::TSocket;
@@ -533,4 +535,48 @@ BOOST_AUTO_TEST_CASE(test_concurrent_client_limit) {
   t2.join();
 }
 
+BOOST_AUTO_TEST_CASE(test_drain) {
+  BOOST_TEST_MESSAGE("Testing drain with idle and busy clients");
+
+  startServer();
+
+  shared_ptr<TSocket> pIdleSock(new TSocket("localhost", getServerPort()), autoSocketCloser);
+  pIdleSock->setRecvTimeout(5000);
+  pIdleSock->open();
+
+  shared_ptr<TSocket> pBusySock(new TSocket("localhost", getServerPort()), autoSocketCloser);
+  pBusySock->setRecvTimeout(5000);
+  pBusySock->open();
+
+  blockUntilAccepted(2);
+
+  // Start a request on the busy client without finishing it
+  shared_ptr<TMemoryBuffer> pRequest(new TMemoryBuffer());
+  ParentServiceClient(make_shared<TBinaryProtocol>(pRequest)).send_getGeneration();
+  std::string request = pRequest->getBufferAsString();
+  size_t half = request.size() / 2;
+  pBusySock->write(reinterpret_cast<const uint8_t*>(request.data()), half);
+  boost::this_thread::sleep(milliseconds(50));
+
+  bool drained = false;
+  boost::thread drainer([&] { drained = pServer->drain(10000); });
+
+  // The idle client is disconnected straight away
+  uint8_t buf[1];
+  BOOST_CHECK_EQUAL(0, pIdleSock->read(&buf[0], 1));
+
+  // The busy client gets its reply, then is disconnected
+  pBusySock->write(reinterpret_cast<const uint8_t*>(request.data()) + half,
+                   request.size() - half);
+  ParentServiceClient busyClient(make_shared<TBinaryProtocol>(pBusySock));
+  BOOST_CHECK_EQUAL(0, busyClient.recv_getGeneration());
+  BOOST_CHECK_EQUAL(0, pBusySock->read(&buf[0], 1));
+
+  // Once drained, serve() returns by itself
+  drainer.join();
+  BOOST_CHECK(drained);
+  pServerThread->join();
+  pServerThread.reset();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -20,6 +20,8 @@
 #include <boost/test/unit_test.hpp>
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocketHandoff.h>
+#include <cstring>
 #include <memory>
 #include "TTransportCheckThrow.h"
 #include <iostream>
@@ -28,6 +30,7 @@ using apache::thrift::transport::TServerSocket;
 using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TTransport;
 using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::receiveSocket;
 using std::shared_ptr;
 
 BOOST_AUTO_TEST_SUITE(TServerSocketTest)
@@ -70,4 +73,75 @@ BOOST_AUTO_TEST_CASE(test_get_port) {
   BOOST_CHECK_EQUAL(888, sock1.getPort());
 }
 
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(test_hand_off) {
+  THRIFT_SOCKET channel[2];
+  BOOST_REQUIRE_EQUAL(0, THRIFT_SOCKETPAIR(AF_LOCAL, SOCK_STREAM, 0, channel));
+
+  TServerSocket sock1("localhost", 0);
+  sock1.listen();
+  sock1.handOff(channel[0]);
+
+  TServerSocket sock2("localhost", 0);
+  sock2.setListenSocket(receiveSocket(channel[1]));
+  sock2.listen();
+  BOOST_CHECK(sock2.isOpen());
+  BOOST_CHECK_EQUAL(sock1.getPort(), sock2.getPort());
+
+  // the socket keeps listening for sock2 once sock1 closes
+  sock1.close();
+  TSocket clientSock("localhost", sock2.getPort());
+  clientSock.open();
+  shared_ptr<TTransport> accepted = sock2.accept();
+  accepted->close();
+  sock2.close();
+
+  ::THRIFT_CLOSESOCKET(channel[0]);
+  ::THRIFT_CLOSESOCKET(channel[1]);
+}
+
+BOOST_AUTO_TEST_CASE(test_hand_off_rejected) {
+  THRIFT_SOCKET channel[2];
+  BOOST_REQUIRE_EQUAL(0, THRIFT_SOCKETPAIR(AF_LOCAL, SOCK_STREAM, 0, channel));
+
+  // Send two descriptors where one is expected
+  int fds[2] = {dup(channel[0]), dup(channel[0])};
+  char byte = 0;
+  struct iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(fds))];
+  } control;
+  std::memset(&control, 0, sizeof(control));
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  BOOST_REQUIRE_EQUAL(1, sendmsg(channel[0], &msg, 0));
+  ::THRIFT_CLOSESOCKET(fds[0]);
+  ::THRIFT_CLOSESOCKET(fds[1]);
+
+  // New descriptors take the lowest free number, so one that leaked would
+  // move the next one up
+  int before = dup(channel[0]);
+  ::THRIFT_CLOSESOCKET(before);
+  TTRANSPORT_CHECK_THROW(receiveSocket(channel[1]), TTransportException::CORRUPTED_DATA);
+  int after = dup(channel[0]);
+  ::THRIFT_CLOSESOCKET(after);
+  BOOST_CHECK_EQUAL(before, after);
+
+  ::THRIFT_CLOSESOCKET(channel[0]);
+  ::THRIFT_CLOSESOCKET(channel[1]);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
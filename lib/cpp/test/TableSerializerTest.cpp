@@ -0,0 +1,304 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/protocol/TSimpleJSONProtocol.h>
+#include <thrift/protocol/TTableSerializer.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+#include "gen-cpp/Recursive_types.h"
+
+#define BOOST_TEST_MODULE TableSerializerTest
+#include <boost/test/unit_test.hpp>
+
+using namespace apache::thrift::protocol;
+using namespace thrift::test::debug;
+using apache::thrift::transport::TMemoryBuffer;
+
+typedef TBinaryProtocolT<TMemoryBuffer> TBufferedBinaryProtocol;
+
+template <class Protocol_, class Struct_>
+static std::string writeGenerated(const Struct_& obj) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ proto(buffer);
+  obj.write(&proto);
+  return buffer->getBufferAsString();
+}
+
+template <class Protocol_, class Struct_>
+static std::string writeTable(const Struct_& obj) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ proto(buffer);
+  TTableSerializer::write(&proto, obj);
+  return buffer->getBufferAsString();
+}
+
+template <class Protocol_, class Struct_>
+static void readPartial(const std::string& data, const TFieldMask& mask, Struct_& obj) {
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size())));
+  Protocol_ proto(buffer);
+  obj.readPartial(&proto, mask);
+}
+
+template <class Protocol_, class Struct_>
+static void readTable(const std::string& data, Struct_& obj) {
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer((uint8_t*)data.data(), static_cast<uint32_t>(data.size())));
+  Protocol_ proto(buffer);
+  TTableSerializer::read(&proto, obj);
+}
+
+// Checks that TTableSerializer writes what the generated code writes, and
+// reads it back
+template <class Protocol_, class Struct_>
+static void checkProtocol(const Struct_& obj) {
+  const std::string generated = writeGenerated<Protocol_>(obj);
+  BOOST_CHECK(generated == writeTable<Protocol_>(obj));
+
+  Struct_ obj2;
+  readTable<Protocol_>(generated, obj2);
+  BOOST_CHECK(obj == obj2);
+}
+
+template <class Struct_>
+static void checkAllProtocols(const Struct_& obj) {
+  checkProtocol<TBinaryProtocol>(obj);
+  checkProtocol<TCompactProtocol>(obj);
+  checkProtocol<TBufferedBinaryProtocol>(obj);
+  checkProtocol<TJSONProtocol>(obj);
+  checkProtocol<TSimpleJSONProtocol>(obj);
+}
+
+static OneOfEach oneOfEach() {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.im_false = false;
+  ooe.a_bite = 0x7f;
+  ooe.integer16 = 27000;
+  ooe.integer32 = 1 << 24;
+  ooe.integer64 = (uint64_t)6000 * 1000 * 1000;
+  ooe.double_precision = M_PI;
+  ooe.some_characters = "JSON THIS! \"\1";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = "\1\2\3\255";
+  return ooe;
+}
+
+BOOST_AUTO_TEST_CASE(test_table_one_of_each) {
+  checkAllProtocols(oneOfEach());
+}
+
+BOOST_AUTO_TEST_CASE(test_table_nested_containers) {
+  HolyMoley hm;
+  hm.big.push_back(oneOfEach());
+  hm.big.push_back(oneOfEach());
+  hm.big[1].a_bite = -3;
+  std::vector<std::string> stage;
+  stage.push_back("and a one");
+  stage.push_back("and a two");
+  hm.contain.insert(stage);
+  hm.contain.insert(std::vector<std::string>());
+  Bonk bonk;
+  bonk.type = 31337;
+  bonk.message = "I am a bonk... xor!";
+  hm.bonks["nothing"] = std::vector<Bonk>();
+  hm.bonks["something"].push_back(bonk);
+  checkAllProtocols(hm);
+}
+
+BOOST_AUTO_TEST_CASE(test_table_all_container_types) {
+  CompactProtoTestStruct cpts;
+  cpts.a_binary = std::string("\0\1\2", 3);
+  cpts.boolean_list.push_back(true);
+  cpts.boolean_list.push_back(false);
+  cpts.boolean_list.push_back(true);
+  cpts.double_set.insert(-1.5);
+  cpts.double_set.insert(2.25);
+  cpts.binary_set.insert(std::string("\xff", 1));
+  cpts.boolean_byte_map[true] = 1;
+  cpts.boolean_byte_map[false] = 0;
+  cpts.string_byte_map["one"] = 1;
+  cpts.list_byte_map[std::vector<int8_t>(3, 7)] = 7;
+  std::map<int8_t, int8_t> key;
+  key[1] = 2;
+  cpts.map_byte_map[key] = 2;
+  cpts.byte_map_map[1][2] = 3;
+  cpts.byte_set_map[4].insert(5);
+  cpts.struct_list.resize(2);
+  cpts.field20000 = -1;
+  // Maps with non-string keys cannot be written as simple JSON objects
+  checkProtocol<TBinaryProtocol>(cpts);
+  checkProtocol<TCompactProtocol>(cpts);
+  checkProtocol<TJSONProtocol>(cpts);
+}
+
+BOOST_AUTO_TEST_CASE(test_table_enums_and_optionals) {
+  StructWithSomeEnum swse;
+  swse.blah = SomeEnum::TWO;
+  checkAllProtocols(swse);
+
+  // TJSONProtocol does not accept the negative ids of implicit fields
+  TupleProtocolTestStruct tuple;
+  tuple.__set_field3(3);
+  tuple.__set_field12(12);
+  checkProtocol<TBinaryProtocol>(tuple);
+  checkProtocol<TCompactProtocol>(tuple);
+  checkProtocol<TSimpleJSONProtocol>(tuple);
+}
+
+BOOST_AUTO_TEST_CASE(test_table_required_fields) {
+  const std::string empty = writeGenerated<TBinaryProtocol>(Empty());
+  SingleMapTestStruct smts;
+  BOOST_CHECK_THROW(readTable<TBinaryProtocol>(empty, smts), TProtocolException);
+  BOOST_CHECK_THROW(readTable<TCompactProtocol>(writeGenerated<TCompactProtocol>(Empty()), smts),
+                    TProtocolException);
+
+  smts.i32_map[1] = 2;
+  checkAllProtocols(smts);
+}
+
+BOOST_AUTO_TEST_CASE(test_table_unknown_fields) {
+  // Fields the reader does not know are skipped
+  const std::string ooe = writeGenerated<TCompactProtocol>(oneOfEach());
+  Bonk bonk;
+  readTable<TCompactProtocol>(ooe, bonk);
+  BOOST_CHECK(bonk == Bonk());
+
+  BreaksRubyCompactProtocol brcp;
+  brcp.field1 = "one";
+  brcp.field2.field2 = "forty-five";
+  brcp.field3 = 3;
+  checkAllProtocols(brcp);
+}
+
+BOOST_AUTO_TEST_CASE(test_table_delegates_non_generic_structs) {
+  // RecList holds its next item by reference, so its descriptor is not
+  // generic and its own read() and write() are used
+  BOOST_CHECK(!RecList::__descriptor.generic);
+  BOOST_CHECK(VectorTest::__descriptor.generic);
+
+  VectorTest vt;
+  vt.lister.resize(2);
+  vt.lister[0].item = 1;
+  vt.lister[1].item = 2;
+  vt.lister[1].nextitem.reset(new RecList());
+  vt.lister[1].nextitem->item = 3;
+
+  const std::string generated = writeGenerated<TBinaryProtocol>(vt);
+  BOOST_CHECK(generated == writeTable<TBinaryProtocol>(vt));
+  VectorTest vt2;
+  readTable<TBinaryProtocol>(generated, vt2);
+  BOOST_REQUIRE_EQUAL(2u, vt2.lister.size());
+  BOOST_REQUIRE(vt2.lister[1].nextitem);
+  BOOST_CHECK_EQUAL(3, vt2.lister[1].nextitem->item);
+}
+
+template <class Protocol_>
+static void checkPartialFields() {
+  TFieldMask mask(OneOfEach::__descriptor, {"integer32", "some_characters", "14"});
+  OneOfEach full = oneOfEach();
+  full.i64_list.assign(1, -1);
+  OneOfEach ooe;
+  readPartial<Protocol_>(writeGenerated<Protocol_>(full), mask, ooe);
+
+  OneOfEach expected;
+  expected.__set_integer32(full.integer32);
+  expected.__set_some_characters(full.some_characters);
+  expected.__set_i64_list(full.i64_list);
+  BOOST_CHECK(ooe == expected);
+  BOOST_CHECK(ooe.__isset.integer32);
+  BOOST_CHECK(!ooe.__isset.zomg_unicode);
+  BOOST_CHECK_EQUAL("", ooe.zomg_unicode);
+}
+
+BOOST_AUTO_TEST_CASE(test_partial_fields) {
+  checkPartialFields<TBinaryProtocol>();
+  checkPartialFields<TCompactProtocol>();
+  checkPartialFields<TBufferedBinaryProtocol>();
+  checkPartialFields<TJSONProtocol>();
+  checkPartialFields<TSimpleJSONProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_partial_nested_fields) {
+  HolyMoley hm;
+  hm.big.push_back(oneOfEach());
+  hm.big.push_back(oneOfEach());
+  hm.big[1].a_bite = -3;
+  hm.contain.insert(std::vector<std::string>(1, "contained"));
+  Bonk bonk;
+  bonk.type = 31337;
+  bonk.message = "I am a bonk... xor!";
+  hm.bonks["something"].push_back(bonk);
+
+  // Paths continue through the elements of lists and the values of maps
+  TFieldMask mask(HolyMoley::__descriptor, {"big.a_bite", "bonks.message"});
+  HolyMoley partial;
+  readPartial<TCompactProtocol>(writeGenerated<TCompactProtocol>(hm), mask, partial);
+
+  BOOST_REQUIRE_EQUAL(2u, partial.big.size());
+  BOOST_CHECK_EQUAL(-3, partial.big[1].a_bite);
+  BOOST_CHECK(partial.big[1].__isset.a_bite);
+  BOOST_CHECK_EQUAL("", partial.big[1].some_characters);
+  BOOST_CHECK(partial.contain.empty());
+  BOOST_REQUIRE_EQUAL(1u, partial.bonks["something"].size());
+  BOOST_CHECK_EQUAL(bonk.message, partial.bonks["something"][0].message);
+  BOOST_CHECK_EQUAL(0, partial.bonks["something"][0].type);
+
+  // Selecting a field whole overrides the paths within it
+  mask.add("big");
+  readPartial<TBinaryProtocol>(writeGenerated<TBinaryProtocol>(hm), mask, partial);
+  BOOST_CHECK(partial.big == hm.big);
+}
+
+BOOST_AUTO_TEST_CASE(test_partial_masks) {
+  BOOST_CHECK_THROW(TFieldMask(OneOfEach::__descriptor, {"nothing"}), std::invalid_argument);
+  BOOST_CHECK_THROW(TFieldMask(OneOfEach::__descriptor, {"integer32.more"}), std::invalid_argument);
+  BOOST_CHECK_THROW(TFieldMask(OneOfEach::__descriptor, {"99"}), std::invalid_argument);
+
+  // A failed add leaves the mask as it was
+  TFieldMask mask(HolyMoley::__descriptor);
+  BOOST_CHECK_THROW(mask.add("big.nothing"), std::invalid_argument);
+  BOOST_CHECK(!mask.selected(0));
+  mask.add("1.im_true");
+  BOOST_CHECK(mask.selected(0));
+  BOOST_REQUIRE(mask.child(0) != nullptr);
+  BOOST_CHECK(mask.child(0)->selected(0));
+  BOOST_CHECK(!mask.child(0)->selected(1));
+
+  // Masks only read the struct they were made for
+  OneOfEach ooe;
+  BOOST_CHECK_THROW(readPartial<TBinaryProtocol>(writeGenerated<TBinaryProtocol>(ooe), mask, ooe),
+                    std::invalid_argument);
+
+  // Required fields outside the mask may be missing
+  SingleMapTestStruct smts;
+  const std::string empty = writeGenerated<TBinaryProtocol>(Empty());
+  readPartial<TBinaryProtocol>(empty, TFieldMask(SingleMapTestStruct::__descriptor), smts);
+  BOOST_CHECK_THROW(readPartial<TBinaryProtocol>(
+                        empty, TFieldMask(SingleMapTestStruct::__descriptor, {"i32_map"}), smts),
+                    TProtocolException);
+}
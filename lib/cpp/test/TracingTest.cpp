@@ -0,0 +1,201 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <thrift/TTracing.h>
+#include <thrift/processor/TTracingEventHandler.h>
+#include <thrift/protocol/THeaderProtocol.h>
+#include <thrift/protocol/TTracingProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/OneWayService.h"
+
+#define BOOST_TEST_MODULE TracingTest
+#include <boost/test/unit_test.hpp>
+
+using namespace apache::thrift;
+using namespace apache::thrift::processor;
+using namespace apache::thrift::protocol;
+using apache::thrift::transport::TMemoryBuffer;
+
+class Handler : public onewaytest::OneWayServiceIf {
+public:
+  void roundTripRPC() override { context = TTracer::current(); }
+
+  void oneWayRPC() override {}
+
+  TTraceContext context;
+};
+
+static TSpan spanNamed(const std::string& name) {
+  TSpan span;
+  span.name = name;
+  return span;
+}
+
+BOOST_AUTO_TEST_CASE(test_ring) {
+  TSpanRing ring(3);
+  BOOST_CHECK_EQUAL(ring.capacity(), 4u);
+  for (int i = 0; i < 4; ++i) {
+    BOOST_CHECK(ring.push(spanNamed(std::to_string(i))));
+  }
+  BOOST_CHECK(!ring.push(spanNamed("4")));
+  BOOST_CHECK_EQUAL(ring.dropped(), 1u);
+
+  TSpan span;
+  for (int i = 0; i < 4; ++i) {
+    BOOST_REQUIRE(ring.pop(span));
+    BOOST_CHECK_EQUAL(span.name, std::to_string(i));
+  }
+  BOOST_CHECK(!ring.pop(span));
+  BOOST_CHECK(ring.push(spanNamed("5")));
+  BOOST_REQUIRE(ring.pop(span));
+  BOOST_CHECK_EQUAL(span.name, "5");
+}
+
+BOOST_AUTO_TEST_CASE(test_ring_threads) {
+  const int THREADS = 4;
+  const int SPANS = 10000;
+  TSpanRing ring(64);
+  std::vector<int> taken(THREADS, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; ++t) {
+    threads.emplace_back([&ring, t] {
+      for (int i = 0; i < SPANS; ++i) {
+        TSpan span;
+        span.context.traceId = t;
+        while (!ring.push(std::move(span))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (int popped = 0; popped < THREADS * SPANS;) {
+    TSpan span;
+    if (ring.pop(span)) {
+      ++taken[span.context.traceId];
+      ++popped;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < THREADS; ++t) {
+    BOOST_CHECK_EQUAL(taken[t], SPANS);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_headers) {
+  TTracer tracer;
+  TTraceContext root = tracer.startSpan(TTraceContext());
+  BOOST_REQUIRE(root.valid());
+  BOOST_CHECK_EQUAL(root.parentSpanId, 0u);
+  TTraceContext child = tracer.startSpan(root);
+  BOOST_CHECK_EQUAL(child.traceId, root.traceId);
+  BOOST_CHECK_EQUAL(child.parentSpanId, root.spanId);
+  BOOST_CHECK_NE(child.spanId, root.spanId);
+
+  std::map<std::string, std::string> headers;
+  TTracer::inject(child, headers);
+  BOOST_CHECK_EQUAL(headers[TTracer::TRACE_ID_HEADER].size(), 16u);
+  TTraceContext extracted = TTracer::extract(headers);
+  BOOST_CHECK_EQUAL(extracted.traceId, child.traceId);
+  BOOST_CHECK_EQUAL(extracted.spanId, child.spanId);
+  BOOST_CHECK_EQUAL(extracted.parentSpanId, child.parentSpanId);
+
+  TTracer::inject(root, headers);
+  BOOST_CHECK(headers.find(TTracer::PARENT_SPAN_ID_HEADER) == headers.end());
+
+  // 128 bit trace ids keep their low 64 bits
+  headers[TTracer::TRACE_ID_HEADER] = "0123456789ABCDEF00000000000000ff";
+  BOOST_CHECK_EQUAL(TTracer::extract(headers).traceId, 0xffu);
+  headers[TTracer::TRACE_ID_HEADER] = "xyz";
+  BOOST_CHECK(!TTracer::extract(headers).valid());
+  BOOST_CHECK(!TTracer::extract(std::map<std::string, std::string>()).valid());
+
+  // Unsampled calls start no trace, but the traces of callers continue
+  TTracer unsampled(16, 0.0);
+  for (int i = 0; i < 100; ++i) {
+    BOOST_CHECK(!unsampled.startSpan(TTraceContext()).valid());
+  }
+  BOOST_CHECK(unsampled.startSpan(root).valid());
+}
+
+BOOST_AUTO_TEST_CASE(test_call) {
+  std::shared_ptr<TTracer> tracer(new TTracer());
+  std::shared_ptr<Handler> handler(new Handler());
+  std::shared_ptr<TTracingEventHandler> tracing(new TTracingEventHandler(tracer));
+  onewaytest::OneWayServiceProcessor processor(handler);
+  processor.setEventHandler(tracing);
+
+  std::shared_ptr<TMemoryBuffer> requests(new TMemoryBuffer());
+  std::shared_ptr<TMemoryBuffer> replies(new TMemoryBuffer());
+  std::shared_ptr<TProtocol> client(new TTracingProtocol(
+      std::make_shared<THeaderProtocol>(replies, requests), tracer));
+  std::shared_ptr<TProtocol> server(new THeaderProtocol(requests, replies));
+  void* connection = tracing->createContext(server, server);
+  onewaytest::OneWayServiceClient stub(client);
+
+  // The client's call is made as part of a trace the caller started
+  TTraceContext caller = tracer->startSpan(TTraceContext());
+  TTracer::setCurrent(caller);
+  stub.send_roundTripRPC();
+  TTracer::setCurrent(TTraceContext());
+  BOOST_CHECK(processor.process(server, server, connection));
+  BOOST_CHECK(!TTracer::current().valid());
+  stub.recv_roundTripRPC();
+
+  stub.send_oneWayRPC();
+  BOOST_CHECK(processor.process(server, server, connection));
+  tracing->deleteContext(connection, server, server);
+
+  std::vector<TSpan> spans;
+  BOOST_REQUIRE_EQUAL(tracer->drain(spans), 4u);
+  BOOST_CHECK_EQUAL(tracer->drain(spans), 0u);
+
+  // Spans are recorded as they end: the server's first
+  const TSpan& serverSpan = spans[0];
+  const TSpan& clientSpan = spans[1];
+  BOOST_CHECK_EQUAL(clientSpan.kind, T_SPAN_CLIENT);
+  BOOST_CHECK_EQUAL(clientSpan.name, "roundTripRPC");
+  BOOST_CHECK_EQUAL(clientSpan.context.traceId, caller.traceId);
+  BOOST_CHECK_EQUAL(clientSpan.context.parentSpanId, caller.spanId);
+  BOOST_CHECK(!clientSpan.error);
+  BOOST_CHECK_EQUAL(serverSpan.kind, T_SPAN_SERVER);
+  BOOST_CHECK_EQUAL(serverSpan.name, "OneWayService.roundTripRPC");
+  BOOST_CHECK_EQUAL(serverSpan.context.traceId, caller.traceId);
+  BOOST_CHECK_EQUAL(serverSpan.context.parentSpanId, clientSpan.context.spanId);
+  BOOST_CHECK(!serverSpan.error);
+  BOOST_CHECK_EQUAL(handler->context.spanId, serverSpan.context.spanId);
+  BOOST_CHECK_GT(serverSpan.startMicros, 0);
+
+  // The oneway call started a trace of its own, which ended when it was sent
+  const TSpan& onewayClient = spans[2];
+  const TSpan& onewayServer = spans[3];
+  BOOST_CHECK_EQUAL(onewayClient.name, "oneWayRPC");
+  BOOST_CHECK_NE(onewayClient.context.traceId, caller.traceId);
+  BOOST_CHECK_EQUAL(onewayClient.context.parentSpanId, 0u);
+  BOOST_CHECK_EQUAL(onewayServer.context.traceId, onewayClient.context.traceId);
+  BOOST_CHECK_EQUAL(onewayServer.context.parentSpanId, onewayClient.context.spanId);
+}
@@ -0,0 +1,131 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string>
+#include <thrift/protocol/TTypeDescriptor.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+#include "gen-cpp/Recursive_types.h"
+
+#define BOOST_TEST_MODULE TypeDescriptorTest
+#include <boost/test/unit_test.hpp>
+
+using namespace apache::thrift::protocol;
+using namespace thrift::test::debug;
+
+BOOST_AUTO_TEST_CASE(test_descriptor_fields) {
+  const TStructDescriptor& desc = OneOfEach::__descriptor;
+  BOOST_CHECK_EQUAL("OneOfEach", desc.name);
+  BOOST_REQUIRE_EQUAL(14u, desc.fieldCount);
+
+  const TFieldDescriptor* field = desc.findField(8);
+  BOOST_REQUIRE(field != nullptr);
+  BOOST_CHECK_EQUAL("some_characters", field->name);
+  BOOST_CHECK_EQUAL(T_STRING, field->type->type);
+  BOOST_CHECK(!field->type->binary);
+  BOOST_CHECK_EQUAL(T_DEFAULT_FIELD, field->requiredness);
+  BOOST_CHECK(desc.findField("some_characters") == field);
+
+  field = desc.findField("base64");
+  BOOST_REQUIRE(field != nullptr);
+  BOOST_CHECK_EQUAL(11, field->id);
+  BOOST_CHECK(field->type->binary);
+
+  field = desc.findField("i16_list");
+  BOOST_REQUIRE(field != nullptr);
+  BOOST_CHECK_EQUAL(T_LIST, field->type->type);
+  BOOST_CHECK_EQUAL(T_I16, field->type->elem->type);
+
+  BOOST_CHECK(desc.findField(15) == nullptr);
+  BOOST_CHECK(desc.findField("nothing") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_descriptor_members) {
+  OneOfEach ooe;
+  ooe.integer32 = 42;
+  ooe.some_characters = "hello";
+  const TStructDescriptor& desc = OneOfEach::__descriptor;
+
+  const TFieldDescriptor* field = desc.findField("integer32");
+  BOOST_CHECK_EQUAL(42, *static_cast<const int32_t*>(TStructDescriptor::member(&ooe, *field)));
+  field = desc.findField("some_characters");
+  *static_cast<std::string*>(TStructDescriptor::member(&ooe, *field)) += " world";
+  BOOST_CHECK_EQUAL("hello world", ooe.some_characters);
+
+  uint32_t index = static_cast<uint32_t>(field - desc.fields);
+  BOOST_CHECK(!desc.isSet(&ooe, index));
+  desc.setIsSet(&ooe, index, true);
+  BOOST_CHECK(ooe.__isset.some_characters);
+  BOOST_CHECK(desc.isSet(&ooe, index));
+}
+
+BOOST_AUTO_TEST_CASE(test_descriptor_nested_types) {
+  const TStructDescriptor& desc = HolyMoley::__descriptor;
+  BOOST_REQUIRE_EQUAL(3u, desc.fieldCount);
+
+  const TTypeDescriptor* big = desc.fields[0].type;
+  BOOST_CHECK_EQUAL(T_LIST, big->type);
+  BOOST_CHECK_EQUAL(T_STRUCT, big->elem->type);
+  BOOST_CHECK(big->elem->structType == &OneOfEach::__descriptor);
+
+  const TTypeDescriptor* contain = desc.fields[1].type;
+  BOOST_CHECK_EQUAL(T_SET, contain->type);
+  BOOST_CHECK_EQUAL(T_LIST, contain->elem->type);
+  BOOST_CHECK_EQUAL(T_STRING, contain->elem->elem->type);
+
+  const TTypeDescriptor* bonks = desc.fields[2].type;
+  BOOST_CHECK_EQUAL(T_MAP, bonks->type);
+  BOOST_CHECK_EQUAL(T_STRING, bonks->elem->type);
+  BOOST_CHECK_EQUAL(T_LIST, bonks->value->type);
+  BOOST_CHECK(bonks->value->elem->structType == &Bonk::__descriptor);
+
+  // Typedefs are resolved
+  const TTypeDescriptor* somemap = StructWithASomemap::__descriptor.fields[0].type;
+  BOOST_CHECK_EQUAL(T_MAP, somemap->type);
+  BOOST_CHECK_EQUAL(T_I32, somemap->value->type);
+}
+
+BOOST_AUTO_TEST_CASE(test_descriptor_requiredness) {
+  SingleMapTestStruct required;
+  const TStructDescriptor& desc = SingleMapTestStruct::__descriptor;
+  BOOST_CHECK_EQUAL(T_REQUIRED_FIELD, desc.fields[0].requiredness);
+  BOOST_CHECK(desc.isSet(&required, 0));
+
+  // Fields are in id order, and implicit ids are negative
+  const TStructDescriptor& tuple = TupleProtocolTestStruct::__descriptor;
+  BOOST_REQUIRE_EQUAL(12u, tuple.fieldCount);
+  BOOST_CHECK_EQUAL(-12, tuple.fields[0].id);
+  BOOST_CHECK_EQUAL("field12", tuple.fields[0].name);
+  BOOST_CHECK_EQUAL(T_OPTIONAL_FIELD, tuple.fields[0].requiredness);
+  BOOST_CHECK_EQUAL("field3", tuple.findField(-3)->name);
+
+  BOOST_CHECK_EQUAL(0u, Empty::__descriptor.fieldCount);
+}
+
+BOOST_AUTO_TEST_CASE(test_descriptor_recursive) {
+  const TStructDescriptor& tree = RecTree::__descriptor;
+  BOOST_CHECK(tree.fields[0].type->elem->structType == &tree);
+  BOOST_CHECK(!tree.fields[0].reference);
+
+  const TStructDescriptor& list = RecList::__descriptor;
+  BOOST_CHECK(list.fields[0].reference);
+  BOOST_CHECK(list.fields[0].type->structType == &list);
+
+  BOOST_CHECK(CoRec::__descriptor.fields[0].type->structType == &CoRec2::__descriptor);
+  BOOST_CHECK(CoRec2::__descriptor.fields[0].type->structType == &CoRec::__descriptor);
+}
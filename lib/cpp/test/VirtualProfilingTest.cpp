@@ -0,0 +1,196 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <thrift/TDispatchProcessor.h>
+#include <thrift/VirtualProfiling.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#define BOOST_TEST_MODULE VirtualProfilingTest
+#include <boost/test/unit_test.hpp>
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+
+class EchoProcessor : public TDispatchProcessorT<TBinaryProtocol> {
+protected:
+  bool dispatchCall(TProtocol*, TProtocol*, const std::string&, int32_t, void*) override {
+    return true;
+  }
+
+  bool dispatchCallTemplated(TBinaryProtocol*,
+                             TBinaryProtocol*,
+                             const std::string&,
+                             int32_t,
+                             void*) override {
+    return true;
+  }
+};
+
+// Writes an i32 through the base classes, as generated code without
+// templates does
+static void writeVirtually(TProtocol& protocol, int calls) {
+  for (int i = 0; i < calls; ++i) {
+    protocol.writeI32(i);
+  }
+}
+
+static const TVirtualProfiler::Entry* find(const std::vector<TVirtualProfiler::Entry>& entries,
+                                           TVirtualProfiler::CallKind kind,
+                                           const std::string& protocol,
+                                           const std::string& transport) {
+  for (const auto& entry : entries) {
+    if (entry.kind == kind && entry.protocol.find(protocol) != std::string::npos
+        && entry.transport.find(transport) != std::string::npos) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+struct ProfilerFixture {
+  ProfilerFixture() { TVirtualProfiler::reset(); }
+  ~ProfilerFixture() {
+    TVirtualProfiler::disable();
+    TVirtualProfiler::reset();
+  }
+};
+
+BOOST_FIXTURE_TEST_CASE(test_disabled, ProfilerFixture) {
+  BOOST_CHECK(!TVirtualProfiler::isEnabled());
+  TBinaryProtocol protocol(std::make_shared<TMemoryBuffer>());
+  writeVirtually(protocol, 10);
+  BOOST_CHECK(TVirtualProfiler::snapshot().empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_virtual_calls, ProfilerFixture) {
+  TVirtualProfiler::enable(0);
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol binary(buffer);
+  TCompactProtocol compact(buffer);
+  writeVirtually(binary, 100);
+  writeVirtually(compact, 10);
+
+  // Transport calls made through the base class are counted too
+  TTransport& transport = *buffer;
+  uint8_t byte = 0;
+  transport.write(&byte, 1);
+
+  // Calls on other threads are kept after they exit
+  std::thread thread([&compact] { writeVirtually(compact, 5); });
+  thread.join();
+
+  TVirtualProfiler::disable();
+  writeVirtually(binary, 100);
+
+  std::vector<TVirtualProfiler::Entry> entries = TVirtualProfiler::snapshot();
+  const TVirtualProfiler::Entry* binaryEntry
+      = find(entries, TVirtualProfiler::VIRTUAL_PROTOCOL_CALL, "TBinaryProtocolT", "TMemoryBuffer");
+  BOOST_REQUIRE(binaryEntry);
+  BOOST_CHECK_EQUAL(binaryEntry->calls, 100u);
+  BOOST_CHECK_EQUAL(binaryEntry->samples, 0u);
+  const TVirtualProfiler::Entry* compactEntry = find(entries,
+                                                     TVirtualProfiler::VIRTUAL_PROTOCOL_CALL,
+                                                     "TCompactProtocolT",
+                                                     "TMemoryBuffer");
+  BOOST_REQUIRE(compactEntry);
+  BOOST_CHECK_EQUAL(compactEntry->calls, 15u);
+  const TVirtualProfiler::Entry* transportEntry
+      = find(entries, TVirtualProfiler::VIRTUAL_TRANSPORT_CALL, "", "TMemoryBuffer");
+  BOOST_REQUIRE(transportEntry);
+  // The protocols, for TTransport, also write each i32 through the base class
+  BOOST_CHECK_EQUAL(transportEntry->calls, 116u);
+  BOOST_CHECK(transportEntry->protocol.empty());
+  // Most frequent first
+  BOOST_CHECK_EQUAL(&entries.front(), transportEntry);
+
+  TVirtualProfiler::reset();
+  BOOST_CHECK(TVirtualProfiler::snapshot().empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_generic_protocol, ProfilerFixture) {
+  TVirtualProfiler::enable(0);
+  EchoProcessor processor;
+  for (int i = 0; i < 2; ++i) {
+    std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    std::shared_ptr<TProtocol> protocol;
+    if (i == 0) {
+      protocol.reset(new TBinaryProtocol(buffer));
+    } else {
+      protocol.reset(new TCompactProtocol(buffer));
+    }
+    protocol->writeMessageBegin("echo", T_CALL, 1);
+    protocol->writeMessageEnd();
+    BOOST_CHECK(processor.process(protocol, protocol, nullptr));
+  }
+
+  std::vector<TVirtualProfiler::Entry> entries = TVirtualProfiler::snapshot();
+  const TVirtualProfiler::Entry* generic = find(entries,
+                                                TVirtualProfiler::GENERIC_PROTOCOL_CALL,
+                                                "TCompactProtocolT",
+                                                "TMemoryBuffer");
+  BOOST_REQUIRE(generic);
+  // Once for the input and once for the output
+  BOOST_CHECK_EQUAL(generic->calls, 2u);
+  BOOST_CHECK_NE(generic->processor.find("EchoProcessor"), std::string::npos);
+  BOOST_CHECK(!find(entries, TVirtualProfiler::GENERIC_PROTOCOL_CALL, "TBinaryProtocolT", ""));
+}
+
+BOOST_FIXTURE_TEST_CASE(test_pprof, ProfilerFixture) {
+  TVirtualProfiler::enable(10);
+  TBinaryProtocol protocol(std::make_shared<TMemoryBuffer>());
+  writeVirtually(protocol, 1000);
+
+  std::vector<TVirtualProfiler::Entry> entries = TVirtualProfiler::snapshot();
+  const TVirtualProfiler::Entry* entry
+      = find(entries, TVirtualProfiler::VIRTUAL_PROTOCOL_CALL, "TBinaryProtocolT", "TMemoryBuffer");
+  BOOST_REQUIRE(entry);
+  BOOST_CHECK_EQUAL(entry->calls, 1000u);
+  // One call in ten on average, of the protocol's and its transport's
+  // together, and from both
+  uint64_t samples = 0;
+  for (const auto& e : entries) {
+    BOOST_CHECK_GT(e.samples, 0u);
+    samples += e.samples;
+  }
+  BOOST_CHECK_GE(samples, 150u);
+  BOOST_CHECK_LE(samples, 250u);
+
+  FILE* f = tmpfile();
+  BOOST_REQUIRE(f);
+  BOOST_CHECK(TVirtualProfiler::writePprof(f));
+  long size = ftell(f);
+  rewind(f);
+  std::string profile(static_cast<size_t>(size), '\0');
+  BOOST_REQUIRE_EQUAL(fread(&profile[0], 1, profile.size(), f), profile.size());
+  fclose(f);
+
+  // Starts with the first sample type, and names the types called
+  BOOST_CHECK_EQUAL(profile[0], '\x0a');
+  BOOST_CHECK_NE(profile.find("virtual_protocol"), std::string::npos);
+  BOOST_CHECK_NE(profile.find("TMemoryBuffer"), std::string::npos);
+}
@@ -0,0 +1,238 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/Mutex.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+namespace test {
+
+using namespace apache::thrift::concurrency;
+
+/**
+ * MutexTests class
+ *
+ * @version :$
+ */
+class MutexTests {
+
+public:
+  /**
+   * Increment a counter from count threads, each loop times, under a mutex
+   */
+  bool contentionTest(int count = 8, int loop = 100000) {
+
+    Mutex mutex;
+    int64_t counter = 0;
+    std::vector<std::thread> threads;
+
+    for (int ix = 0; ix < count; ix++) {
+      threads.emplace_back([&mutex, &counter, loop] {
+        for (int lix = 0; lix < loop; lix++) {
+          Guard g(mutex);
+          ++counter;
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    bool success = counter == static_cast<int64_t>(count) * loop;
+
+    std::cout << "\t\t\t" << (success ? "Success" : "Failure") << ": counted " << counter
+              << std::endl;
+
+    return success;
+  }
+
+  /**
+   * Try to lock, with and without a timeout, a mutex another thread holds
+   */
+  bool timedlockTest(int64_t timeout = 20) {
+
+    Mutex mutex;
+    std::atomic<bool> locked(false);
+    std::atomic<bool> release(false);
+
+    std::thread holder([&] {
+      mutex.lock();
+      locked = true;
+      while (!release) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      mutex.unlock();
+    });
+
+    while (!locked) {
+      std::this_thread::yield();
+    }
+
+    bool success = !mutex.trylock();
+
+    auto start = std::chrono::steady_clock::now();
+    success = !mutex.timedlock(timeout) && success;
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    success = elapsed >= timeout && success;
+
+    {
+      Guard g(mutex, -1);
+      success = !g && success;
+    }
+
+    release = true;
+    success = mutex.timedlock(10000) && success;
+    mutex.unlock();
+    holder.join();
+
+    success = mutex.trylock() && success;
+    mutex.unlock();
+
+    std::cout << "\t\t\t" << (success ? "Success" : "Failure") << ": timed out after " << elapsed
+              << "ms" << std::endl;
+
+    return success;
+  }
+
+  /**
+   * Wake count threads waiting on a monitor, one at a time and then all at
+   * once
+   */
+  bool notifyTest(int count = 8) {
+
+    Monitor monitor;
+    int tickets = 0;
+    int waiting = 0;
+    int done = 0;
+    std::vector<std::thread> threads;
+
+    for (int ix = 0; ix < count; ix++) {
+      threads.emplace_back([&] {
+        Synchronized s(monitor);
+        ++waiting;
+        monitor.notifyAll();
+        while (tickets == 0) {
+          monitor.wait();
+        }
+        --tickets;
+        ++done;
+        monitor.notifyAll();
+      });
+    }
+
+    bool success = true;
+    {
+      Synchronized s(monitor);
+      while (waiting < count) {
+        monitor.wait();
+      }
+
+      // One by one, for half of them
+      for (int ix = 0; ix < count / 2; ix++) {
+        ++tickets;
+        monitor.notify();
+        while (done <= ix) {
+          monitor.wait();
+        }
+      }
+
+      // And the rest together
+      tickets += count - count / 2;
+      monitor.notifyAll();
+      while (done < count) {
+        success = monitor.waitForTimeRelative(10000) == 0 && success;
+      }
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    std::cout << "\t\t\t" << (success ? "Success" : "Failure") << ": woke " << done << " threads"
+              << std::endl;
+
+    return success;
+  }
+
+  static std::atomic<int> contentions;
+  static std::atomic<const void*> contendedId;
+  static std::atomic<int64_t> contendedMicros;
+  static std::atomic<const void*> holderCallsite;
+
+  static void recordContention(const MutexContention& contention) {
+    contendedId = contention.id;
+    contendedMicros = contention.waitTimeMicros;
+    holderCallsite = contention.holderCallsite;
+    ++contentions;
+  }
+
+  /**
+   * Make a thread wait for a mutex, with profiling enabled
+   */
+  bool profilingTest(int64_t hold = 20) {
+
+    Mutex mutex;
+    contentions = 0;
+    enableMutexProfiling(1, &recordContention);
+
+    mutex.lock();
+    std::thread waiter([&mutex] {
+      Guard g(mutex);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(hold));
+    mutex.unlock();
+    waiter.join();
+
+    enableMutexProfiling(0, nullptr);
+
+    // Uncontended, and unprofiled, acquisitions are not reported
+    mutex.lock();
+    mutex.unlock();
+
+    bool success = contentions == 1 && contendedId == &mutex && contendedMicros >= hold * 900
+                   && holderCallsite != nullptr;
+
+    std::cout << "\t\t\t" << (success ? "Success" : "Failure") << ": " << contentions
+              << " contentions reported, waited " << contendedMicros << "us" << std::endl;
+
+    return success;
+  }
+};
+
+std::atomic<int> MutexTests::contentions(0);
+std::atomic<const void*> MutexTests::contendedId(nullptr);
+std::atomic<int64_t> MutexTests::contendedMicros(0);
+std::atomic<const void*> MutexTests::holderCallsite(nullptr);
+}
+}
+}
+} // apache::thrift::concurrency::test
+
+using namespace apache::thrift::concurrency::test;
@@ -21,6 +21,7 @@
 #include <vector>
 #include <string>
 
+#include "MutexTests.h"
 #include "ThreadFactoryTests.h"
 #include "TimerManagerTests.h"
 #include "ThreadManagerTests.h"
@@ -46,6 +47,44 @@ int main(int argc, char** argv) {
 
   bool runAll = args[0].compare("all") == 0;
 
+  if (runAll || args[0].compare("mutex") == 0) {
+
+    MutexTests mutexTests;
+
+    std::cout << "Mutex tests..." << std::endl;
+
+    int contentionCount = WEIGHT;
+    int contentionLoop = 10000 * WEIGHT;
+
+    std::cout << "\t\tMutex contention test: N = " << contentionCount << "x" << contentionLoop << std::endl;
+
+    if (!mutexTests.contentionTest(contentionCount, contentionLoop)) {
+      std::cerr << "\t\tMutex contention test FAILED" << std::endl;
+      return 1;
+    }
+
+    std::cout << "\t\tMutex timed lock test" << std::endl;
+
+    if (!mutexTests.timedlockTest()) {
+      std::cerr << "\t\tMutex timed lock test FAILED" << std::endl;
+      return 1;
+    }
+
+    std::cout << "\t\tMonitor notify test: N = " << WEIGHT << std::endl;
+
+    if (!mutexTests.notifyTest(WEIGHT)) {
+      std::cerr << "\t\tMonitor notify test FAILED" << std::endl;
+      return 1;
+    }
+
+    std::cout << "\t\tMutex profiling test" << std::endl;
+
+    if (!mutexTests.profilingTest()) {
+      std::cerr << "\t\tMutex profiling test FAILED" << std::endl;
+      return 1;
+    }
+  }
+
   if (runAll || args[0].compare("thread-factory") == 0) {
 
     ThreadFactoryTests threadFactoryTests;
@@ -84,6 +123,13 @@ int main(int argc, char** argv) {
       std::cerr << "\t\ttThreadFactory monitor timeout FAILED" << std::endl;
       return 1;
     }
+
+    std::cout << "\t\tThreadFactory affinity test" << std::endl;
+
+    if (!threadFactoryTests.affinityTest()) {
+      std::cerr << "\t\ttThreadFactory affinity FAILED" << std::endl;
+      return 1;
+    }
   }
 
   if (runAll || args[0].compare("util") == 0) {
@@ -149,6 +195,13 @@ int main(int argc, char** argv) {
       std::cerr << "\t\tTimerManager tests FAILED" << std::endl;
       return 1;
     }
+
+    std::cout << "\t\tTimerManager test05" << std::endl;
+
+    if (!timerManagerTests.test05()) {
+      std::cerr << "\t\tTimerManager tests FAILED" << std::endl;
+      return 1;
+    }
   }
 
   if (runAll || args[0].compare("thread-manager") == 0) {
@@ -184,6 +237,20 @@ int main(int argc, char** argv) {
         std::cerr << "\t\tThreadManager blockTest FAILED" << std::endl;
         return 1;
       }
+
+      std::cout << "\t\tThreadManager strict priority test" << std::endl;
+
+      if (!threadManagerTests.priorityTest(ThreadManager::STRICT_PRIORITY)) {
+        std::cerr << "\t\tThreadManager strict priorityTest FAILED" << std::endl;
+        return 1;
+      }
+
+      std::cout << "\t\tThreadManager weighted fair priority test" << std::endl;
+
+      if (!threadManagerTests.priorityTest(ThreadManager::WEIGHTED_FAIR)) {
+        std::cerr << "\t\tThreadManager weighted fair priorityTest FAILED" << std::endl;
+        return 1;
+      }
     }
   }
 
@@ -18,6 +18,7 @@
  */
 
 #include <thrift/thrift-config.h>
+#include <thrift/concurrency/AffinityThreadFactory.h>
 #include <thrift/concurrency/Thread.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/concurrency/Monitor.h>
@@ -25,8 +26,13 @@
 
 #include <assert.h>
 #include <iostream>
+#include <stdexcept>
 #include <vector>
 
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
 namespace apache {
 namespace thrift {
 namespace concurrency {
@@ -300,6 +306,97 @@ public:
 
     return success;
   }
+
+  /**
+   * Records the CPUs the thread that runs it may run on
+   */
+  class AffinityTask : public Runnable {
+
+  public:
+    AffinityTask(Monitor& monitor) : _monitor(monitor), _done(false) {}
+
+    void run() override {
+      Synchronized s(_monitor);
+#if defined(__linux__)
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+          if (CPU_ISSET(cpu, &set)) {
+            _cpus.push_back(cpu);
+          }
+        }
+      }
+#endif
+      _done = true;
+      _monitor.notify();
+    }
+
+    Monitor& _monitor;
+    bool _done;
+    AffinityThreadFactory::CpuSet _cpus;
+  };
+
+  /**
+   * Checks CPU list parsing, and that threads from an AffinityThreadFactory
+   * are bound to the CPUs given, in turn
+   */
+  bool affinityTest() {
+    typedef AffinityThreadFactory::CpuSet CpuSet;
+
+    if (AffinityThreadFactory::parseCpuList("0-3,8,10-11\n") != CpuSet({0, 1, 2, 3, 8, 10, 11})
+        || AffinityThreadFactory::parseCpuList("5,1,1") != CpuSet({1, 5})
+        || !AffinityThreadFactory::parseCpuList("").empty()) {
+      std::cerr << "\t\t\tCPU lists parsed wrongly" << std::endl;
+      return false;
+    }
+    const char* bad[] = {"1-", "3-1", "a", "1,", "1,,2", "-1"};
+    for (const char* list : bad) {
+      try {
+        AffinityThreadFactory::parseCpuList(list);
+        std::cerr << "\t\t\tCPU list \"" << list << "\" was accepted" << std::endl;
+        return false;
+      } catch (const std::invalid_argument&) {
+      }
+    }
+
+    int nodes = AffinityThreadFactory::numaNodeCount();
+    std::cout << "\t\t\t" << nodes << " NUMA nodes" << std::endl;
+    CpuSet node0 = AffinityThreadFactory::numaNodeCpus(0);
+    if (nodes < 1 || node0.empty()) {
+      std::cerr << "\t\t\tno CPUs found on node 0" << std::endl;
+      return false;
+    }
+
+    // Threads get one CPU each, in turn
+    std::vector<CpuSet> cpuSets;
+    for (int cpu : node0) {
+      cpuSets.push_back(CpuSet(1, cpu));
+    }
+    AffinityThreadFactory threadFactory(cpuSets, 0, false);
+    for (size_t i = 0; i < cpuSets.size() + 1; i++) {
+      Monitor monitor;
+      shared_ptr<AffinityTask> task(new AffinityTask(monitor));
+      shared_ptr<Thread> thread = threadFactory.newThread(task);
+      {
+        Synchronized s(monitor);
+        thread->start();
+        while (!task->_done) {
+          monitor.wait();
+        }
+      }
+      thread->join();
+#if defined(__linux__)
+      if (task->_cpus != cpuSets[i % cpuSets.size()]) {
+        std::cerr << "\t\t\tthread " << i << " was not bound to CPU "
+                  << cpuSets[i % cpuSets.size()][0] << std::endl;
+        return false;
+      }
+#endif
+    }
+
+    return true;
+  }
 };
 
 }
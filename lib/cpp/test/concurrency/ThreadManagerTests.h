@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <deque>
 #include <set>
+#include <vector>
 #include <iostream>
 #include <stdint.h>
 
@@ -398,6 +399,122 @@ public:
 
   }
 
+  class PriorityTask : public Runnable {
+
+  public:
+    PriorityTask(Monitor& monitor, std::vector<PRIORITY>& order, PRIORITY priority)
+      : _monitor(monitor), _order(order), _priority(priority) {}
+
+    void run() override {
+      Synchronized s(_monitor);
+      _order.push_back(_priority);
+      _monitor.notify();
+    }
+
+    Monitor& _monitor;
+    std::vector<PRIORITY>& _order;
+    PRIORITY _priority;
+  };
+
+  /**
+   * Priority test.  Queue tasks of several priorities behind a task that
+   * blocks the only worker, and check the order they run in once it is
+   * unblocked. */
+
+  bool priorityTest(ThreadManager::SCHEDULING scheduling) {
+    std::vector<uint32_t> weights;
+    if (scheduling == ThreadManager::WEIGHTED_FAIR) {
+      weights.assign(N_PRIORITIES, 1);
+      weights[HIGH_IMPORTANT] = 3;
+    }
+    shared_ptr<ThreadManager> threadManager
+        = ThreadManager::newPriorityThreadManager(1, scheduling, weights);
+    threadManager->threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory(false)));
+    threadManager->start();
+
+    Monitor entryMonitor;
+    Monitor blockMonitor;
+    bool blocked(true);
+    Monitor doneMonitor;
+    size_t activeCount = 1;
+    shared_ptr<BlockTask> blockingTask(
+        new BlockTask(entryMonitor, blockMonitor, blocked, doneMonitor, activeCount));
+    threadManager->add(blockingTask);
+    {
+      Synchronized s(entryMonitor);
+      while (!blockingTask->_entered) {
+        entryMonitor.wait();
+      }
+    }
+
+    Monitor monitor;
+    std::vector<PRIORITY> order;
+    const size_t count = 8;
+    for (size_t ix = 0; ix < count; ix++) {
+      threadManager->add(shared_ptr<Runnable>(new PriorityTask(monitor, order, BEST_EFFORT)),
+                         0LL, 0LL, BEST_EFFORT);
+      threadManager->add(shared_ptr<Runnable>(new PriorityTask(monitor, order, NORMAL)),
+                         0LL, 0LL, NORMAL);
+      threadManager->add(shared_ptr<Runnable>(new PriorityTask(monitor, order, HIGH_IMPORTANT)),
+                         0LL, 0LL, HIGH_IMPORTANT);
+    }
+
+    bool success = true;
+    try {
+      threadManager->add(shared_ptr<Runnable>(new PriorityTask(monitor, order, NORMAL)),
+                         0LL, 0LL, N_PRIORITIES);
+      std::cerr << "			added a task of an invalid priority" << std::endl;
+      success = false;
+    } catch (InvalidArgumentException&) {
+    }
+
+    // The least urgent task is the one to drop
+    shared_ptr<Runnable> removed = threadManager->removeNextPending();
+    if (!removed || dynamic_cast<PriorityTask*>(removed.get())->_priority != BEST_EFFORT) {
+      std::cerr << "			removeNextPending did not remove a BEST_EFFORT task" << std::endl;
+      success = false;
+    }
+
+    {
+      Synchronized s(blockMonitor);
+      blocked = false;
+      blockMonitor.notifyAll();
+    }
+    {
+      Synchronized s(monitor);
+      while (order.size() < 3 * count - 1) {
+        monitor.wait();
+      }
+    }
+    threadManager->stop();
+
+    if (scheduling == ThreadManager::STRICT_PRIORITY) {
+      for (size_t ix = 0; ix < order.size(); ix++) {
+        PRIORITY expected = ix < count ? HIGH_IMPORTANT : ix < 2 * count ? NORMAL : BEST_EFFORT;
+        if (order[ix] != expected) {
+          std::cerr << "			task " << ix << " had priority " << order[ix] << ", expected "
+                    << expected << std::endl;
+          success = false;
+        }
+      }
+    } else {
+      // Of the first count tasks, about three HIGH_IMPORTANT run for each of
+      // the others, and both others run
+      size_t counts[N_PRIORITIES] = {0};
+      for (size_t ix = 0; ix < count; ix++) {
+        counts[order[ix]]++;
+      }
+      if (counts[HIGH_IMPORTANT] < 4 || counts[HIGH_IMPORTANT] > 6 || counts[NORMAL] == 0
+          || counts[BEST_EFFORT] == 0) {
+        std::cerr << "			first " << count << " tasks ran " << counts[HIGH_IMPORTANT] << " "
+                  << counts[NORMAL] << " " << counts[BEST_EFFORT]
+                  << " HIGH_IMPORTANT, NORMAL and BEST_EFFORT tasks" << std::endl;
+        success = false;
+      }
+    }
+    return success;
+  }
+
   bool apiTestWithThreadFactory(shared_ptr<ThreadFactory> threadFactory)
   {
     shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(1);
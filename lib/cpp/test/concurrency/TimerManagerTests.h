@@ -25,6 +25,7 @@
 #include <chrono>
 #include <thread>
 #include <iostream>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -262,6 +263,97 @@ public:
     return true;
   }
 
+  /**
+   * Counts the tasks run, and those run before they were due.
+   */
+  class CountingTask : public Runnable {
+  public:
+    CountingTask(Monitor& monitor, size_t& count, size_t& early, int64_t timeout)
+      : _monitor(monitor),
+        _count(count),
+        _early(early),
+        _due(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout)) {}
+
+    void run() override {
+      Synchronized s(_monitor);
+      if (std::chrono::steady_clock::now() < _due) {
+        _early++;
+      }
+      _count++;
+      _monitor.notifyAll();
+    }
+
+    Monitor& _monitor;
+    size_t& _count;
+    size_t& _early;
+    std::chrono::time_point<std::chrono::steady_clock> _due;
+  };
+
+  /**
+   * This test adds many tasks from several threads, with timeouts long
+   * enough for some to be cascaded between wheel levels, removes every other
+   * one, and checks that the rest run, and none before it is due.
+   */
+  bool test05(uint64_t timeout = 1000LL) {
+    TimerManager timerManager;
+    timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
+    timerManager.start();
+    assert(timerManager.state() == TimerManager::STARTED);
+
+    const size_t threadCount = 4;
+    const size_t tasksPerThread = 500;
+    size_t count = 0;
+    size_t early = 0;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; i++) {
+      threads.emplace_back([&, i]() {
+        std::vector<TimerManager::Timer> timers;
+        for (size_t j = 0; j < tasksPerThread; j++) {
+          int64_t taskTimeout = static_cast<int64_t>(1 + (i * tasksPerThread + j) % timeout);
+          timers.push_back(timerManager.add(
+              std::make_shared<CountingTask>(_monitor, count, early, taskTimeout), taskTimeout));
+        }
+        for (size_t j = 0; j < tasksPerThread; j += 2) {
+          try {
+            timerManager.remove(timers[j]);
+          } catch (const UncancellableTaskException&) {
+            // Already ran, which is counted below
+          } catch (const NoSuchTaskException&) {
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    const size_t expected = threadCount * tasksPerThread / 2;
+    {
+      Synchronized s(_monitor);
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout * 3);
+      while (count < expected && std::chrono::steady_clock::now() < deadline) {
+        _monitor.waitForTime(deadline);
+      }
+      if (count < expected || count > threadCount * tasksPerThread) {
+        std::cerr << "ran " << count << " tasks, expected at least " << expected << std::endl;
+        return false;
+      }
+      if (early != 0) {
+        std::cerr << early << " tasks ran before they were due" << std::endl;
+        return false;
+      }
+    }
+
+    // Let any task that was running when counted finish
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (timerManager.taskCount() != 0) {
+      std::cerr << timerManager.taskCount() << " tasks left, expected none" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
   friend class TestTask;
 
   Monitor _monitor;
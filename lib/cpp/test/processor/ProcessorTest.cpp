@@ -851,6 +851,55 @@ void testUnexpectedError() {
   checkNoEvents(log);
 }
 
+template <typename TemplateTraits>
+void testPriorities() {
+  std::shared_ptr<EventLog> log(new EventLog);
+  std::shared_ptr<ChildHandler> handler(new ChildHandler(log));
+  typename TemplateTraits::ParentProcessor parent(handler);
+  typename TemplateTraits::ChildProcessor child(handler);
+
+  // Annotated functions have their priority, inherited ones included
+  BOOST_CHECK_EQUAL(parent.getPriority("onewayWait"), apache::thrift::concurrency::BEST_EFFORT);
+  BOOST_CHECK_EQUAL(parent.getPriority("getValue"), apache::thrift::concurrency::NORMAL);
+  BOOST_CHECK_EQUAL(child.getPriority("getValue"), apache::thrift::concurrency::HIGH);
+  BOOST_CHECK_EQUAL(child.getPriority("onewayWait"), apache::thrift::concurrency::BEST_EFFORT);
+  BOOST_CHECK_EQUAL(child.getPriority("setValue"), apache::thrift::concurrency::NORMAL);
+  BOOST_CHECK_EQUAL(child.getPriority("unknown"), apache::thrift::concurrency::NORMAL);
+}
+
+BOOST_AUTO_TEST_CASE(Templated_priorities) {
+  testPriorities<TemplatedTraits>();
+}
+
+BOOST_AUTO_TEST_CASE(Untemplated_priorities) {
+  testPriorities<UntemplatedTraits>();
+}
+
+template <typename TemplateTraits>
+void testInline() {
+  std::shared_ptr<EventLog> log(new EventLog);
+  std::shared_ptr<ChildHandler> handler(new ChildHandler(log));
+  typename TemplateTraits::ParentProcessor parent(handler);
+  typename TemplateTraits::ChildProcessor child(handler);
+
+  // Annotated functions are inline, inherited ones included
+  BOOST_CHECK(parent.isInline("getGeneration"));
+  BOOST_CHECK(!parent.isInline("getValue"));
+  BOOST_CHECK(!parent.isInline("incrementGeneration"));
+  BOOST_CHECK(child.isInline("getValue"));
+  BOOST_CHECK(child.isInline("getGeneration"));
+  BOOST_CHECK(!child.isInline("setValue"));
+  BOOST_CHECK(!child.isInline("unknown"));
+}
+
+BOOST_AUTO_TEST_CASE(Templated_inline) {
+  testInline<TemplatedTraits>();
+}
+
+BOOST_AUTO_TEST_CASE(Untemplated_inline) {
+  testInline<UntemplatedTraits>();
+}
+
 // Macro to define simple tests that can be used with all server types
 #define DEFINE_SIMPLE_TESTS(Server, Template)                                                      \
   BOOST_AUTO_TEST_CASE(Server##_##Template##_basicService) {                                       \
@@ -6,17 +6,17 @@ exception MyError {
 
 service ParentService {
   i32 incrementGeneration()
-  i32 getGeneration()
+  i32 getGeneration() (inline)
   void addString(1: string s)
   list<string> getStrings()
 
   binary getDataWait(1: i32 length)
-  oneway void onewayWait()
+  oneway void onewayWait() (priority = "BEST_EFFORT")
   void exceptionWait(1: string message) throws (2: MyError error)
   void unexpectedExceptionWait(1: string message)
 }
 
 service ChildService extends ParentService {
   i32 setValue(1: i32 value)
-  i32 getValue()
+  i32 getValue() (priority = "HIGH", inline = "true")
 }